@@ -52,6 +52,8 @@ void zsfo::Mog::init(const Mat& image)
     width = image.cols, height = image.rows;
     type = image.type();
     count = 1;
+    relearnCount = 0;
+    countBeforeRelearn = 1;
     if (type == CV_8UC1)
         model.create(height, width * sizeof(ModelC1) * numGauss, CV_8UC1);
     else if (type == CV_8UC3)
@@ -111,12 +113,7 @@ void zsfo::Mog::update(const Mat& image, Mat& fore, Mat& back, const vector<Rect
     
     fore.create(height, width, CV_8UC1);
     back.create(height, width, type);
-    float learnRate = minLearnRate;
-    if (count < maxCount)
-    {
-        count++;
-        learnRate = 1.0F / count;
-    }
+    float learnRate = getLearnRate();
     memset(mask.data, 255, width * height);
     if (!noUpdate.empty())
     {
@@ -407,12 +404,7 @@ void zsfo::Mog::update(const Mat& image, Mat& fore, const vector<Rect>& noUpdate
         THROW_EXCEPT("input image size or format not valid");
 
     fore.create(height, width, CV_8UC1);
-    float learnRate = minLearnRate;
-    if (count < maxCount)
-    {
-        count++;
-        learnRate = 1.0F / count;
-    }
+    float learnRate = getLearnRate();
     memset(mask.data, 255, width * height);
     if (!noUpdate.empty())
     {
@@ -692,12 +684,7 @@ void zsfo::Mog::update(const Mat& image, const vector<Rect>& noUpdate)
     if (image.cols != width && image.rows != height && image.type() != type)
         THROW_EXCEPT("input image size or format not valid");
 
-    float learnRate = minLearnRate;
-    if (count < maxCount)
-    {
-        count++;
-        learnRate = 1.0F / count;
-    }
+    float learnRate = getLearnRate();
     memset(mask.data, 255, width * height);
     if (!noUpdate.empty())
     {
@@ -906,6 +893,33 @@ void zsfo::Mog::update(const Mat& image, const vector<Rect>& noUpdate)
     }
 }
 
+float zsfo::Mog::getLearnRate(void)
+{
+    float learnRate = minLearnRate;
+    if (count < maxCount)
+    {
+        count++;
+        learnRate = 1.0F / count;
+    }
+    // 重新学习结束, 恢复更新次数, 下一次更新使用原来的学习率
+    if (relearnCount > 0 && --relearnCount == 0 && count < countBeforeRelearn)
+        count = countBeforeRelearn;
+    return learnRate;
+}
+
+void zsfo::Mog::relearn(int numOfFrames)
+{
+    if (!model.data)
+        THROW_EXCEPT("model is empty");
+    if (numOfFrames < 1)
+        numOfFrames = 1;
+    if (relearnCount == 0)
+        countBeforeRelearn = count;
+    relearnCount = numOfFrames;
+    if (count > numOfFrames)
+        count = numOfFrames;
+}
+
 void zsfo::Mog::getBackground(Mat& back) const
 {
     if (!model.data)
@@ -41,10 +41,25 @@ public:
         const std::vector<cv::Rect>& noUpdate = std::vector<cv::Rect>());
     //! 获取背景图, 格式和尺寸同处理图片相同
     void getBackground(cv::Mat& backImage) const;
+    //! 快速重新学习背景
+    /*!
+        学习率等于 1 / 更新次数, 把更新次数减小到 numOfFrames 使学习率临时增大,
+        之后的 numOfFrames 次更新学习率从 1 / (numOfFrames + 1) 逐渐减小,
+        结束后更新次数恢复为重新学习之前的值, 学习率立即回到原来的值.
+        重新学习期间再次调用时重新计算帧数, 结束后仍然恢复为第一次调用之前的值.
+        光照突变或者镜头移动后调用, 新的背景在几帧之内成为主要的高斯分布
+        \param[in] numOfFrames 重新学习的帧数, 小于 1 时按 1 处理
+     */
+    Z_LIB_EXPORT void relearn(int numOfFrames);
 private:
+    //! 每次更新时增加更新次数, 返回本次更新的学习率
+    float getLearnRate(void);
+
     cv::Mat model, mask;
     int type, width, height;
     int count;
+    int relearnCount;              ///< 剩余的重新学习的更新次数
+    int countBeforeRelearn;        ///< 重新学习之前的更新次数
 };
 
 }
\ No newline at end of file
@@ -10,6 +10,8 @@ using namespace std;
 using namespace cv;
 
 const static int adjPositions[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+// 随机数种子固定, 相同的输入总是得到相同的输出, 多个实例在不同线程中运行的结果与单线程运行一致
+const static long long int randSeeds[6] = {0x2F6B4C91, 0x5D0E37A3, 0x1C93F6E5, 0x7A48D21B, 0x3E7C5A0F, 0x64B1E987};
 
 namespace zsfo
 {
@@ -37,11 +39,11 @@ void ViBe::init(const Mat& image, const Config& config)
     //printf("\n");
 
     // 初始化随机数
-    rndReplaceCurr.init(imageWidth * imageHeight, 0, subSampleInterval, getTickCount());
-    rndIndexCurr.init(imageWidth * imageHeight, 0, numOfSamples, getTickCount() / 2);
-    rndReplaceAdj.init(imageWidth * imageHeight, 0, subSampleInterval, getTickCount() / 3);
-    rndPositionAdj.init(imageWidth * imageHeight, 0, 8, getTickCount() / 4);
-    rndIndexAdj.init(imageWidth * imageHeight, 0, numOfSamples, getTickCount() / 5); 
+    rndReplaceCurr.init(imageWidth * imageHeight, 0, subSampleInterval, randSeeds[0]);
+    rndIndexCurr.init(imageWidth * imageHeight, 0, numOfSamples, randSeeds[1]);
+    rndReplaceAdj.init(imageWidth * imageHeight, 0, subSampleInterval, randSeeds[2]);
+    rndPositionAdj.init(imageWidth * imageHeight, 0, 8, randSeeds[3]);
+    rndIndexAdj.init(imageWidth * imageHeight, 0, numOfSamples, randSeeds[4]); 
 
     // 不更新区域图
     noUpdateImage = Mat::zeros(imageHeight, imageWidth, CV_8UC1);
@@ -80,7 +82,7 @@ void ViBe::refill(const Mat& image)
 void ViBe::fill8UC3(const Mat& image)
 {
     RandUniformInt rndInit;
-    rndInit.init(imageWidth * imageHeight * numOfSamples, 0, 8, getTickCount());
+    rndInit.init(imageWidth * imageHeight * numOfSamples, 0, 8, randSeeds[5]);
     // 输入图片的行首地址
     const unsigned char** ptrImage = new const unsigned char* [imageHeight];
     for (int i = 0; i < imageHeight; i++)
@@ -106,7 +108,7 @@ void ViBe::fill8UC3(const Mat& image)
 void ViBe::fill8UC1(const Mat& image)
 {
     RandUniformInt rndInit;
-    rndInit.init(imageWidth * imageHeight * numOfSamples, 0, 8, getTickCount());
+    rndInit.init(imageWidth * imageHeight * numOfSamples, 0, 8, randSeeds[5]);
     // 输入图片的行首地址
     const unsigned char** ptrImage = new const unsigned char* [imageHeight];
     for (int i = 0; i < imageHeight; i++)
@@ -115,6 +115,10 @@ void Blob::initConfigParam(const string& path)
         initFileStream >> configOutputInfo->runOutputHistory;
         initFileStream >> stringNotUsed;
         initFileStream >> configOutputInfo->runOutputVisualAndState;
+        initFileStream >> stringNotUsed;
+        initFileStream >> configOutputInfo->runInterpolateHistory;
+        initFileStream >> stringNotUsed;
+        initFileStream >> configOutputInfo->maxInterpolateFrameGap;
 
         initFileStream.close();
     }
@@ -126,6 +130,8 @@ void Blob::initConfigParam(const string& path)
         configOutputInfo->minHistorySizeForOutput = 0;
         configOutputInfo->runOutputHistory = true;
         configOutputInfo->runOutputVisualAndState = true;
+        configOutputInfo->runInterpolateHistory = false;
+        configOutputInfo->maxInterpolateFrameGap = 10;
     }
 
 #if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
@@ -135,6 +141,8 @@ void Blob::initConfigParam(const string& path)
     printf("    configOutputInfo.minHistorySizeForOutput = %d\n", configOutputInfo->minHistorySizeForOutput);
     printf("    configOutputInfo.runOutputHistory = %s\n", configOutputInfo->runOutputHistory ? "true" : "false");
     printf("    configOutputInfo.runOutputVisualAndState = %s\n", configOutputInfo->runOutputVisualAndState ? "true" : "false");
+    printf("    configOutputInfo.runInterpolateHistory = %s\n", configOutputInfo->runInterpolateHistory ? "true" : "false");
+    printf("    configOutputInfo.maxInterpolateFrameGap = %d\n", configOutputInfo->maxInterpolateFrameGap);
 
     printf("\n");
 #endif
@@ -169,6 +177,11 @@ void Blob::updateState(OrigSceneProxy& origFrame, OrigForeProxy& foreImage,
     if (snapshotHistory) snapshotHistory->updateHistory(origFrame, foreImage, matchRect);
 }
 
+bool Blob::mustUpdateSnapshot(void) const
+{
+    return !isToBeDeleted && snapshotHistory && snapshotHistory->mustUpdate(matchRect);
+}
+
 bool Blob::outputInfo(ObjectInfo& objectInfo, bool isFinal) const
 {
     objectInfo.ID = ID;     
@@ -183,7 +196,7 @@ bool Blob::outputInfo(ObjectInfo& objectInfo, bool isFinal) const
 
     objectInfo.isFinal = 1;
 
-    if (rectHistory->history.size() < configOutputInfo->minHistorySizeForOutput)
+    if (rectHistory->totalSize() < configOutputInfo->minHistorySizeForOutput)
     {
         objectInfo.hasHistory = 0;
 #if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
@@ -192,8 +205,10 @@ bool Blob::outputInfo(ObjectInfo& objectInfo, bool isFinal) const
         return true;
     }
 
+    rectHistory->outputStatistics(objectInfo);
     if (configOutputInfo->runOutputHistory)
-        rectHistory->outputHistory(objectInfo);
+        rectHistory->outputHistory(objectInfo, configOutputInfo->runInterpolateHistory, 
+            configOutputInfo->maxInterpolateFrameGap);
 
     if (configOutputInfo->runOutputVisualAndState)
         if (snapshotHistory) snapshotHistory->outputHistory(objectInfo);
@@ -212,6 +227,33 @@ void Blob::drawHistory(Mat& normalImage, const Scalar& color) const
     rectHistory->drawCenterHistory(normalImage, color);
 }
 
+void Blob::setOutputParams(const bool* interpolateHistory, const int* maxInterpolateFrameGap)
+{
+    if (!(interpolateHistory || maxInterpolateFrameGap))
+        return;
+
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    printf("Some output info param(s) of Blob set:\n");
+#endif
+    if (interpolateHistory)
+    {
+        configOutputInfo->runInterpolateHistory = *interpolateHistory;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  configOutputInfo.runInterpolateHistory = %s\n", configOutputInfo->runInterpolateHistory ? "true" : "false");
+#endif
+    }
+    if (maxInterpolateFrameGap)
+    {
+        configOutputInfo->maxInterpolateFrameGap = *maxInterpolateFrameGap;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  configOutputInfo.maxInterpolateFrameGap = %d\n", configOutputInfo->maxInterpolateFrameGap);
+#endif
+    }
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    printf("\n");
+#endif
+}
+
 int Blob::getID(void) const
 {
     return ID;
@@ -240,7 +282,7 @@ void Blob::setToBeDeleted(void)
 int Blob::getHistoryLength(void) const
 {
     if (rectHistory)
-        return (int)rectHistory->history.size();
+        return rectHistory->totalSize();
     else 
         return 0;
 }
@@ -252,6 +294,25 @@ void Blob::getCenterHistory(vector<Point>& centerHistory) const
         rectHistory->getCenterHistory(centerHistory);
 }
 
+Rect Blob::getPredictedRect(void) const
+{
+    if (rectHistory->totalSize() == 0)
+        return matchRect;
+    return rectHistory->predictRect(*rectHistory->currTime);
+}
+
+long long int Blob::getElapsedTime(void) const
+{
+    if (rectHistory->totalSize() == 0)
+        return 0;
+    return *rectHistory->currTime - rectHistory->currRecord.time;
+}
+
+void Blob::fitCenterLine(Point& pointInLine, Point2d& dirVector, double& avgError) const
+{
+    rectHistory->linearRegres(pointInLine, dirVector, avgError);
+}
+
 bool Blob::doesTurnAround(void) const
 {
     if (rectHistory) 
@@ -265,4 +326,19 @@ void Blob::printHistory(void) const
     rectHistory->displayHistory();
 }
 
+void Blob::setHistoryMemory(const Ptr<HistoryCapacity>& capacity, const Ptr<HistoryMemoryInfo>& memory)
+{
+    rectHistory->setMemory(capacity, memory);
+}
+
+long long int Blob::getHistoryImageBytes(void) const
+{
+    return rectHistory->history.getImageBytes();
+}
+
+long long int Blob::releaseHistoryImages(long long int bytesToRelease)
+{
+    return rectHistory->releaseImages(bytesToRelease);
+}
+
 }
@@ -9,6 +9,8 @@
 #include "ShowData.h"
 #include "Exception.h"
 #include "CompileControl.h"
+#include "FrameDeadline.h"
+#include "StageProfiler.h"
 
 namespace zsfo
 {
@@ -24,6 +26,9 @@ public:
         const bool* charRegionCheck = 0, const std::vector<cv::Rect>& charRegionRects = std::vector<cv::Rect>(),
         const bool* merge = 0, const bool* mergeHori = 0, const bool* mergeVert = 0, const bool* mergeBigSmall = 0,
         const bool* refine = 0, const bool* refineByShape = 0, const bool* refineByGrad = 0, const bool* refineByColor = 0);
+    //! 设置单帧处理的时间预算
+    void setFrameDeadline(const cv::Ptr<FrameDeadline>& deadline);
+    void setStageProfiler(const cv::Ptr<StageProfiler>& profiler);
     //! 简单版本的处理函数
     void proc(cv::Mat& foreImage, const cv::Mat& image, const cv::Mat& backImage, 
         std::vector<cv::Rect>& rects, std::vector<cv::Rect>& stableRects);
@@ -196,6 +201,9 @@ private:
     int imageWidth, imageHeight;
     cv::Rect fullBaseRect;
 
+    cv::Ptr<FrameDeadline> frameDeadline;  ///< 单帧处理的时间预算, 为空时不限制
+    cv::Ptr<StageProfiler> stageProfiler;  ///< 分步骤耗时统计, 为空时不计时
+
     std::vector<cv::Rect> rectsProc;
     std::vector<cv::Rect> rectsStable;
     std::vector<RectInfo> rectsRecords;
@@ -227,6 +235,16 @@ void BlobExtractor::setConfigParams(
         refine, refineByShape, refineByGrad, refineByColor);
 }
 
+void BlobExtractor::setFrameDeadline(const Ptr<FrameDeadline>& deadline)
+{
+    ptrImpl->setFrameDeadline(deadline);
+}
+
+void BlobExtractor::setStageProfiler(const Ptr<StageProfiler>& profiler)
+{
+    ptrImpl->setStageProfiler(profiler);
+}
+
 void BlobExtractor::proc(Mat& foreImage, const Mat& image, const Mat& backImage, vector<Rect>& rects, vector<Rect>& stableRects)
 {
     ptrImpl->proc(foreImage, image, backImage, rects, stableRects);
@@ -589,8 +607,19 @@ void BlobExtractor::Impl::setConfigParams(
 #endif
 }
 
+void BlobExtractor::Impl::setFrameDeadline(const Ptr<FrameDeadline>& deadline)
+{
+    frameDeadline = deadline;
+}
+
+void BlobExtractor::Impl::setStageProfiler(const Ptr<StageProfiler>& profiler)
+{
+    stageProfiler = profiler;
+}
+
 void BlobExtractor::Impl::morphOperation(Mat& foreImage)
 {
+    StageTimer timer(stageProfiler, ProcStage::Morphology);
     Mat coarseElement = getStructuringElement(MORPH_ELLIPSE, Size(7, 7), Point(-1, -1));
     Mat fineElement = getStructuringElement(MORPH_ELLIPSE, Size(3, 3), Point(-1, -1));
     medianBlur(foreImage, foreImage, 3);
@@ -724,6 +753,7 @@ void BlobExtractor::Impl::proc(Mat& foreImage, const Mat& image, const Mat& back
 
 void BlobExtractor::Impl::findRectsDayMode(cv::Mat& foreImage, const Mat& image, const Mat& backImage, std::vector<cv::Rect>& rects)
 {
+    StageTimer timer(stageProfiler, ProcStage::Labeling);
     rects.clear();
     // 找轮廓
     vector< vector<Point> > initContours;
@@ -790,6 +820,8 @@ void BlobExtractor::Impl::findRectsDayMode(cv::Mat& foreImage, const Mat& image,
         }
 
         //相关系数检测
+        if (corrCheck && !frameDeadline.empty() && !frameDeadline->allows(OptionalStage::CorrCheck))
+            corrCheck = false;
         if (corrCheck)
         {
             Scalar rectCorrRatio = calcCenterCorrRatio(image, backImage, currRect);
@@ -835,6 +867,7 @@ static bool areTheSameRects(const vector<Rect>& rects1, const vector<Rect>& rect
 
 void BlobExtractor::Impl::mergeRectsDayMode(const vector<Rect>& srcRects, vector<Rect>& dstRects)
 {
+    StageTimer timer(stageProfiler, ProcStage::Merge);
     dstRects.clear();
     if (srcRects.size() == 0)
         return;
@@ -851,7 +884,7 @@ void BlobExtractor::Impl::mergeRectsDayMode(const vector<Rect>& srcRects, vector
         mergeHorizontalRects(src, dst);
         src = dst;
     }
-    if (configMODM.runMergeBigSmall)
+    if (configMODM.runMergeBigSmall && (frameDeadline.empty() || frameDeadline->allows(OptionalStage::MergeBigSmall)))
     {
         while (true)
         {
@@ -1094,11 +1127,17 @@ void BlobExtractor::Impl::proc(Mat& foreImage, const Mat& image, const Mat& back
         vector<Object> temp1, temp2;
         findObjectsDayMode(foreImage, image, backImage, temp1);
         mergeObjectsDayMode(temp1, temp2);
+        // 合并之后超出预算时不进行梯度优化
+        if (!frameDeadline.empty() && !frameDeadline->allows(OptionalStage::GradientRefine))
+            objects.swap(temp2);
+        else
+        {
 #if CMPL_USE_NEW_REFINE
-        refineObjectsDayModeNew(image, backImage, gradDiffImage, temp2, objects);
+            refineObjectsDayModeNew(image, backImage, gradDiffImage, temp2, objects);
 #else
-        refineObjectsDayMode(image, backImage, gradDiffImage, temp2, objects);
+            refineObjectsDayMode(image, backImage, gradDiffImage, temp2, objects);
 #endif
+        }
     }
     rectsProc.clear();
     int objectCount = objects.size();
@@ -1132,6 +1171,7 @@ bool BlobExtractor::Impl::areTheSameObjects(const vector<Object>& objects1, cons
 
 void BlobExtractor::Impl::mergeObjectsDayMode(const vector<Object>& initObjects, vector<Object>& finalObjects)
 {
+    StageTimer timer(stageProfiler, ProcStage::Merge);
     finalObjects.clear();
     if (initObjects.size() == 0)
         return;
@@ -1148,7 +1188,7 @@ void BlobExtractor::Impl::mergeObjectsDayMode(const vector<Object>& initObjects,
         mergeHorizontalObjects(src, dst);
         src = dst;
     }
-    if (configMODM.runMergeBigSmall)
+    if (configMODM.runMergeBigSmall && (frameDeadline.empty() || frameDeadline->allows(OptionalStage::MergeBigSmall)))
     {
         while (true)
         {
@@ -1399,6 +1439,7 @@ void BlobExtractor::Impl::mergeVerticalObjects(const vector<Object>& srcObjects,
 
 void BlobExtractor::Impl::findObjectsDayMode(Mat& foreImage, const Mat& normImage, const Mat& backImage, vector<Object>& objects)
 {
+    StageTimer timer(stageProfiler, ProcStage::Labeling);
     objects.clear();
     // 找轮廓
     vector< vector<Point> > initContours;
@@ -1466,6 +1507,8 @@ void BlobExtractor::Impl::findObjectsDayMode(Mat& foreImage, const Mat& normImag
         }
 
         // 计算当前矩形区域内彩色图和背景图的相关系数
+        if (configFODM.runCorrRatioTest && corrCheck && !frameDeadline.empty() && !frameDeadline->allows(OptionalStage::CorrCheck))
+            corrCheck = false;
         if (configFODM.runCorrRatioTest && corrCheck)
         {
             Scalar rectCorrRatio = calcCenterCorrRatio(normImage, backImage, currRect);
@@ -1538,6 +1581,7 @@ void BlobExtractor::Impl::findObjectsDayMode(Mat& foreImage, const Mat& normImag
 void BlobExtractor::Impl::refineObjectsDayMode(const Mat& normImage, const Mat& backImage, const Mat& gradDiffImage, 
     const vector<Object>& initObjects, vector<Object>& finalObjects)
 {
+    StageTimer timer(stageProfiler, ProcStage::Refine);
     finalObjects.clear();
     if (initObjects.empty())
         return;
@@ -2118,6 +2162,7 @@ Rect BlobExtractor::Impl::fitRectToForeground(const Mat& foreImage, const Rect&
 void BlobExtractor::Impl::refineObjectsDayModeNew(const Mat& normImage, const Mat& backImage, const Mat& gradDiffImage, 
     const vector<Object>& initObjects, vector<Object>& finalObjects)
 {
+    StageTimer timer(stageProfiler, ProcStage::Refine);
     finalObjects.clear();
     if (initObjects.empty())
         return;
@@ -6,6 +6,9 @@
 namespace zsfo
 {
 
+struct FrameDeadline;
+class StageProfiler;
+
 //! 根据前景图, 彩色图等确定当前帧中前景矩形的类
 class Z_LIB_EXPORT BlobExtractor
 {
@@ -47,6 +50,14 @@ public:
         const bool* charRegionCheck = 0, const std::vector<cv::Rect>& charRegionRects = std::vector<cv::Rect>(),
         const bool* merge = 0, const bool* mergeHori = 0, const bool* mergeVert = 0, const bool* mergeBigSmall = 0,
         const bool* refine = 0, const bool* refineByShape = 0, const bool* refineByGrad = 0, const bool* refineByColor = 0);
+    //! 设置单帧处理的时间预算
+    /*!
+        设置后, 梯度优化, 大小矩形合并和相关系数检测执行前查询 deadline, 超出预算时跳过, 
+        deadline 由调用者在每帧开始时计时, 为空时所有步骤按配置参数执行
+     */
+    void setFrameDeadline(const cv::Ptr<FrameDeadline>& deadline);
+    //! 设置分步骤耗时统计器, 形态学操作, 轮廓筛选, 矩形合并和矩形优化分别计时, 为空时不计时
+    void setStageProfiler(const cv::Ptr<StageProfiler>& profiler);
     //! 简单版本的处理函数
     /*!
         根据前景图 foreImage(CV_8UC1) 找前景矩形, 过滤掉较小的矩形, 
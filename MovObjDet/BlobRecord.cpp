@@ -22,6 +22,7 @@ static const int BlobVisHisRcrdFrmCntDiff = 10;
 static const int CrsLnVisHisMaxDistToRecord = 15;
 static const int CrsLnVisHisRcrdFrmCntDiff = 3;
 const static int stepCheckStability = 5;
+static const double BlobQuanHistoryVelocitySmoothRatio = 0.5;
 
 namespace zsfo
 {
@@ -65,91 +66,549 @@ void BlobQuanRecord::makeRecord(const Mat& scene, const Rect& rect,
     scene(this->origRect).copyTo(this->image);
 }
 
+
+BlobQuanStatistics::BlobQuanStatistics(void)
+    : count(0), 
+      sumX(0), sumY(0), sumXY(0), sumX2(0), sumY2(0),
+      meanX(0), meanY(0), meanWidth(0), meanHeight(0), m2X(0), m2Y(0)
+{
+
+}
+
+void BlobQuanStatistics::update(const BlobQuanRecord& record)
+{
+    count++;
+
+    double x = record.center.x, y = record.center.y;
+    sumX += x;
+    sumY += y;
+    sumXY += x * y;
+    sumX2 += x * x;
+    sumY2 += y * y;
+
+    double diffX = record.rect.x - meanX;
+    meanX += diffX / count;
+    m2X += diffX * (record.rect.x - meanX);
+    double diffY = record.rect.y - meanY;
+    meanY += diffY / count;
+    m2Y += diffY * (record.rect.y - meanY);
+    meanWidth += (record.rect.width - meanWidth) / count;
+    meanHeight += (record.rect.height - meanHeight) / count;
+}
+
+void BlobQuanStatistics::linearRegres(Point& pointInLine, Point2d& dirVector, double& avgError) const
+{
+    if (count == 0)
+    {
+        pointInLine = Point(0, 0);
+        dirVector = Point2d(1, 0);
+        avgError = 0;
+        return;
+    }
+
+    double N = count;
+    double dX2 = N * sumX2 - sumX * sumX;
+    double dY2 = N * sumY2 - sumY * sumY;
+    double dXY = N * sumXY - sumX * sumY;
+
+    pointInLine.x = sumX / N;
+    pointInLine.y = sumY / N;
+
+    double theta = atan2(2 * dXY, dX2 - dY2) / 2;
+    dirVector.x = cos(theta);
+    dirVector.y = sin(theta);
+
+    // 点到直线距离的平方的均值可以由二阶中心矩直接得到, 不需要再遍历历史记录
+    double meanSquareError = (dirVector.y * dirVector.y * dX2 - 2 * dirVector.x * dirVector.y * dXY + 
+        dirVector.x * dirVector.x * dY2) / (N * N);
+    avgError = meanSquareError > 0 ? sqrt(meanSquareError) : 0;
+}
+
+void BlobQuanStatistics::output(ObjectHistoryStatistics& statistics) const
+{
+    statistics.numOfRecords = count;
+    statistics.meanNormWidth = meanWidth;
+    statistics.meanNormHeight = meanHeight;
+    statistics.stdDevNormX = count ? sqrt(m2X / count) : 0;
+    statistics.stdDevNormY = count ? sqrt(m2Y / count) : 0;
+}
+
+DirectionStatistics::DirectionStatistics(void)
+    : prefixPositive(1, 0), prefixNegative(1, 0), 
+      capacity(0), numOfPushed(0), begIndex(0), numOfPositive(0), numOfNegative(0)
+{
+
+}
+
+void DirectionStatistics::setCapacity(int maxSize)
+{
+    if (numOfPushed > 0)
+        return;
+
+    // 计算中值需要最近的 5 个原始值
+    capacity = maxSize > 0 ? max(maxSize, 5) : 0;
+    raw.assign(capacity, 0);
+    prefixPositive.assign(capacity + 1, 0);
+    prefixNegative.assign(capacity + 1, 0);
+}
+
+void DirectionStatistics::push_back(char dir)
+{
+    if (capacity > 0)
+    {
+        // 环形缓冲区已满, 新值覆盖最早的值
+        if (numOfPushed >= capacity)
+        {
+            char oldest = raw[rawSlot(numOfPushed)];
+            numOfPositive -= oldest > 0 ? 1 : 0;
+            numOfNegative -= oldest < 0 ? 1 : 0;
+            begIndex++;
+        }
+        raw[rawSlot(numOfPushed)] = dir;
+    }
+    else
+    {
+        raw.push_back(dir);
+        prefixPositive.resize(numOfPushed + 2);
+        prefixNegative.resize(numOfPushed + 2);
+    }
+    numOfPushed++;
+    numOfPositive += dir > 0 ? 1 : 0;
+    numOfNegative += dir < 0 ? 1 : 0;
+
+    // 窗口长度为 5, 新值只影响滤波后序列的最后三个值
+    for (int i = max(0, numOfPushed - 3); i < numOfPushed; i++)
+    {
+        char median = calcMedian(i);
+        prefixPositive[prefixSlot(i + 1)] = prefixPositive[prefixSlot(i)] + (median > 0 ? 1 : 0);
+        prefixNegative[prefixSlot(i + 1)] = prefixNegative[prefixSlot(i)] + (median < 0 ? 1 : 0);
+    }
+}
+
+char DirectionStatistics::calcMedian(int index) const
+{
+    int left = max(0, index - 2);
+    int right = min(numOfPushed - 1, index + 2);
+    char window[5];
+    int winLength = right - left + 1;
+    for (int i = 0; i < winLength; i++)
+        window[i] = raw[rawSlot(left + i)];
+    sort(window, window + winLength);
+    return window[winLength / 2];
+}
+
+}
+
+namespace
+{
+static bool isRectPairStable(const Rect& fstRect, double fstGradDiffMean, const Rect& sndRect, double sndGradDiffMean)
+{
+    Rect uniRect = fstRect | sndRect;
+    double fstRectRatio = double(fstRect.area()) / double(uniRect.area());
+    double sndRectRatio = double(sndRect.area()) / double(uniRect.area());
+
+    return ((uniRect.width > 20 || uniRect.height > 20) ? 
+            (fstRectRatio > 0.9 && sndRectRatio > 0.9) :
+            (fstRectRatio > 0.8 && sndRectRatio > 0.8)) &&
+           fstGradDiffMean < 5 && sndGradDiffMean < 5;
+}
+
+// 在 begRecord 和 endRecord 之间按帧编号 number 线性插值, 原始尺寸矩形的计算方法和 BlobQuanRecord::makeRecord 相同
+static void interpolateRecord(const zsfo::BlobQuanRecord& begRecord, const zsfo::BlobQuanRecord& endRecord, 
+    int number, const zsfo::SizeInfo& sizeInfo, zsfo::ObjectRecord& record)
+{
+    double ratio = double(number - begRecord.count) / double(endRecord.count - begRecord.count);
+    const Rect& begRect = begRecord.rect;
+    const Rect& endRect = endRecord.rect;
+    record.time = begRecord.time + (long long int)(ratio * (endRecord.time - begRecord.time) + 0.5);
+    record.number = number;
+    record.normRect.x = cvRound(begRect.x + ratio * (endRect.x - begRect.x));
+    record.normRect.y = cvRound(begRect.y + ratio * (endRect.y - begRect.y));
+    record.normRect.width = cvRound(begRect.width + ratio * (endRect.width - begRect.width));
+    record.normRect.height = cvRound(begRect.height + ratio * (endRect.height - begRect.height));
+    record.origRect.x = record.normRect.x * sizeInfo.horiScale;
+    record.origRect.y = record.normRect.y * sizeInfo.vertScale;
+    record.origRect.width = record.normRect.width * sizeInfo.horiScale;
+    record.origRect.height = record.normRect.height * sizeInfo.vertScale;
+    record.image.release();
+    record.isInterpolated = 1;
+}
+
+inline long long int calcImageBytes(const Mat& image)
+{
+    return image.data ? (long long int)(image.total() * image.elemSize()) : 0;
+}
+}
+
+namespace zsfo
+{
+
+BlobQuanRecordBuffer::BlobQuanRecordBuffer(void)
+    : head(0), numOfRecent(0), recentCapacity(0), olderCapacity(0), 
+      decimStep(1), numOfMoved(0), imageBytes(0)
+{
+
+}
+
+void BlobQuanRecordBuffer::setCapacity(int maxSize, int numOfRecentRecords)
+{
+    if (!empty())
+        return;
+
+    if (maxSize <= 0)
+    {
+        recentCapacity = 0;
+        olderCapacity = 0;
+        recent.clear();
+    }
+    else
+    {
+        recentCapacity = numOfRecentRecords > 0 && numOfRecentRecords < maxSize ? numOfRecentRecords : maxSize;
+        olderCapacity = maxSize - recentCapacity;
+        recent.resize(recentCapacity);
+    }
+    head = 0;
+    numOfRecent = 0;
+    decimStep = 1;
+    numOfMoved = 0;
+}
+
+int BlobQuanRecordBuffer::size(void) const
+{
+    return older.size() + numOfRecent;
+}
+
+bool BlobQuanRecordBuffer::empty(void) const
+{
+    return older.empty() && numOfRecent == 0;
+}
+
+const BlobQuanRecord& BlobQuanRecordBuffer::operator[](int index) const
+{
+    int numOfOlder = older.size();
+    if (index < numOfOlder)
+        return older[index];
+    return recent[(head + index - numOfOlder) % recentCapacity];
+}
+
+BlobQuanRecord& BlobQuanRecordBuffer::at(int index)
+{
+    int numOfOlder = older.size();
+    if (index < numOfOlder)
+        return older[index];
+    return recent[(head + index - numOfOlder) % recentCapacity];
+}
+
+const BlobQuanRecord& BlobQuanRecordBuffer::back(void) const
+{
+    return (*this)[size() - 1];
+}
+
+void BlobQuanRecordBuffer::drop(BlobQuanRecord& record, HistoryMemoryInfo& memory)
+{
+    long long int bytes = calcImageBytes(record.image);
+    if (bytes)
+    {
+        imageBytes -= bytes;
+        memory.imageBytes -= bytes;
+        memory.numOfImages--;
+        record.image.release();
+    }
+    memory.numOfRecords--;
+    memory.recordBytes -= sizeof(BlobQuanRecord);
+}
+
+void BlobQuanRecordBuffer::compactOlder(HistoryMemoryInfo& memory)
+{
+    // 保留轨迹起点, 之后隔一条删除一条
+    int length = older.size();
+    int dst = 1;
+    for (int src = 1; src < length; src++)
+    {
+        if (src % 2 == 0)
+            older[dst++] = older[src];
+        else
+        {
+            drop(older[src], memory);
+            memory.numOfDecimated++;
+        }
+    }
+    older.resize(dst);
+    decimStep *= 2;
+}
+
+void BlobQuanRecordBuffer::push_back(const BlobQuanRecord& record, HistoryMemoryInfo& memory)
+{
+    long long int bytes = calcImageBytes(record.image);
+    imageBytes += bytes;
+    memory.imageBytes += bytes;
+    memory.numOfImages += bytes ? 1 : 0;
+    memory.numOfRecords++;
+    memory.recordBytes += sizeof(BlobQuanRecord);
+    if (memory.recordBytes + memory.imageBytes > memory.peakBytes)
+        memory.peakBytes = memory.recordBytes + memory.imageBytes;
+
+    // 不限制长度
+    if (recentCapacity == 0)
+    {
+        older.push_back(record);
+        return;
+    }
+
+    // 环形缓冲区未满
+    if (numOfRecent < recentCapacity)
+    {
+        recent[(head + numOfRecent) % recentCapacity] = record;
+        numOfRecent++;
+        return;
+    }
+
+    // 环形缓冲区已满, 最早的记录被挤出, 按 decimStep 降采样后放到 older 中
+    BlobQuanRecord& oldest = recent[head];
+    if (olderCapacity > 0 && numOfMoved % decimStep == 0)
+        older.push_back(oldest);
+    else
+    {
+        drop(oldest, memory);
+        memory.numOfDecimated++;
+    }
+    numOfMoved++;
+    recent[head] = record;
+    head = (head + 1) % recentCapacity;
+    if ((int)older.size() > olderCapacity)
+        compactOlder(memory);
+}
+
+long long int BlobQuanRecordBuffer::releaseImages(long long int bytesToRelease, HistoryMemoryInfo& memory)
+{
+    long long int released = 0;
+    int length = size();
+    for (int i = 0; i < length && released < bytesToRelease && imageBytes > 0; i++)
+    {
+        Mat& image = at(i).image;
+        long long int bytes = calcImageBytes(image);
+        if (!bytes)
+            continue;
+        image.release();
+        imageBytes -= bytes;
+        memory.imageBytes -= bytes;
+        memory.numOfImages--;
+        memory.numOfImagesEvicted++;
+        released += bytes;
+    }
+    return released;
+}
+
+void BlobQuanRecordBuffer::clear(HistoryMemoryInfo& memory)
+{
+    int length = size();
+    for (int i = 0; i < length; i++)
+        drop(at(i), memory);
+    older.clear();
+    recent.assign(recentCapacity, BlobQuanRecord());
+    head = 0;
+    numOfRecent = 0;
+    decimStep = 1;
+    numOfMoved = 0;
+    imageBytes = 0;
+}
+
 BlobQuanHistory::BlobQuanHistory(const cv::Ptr<SizeInfo>& sizesOrigAndNorm, 
     const cv::Ptr<long long int>& time, const cv::Ptr<int>& count, int blobID, bool historyWithImages)
-    : ID(blobID),
+    : numOfPushed(0),
+      numOfVelocityUpdates(0),
+      stableRects(stepCheckStability),
+      stableGradDiffMeans(stepCheckStability, 0),
+      lastUnstableIndex(stepCheckStability, -1),
+      checkDirStep(BlobQuanHistoryCheckDirStep),
+      maxDiffVal(BlobQuanHistoryMaxDiffVal),
+      ID(blobID),
       sizeInfo(sizesOrigAndNorm),
       currTime(time),
       currCount(count),
-      checkDirStep(BlobQuanHistoryCheckDirStep),
-      maxDiffVal(BlobQuanHistoryMaxDiffVal),
-      recordImage(historyWithImages)
+      recordImage(historyWithImages),
+      capacity(new HistoryCapacity),
+      memory(new HistoryMemoryInfo)
 {
-
+    capacity->maxHistorySize = 0;
+    capacity->numOfRecentRecords = 0;
+    capacity->maxImageBytes = 0;
+    capacity->evictPolicy = HistoryEvictPolicy::DropOwnOldest;
 }
 
 BlobQuanHistory::BlobQuanHistory(const BlobQuanHistory& history, int blobID)
-    : ID(blobID),
+    : numOfPushed(0),
+      numOfVelocityUpdates(0),
+      stableRects(stepCheckStability),
+      stableGradDiffMeans(stepCheckStability, 0),
+      lastUnstableIndex(stepCheckStability, -1),
+      checkDirStep(history.checkDirStep),
+      maxDiffVal(history.maxDiffVal),
+      ID(blobID),
       sizeInfo(history.sizeInfo),
       currTime(history.currTime),
       currCount(history.currCount),
-      checkDirStep(history.checkDirStep),
-      maxDiffVal(history.maxDiffVal),
-      recordImage(history.recordImage)
+      recordImage(history.recordImage),
+      capacity(history.capacity),
+      memory(history.memory)
 {
 
 }
 
+BlobQuanHistory::~BlobQuanHistory(void)
+{
+    history.clear(*memory);
+}
+
 BlobQuanHistory* BlobQuanHistory::createNew(int blobID) const
 {
     BlobQuanHistory* ptr = new BlobQuanHistory(*this, blobID);
     return ptr;
 }
 
+void BlobQuanHistory::setMemory(const Ptr<HistoryCapacity>& historyCapacity, const Ptr<HistoryMemoryInfo>& historyMemory)
+{
+    history.clear(*memory);
+    capacity = historyCapacity;
+    memory = historyMemory;
+}
+
 int BlobQuanHistory::size(void) const
 {
     return history.size();
 }
 
-void BlobQuanHistory::pushRecord(const Rect& rect, double gradDiffMean)
+int BlobQuanHistory::totalSize(void) const
 {
-    currRecord.makeRecord(rect, gradDiffMean, *currTime, *currCount, *sizeInfo);
-    history.push_back(currRecord);
+    return numOfPushed;
+}
 
-    int index = history.size() - 1;
-    if (index > 0 && index % checkDirStep == 0)
+long long int BlobQuanHistory::releaseImages(long long int bytesToRelease)
+{
+    return history.releaseImages(bytesToRelease, *memory);
+}
+
+void BlobQuanHistory::updateDirection(void)
+{
+    // 每隔 checkDirStep 条记录, 和上一次检测时的矩形中心比较, 确定运动方向
+    if (numOfPushed > 1 && (numOfPushed - 1) % checkDirStep == 0)
     {
-        if (history[index].center.x + maxDiffVal < history[index - checkDirStep].center.x)
+        if (currRecord.center.x + maxDiffVal < dirRefCenter.x)
             dirCenterX.push_back(-1);
-        else if (history[index].center.x > history[index- checkDirStep].center.x + maxDiffVal)
+        else if (currRecord.center.x > dirRefCenter.x + maxDiffVal)
             dirCenterX.push_back(1);
         else
             dirCenterX.push_back(0);
 
-        if (history[index].center.y + maxDiffVal < history[index - checkDirStep].center.y)
+        if (currRecord.center.y + maxDiffVal < dirRefCenter.y)
             dirCenterY.push_back(-1);
-        else if (history[index].center.y > history[index - checkDirStep].center.y + maxDiffVal)
+        else if (currRecord.center.y > dirRefCenter.y + maxDiffVal)
             dirCenterY.push_back(1);
         else
             dirCenterY.push_back(0);
     }
+    if ((numOfPushed - 1) % checkDirStep == 0)
+        dirRefCenter = currRecord.center;
 }
 
-void BlobQuanHistory::pushRecord(const OrigSceneProxy& scene, const Rect& rect, double gradDiffMean)
+void BlobQuanHistory::updateStatistics(void)
 {
-    if (recordImage)
-        currRecord.makeRecord(scene.getShallowCopy(), rect, gradDiffMean, *currTime, *currCount, *sizeInfo);
+    statistics.update(currRecord);
+
+    // 和前第 stepCheckStability 条记录比较, 记录不稳定的位置, 供 checkStability 使用
+    int slot = currRecord.index % stepCheckStability;
+    if (currRecord.index >= stepCheckStability &&
+        !isRectPairStable(currRecord.rect, currRecord.gradDiffMean, stableRects[slot], stableGradDiffMeans[slot]))
+        lastUnstableIndex[slot] = currRecord.index;
+    stableRects[slot] = currRecord.rect;
+    stableGradDiffMeans[slot] = currRecord.gradDiffMean;
+}
+
+void BlobQuanHistory::updateVelocity(const BlobQuanRecord& lastRecord)
+{
+    // 时间戳没有增加时无法估计速度, 保持原来的估计
+    long long int elapsed = currRecord.time - lastRecord.time;
+    if (elapsed <= 0)
+        return;
+
+    Point2d currVelocity(double(currRecord.center.x - lastRecord.center.x) / elapsed,
+                         double(currRecord.center.y - lastRecord.center.y) / elapsed);
+    if (numOfVelocityUpdates == 0)
+        velocity = currVelocity;
     else
-        currRecord.makeRecord(rect, gradDiffMean, *currTime, *currCount, *sizeInfo);
-    history.push_back(currRecord);
+        velocity = currVelocity * BlobQuanHistoryVelocitySmoothRatio + 
+                   velocity * (1 - BlobQuanHistoryVelocitySmoothRatio);
+    numOfVelocityUpdates++;
+}
+
+Rect BlobQuanHistory::predictRect(long long int time) const
+{
+    long long int elapsed = time - currRecord.time;
+    if (numOfVelocityUpdates == 0 || elapsed <= 0)
+        return currRecord.rect;
+
+    Rect rect = currRecord.rect;
+    rect.x += cvRound(velocity.x * elapsed);
+    rect.y += cvRound(velocity.y * elapsed);
+    return rect;
+}
 
-    int index = history.size() - 1;
-    if (index > 0 && index % checkDirStep == 0)
+bool BlobQuanHistory::allowImage(long long int bytes)
+{
+    if (capacity->maxImageBytes <= 0 || memory->imageBytes + bytes <= capacity->maxImageBytes)
+        return true;
+
+    // 超出上限的部分由 BlobTracker 在每帧处理结束后统一释放
+    if (capacity->evictPolicy == HistoryEvictPolicy::DropFromLargest)
+        return true;
+
+    if (capacity->evictPolicy == HistoryEvictPolicy::DropOwnOldest)
     {
-        if (history[index].center.x + maxDiffVal < history[index - checkDirStep].center.x)
-            dirCenterX.push_back(-1);
-        else if (history[index].center.x > history[index- checkDirStep].center.x + maxDiffVal)
-            dirCenterX.push_back(1);
-        else
-            dirCenterX.push_back(0);
+        history.releaseImages(memory->imageBytes + bytes - capacity->maxImageBytes, *memory);
+        if (memory->imageBytes + bytes <= capacity->maxImageBytes)
+            return true;
+    }
 
-        if (history[index].center.y + maxDiffVal < history[index - checkDirStep].center.y)
-            dirCenterY.push_back(-1);
-        else if (history[index].center.y > history[index - checkDirStep].center.y + maxDiffVal)
-            dirCenterY.push_back(1);
-        else
-            dirCenterY.push_back(0);
+    memory->numOfImagesRejected++;
+    return false;
+}
+
+void BlobQuanHistory::pushRecord(const Rect& rect, double gradDiffMean)
+{
+    history.setCapacity(capacity->maxHistorySize, capacity->numOfRecentRecords);
+    dirCenterX.setCapacity(capacity->maxHistorySize);
+    dirCenterY.setCapacity(capacity->maxHistorySize);
+    currRecord.makeRecord(rect, gradDiffMean, *currTime, *currCount, *sizeInfo);
+    currRecord.index = numOfPushed;
+    if (!history.empty())
+        updateVelocity(history.back());
+    history.push_back(currRecord, *memory);
+    numOfPushed++;
+    updateDirection();
+    updateStatistics();
+}
+
+void BlobQuanHistory::pushRecord(const OrigSceneProxy& scene, const Rect& rect, double gradDiffMean)
+{
+    history.setCapacity(capacity->maxHistorySize, capacity->numOfRecentRecords);
+    dirCenterX.setCapacity(capacity->maxHistorySize);
+    dirCenterY.setCapacity(capacity->maxHistorySize);
+    currRecord.makeRecord(rect, gradDiffMean, *currTime, *currCount, *sizeInfo);
+    currRecord.index = numOfPushed;
+    if (!history.empty())
+        updateVelocity(history.back());
+    if (recordImage)
+    {
+        const Mat& origScene = scene.getShallowCopy();
+        if (allowImage(currRecord.origRect.area() * (long long int)origScene.elemSize()))
+            origScene(currRecord.origRect).copyTo(currRecord.image);
     }
+    history.push_back(currRecord, *memory);
+    // currRecord 不持有截图, 截图只由 history 管理
+    currRecord.image.release();
+    numOfPushed++;
+    updateDirection();
+    updateStatistics();
 }
 
 void BlobQuanHistory::displayHistory(void) const
@@ -166,21 +625,53 @@ void BlobQuanHistory::displayHistory(void) const
     printf("End display total history...........................................\n");
 }
 
-void BlobQuanHistory::outputHistory(ObjectInfo& objectInfo) const
+void BlobQuanHistory::outputHistory(ObjectInfo& objectInfo, bool interpolate, int maxFrameGap) const
 {
     int size = history.size();
     objectInfo.hasHistory = size != 0;
-    objectInfo.history.resize(history.size());
-    for (int i = 0; i < history.size(); i++)
+
+    // 统计插值后的记录条数
+    int outputSize = size;
+    if (interpolate)
+    {
+        for (int i = 1; i < size; i++)
+        {
+            int gap = history[i].count - history[i - 1].count;
+            if (gap > 1 && (maxFrameGap <= 0 || gap <= maxFrameGap))
+                outputSize += gap - 1;
+        }
+    }
+
+    objectInfo.history.resize(outputSize);
+    int index = 0;
+    for (int i = 0; i < size; i++)
     {
-        objectInfo.history[i].time = history[i].time;
-        objectInfo.history[i].number = history[i].count;
-        objectInfo.history[i].normRect = history[i].rect;
-        objectInfo.history[i].origRect = history[i].origRect;
-        objectInfo.history[i].image = history[i].image;
+        if (interpolate && i > 0)
+        {
+            const BlobQuanRecord& begRecord = history[i - 1];
+            const BlobQuanRecord& endRecord = history[i];
+            int gap = endRecord.count - begRecord.count;
+            if (gap > 1 && (maxFrameGap <= 0 || gap <= maxFrameGap))
+            {
+                for (int number = begRecord.count + 1; number < endRecord.count; number++)
+                    interpolateRecord(begRecord, endRecord, number, *sizeInfo, objectInfo.history[index++]);
+            }
+        }
+        ObjectRecord& record = objectInfo.history[index++];
+        record.time = history[i].time;
+        record.number = history[i].count;
+        record.normRect = history[i].rect;
+        record.origRect = history[i].origRect;
+        record.image = history[i].image;
+        record.isInterpolated = 0;
     }
 }
 
+void BlobQuanHistory::outputStatistics(ObjectInfo& objectInfo) const
+{
+    statistics.output(objectInfo.historyStatistics);
+}
+
 void BlobQuanHistory::drawRect(Mat& normalImage, const Scalar& color) const
 {
     //if (history.size() > 1)
@@ -242,57 +733,28 @@ bool BlobQuanHistory::checkStability(int timeInMilliSec) const
     if (history.size() < 2)
         return false;
 
-    int end = history.size() - 1, beg = -1;
-    long long int begTime = history.back().time;
-    // 根据历史的结束时间，往回退 timeInMilliSec 找到下标
-    for (int i = history.size() - 1; i >= 0; i--)
+    const BlobQuanRecord& endRecord = history.back();
+    long long int begTime = endRecord.time - timeInMilliSec;
+    // 历史记录按时间排序, 二分查找时间早于 begTime 的最后一条记录
+    int low = 0, high = history.size();
+    while (low < high)
     {
-        if (history[i].time < begTime - timeInMilliSec)
-        {
-            beg = i;
-            break;
-        }
+        int mid = (low + high) / 2;
+        if (history[mid].time < begTime)
+            low = mid + 1;
+        else
+            high = mid;
     }
 
-    if (beg < 0) return false;
+    if (low == 0) return false;
+    const BlobQuanRecord& begRecord = history[low - 1];
 
-    if (end - beg <= stepCheckStability)
-    {
-        Rect begRect = history[beg].rect;
-        Rect endRect = history[end].rect;
-        Rect uniRect = begRect | endRect;
-        double begRectRatio = double(begRect.area()) / double(uniRect.area());
-        double endRectRatio = double(endRect.area()) / double(uniRect.area());
-
-        if (((uniRect.width > 20 || uniRect.height > 20) ? 
-             (begRectRatio > 0.9 && endRectRatio > 0.9) :
-             (begRectRatio > 0.8 && endRectRatio > 0.8)) &&
-            history[beg].gradDiffMean < 5 && history[end].gradDiffMean < 5)
-            return true;
-        else
-            return false;
-    }
-    else
-    {
-        beg += stepCheckStability;
-        for (int i = end; i >= beg; i -= stepCheckStability)
-        {
-            Rect begRect = history[i].rect;
-            Rect endRect = history[i - stepCheckStability].rect;
-            Rect uniRect = begRect | endRect;
-            double begRectRatio = double(begRect.area()) / double(uniRect.area());
-            double endRectRatio = double(endRect.area()) / double(uniRect.area());
-
-            if (((uniRect.width > 20 || uniRect.height > 20) ? 
-                 (begRectRatio > 0.9 && endRectRatio > 0.9) :
-                 (begRectRatio > 0.8 && endRectRatio > 0.8)) &&
-                history[i].gradDiffMean < 5 && history[i - stepCheckStability].gradDiffMean < 5)
-                continue;
-            else
-                return false;
-        }
-        return true;
-    }
+    if (endRecord.index - begRecord.index <= stepCheckStability)
+        return isRectPairStable(begRecord.rect, begRecord.gradDiffMean, endRecord.rect, endRecord.gradDiffMean);
+    
+    // 从 endRecord 开始往回每隔 stepCheckStability 条记录比较一次, 直到 begRecord, 
+    // 所有比较结果都稳定, 等价于这些位置上最新的不稳定记录早于 begRecord 之后的第 stepCheckStability 条记录
+    return lastUnstableIndex[endRecord.index % stepCheckStability] < begRecord.index + stepCheckStability;
 }
 
 //double BlobQuanHistory::calcImageSpeed(void) const
@@ -364,88 +826,37 @@ bool BlobQuanHistory::checkStability(int timeInMilliSec) const
 
 void BlobQuanHistory::linearRegres(Point& pointInLine, Point2d& dirVector, double& avgError) const
 {
-    double N = history.size();  
-    double sumX = 0, sumY = 0, sumXY = 0, sumX2 = 0, sumY2 = 0;
-    for (int i = 0; i < N; i++)
-    {
-        sumX += history[i].center.x;
-        sumY += history[i].center.y;
-        sumXY += history[i].center.x * history[i].center.y;
-        sumX2 += history[i].center.x * history[i].center.x;
-        sumY2 += history[i].center.y * history[i].center.y;
-    }
-
-    double dX2 = N * sumX2 - sumX * sumX;
-    double dY2 = N * sumY2 - sumY * sumY;
-    double dXY = N * sumXY - sumX * sumY;
-
-    pointInLine.x = sumX / N;
-    pointInLine.y = sumY / N;
-
-    double theta = atan2(2 * dXY, dX2 - dY2) / 2;
-    dirVector.x = cos(theta);
-    dirVector.y = sin(theta);
-
-    double sumError = 0;
-    for (int i = 0; i < N; i++)
-    {
-        sumError += fabs(dirVector.y * history[i].center.x + dirVector.x * pointInLine.y -
-                         dirVector.y * pointInLine.x - dirVector.x * history[i].center.y);
-    }
-    avgError = sumError / N;
+    // 直线和距离的均方根都由全部记录的增量统计量得到, 两者基于相同的数据, 代价是 O(1)
+    statistics.linearRegres(pointInLine, dirVector, avgError);
 }
 
 }
 
 namespace
 {
-static bool checkDirTurnAround(vector<char>& dir)
+static bool checkDirTurnAround(const zsfo::DirectionStatistics& dir)
 {
     bool doesTurnAround = false;
     // 统计是正值多还是负值多
-    int posiCount = 0, negaCount = 0;
-    for (int i = 0 ; i < dir.size(); i++)
-    {
-        posiCount += dir[i] > 0 ? 1 : 0;
-        negaCount += dir[i] < 0 ? 1 : 0;
-    }
+    int size = dir.size();
+    int posiCount = dir.countMedianPositive(0, size);
+    int negaCount = dir.countMedianNegative(0, size);
+    // 前半段的结束位置和最后一小段的起始位置
+    int fstHalfEnd = size / 2;
+    int tailBeg = int(ceil(size * 0.7));
     // 如果正值多
     if (posiCount > negaCount)
     {
-        // 统计前半段的正值
-        int posiFstHalfCount = 0;
-        for (int i = 0; i < dir.size() / 2; i++)
-            posiFstHalfCount += dir[i] > 0 ? 1 : 0;
-        // 如果前半段的正值多
-        if (posiFstHalfCount > 0.7 * dir.size() / 2)
-        {               
-            // 统计最后一小段的负值
-            int negaTailCount = 0;
-            for (int i = dir.size() - 1; i >= dir.size() * 0.7; i--)
-            {
-                negaTailCount += dir[i] < 0 ? 1 : 0;
-            }
-            doesTurnAround = negaTailCount > 0.7 * 0.3 * dir.size();
-        }
+        // 如果前半段的正值多, 统计最后一小段的负值
+        if (dir.countMedianPositive(0, fstHalfEnd) > 0.7 * size / 2)
+            doesTurnAround = dir.countMedianNegative(tailBeg, size) > 0.7 * 0.3 * size;
     }
     // 如果负值多
     else
     {
-        // 统计前半段负值
-        int negaFstHalfCount = 0;
-        for (int i = 0; i < dir.size() / 2; i++)
-            negaFstHalfCount += dir[i] < 0 ? 1 : 0;
-        // 如果前半段的负值多
-        if (negaFstHalfCount > 0.7 * dir.size() / 2)
-        {               
-            // 统计最后一小段的正值
-            int posiTailCount = 0;
-            for (int i = dir.size() - 1; i >= dir.size() * 0.7; i--)
-            {
-                posiTailCount += dir[i] > 0 ? 1 : 0;
-            }
-            doesTurnAround = posiTailCount > 0.7 * 0.3 * dir.size();
-        }
+        // 如果前半段的负值多, 统计最后一小段的正值
+        if (dir.countMedianNegative(0, fstHalfEnd) > 0.7 * size / 2)
+            doesTurnAround = dir.countMedianPositive(tailBeg, size) > 0.7 * 0.3 * size;
     }
     return doesTurnAround;
 }
@@ -460,28 +871,15 @@ bool BlobQuanHistory::checkTurnAround(void) const
         dirCenterX.size() % 5 != 0 || dirCenterY.size() % 5 != 0*/)
         return false;
 
-    vector<char> dirX, dirY;
-    ztool::localMedian(dirCenterX, dirX, 5);
-    ztool::localMedian(dirCenterY, dirY, 5);
-    //showArrayByHoriBar("x diff sign", dirX, false, true);
-    //showArrayByVertBar("y diff sign", dirY, false, true);
-    //waitKey(0);
-    
-    int zeroX = 0;
-    for (int i = 0; i < dirX.size(); i++)
-        zeroX += dirX[i] == 0 ? 1 : 0;
-    double zeroRatioX = double(zeroX) / dirX.size();
-
-    int zeroY = 0;
-    for (int i = 0; i < dirY.size(); i++)
-        zeroY += dirY[i] == 0 ? 1 : 0;
-    double zeroRatioY = double(zeroY) / dirY.size();
+    // dirCenterX 和 dirCenterY 在添加运动方向时已经完成了窗口长度为 5 的中值滤波
+    double zeroRatioX = double(dirCenterX.countMedianZero(0, dirCenterX.size())) / dirCenterX.size();
+    double zeroRatioY = double(dirCenterY.countMedianZero(0, dirCenterY.size())) / dirCenterY.size();
 
     // 如果 0 值太多，则无法断定是否掉头，直接返回 false 
     if (zeroRatioX > 0.3 && zeroRatioY > 0.3)
         return false;
 
-    return checkDirTurnAround(dirX) || checkDirTurnAround(dirY);
+    return checkDirTurnAround(dirCenterX) || checkDirTurnAround(dirCenterY);
 }
 
 bool BlobQuanHistory::checkYDirection(int legalDirection) const
@@ -489,16 +887,9 @@ bool BlobQuanHistory::checkYDirection(int legalDirection) const
     if (dirCenterY.size() < 2)
         return true;
 
-    int positiveCount = 0, negativeCount = 0, zeroCount = 0;
-    for (int i = 0; i < dirCenterY.size(); i++)
-    {
-        if (dirCenterY[i] > 0)
-            positiveCount++;
-        else if (dirCenterY[i] < 0)
-            negativeCount++;
-        else
-            zeroCount++;
-    }
+    int positiveCount = dirCenterY.getNumOfPositive();
+    int negativeCount = dirCenterY.getNumOfNegative();
+    int zeroCount = dirCenterY.getNumOfZero();
     if (positiveCount + negativeCount + zeroCount == 0)
         return true;
 
@@ -523,27 +914,95 @@ bool BlobQuanHistory::checkYDirection(int legalDirection) const
         return true;
 }
 
-const Mat& OrigSceneProxy::getDeepCopy(void)
+SnapshotFrameHandle::SnapshotFrameHandle(const Ptr<SnapshotFrame>& snapshotFrame)
+    : frame(snapshotFrame)
 {
-    if (!done) 
-    {    
-        done = true;
-        shallowCopy.copyTo(deepCopy);
+    if (!frame.empty())
+        frame->numOfRefs++;
+}
+
+SnapshotFrameHandle::SnapshotFrameHandle(const SnapshotFrameHandle& handle)
+    : frame(handle.frame)
+{
+    if (!frame.empty())
+        frame->numOfRefs++;
+}
+
+SnapshotFrameHandle::~SnapshotFrameHandle(void)
+{
+    release();
+}
+
+SnapshotFrameHandle& SnapshotFrameHandle::operator=(const SnapshotFrameHandle& handle)
+{
+    if (frame != handle.frame)
+    {
+        release();
+        frame = handle.frame;
+        if (!frame.empty())
+            frame->numOfRefs++;
     }
-    return deepCopy;
+    return *this;
 }
 
-const Mat& OrigForeProxy::getDeepCopy(const Rect& normRect, const Rect& origRect)
+void SnapshotFrameHandle::release(void)
 {
-    if (!done)
+    if (!frame.empty())
+        frame->numOfRefs--;
+    frame.release();
+}
+
+SnapshotFrameRing::SnapshotFrameRing(int size)
+    : next(0)
+{
+    frames.resize(size > 0 ? size : 1);
+}
+
+SnapshotFrameHandle SnapshotFrameRing::acquire(const Mat& scene, const Mat& normFore, long long int time, int count)
+{
+    int size = frames.size();
+    int index = next;
+    // 优先复用没有被引用的快照帧, 沿用其已经分配的内存
+    for (int i = 0; i < size; i++)
     {
+        int curr = (next + i) % size;
+        if (!frames[curr].empty() && frames[curr]->numOfRefs == 0)
+        {
+            index = curr;
+            break;
+        }
+    }
+    // 找不到可以复用的快照帧, 重新分配, 原来位置上的快照帧由引用它的句柄保持
+    if (frames[index].empty() || frames[index]->numOfRefs != 0)
+        frames[index] = new SnapshotFrame;
+    next = (index + 1) % size;
+
+    SnapshotFrame& frame = *frames[index];
+    scene.copyTo(frame.scene);
+    normFore.copyTo(frame.normFore);
+    frame.time = time;
+    frame.count = count;
+    return SnapshotFrameHandle(frames[index]);
+}
+
+const SnapshotFrameHandle& OrigSceneProxy::getFrameHandle(const OrigForeProxy& fore)
+{
+    if (!done) 
+    {    
         done = true;
-        origFore = Mat::zeros(origSize, CV_8UC1);
+        if (ring)
+            handle = ring->acquire(shallowCopy, fore.getNormFore(), currTime, currCount);
+        else
+        {
+            Ptr<SnapshotFrame> frame = new SnapshotFrame;
+            shallowCopy.copyTo(frame->scene);
+            fore.getNormFore().copyTo(frame->normFore);
+            frame->time = currTime;
+            frame->count = currCount;
+            handle = SnapshotFrameHandle(frame);
+        }
     }
-    Mat normForeROI = normFore(normRect);
-    Mat origForeROI = origFore(origRect);
-    resize(normForeROI, origForeROI, Size(origRect.width, origRect.height), 0, 0, INTER_NEAREST);
-    return origFore;
+    return handle;
 }
 
 }
@@ -555,34 +1014,20 @@ namespace zsfo
 
 void BlobSnapshotRecord::makeRecord(OrigSceneProxy& scene, OrigForeProxy& fore, 
     const SizeInfo& sizeInfo, const cv::Rect& baseRect, const cv::Rect& blobRect, 
-    long long int currTime, int currCount, int saveMode)
+    long long int currTime, int currCount, int mode)
 {
     normRect = blobRect & baseRect;
     origRect = Rect(int(normRect.x * sizeInfo.horiScale), int(normRect.y * sizeInfo.vertScale),
                     int(normRect.width * sizeInfo.horiScale), int(normRect.height * sizeInfo.vertScale));
     time = currTime;
     count = currCount;
+    saveMode = mode;
 
-    // 保存全景图
-    if (saveMode & SaveSnapshotMode::SaveScene)
-        fullFrame = scene.getDeepCopy();
-
-    // 保存运动目标的截图
-    if (saveMode & SaveSnapshotMode::SaveSlice)
-    {       
-        //Mat tempImage = Mat(scene.getDeepCopy(), origRect);
-        //tempImage.copyTo(blobImage);
-        blobImage = Mat(scene.getDeepCopy(), origRect);
-    }
-
-    // 保存运动目标的二值化前景图
-    if (saveMode & SaveSnapshotMode::SaveMask)
-    {
-        //Mat foreImageROI = Mat(normForeImage, normRect);
-        //resize(foreImageROI, foreImage, Size(origRect.width, origRect.height));
-        //threshold(foreImage, foreImage, 127, 255, THRESH_BINARY);
-        foreImage = fore.getDeepCopy(normRect, origRect);
-    }
+    // 只记录快照帧, 全景图, 运动目标的截图和二值化前景图在 outputImages 中才生成
+    if (saveMode & (SaveSnapshotMode::SaveScene | SaveSnapshotMode::SaveSlice | SaveSnapshotMode::SaveMask))
+        frame = scene.getFrameHandle(fore);
+    else
+        frame.release();
 }
 
 void BlobSnapshotRecord::makeRecord(OrigSceneProxy& scene, OrigForeProxy& fore, 
@@ -604,9 +1049,8 @@ void BlobSnapshotRecord::copyTo(BlobSnapshotRecord& record) const
     record.origRect = origRect;
     record.time = time;
     record.count = count;
-    blobImage.copyTo(record.blobImage);
-    foreImage.copyTo(record.foreImage);
-    fullFrame.copyTo(record.fullFrame);
+    record.saveMode = saveMode;
+    record.frame = frame;
 }
 
 void BlobSnapshotRecord::outputImages(ObjectSnapshotRecord& snapshotRecord) const
@@ -623,15 +1067,28 @@ void BlobSnapshotRecord::outputImages(ObjectSnapshotRecord& snapshotRecord) cons
     snapshotRecord.cross = crossIn;
     // 保存截图的行驶方向
     snapshotRecord.direction = direction;
+    if (frame.empty())
+        return;
     // 保存抓拍车辆时的原始帧
-    if (fullFrame.data)
-        fullFrame.copyTo(snapshotRecord.scene);
+    if (saveMode & SaveSnapshotMode::SaveScene)
+        frame->scene.copyTo(snapshotRecord.scene);
     // 保存前景二值图
-    if (foreImage.data)
-        foreImage.copyTo(snapshotRecord.mask);
+    if (saveMode & SaveSnapshotMode::SaveMask)
+    {
+        snapshotRecord.mask = Mat::zeros(frame->scene.size(), CV_8UC1);
+        Mat origForeROI = snapshotRecord.mask(origRect);
+        resize(frame->normFore(normRect), origForeROI, Size(origRect.width, origRect.height), 0, 0, INTER_NEAREST);
+    }
     // 保存原始帧中的车辆截图
-    if (blobImage.data)
-        blobImage.copyTo(snapshotRecord.slice);
+    if (saveMode & SaveSnapshotMode::SaveSlice)
+        frame->scene(origRect).copyTo(snapshotRecord.slice);
+}
+
+Mat BlobSnapshotRecord::getSlice(void) const
+{
+    if (frame.empty())
+        return Mat();
+    return frame->scene(origRect);
 }
 
 BlobTriBoundSnapshotHistory::BlobTriBoundSnapshotHistory(const cv::Ptr<SizeInfo>& sizesOrigAndNorm, 
@@ -769,7 +1226,7 @@ void BlobTriBoundSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
 #if CMPL_SHOW_IMAGE
             if (configUpdate->runShowImage)
             {
-                imshow("left record", leftRecord.blobImage);
+                imshow("left record", leftRecord.getSlice());
                 waitKey(configUpdate->waitTime);
                 destroyWindow("left record");
             }
@@ -808,7 +1265,7 @@ void BlobTriBoundSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
 #if CMPL_SHOW_IMAGE
             if (configUpdate->runShowImage)
             {
-                imshow("right record", rightRecord.blobImage);
+                imshow("right record", rightRecord.getSlice());
                 waitKey(configUpdate->waitTime);
                 destroyWindow("right record");
             }
@@ -847,7 +1304,7 @@ void BlobTriBoundSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
 #if CMPL_SHOW_IMAGE
             if (configUpdate->runShowImage)
             {
-                imshow("bottom record", bottomRecord.blobImage);
+                imshow("bottom record", bottomRecord.getSlice());
                 waitKey(configUpdate->waitTime);
                 destroyWindow("bottom record");
             }
@@ -858,6 +1315,26 @@ void BlobTriBoundSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
     lastRect = currRect;
 }
 
+bool BlobTriBoundSnapshotHistory::mustUpdate(const cv::Rect& currRect) const
+{
+    // 与 updateHistory 的跨越判断相同, 跳过的帧不更新 lastRect, 跨越会在下一次更新时补上
+    if (!hasUpdate)
+        return true;
+    if (!hasLeftCrossLoopLeft &&
+        recordLoop->leftToLeftBound(Point(lastRect.x, lastRect.y + lastRect.height / 2)) !=
+        recordLoop->leftToLeftBound(Point(currRect.x, currRect.y + currRect.height / 2)))
+        return true;
+    if (!hasRightCrossLoopRight &&
+        recordLoop->rightToRightBound(Point(lastRect.x + lastRect.width, lastRect.y + lastRect.height / 2)) !=
+        recordLoop->rightToRightBound(Point(currRect.x + currRect.width, currRect.y + currRect.height / 2)))
+        return true;
+    if (!hasBottomCrossLoopBottom &&
+        recordLoop->belowBottomBound(Point(lastRect.x + lastRect.width / 2, lastRect.y + lastRect.height)) !=
+        recordLoop->belowBottomBound(Point(currRect.x + currRect.width / 2, currRect.y + currRect.height)))
+        return true;
+    return false;
+}
+
 bool BlobTriBoundSnapshotHistory::outputHistory(ObjectInfo& objectInfo) const
 {
     if (!hasUpdate)
@@ -1239,7 +1716,7 @@ void BlobBottomBoundSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
 #if CMPL_SHOW_IMAGE
             if (configUpdate->runShowImage)
             {
-                imshow("bottom record", bottomRecord.blobImage);
+                imshow("bottom record", bottomRecord.getSlice());
                 waitKey(configUpdate->waitTime);
                 destroyWindow("bottom record");
             }
@@ -1250,6 +1727,15 @@ void BlobBottomBoundSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
     lastRect = currRect;
 }
 
+bool BlobBottomBoundSnapshotHistory::mustUpdate(const cv::Rect& currRect) const
+{
+    if (!hasUpdate)
+        return true;
+    return !hasBottomCrossLoopBottom &&
+        recordLoop->belowBottomBound(Point(lastRect.x + lastRect.width / 2, lastRect.y + lastRect.height)) !=
+        recordLoop->belowBottomBound(Point(currRect.x + currRect.width / 2, currRect.y + currRect.height));
+}
+
 bool BlobBottomBoundSnapshotHistory::outputHistory(ObjectInfo& objectInfo) const
 {
     if (!hasUpdate)
@@ -1397,7 +1883,7 @@ void BlobCrossLineSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
 #if CMPL_SHOW_IMAGE
             if (configUpdate->runShowImage)
             {
-                imshow("cross line record", crossLineRecord.blobImage);
+                imshow("cross line record", crossLineRecord.getSlice());
                 waitKey(configUpdate->waitTime);
                 destroyWindow("cross line record");
             }
@@ -1420,7 +1906,7 @@ void BlobCrossLineSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
 #if CMPL_SHOW_IMAGE
                 if (configUpdate->runShowImage)
                 {
-                    imshow("cross line record", crossLineRecord.blobImage);
+                    imshow("cross line record", crossLineRecord.getSlice());
                     waitKey(configUpdate->waitTime);
                     destroyWindow("cross line record");
                 }
@@ -1430,6 +1916,12 @@ void BlobCrossLineSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
     }
 }
 
+bool BlobCrossLineSnapshotHistory::mustUpdate(const cv::Rect& currRect) const
+{
+    return !hasUpdate &&
+        recordLine->distTo(Point(currRect.x + currRect.width / 2, currRect.y + currRect.height / 2)) < maxDistToRecord;
+}
+
 bool BlobCrossLineSnapshotHistory::outputHistory(ObjectInfo& objectInfo) const
 {
     if (!hasCrossLine)
@@ -1712,6 +2204,11 @@ void BlobMultiRecordSnapshotHistory::updateHistory(OrigSceneProxy& origFrame,
     }
 }
 
+bool BlobMultiRecordSnapshotHistory::mustUpdate(const cv::Rect& currRect) const
+{
+    return history.empty();
+}
+
 bool BlobMultiRecordSnapshotHistory::outputHistory(ObjectInfo& objectInfo) const
 {
     int size = history.size();
@@ -1723,3 +2220,95 @@ bool BlobMultiRecordSnapshotHistory::outputHistory(ObjectInfo& objectInfo) const
 }
 
 }
+
+namespace
+{
+
+// 按帧编号在 begRecord 和 endRecord 之间插值, 返回 midRecord 的中心和宽高偏离插值结果的最大值
+double interpolateDeviation(const zsfo::ObjectRecord& begRecord, const zsfo::ObjectRecord& endRecord,
+    const zsfo::ObjectRecord& midRecord, double ratio)
+{
+    const Rect& beg = begRecord.normRect;
+    const Rect& end = endRecord.normRect;
+    const Rect& mid = midRecord.normRect;
+    double devCenterX = fabs((beg.x + beg.width * 0.5) * (1 - ratio) + (end.x + end.width * 0.5) * ratio - (mid.x + mid.width * 0.5));
+    double devCenterY = fabs((beg.y + beg.height * 0.5) * (1 - ratio) + (end.y + end.height * 0.5) * ratio - (mid.y + mid.height * 0.5));
+    double devWidth = fabs(beg.width * (1 - ratio) + end.width * ratio - mid.width);
+    double devHeight = fabs(beg.height * (1 - ratio) + end.height * ratio - mid.height);
+    return max(max(devCenterX, devCenterY), max(devWidth, devHeight));
+}
+
+}
+
+namespace zsfo
+{
+
+void simplifyHistory(const ObjectInfo& object, double tolerance, vector<ObjectRecord>& simplifiedHistory)
+{
+    const vector<ObjectRecord>& history = object.history;
+    int size = history.size();
+    if (tolerance <= 0 || size <= 2)
+    {
+        simplifiedHistory = history;
+        return;
+    }
+
+    // 第一条, 最后一条和快照图片所在帧的记录必须保留
+    vector<int> snapshotNumbers(object.snapshotHistory.size());
+    for (int i = 0; i < snapshotNumbers.size(); i++)
+        snapshotNumbers[i] = object.snapshotHistory[i].number;
+    sort(snapshotNumbers.begin(), snapshotNumbers.end());
+    vector<char> keep(size, 0);
+    keep[0] = keep[size - 1] = 1;
+    for (int i = 1; i < size - 1; i++)
+        keep[i] = binary_search(snapshotNumbers.begin(), snapshotNumbers.end(), history[i].number);
+
+    // 在相邻的必须保留的记录之间做 Douglas-Peucker 简化, 用栈代替递归
+    vector<pair<int, int> > segments;
+    int begIndex = 0;
+    for (int i = 1; i < size; i++)
+    {
+        if (keep[i])
+        {
+            segments.push_back(make_pair(begIndex, i));
+            begIndex = i;
+        }
+    }
+    while (!segments.empty())
+    {
+        int beg = segments.back().first, end = segments.back().second;
+        segments.pop_back();
+        if (end - beg < 2)
+            continue;
+
+        int numberDiff = history[end].number - history[beg].number;
+        double maxDev = -1;
+        int maxIndex = beg;
+        for (int i = beg + 1; i < end; i++)
+        {
+            double ratio = numberDiff > 0 ? 
+                double(history[i].number - history[beg].number) / numberDiff : double(i - beg) / (end - beg);
+            double dev = interpolateDeviation(history[beg], history[end], history[i], ratio);
+            if (dev > maxDev)
+            {
+                maxDev = dev;
+                maxIndex = i;
+            }
+        }
+        if (maxDev > tolerance)
+        {
+            keep[maxIndex] = 1;
+            segments.push_back(make_pair(beg, maxIndex));
+            segments.push_back(make_pair(maxIndex, end));
+        }
+    }
+
+    simplifiedHistory.clear();
+    for (int i = 0; i < size; i++)
+    {
+        if (keep[i])
+            simplifiedHistory.push_back(history[i]);
+    }
+}
+
+}
@@ -5,6 +5,8 @@
 #include "FileStreamScopeGuard.h"
 #include "Exception.h"
 #include "CompileControl.h"
+#include "FrameDeadline.h"
+#include "StageProfiler.h"
 
 using namespace cv;
 using namespace std;
@@ -55,6 +57,43 @@ void BlobTracker::setConfigParams(const bool* checkTurnAround, const double* max
         minRatioIntersectToSelf, minRatioIntersectToBlob);
 }
 
+void BlobTracker::setHistoryMemoryParams(const int* maxHistorySize, const int* numOfRecentRecords,
+    const long long int* maxImageBytes, const int* evictPolicy)
+{
+    ptrImpl->setHistoryMemoryParams(maxHistorySize, numOfRecentRecords, maxImageBytes, evictPolicy);
+}
+
+void BlobTracker::setOutputParams(const bool* interpolateHistory, const int* maxInterpolateFrameGap)
+{
+    ptrImpl->setOutputParams(interpolateHistory, maxInterpolateFrameGap);
+}
+
+void BlobTracker::setMotionPredictParams(const bool* runPredictMotion, const int* refProcInterval, 
+    const double* maxGateScale)
+{
+    ptrImpl->setMotionPredictParams(runPredictMotion, refProcInterval, maxGateScale);
+}
+
+void BlobTracker::getHistoryMemoryInfo(HistoryMemoryInfo& info) const
+{
+    ptrImpl->getHistoryMemoryInfo(info);
+}
+
+void BlobTracker::getActivityInfo(TrackingActivityInfo& info) const
+{
+    ptrImpl->getActivityInfo(info);
+}
+
+void BlobTracker::setFrameDeadline(const Ptr<FrameDeadline>& deadline)
+{
+    ptrImpl->setFrameDeadline(deadline);
+}
+
+void BlobTracker::setStageProfiler(const Ptr<StageProfiler>& profiler)
+{
+    ptrImpl->setStageProfiler(profiler);
+}
+
 void BlobTracker::proc(long long int time, int count, const vector<Rect>& rects, vector<ObjectInfo>& objects)
 {
     ptrImpl->proc(time, count, rects, objects);
@@ -86,6 +125,7 @@ void BlobTracker::final(vector<ObjectInfo>& objects) const
 
 void BlobTracker::BlobTrackerImpl::initConfigParam(const string& path)
 {
+    historyCapacity = new HistoryCapacity;
     if (!path.empty())
     {
         fstream initFileStream;
@@ -123,6 +163,22 @@ void BlobTracker::BlobTrackerImpl::initConfigParam(const string& path)
         initFileStream >> stringNotUsed;
         initFileStream >> configMatch.runShowFitLine;
 
+        initFileStream >> stringNotUsed >> stringNotUsed;
+        initFileStream >> historyCapacity->maxHistorySize;
+        initFileStream >> stringNotUsed;
+        initFileStream >> historyCapacity->numOfRecentRecords;
+        initFileStream >> stringNotUsed;
+        initFileStream >> historyCapacity->maxImageBytes;
+        initFileStream >> stringNotUsed;
+        initFileStream >> historyCapacity->evictPolicy;
+
+        initFileStream >> stringNotUsed >> stringNotUsed;
+        initFileStream >> configMatch.runPredictMotion;
+        initFileStream >> stringNotUsed;
+        initFileStream >> configMatch.refProcInterval;
+        initFileStream >> stringNotUsed;
+        initFileStream >> configMatch.maxGateScale;
+
         initFileStream.close();
     }
     else
@@ -135,9 +191,18 @@ void BlobTracker::BlobTrackerImpl::initConfigParam(const string& path)
         configMatch.minRatioIntersectToSelf = 0.6;
         configMatch.minRatioIntersectToBlob = 0.6;
         configMatch.maxHistorySizeForDistMatch = 0;
-        configMatch.maxAvgErrorForDistMatch = 15;
+        configMatch.maxAvgErrorForDistMatch = 19;
         configMatch.runDisplayCalcResults = false;
         configMatch.runShowFitLine = false;
+        configMatch.runPredictMotion = false;
+        configMatch.refProcInterval = 0;
+        configMatch.maxGateScale = 4;
+
+        // 默认不限制历史记录的条数和截图占用的内存, 和引入容量上限之前的输出一致
+        historyCapacity->maxHistorySize = 0;
+        historyCapacity->numOfRecentRecords = 0;
+        historyCapacity->maxImageBytes = 0;
+        historyCapacity->evictPolicy = HistoryEvictPolicy::DropOwnOldest;
     }
 
 #if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
@@ -152,6 +217,15 @@ void BlobTracker::BlobTrackerImpl::initConfigParam(const string& path)
     printf("    configMatch.maxAvgErrorForDistMatch = %.4f\n", configMatch.maxAvgErrorForDistMatch);
     printf("    configMatch.runDisplayCalcResults = %s\n", configMatch.runDisplayCalcResults ? "true" : "false");
     printf("    configMatch.runShowFitLine = %s\n", configMatch.runShowFitLine ? "true" : "false");
+    printf("    configMatch.runPredictMotion = %s\n", configMatch.runPredictMotion ? "true" : "false");
+    printf("    configMatch.refProcInterval = %d\n", configMatch.refProcInterval);
+    printf("    configMatch.maxGateScale = %.4f\n", configMatch.maxGateScale);
+
+    printf("  history memory:\n");
+    printf("    historyCapacity.maxHistorySize = %d\n", historyCapacity->maxHistorySize);
+    printf("    historyCapacity.numOfRecentRecords = %d\n", historyCapacity->numOfRecentRecords);
+    printf("    historyCapacity.maxImageBytes = %lld\n", historyCapacity->maxImageBytes);
+    printf("    historyCapacity.evictPolicy = %d\n", historyCapacity->evictPolicy);
 
     printf("\n");
 #endif
@@ -164,8 +238,10 @@ void BlobTracker::BlobTrackerImpl::init(const SizeInfo& sizesOrigAndNorm, const
     sizeInfo = new SizeInfo(sizesOrigAndNorm);
     currTime = new long long int;
     currCount = new int;
+    historyMemory = new HistoryMemoryInfo;
     initConfigParam(path);
     blobInstance = new Blob(sizeInfo, currTime, currCount, 0, historyWithImages, path);
+    blobInstance->setHistoryMemory(historyCapacity, historyMemory);
     blobCount = 0;
 }
 
@@ -178,8 +254,10 @@ void BlobTracker::BlobTrackerImpl::initLineSegment(const SizeInfo& sizesOrigAndN
     baseRect = new Rect(0, 0, sizeInfo->normWidth, sizeInfo->normHeight);
     currTime = new long long int;
     currCount = new int;
+    historyMemory = new HistoryMemoryInfo;
     initConfigParam(path);
     blobInstance = new Blob(sizeInfo, recordLine, baseRect, currTime, currCount, 0, saveSnapshotMode, historyWithImages, path);
+    blobInstance->setHistoryMemory(historyCapacity, historyMemory);
     blobCount = 0;
 }
 
@@ -192,9 +270,11 @@ void BlobTracker::BlobTrackerImpl::initBottomBound(const SizeInfo& sizesOrigAndN
     baseRect = new Rect(0, 0, sizeInfo->normWidth, sizeInfo->normHeight);
     currTime = new long long int;
     currCount = new int;
+    historyMemory = new HistoryMemoryInfo;
     initConfigParam(path);
     blobInstance = new Blob(sizeInfo, recordLoop, baseRect, currTime, currCount, 
         0, false, saveSnapshotMode, historyWithImages, path);
+    blobInstance->setHistoryMemory(historyCapacity, historyMemory);
     blobCount = 0;
 }
 
@@ -207,9 +287,11 @@ void BlobTracker::BlobTrackerImpl::initTriBound(const SizeInfo& sizesOrigAndNorm
     baseRect = new Rect(0, 0, sizeInfo->normWidth, sizeInfo->normHeight);
     currTime = new long long int;
     currCount = new int;
+    historyMemory = new HistoryMemoryInfo;
     initConfigParam(path);
     blobInstance = new Blob(sizeInfo, recordLoop, baseRect, currTime, currCount, 
         0, true, saveSnapshotMode, historyWithImages, path);
+    blobInstance->setHistoryMemory(historyCapacity, historyMemory);
     blobCount = 0;
 }
 
@@ -221,9 +303,11 @@ void BlobTracker::BlobTrackerImpl::initMultiRecord(const SizeInfo& sizesOrigAndN
     baseRect = new Rect(0, 0, sizeInfo->normWidth, sizeInfo->normHeight);
     currTime = new long long int;
     currCount = new int;
+    historyMemory = new HistoryMemoryInfo;
     initConfigParam(path);
     blobInstance = new Blob(sizeInfo, baseRect, currTime, currCount, 
         0, saveSnapshotMode, saveSnapshotInterval, numOfSnapshotSaved, historyWithImages, path);
+    blobInstance->setHistoryMemory(historyCapacity, historyMemory);
     blobCount = 0;
 }
 
@@ -269,6 +353,130 @@ void BlobTracker::BlobTrackerImpl::setConfigParams(const bool* checkTurnAround,
 #endif
 }
 
+void BlobTracker::BlobTrackerImpl::setHistoryMemoryParams(const int* maxHistorySize, const int* numOfRecentRecords,
+    const long long int* maxImageBytes, const int* evictPolicy)
+{
+    if (!(maxHistorySize || numOfRecentRecords || maxImageBytes || evictPolicy))
+        return;
+
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    printf("Some history memory param(s) of BlobTracker set:\n");
+#endif
+    if (maxHistorySize)
+    {
+        historyCapacity->maxHistorySize = *maxHistorySize;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  historyCapacity.maxHistorySize = %d\n", historyCapacity->maxHistorySize);
+#endif
+    }
+    if (numOfRecentRecords)
+    {
+        historyCapacity->numOfRecentRecords = *numOfRecentRecords;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  historyCapacity.numOfRecentRecords = %d\n", historyCapacity->numOfRecentRecords);
+#endif
+    }
+    if (maxImageBytes)
+    {
+        historyCapacity->maxImageBytes = *maxImageBytes;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  historyCapacity.maxImageBytes = %lld\n", historyCapacity->maxImageBytes);
+#endif
+    }
+    if (evictPolicy)
+    {
+        historyCapacity->evictPolicy = *evictPolicy;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  historyCapacity.evictPolicy = %d\n", historyCapacity->evictPolicy);
+#endif
+    }
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    printf("\n");
+#endif
+}
+
+void BlobTracker::BlobTrackerImpl::setOutputParams(const bool* interpolateHistory, const int* maxInterpolateFrameGap)
+{
+    // 所有运动目标共享 blobInstance 的输出配置
+    blobInstance->setOutputParams(interpolateHistory, maxInterpolateFrameGap);
+}
+
+void BlobTracker::BlobTrackerImpl::setMotionPredictParams(const bool* runPredictMotion, const int* refProcInterval, 
+    const double* maxGateScale)
+{
+    if (!(runPredictMotion || refProcInterval || maxGateScale))
+        return;
+
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    printf("Some motion predict param(s) of BlobTracker set:\n");
+#endif
+    if (runPredictMotion)
+    {
+        configMatch.runPredictMotion = *runPredictMotion;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  configMatch.runPredictMotion = %s\n", configMatch.runPredictMotion ? "true" : "false");
+#endif
+    }
+    if (refProcInterval)
+    {
+        configMatch.refProcInterval = *refProcInterval;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  configMatch.refProcInterval = %d\n", configMatch.refProcInterval);
+#endif
+    }
+    if (maxGateScale)
+    {
+        configMatch.maxGateScale = *maxGateScale;
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+        printf("  configMatch.maxGateScale = %.4f\n", configMatch.maxGateScale);
+#endif
+    }
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    printf("\n");
+#endif
+}
+
+void BlobTracker::BlobTrackerImpl::getHistoryMemoryInfo(HistoryMemoryInfo& info) const
+{
+    info = *historyMemory;
+}
+
+void BlobTracker::BlobTrackerImpl::getActivityInfo(TrackingActivityInfo& info) const
+{
+    info.numOfBlobs = 0;
+    info.numOfBlobsNearRecord = 0;
+    for (list<Ptr<Blob> >::const_iterator ptrBlob = blobList.begin(); ptrBlob != blobList.end(); ++ptrBlob)
+    {
+        if ((*ptrBlob)->getIsToBeDeleted())
+            continue;
+        info.numOfBlobs++;
+        Rect rect = (*ptrBlob)->getCurrRect();
+        bool isNear = true;
+        if (!recordLoop.empty())
+        {
+            Rect extRect(rect.x - rect.width / 2, rect.y - rect.height / 2, rect.width * 2, rect.height * 2);
+            isNear = recordLoop->intersects(extRect);
+        }
+        else if (!recordLine.empty())
+        {
+            Point center(rect.x + rect.width / 2, rect.y + rect.height / 2);
+            isNear = recordLine->closeTo(center, max(rect.width, rect.height));
+        }
+        if (isNear)
+            info.numOfBlobsNearRecord++;
+    }
+}
+
+void BlobTracker::BlobTrackerImpl::setFrameDeadline(const Ptr<FrameDeadline>& deadline)
+{
+    frameDeadline = deadline;
+}
+
+void BlobTracker::BlobTrackerImpl::setStageProfiler(const Ptr<StageProfiler>& profiler)
+{
+    stageProfiler = profiler;
+}
+
 void BlobTracker::BlobTrackerImpl::proc(long long int time, int count, 
     const vector<Rect>& rects, vector<ObjectInfo>& objects)
 {
@@ -343,52 +551,10 @@ void BlobTracker::BlobTrackerImpl::addBlob(const Rect& rect)
 
 void BlobTracker::BlobTrackerImpl::updateBlobListBeforeCheck(const vector<Rect>& rects)
 {
+    StageTimer timer(stageProfiler, ProcStage::Match);
     match(rects);
 }
 
-}
-
-namespace
-{
-
-void linearRegres(const vector<Point>& history, Point& pointInLine, Point2d& dirVector, double& avgError)
-{
-    double N = history.size();  
-    double sumX = 0, sumY = 0, sumXY = 0, sumX2 = 0, sumY2 = 0;
-    for (int i = 0; i < N; i++)
-    {
-        sumX += history[i].x;
-        sumY += history[i].y;
-        sumXY += history[i].x * history[i].y;
-        sumX2 += history[i].x * history[i].x;
-        sumY2 += history[i].y * history[i].y;
-    }
-
-    double dX2 = N * sumX2 - sumX * sumX;
-    double dY2 = N * sumY2 - sumY * sumY;
-    double dXY = N * sumXY - sumX * sumY;
-
-    pointInLine.x = sumX / N;
-    pointInLine.y = sumY / N;
-
-    double theta = atan2(2 * dXY, dX2 - dY2) / 2;
-    dirVector.x = cos(theta);
-    dirVector.y = sin(theta);
-
-    double sumError = 0;
-    for (int i = 0; i < N; i++)
-    {
-        sumError += fabs(dirVector.y * history[i].x + dirVector.x * pointInLine.y -
-                         dirVector.y * pointInLine.x - dirVector.x * history[i].y);
-    }
-    avgError = sumError / N;
-}
-
-}
-
-namespace zsfo
-{
-
 void BlobTracker::BlobTrackerImpl::match(const vector<Rect>& rects)
 {
     // 如果 blobList 为空，rects 为空，不进行任何操作，直接返回
@@ -445,6 +611,8 @@ void BlobTracker::BlobTrackerImpl::match(const vector<Rect>& rects)
     double* ratioToBlob = new double[blobList.size() * rects.size()];
     // 当前帧中的矩形中心和当前 blobList 中运动目标在上一帧中的矩形中心的距离
     double* dist = new double[blobList.size() * rects.size()];
+    // 当前 blobList 中的运动目标按照处理间隔缩放后的距离匹配门限
+    double* maxDist = new double[blobList.size()];
     // 当前 blobList 中的运动目标和当前帧中的矩形的匹配关系
     bool* match = new bool[blobList.size() * rects.size()];
     // 是否对应新的运动目标的矩形
@@ -457,11 +625,20 @@ void BlobTracker::BlobTrackerImpl::match(const vector<Rect>& rects)
     }
 
     // 计算相交比例和距离
+    // 如果进行运动预测, 上一帧中的矩形替换成按匀速运动模型预测的当前帧中的矩形
+    // 处理间隔超过参考间隔时, 距离匹配门限按时间间隔的比例放大
     int i = 0;
     for (list<Ptr<Blob> >::iterator ptrBlob = blobList.begin(); ptrBlob != blobList.end(); ++ptrBlob, i++)
     {
         Blob* pCurrBlob = *ptrBlob;
-        Rect lastRect = pCurrBlob->getCurrRect();
+        Rect lastRect = configMatch.runPredictMotion ? pCurrBlob->getPredictedRect() : pCurrBlob->getCurrRect();
+        double gateScale = 1;
+        if (configMatch.refProcInterval > 0)
+        {
+            gateScale = double(pCurrBlob->getElapsedTime()) / configMatch.refProcInterval;
+            gateScale = min(max(gateScale, 1.0), max(configMatch.maxGateScale, 1.0));
+        }
+        maxDist[i] = configMatch.maxDistRectAndBlob * gateScale;
         Point lastCenter = Point(lastRect.x + lastRect.width / 2, lastRect.y + lastRect.height / 2);
         for (int j = 0; j < numOfRect; j++)
         {
@@ -502,7 +679,7 @@ void BlobTracker::BlobTrackerImpl::match(const vector<Rect>& rects)
             }
         }
         // 没有能够和运动目标进行匹配的矩形，创建新的跟踪对象
-        if (minDist > configMatch.maxDistRectAndBlob && 
+        if (minDist > maxDist[minDistIndex] && 
             ratioToSelf[minDistIndex * numOfRect + i] < /*0.6*/configMatch.minRatioIntersectToSelf &&
             ratioToBlob[minDistIndex * numOfRect + i] < /*0.6*/configMatch.minRatioIntersectToBlob)
         {
@@ -673,16 +850,14 @@ void BlobTracker::BlobTrackerImpl::match(const vector<Rect>& rects)
             Point pointInLine; 
             Point2d dirUnitVector;
             double avgError;
-            vector<Point> centerHistory;
-            pCurrBlob->getCenterHistory(centerHistory);
-            linearRegres(centerHistory, pointInLine, dirUnitVector, avgError);
+            pCurrBlob->fitCenterLine(pointInLine, dirUnitVector, avgError);
             // 如果历史轨迹小于 10 
             // 或者拟合出来的直线是竖直方向的直线
             // 或者轨迹上个点相距拟合直线的距离过大
             // 或者所有与运动目标相交的矩形面积都较小
             // 直接找最小距离
             if (pCurrBlob->getHistoryLength() < /*10*/configMatch.maxHistorySizeForDistMatch || 
-                avgError > /*15*/configMatch.maxAvgErrorForDistMatch || areAllRectsSmall)
+                avgError > /*19*/configMatch.maxAvgErrorForDistMatch || areAllRectsSmall)
             {
                 // 找第一个与运动目标匹配的矩形
                 for (int j = 0; j < numOfRect; j++)
@@ -826,6 +1001,7 @@ void BlobTracker::BlobTrackerImpl::match(const vector<Rect>& rects)
     delete [] ratioToSelf;
     delete [] ratioToBlob;
     delete [] dist;
+    delete [] maxDist;
     delete [] match;
     delete [] isNewBlobRect;
 }
@@ -858,22 +1034,66 @@ void BlobTracker::BlobTrackerImpl::updateState(void)
 
 void BlobTracker::BlobTrackerImpl::updateState(const Mat& origFrame, const Mat& foreImage)
 {
-    OrigSceneProxy scene(origFrame);
-    OrigForeProxy fore(foreImage, Size(sizeInfo->origWidth, sizeInfo->origHeight));
+    StageTimer timer(stageProfiler, ProcStage::Snapshot);
+    // 超出预算时只记录矩形, 不更新快照图片和历史截图,
+    // 正在跨越线圈等跳过这一帧就会丢失抓拍的目标仍然更新, 保证输出时有快照图片
+    bool skipSnapshot = !frameDeadline.empty() && !frameDeadline->allows(OptionalStage::SnapshotUpdate);
+    OrigSceneProxy scene(origFrame, &frameRing, *currTime, *currCount);
+    OrigForeProxy fore(foreImage);
     for (list<Ptr<Blob> >::iterator ptrBlob = blobList.begin(); ptrBlob != blobList.end(); ptrBlob++)
     {
-        (*ptrBlob)->updateState(scene, fore);
+        if (skipSnapshot && !(*ptrBlob)->mustUpdateSnapshot())
+            (*ptrBlob)->updateState();
+        else
+            (*ptrBlob)->updateState(scene, fore);
     }
+    evictHistoryImages();
 }
 
 void BlobTracker::BlobTrackerImpl::updateState(const Mat& origFrame, const Mat& foreImage, 
     const Mat& gradDiffImage, const Mat& lastGradDiffImage)
 {
-    OrigSceneProxy scene(origFrame);
-    OrigForeProxy fore(foreImage, Size(sizeInfo->origWidth, sizeInfo->origHeight));
+    StageTimer timer(stageProfiler, ProcStage::Snapshot);
+    bool skipSnapshot = !frameDeadline.empty() && !frameDeadline->allows(OptionalStage::SnapshotUpdate);
+    OrigSceneProxy scene(origFrame, &frameRing, *currTime, *currCount);
+    OrigForeProxy fore(foreImage);
     for (list<Ptr<Blob> >::iterator ptrBlob = blobList.begin(); ptrBlob != blobList.end(); ptrBlob++)
     {
-        (*ptrBlob)->updateState(scene, fore, gradDiffImage, lastGradDiffImage);
+        if (skipSnapshot && !(*ptrBlob)->mustUpdateSnapshot())
+            (*ptrBlob)->updateState();
+        else
+            (*ptrBlob)->updateState(scene, fore, gradDiffImage, lastGradDiffImage);
+    }
+    evictHistoryImages();
+}
+
+void BlobTracker::BlobTrackerImpl::evictHistoryImages(void)
+{
+    if (historyCapacity->evictPolicy != HistoryEvictPolicy::DropFromLargest ||
+        historyCapacity->maxImageBytes <= 0)
+        return;
+
+    while (historyMemory->imageBytes > historyCapacity->maxImageBytes)
+    {
+        // 找到截图占用内存最多的目标, 释放其较早的截图, 至少释放一半
+        Blob* pLargestBlob = 0;
+        long long int largestBytes = 0;
+        for (list<Ptr<Blob> >::iterator ptrBlob = blobList.begin(); ptrBlob != blobList.end(); ++ptrBlob)
+        {
+            long long int bytes = (*ptrBlob)->getHistoryImageBytes();
+            if (bytes > largestBytes)
+            {
+                largestBytes = bytes;
+                pLargestBlob = *ptrBlob;
+            }
+        }
+        if (!pLargestBlob)
+            break;
+
+        long long int bytesToRelease = historyMemory->imageBytes - historyCapacity->maxImageBytes;
+        if (bytesToRelease < largestBytes / 2)
+            bytesToRelease = largestBytes / 2;
+        pLargestBlob->releaseHistoryImages(bytesToRelease);
     }
 }
 
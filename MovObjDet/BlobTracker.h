@@ -11,6 +11,8 @@ namespace zsfo
 struct RegionOfInterest;
 struct LineSegment;
 struct VirtualLoop;
+struct FrameDeadline;
+class StageProfiler;
 
 //! 记录快照模式
 struct RecordSnapshotMode
@@ -36,17 +38,62 @@ struct SaveSnapshotMode
     };
 };
 
+//! 运动目标历史截图占用内存超过上限时的处理策略
+struct HistoryEvictPolicy
+{
+    enum
+    {
+        DropOwnOldest = 0,     ///< 释放当前目标自身最早的历史截图
+        DropFromLargest = 1,   ///< 每帧处理结束后, 释放截图占用内存最多的目标的较早的历史截图
+        RejectNew = 2          ///< 不再为新的历史记录保存截图
+    };
+};
+
+//! 运动目标历史记录的内存占用统计
+struct HistoryMemoryInfo
+{
+    //! 构造函数
+    HistoryMemoryInfo(void)
+        : numOfRecords(0), recordBytes(0), numOfImages(0), imageBytes(0), peakBytes(0),
+          numOfDecimated(0), numOfImagesEvicted(0), numOfImagesRejected(0)
+    {};
+
+    long long int numOfRecords;        ///< 当前保存的历史记录条数
+    long long int recordBytes;         ///< 历史记录本身占用的字节数, 不含截图
+    long long int numOfImages;         ///< 当前保存的历史截图数量
+    long long int imageBytes;          ///< 历史截图占用的字节数
+    long long int peakBytes;           ///< recordBytes 与 imageBytes 之和的峰值
+    long long int numOfDecimated;      ///< 因历史长度限制被降采样丢弃的记录条数
+    long long int numOfImagesEvicted;  ///< 因内存上限被释放的历史截图数量
+    long long int numOfImagesRejected; ///< 因内存上限没有保存的历史截图数量
+};
+
+//! 当前帧跟踪状态的活跃程度, 供调用者调整处理帧率
+struct TrackingActivityInfo
+{
+    //! 构造函数
+    TrackingActivityInfo(void) : numOfBlobs(0), numOfBlobsNearRecord(0) {};
+    int numOfBlobs;            ///< 正在跟踪的运动目标数量
+    //! 靠近抓拍线圈或者线段的运动目标数量
+    /*!
+        线圈模式下矩形向四周扩展一半宽高后与线圈相交, 线段模式下矩形中心到线段的距离不超过矩形宽高的较大值,
+        多幅快照和只记录历史的模式在整个跟踪过程中都需要完整的帧率, 所有运动目标都计入
+     */
+    int numOfBlobsNearRecord;
+};
+
 //! 输出运动目标的单帧历史记录
 struct ObjectRecord
 {
     //! 构造函数
-    ObjectRecord(void) : time(0), number(0) {};
+    ObjectRecord(void) : time(0), number(0), isInterpolated(0) {};
 
     long long int time;        ///< 时间戳
     int number;                ///< 帧编号
     cv::Rect normRect;         ///< 归一化帧中的矩形
     cv::Rect origRect;         ///< 原始尺寸帧中的矩形
     cv::Mat image;             ///< 目标截图, 从原始帧中的 origRect 中截取
+    int isInterpolated;        ///< 是否是在跳过的帧上插值得到的记录, 插值得到的记录没有目标截图
 };
 
 //! 输出运动目标的快照记录
@@ -66,6 +113,24 @@ struct ObjectSnapshotRecord
     int direction;             ///< 快照时的行驶方向 1 从左到右 2 从右到左 3 从上到下 4 从下到上 -1 未知
 };
 
+//! 输出运动目标历史轨迹的统计量
+/*!
+    统计量在跟踪过程中逐帧累积, 包括因历史长度限制被降采样丢弃的记录
+ */
+struct ObjectHistoryStatistics
+{
+    //! 构造函数
+    ObjectHistoryStatistics(void)
+        : numOfRecords(0), meanNormWidth(0), meanNormHeight(0), stdDevNormX(0), stdDevNormY(0)
+    {};
+
+    int numOfRecords;          ///< 参与统计的历史记录条数
+    double meanNormWidth;      ///< 归一化帧中矩形宽度的均值
+    double meanNormHeight;     ///< 归一化帧中矩形高度的均值
+    double stdDevNormX;        ///< 归一化帧中矩形左上角 x 坐标的标准差
+    double stdDevNormY;        ///< 归一化帧中矩形左上角 y 坐标的标准差
+};
+
 //! 输出的运动目标结构体
 struct ObjectInfo
 {
@@ -84,6 +149,7 @@ struct ObjectInfo
     // 历史信息
     int hasHistory;            ///< 是否有历史轨迹信息
     std::vector<ObjectRecord> history;     ///< 历史轨迹
+    ObjectHistoryStatistics historyStatistics; ///< 历史轨迹的统计量
 
     // 快照信息
     int hasSnapshotHistory;      ///< 是否有快照图片
@@ -93,6 +159,18 @@ struct ObjectInfo
     double velocity;           ///< 速度，高清版中单位为千米/时
 };
 
+//! 简化运动目标的历史轨迹
+/*!
+    对归一化矩形的中心和宽高组成的轨迹做 Douglas-Peucker 简化,
+    按帧编号对保留的记录线性插值, 可以在 tolerance 误差内重建被删除的记录.
+    第一条记录, 最后一条记录和快照图片所在帧的记录总是保留.
+    \param[in] object 运动目标, 使用其中的 history 和 snapshotHistory
+    \param[in] tolerance 中心坐标和宽高允许的最大误差, 以归一化帧中的像素计算, 小于等于 0 时不简化
+    \param[out] simplifiedHistory 简化后的历史轨迹
+ */
+Z_LIB_EXPORT void simplifyHistory(const ObjectInfo& object, double tolerance, 
+    std::vector<ObjectRecord>& simplifiedHistory);
+
 //! 输出的静态目标结构体
 struct StaticObjectInfo
 {
@@ -205,6 +283,51 @@ public:
      */
     void setConfigParams(const bool* checkTurnAround = 0, const double* maxDistRectAndBlob = 0,
         const double* minRatioIntersectToSelf = 0, const double* minRatioIntersectToBlob = 0);
+    //! 修改运动目标历史记录的容量和内存上限
+    /*!
+        所有函数的传入参数均为指针形式, 只要指针不为空指针, 就会将类的配置参数按给定的值重置
+        历史记录的容量在运动目标第一次记录时确定, 修改 maxHistorySize 和 numOfRecentRecords 只对之后新建的跟踪目标有效.
+        默认不限制条数和内存, 需要限制时由调用者设置
+        \param[in] maxHistorySize 每个运动目标最多保存的历史记录条数, 等于 0 表示不限制
+        \param[in] numOfRecentRecords 按处理帧率完整保存的最近的历史记录条数, 更早的记录降采样保存, 保留轨迹的起点
+        \param[in] maxImageBytes 所有运动目标的历史截图占用的字节数上限, 等于 0 表示不限制
+        \param[in] evictPolicy 历史截图占用内存超过上限时的处理策略, 取值见 HistoryEvictPolicy
+     */
+    void setHistoryMemoryParams(const int* maxHistorySize = 0, const int* numOfRecentRecords = 0,
+        const long long int* maxImageBytes = 0, const int* evictPolicy = 0);
+    //! 修改运动预测和匹配门限缩放参数
+    /*!
+        所有函数的传入参数均为指针形式, 只要指针不为空指针, 就会将类的配置参数按给定的值重置
+        运动预测按匀速运动模型, 根据时间戳推算运动目标在当前帧中的矩形, 匹配时和预测的矩形计算距离和相交比例
+        如果当前帧和运动目标上一次记录的时间间隔大于 refProcInterval, maxDistRectAndBlob 按时间间隔的比例放大
+        \param[in] runPredictMotion 是否进行运动预测, 默认不进行, 和上一次记录的矩形匹配
+        \param[in] refProcInterval 匹配门限对应的参考处理间隔, 单位为毫秒, 默认为 0, 小于等于 0 表示不缩放匹配门限
+        \param[in] maxGateScale 匹配门限的最大放大倍数
+     */
+    void setMotionPredictParams(const bool* runPredictMotion = 0, const int* refProcInterval = 0, 
+        const double* maxGateScale = 0);
+    //! 修改跟踪结束时输出历史轨迹的参数
+    /*!
+        所有函数的传入参数均为指针形式, 只要指针不为空指针, 就会将类的配置参数按给定的值重置
+        隔帧处理时, 历史轨迹只包含实际处理的帧, 选择插值后, 输出时在相邻两条记录之间按帧编号线性插值, 
+        补齐跳过的帧的矩形和时间戳
+        \param[in] interpolateHistory 是否对跳过的帧插值
+        \param[in] maxInterpolateFrameGap 相邻两条记录的帧编号之差不超过这个值才进行插值, 小于等于 0 表示不限制
+     */
+    void setOutputParams(const bool* interpolateHistory = 0, const int* maxInterpolateFrameGap = 0);
+    //! 获取运动目标历史记录的内存占用统计
+    void getHistoryMemoryInfo(HistoryMemoryInfo& info) const;
+    //! 获取最近一次处理后的跟踪状态的活跃程度
+    void getActivityInfo(TrackingActivityInfo& info) const;
+    //! 设置单帧处理的时间预算
+    /*!
+        设置后, 更新快照图片和历史截图前查询 deadline, 超出预算时这一帧只记录矩形, 
+        正在跨越线圈等跳过这一帧就会丢失抓拍的目标仍然更新, 
+        deadline 由调用者在每帧开始时计时, 为空时总是更新
+     */
+    void setFrameDeadline(const cv::Ptr<FrameDeadline>& deadline);
+    //! 设置分步骤耗时统计器, 矩形匹配和快照更新分别计时, 为空时不计时
+    void setStageProfiler(const cv::Ptr<StageProfiler>& profiler);
     //! 处理函数
     /*!
         如果 BlobTracker 的实例按照含有保存历史图片的方式进行初始化, 并且调用这个版本的处理函数, 将不会得到图片
@@ -7,36 +7,100 @@
 
 namespace zsfo
 {
-// 以下是全景图和前景图的代理类
-// 采用 lazy evaluation 策略, 当 BlobVisualRecord 的实例的 makeRecord 成员函数真正需要到这些图片时, 才制作出深拷贝
-// BlobVisualRecord::makeRecord 函数调用 cv::Mat 的 = 运算符, 保存图片的浅拷贝
-// 如果处理某一帧时恰好有多个 BlobVisualRecord 实例都要保存全景图和前景图, 
-// 那么这些实例可以共享一份全景图和前景图的深拷贝
+//! 快照帧, 保存抓拍时的原始尺寸全景图和归一化尺寸前景图
+struct SnapshotFrame
+{
+    //! 构造函数
+    SnapshotFrame(void) : time(0), count(0), numOfRefs(0) {};
 
-//! 全景图延迟处理类
-class OrigSceneProxy
+    cv::Mat scene;             ///< 原始尺寸的全景图
+    cv::Mat normFore;          ///< 归一化尺寸的前景图
+    long long int time;        ///< 时间戳
+    int count;                 ///< 帧编号
+    int numOfRefs;             ///< 引用本快照帧的句柄的数量, 等于 0 时可以被环形缓冲区复用
+};
+
+//! 快照帧句柄, 复制句柄只增加快照帧的引用计数
+class SnapshotFrameHandle
 {
 public:
-    OrigSceneProxy(const cv::Mat& frame) : done(false), shallowCopy(frame) {};
-    const cv::Mat& getDeepCopy(void);
-    const cv::Mat& getShallowCopy(void) const {return shallowCopy;};
-private:    
-    const cv::Mat& shallowCopy;
-    cv::Mat deepCopy;
-    bool done;
+    //! 构造空句柄
+    SnapshotFrameHandle(void) {};
+    //! 引用快照帧
+    explicit SnapshotFrameHandle(const cv::Ptr<SnapshotFrame>& snapshotFrame);
+    //! 拷贝构造函数, 增加引用计数
+    SnapshotFrameHandle(const SnapshotFrameHandle& handle);
+    //! 析构函数, 减少引用计数
+    ~SnapshotFrameHandle(void);
+    //! 赋值
+    SnapshotFrameHandle& operator=(const SnapshotFrameHandle& handle);
+    //! 释放引用
+    void release(void);
+    //! 是否为空句柄
+    bool empty(void) const {return frame.empty();};
+    //! 访问快照帧
+    const SnapshotFrame* operator->(void) const {return frame;};
+private:
+    cv::Ptr<SnapshotFrame> frame;
 };
 
-//! 前景图延迟处理类
+//! 最近若干快照帧的环形缓冲区
+/*!
+    一帧中无论有多少个运动目标抓拍, 都只将这一帧复制一次到环形缓冲区中
+    快照记录只保存快照帧句柄和矩形, 截图, 前景图和全景图在输出时才生成
+    没有被任何快照记录引用的快照帧会被复用, 避免每次抓拍都重新分配整帧的内存,
+    仍被引用的快照帧由句柄保持, 环形缓冲区在该位置换上新分配的快照帧
+ */
+class SnapshotFrameRing
+{
+public:
+    //! 构造函数
+    /*!
+        \param[in] size 环形缓冲区的长度
+     */
+    SnapshotFrameRing(int size = 8);
+    //! 将当前帧复制到环形缓冲区中, 返回快照帧句柄
+    /*!
+        \param[in] scene 原始尺寸的全景图
+        \param[in] normFore 归一化尺寸的前景图
+        \param[in] time 时间戳
+        \param[in] count 帧编号
+     */
+    SnapshotFrameHandle acquire(const cv::Mat& scene, const cv::Mat& normFore, long long int time, int count);
+private:
+    std::vector<cv::Ptr<SnapshotFrame> > frames;  ///< 快照帧
+    int next;                                      ///< 下一次优先使用的位置
+};
+
+// 以下是全景图和前景图的代理类
+// 采用 lazy evaluation 策略, 当 BlobSnapshotRecord 的实例的 makeRecord 成员函数真正需要到这些图片时,
+// 才将当前帧复制到快照帧环形缓冲区中, 同一帧中所有需要抓拍的实例共享一个快照帧句柄
+
+//! 前景图代理类
 class OrigForeProxy
 {
 public:
-    OrigForeProxy(const cv::Mat& normForeImage, const cv::Size& origImageSize)
-        : done(false), normFore(normForeImage), origSize(origImageSize) {}
-    const cv::Mat& getDeepCopy(const cv::Rect& normRect, const cv::Rect& origRect);
+    OrigForeProxy(const cv::Mat& normForeImage) : normFore(normForeImage) {};
+    const cv::Mat& getNormFore(void) const {return normFore;};
 private:
     const cv::Mat& normFore;
-    cv::Size origSize;
-    cv::Mat origFore;
+};
+
+//! 全景图延迟处理类
+class OrigSceneProxy
+{
+public:
+    OrigSceneProxy(const cv::Mat& frame, SnapshotFrameRing* frameRing = 0, long long int time = 0, int count = 0)
+        : shallowCopy(frame), ring(frameRing), currTime(time), currCount(count), done(false) {};
+    //! 获取当前帧的快照帧句柄, 第一次调用时才复制当前帧
+    const SnapshotFrameHandle& getFrameHandle(const OrigForeProxy& fore);
+    const cv::Mat& getShallowCopy(void) const {return shallowCopy;};
+private:    
+    const cv::Mat& shallowCopy;
+    SnapshotFrameRing* ring;
+    long long int currTime;
+    int currCount;
+    SnapshotFrameHandle handle;
     bool done;
 };
 
@@ -45,7 +109,7 @@ private:
 struct BlobQuanRecord
 {
     //! 构造函数
-    BlobQuanRecord(void) : time(0), count(0) {};
+    BlobQuanRecord(void) : time(0), count(0), index(0) {};
     //! 根据输入信息生成记录
     /*!
         \param[in] rect 归一化尺寸的矩形
@@ -77,6 +141,143 @@ struct BlobQuanRecord
     cv::Mat image;             ///< 目标截图
     long long int time;        ///< 时间戳      
     int count;                 ///< 帧编号
+    int index;                 ///< 在运动目标历史中的序号, 从 0 开始, 包括被丢弃的记录
+};
+
+//! 运动目标历史轨迹的增量统计量, 每添加一条记录以 O(1) 的代价更新
+struct BlobQuanStatistics
+{
+    //! 构造函数
+    BlobQuanStatistics(void);
+    //! 添加一条记录
+    void update(const BlobQuanRecord& record);
+    //! 对矩形中心拟合直线
+    /*!
+        \param[out] pointInLine 拟合直线上的一点
+        \param[out] dirVector 拟合直线的单位方向向量
+        \param[out] avgError 矩形中心到拟合直线的距离的均方根
+     */
+    void linearRegres(cv::Point& pointInLine, cv::Point2d& dirVector, double& avgError) const;
+    //! 输出统计量
+    void output(ObjectHistoryStatistics& statistics) const;
+
+    int count;                 ///< 记录条数
+    // 矩形中心坐标的累加和, 用于最小二乘拟合直线
+    double sumX, sumY, sumXY, sumX2, sumY2;
+    // 矩形左上角坐标和矩形尺寸的均值, 以及左上角坐标的二阶中心矩的累加值, 按 Welford 算法更新
+    double meanX, meanY, meanWidth, meanHeight, m2X, m2Y;
+};
+
+//! 运动方向序列的增量统计
+/*!
+    保存原始的运动方向序列和窗口长度为 5 的中值滤波后的序列, 
+    添加新值时只有滤波后序列的最后三个值会改变, 
+    同时维护滤波后序列中正值, 负值和零值个数的前缀和, 任意区间内的计数都可以在 O(1) 时间内得到
+    capacity 大于 0 时原始序列和前缀和都保存在固定长度的环形缓冲区中, 
+    序列只保留最近添加的 capacity 个值, 下标 0 对应保留的最早的值
+ */
+class DirectionStatistics
+{
+public:
+    //! 构造函数
+    DirectionStatistics(void);
+    //! 设置容量, 只有在序列为空时才有效, maxSize 等于 0 表示不限制长度, 大于 0 时至少为 5
+    void setCapacity(int maxSize);
+    //! 添加运动方向, 1 正方向 -1 负方向 0 静止
+    void push_back(char dir);
+    //! 序列长度
+    int size(void) const {return numOfPushed - begIndex;};
+    //! 原始序列中正值的个数
+    int getNumOfPositive(void) const {return numOfPositive;};
+    //! 原始序列中负值的个数
+    int getNumOfNegative(void) const {return numOfNegative;};
+    //! 原始序列中零值的个数
+    int getNumOfZero(void) const {return size() - numOfPositive - numOfNegative;};
+    //! 滤波后序列在下标区间 [beg, end) 中正值的个数
+    int countMedianPositive(int beg, int end) const 
+    {return prefixPositive[prefixSlot(begIndex + end)] - prefixPositive[prefixSlot(begIndex + beg)];};
+    //! 滤波后序列在下标区间 [beg, end) 中负值的个数
+    int countMedianNegative(int beg, int end) const 
+    {return prefixNegative[prefixSlot(begIndex + end)] - prefixNegative[prefixSlot(begIndex + beg)];};
+    //! 滤波后序列在下标区间 [beg, end) 中零值的个数
+    int countMedianZero(int beg, int end) const 
+    {return end - beg - countMedianPositive(beg, end) - countMedianNegative(beg, end);};
+
+private:
+    //! 按 ztool::localMedian 的规则计算滤波后序列第 index 个值, index 为添加的总序号
+    char calcMedian(int index) const;
+    //! 总序号为 index 的原始值在 raw 中的下标
+    int rawSlot(int index) const {return capacity > 0 ? index % capacity : index;};
+    //! 总序号为 index 的前缀和在 prefixPositive 和 prefixNegative 中的下标
+    int prefixSlot(int index) const {return capacity > 0 ? index % (capacity + 1) : index;};
+
+    std::vector<char> raw;             ///< 原始序列
+    std::vector<int> prefixPositive;   ///< 滤波后序列正值个数的前缀和, 长度比原始序列多 1
+    std::vector<int> prefixNegative;   ///< 滤波后序列负值个数的前缀和, 长度比原始序列多 1
+    int capacity;                      ///< 保留的序列长度, 等于 0 表示不限制
+    int numOfPushed;                   ///< 总共添加过的值的个数
+    int begIndex;                      ///< 保留的最早的值的总序号
+    int numOfPositive;                 ///< 保留的原始序列中正值的个数
+    int numOfNegative;                 ///< 保留的原始序列中负值的个数
+};
+
+//! 运动目标历史记录的容量和内存上限配置, 同一个 BlobTracker 管理的所有运动目标共享一份
+struct HistoryCapacity
+{
+    int maxHistorySize;          ///< 每个运动目标最多保存的历史记录条数, 等于 0 表示不限制
+    int numOfRecentRecords;      ///< 按处理帧率完整保存的最近的历史记录条数
+    long long int maxImageBytes; ///< 所有运动目标的历史截图占用的字节数上限, 等于 0 表示不限制
+    int evictPolicy;             ///< 历史截图占用内存超过上限时的处理策略, 取值见 HistoryEvictPolicy
+};
+
+//! 有界的运动目标历史记录存储
+/*!
+    最近的 recentCapacity 条记录保存在环形缓冲区 recent 中,
+    被挤出环形缓冲区的较早记录每 decimStep 条保留一条, 放到 older 中,
+    older 的长度超过 olderCapacity 时隔一条删除一条, 并将 decimStep 加倍,
+    所以总长度不超过 recentCapacity + olderCapacity, 并且始终保留轨迹的起点
+    recentCapacity 等于 0 时不限制长度, 所有记录按顺序放在 older 中
+    下标 0 对应最早的记录, 下标 size() - 1 对应最新的记录
+    所有增删操作同时更新共享的内存占用统计
+ */
+class BlobQuanRecordBuffer
+{
+public:
+    //! 构造函数
+    BlobQuanRecordBuffer(void);
+    //! 设置容量, 只有在存储为空时才有效
+    void setCapacity(int maxSize, int numOfRecent);
+    //! 当前保存的记录条数
+    int size(void) const;
+    //! 是否为空
+    bool empty(void) const;
+    //! 按时间顺序访问记录
+    const BlobQuanRecord& operator[](int index) const;
+    //! 最新的记录
+    const BlobQuanRecord& back(void) const;
+    //! 添加记录, 超出容量的记录被降采样丢弃
+    void push_back(const BlobQuanRecord& record, HistoryMemoryInfo& memory);
+    //! 从最早的记录开始释放截图, 直到释放的字节数不少于 bytesToRelease, 返回实际释放的字节数
+    long long int releaseImages(long long int bytesToRelease, HistoryMemoryInfo& memory);
+    //! 清空所有记录
+    void clear(HistoryMemoryInfo& memory);
+    //! 当前保存的截图占用的字节数
+    long long int getImageBytes(void) const {return imageBytes;};
+
+private:
+    BlobQuanRecord& at(int index);
+    void drop(BlobQuanRecord& record, HistoryMemoryInfo& memory);
+    void compactOlder(HistoryMemoryInfo& memory);
+
+    std::vector<BlobQuanRecord> older;   ///< 较早的降采样记录, 容量不受限时保存所有记录
+    std::vector<BlobQuanRecord> recent;  ///< 最近记录的环形缓冲区
+    int head;                            ///< recent 中最早记录的下标
+    int numOfRecent;                     ///< recent 中的记录条数
+    int recentCapacity;                  ///< recent 的容量
+    int olderCapacity;                   ///< older 的容量
+    int decimStep;                       ///< 被挤出环形缓冲区的记录每隔多少条保留一条
+    int numOfMoved;                      ///< 被挤出环形缓冲区的记录总数
+    long long int imageBytes;            ///< 当前保存的截图占用的字节数
 };
 
 //! 记录运动目标历史的结构体
@@ -98,17 +299,30 @@ struct BlobQuanHistory
         \param[in] blobID 运动目标的编号
      */
     BlobQuanHistory(const BlobQuanHistory& history, int blobID);
-    //! 根据现有实例拷贝构造创建新实例, 返回新实例的指针, 使用新的 ID 共享变量只增加引用计数 
+    //! 析构函数, 从共享的内存占用统计中减去本实例的记录
+    ~BlobQuanHistory(void);
+    //! 根据现有实例拷贝构造创建新实例, 返回新实例的指针, 使用新的 ID 共享变量只增加引用计数
     BlobQuanHistory* createNew(int blobID) const;
-    //! 返回历史记录的长度
+    //! 设置共享的容量配置和内存占用统计
+    void setMemory(const cv::Ptr<HistoryCapacity>& historyCapacity, const cv::Ptr<HistoryMemoryInfo>& historyMemory);
+    //! 返回当前保存的历史记录的长度
     int size(void) const;
+    //! 返回总共添加过的历史记录的长度, 包括因容量限制被丢弃的记录
+    int totalSize(void) const;
+    //! 从最早的记录开始释放截图, 返回实际释放的字节数
+    long long int releaseImages(long long int bytesToRelease);
     //! 根据当前帧得到的 rect 和 gradDiffMean 把记录 push 到向量中
     void pushRecord(const cv::Rect& rect, double gradDiffMean);
     void pushRecord(const OrigSceneProxy& scene, const cv::Rect& rect, double gradDiffMean);
     //! 打印历史
     void displayHistory(void) const;
     //! 输出历史
-    void outputHistory(ObjectInfo& objectInfo) const;
+    /*!
+        \param[out] objectInfo 历史写入的结构体
+        \param[in] interpolate 是否在相邻两条记录之间对跳过的帧线性插值
+        \param[in] maxFrameGap 相邻两条记录的帧编号之差不超过这个值才进行插值, 小于等于 0 表示不限制
+     */
+    void outputHistory(ObjectInfo& objectInfo, bool interpolate = false, int maxFrameGap = 0) const;
     //! 画当前的矩形
     void drawRect(cv::Mat& normalImage, const cv::Scalar& color) const;
     //! 画矩形中心点的历史轨迹
@@ -119,30 +333,44 @@ struct BlobQuanHistory
     void drawBottomHistory(cv::Mat& normalImage, const cv::Scalar& color) const;
     //! 获取矩形中心点的历史轨迹
     void getCenterHistory(std::vector<cv::Point>& centerHistory) const;
+    //! 输出历史轨迹的统计量
+    void outputStatistics(ObjectInfo& objectInfo) const;
     //! 检测矩形区域和相应的纹理是否稳定
     bool checkStability(int timeInMilliSec) const;
     //! 对矩形中心拟合轨迹
     /*!
         \param[out] pointInLine 拟合直线上的一点
         \param[out] dirVector 拟合直线的单位方向向量
-        \param[out] avgError 用于拟合直线的点到拟合直线的距离的平均值
+        \param[out] avgError 全部历史记录的矩形中心到拟合直线的距离的均方根
      */
     void linearRegres(cv::Point& pointInLine, cv::Point2d& dirVector, double& avgError) const;
     //! 检测是否有掉头
     bool checkTurnAround(void) const;
     //! 检测 Y 轴方向上的运动方向是否和合法方向一致
     bool checkYDirection(int legalDirection) const;
+    //! 按匀速运动模型预测运动目标在 time 时刻的矩形, 还没有估计出速度时返回当前矩形
+    cv::Rect predictRect(long long int time) const;
     
-    std::vector<BlobQuanRecord> history;       ///< 矩形各类信息的历史记录
+    BlobQuanRecordBuffer history;              ///< 矩形各类信息的历史记录
     //BlobQuanRecord initRecord;                 ///< 初始帧矩形记录
     BlobQuanRecord currRecord;                 ///< 当前帧矩形记录
+    int numOfPushed;                           ///< 总共添加过的记录条数
+    cv::Point dirRefCenter;                    ///< 上一次检测运动方向时的矩形中心
+    BlobQuanStatistics statistics;             ///< 历史轨迹的增量统计量
+    cv::Point2d velocity;                      ///< 矩形中心的运动速度, 单位为像素/毫秒
+    int numOfVelocityUpdates;                  ///< 速度估计的更新次数
+
+    // 检测稳定性用的变量, 下标为记录的序号对 stepCheckStability 取模
+    std::vector<cv::Rect> stableRects;         ///< 最近 stepCheckStability 条记录的矩形
+    std::vector<double> stableGradDiffMeans;   ///< 最近 stepCheckStability 条记录的梯度差均值
+    std::vector<int> lastUnstableIndex;        ///< 和前第 stepCheckStability 条记录相比不稳定的最新的记录序号
 
     // X 轴和 Y 轴运动方向的向量
     // if currCenter.x > lastCenter.x + maxDiffVal, sign = 1
     // else if currCenter.x < lastCenter.x - maxDiffVal, sign = -1
     // else sign = 0
-    std::vector<char> dirCenterX;  ///< 矩形中心点 x 坐标的运动方向
-    std::vector<char> dirCenterY;  ///< 矩形中心点 y 坐标的运动方向
+    DirectionStatistics dirCenterX;  ///< 矩形中心点 x 坐标的运动方向
+    DirectionStatistics dirCenterY;  ///< 矩形中心点 y 坐标的运动方向
     // 以下两者为共享变量
     int checkDirStep;       ///< 间隔多少帧检测一次矩形中心点的运动方向
     int maxDiffVal;         ///< 判定运动方向的阈值
@@ -153,13 +381,29 @@ struct BlobQuanHistory
     cv::Ptr<long long int> currTime;    ///< 时间戳
     cv::Ptr<int> currCount;             ///< 帧编号
     bool recordImage;                   ///< 是否记录截图
+    cv::Ptr<HistoryCapacity> capacity;  ///< 历史记录的容量和内存上限
+    cv::Ptr<HistoryMemoryInfo> memory;  ///< 历史记录的内存占用统计
+
+private:
+    //! 未实现的拷贝构造函数
+    BlobQuanHistory(const BlobQuanHistory& history);
+    //! 未实现的赋值符号
+    BlobQuanHistory& operator=(const BlobQuanHistory& history);
+    //! 添加记录后更新运动方向
+    void updateDirection(void);
+    //! 添加记录后更新统计量
+    void updateStatistics(void);
+    //! 根据上一条记录 lastRecord 和当前记录 currRecord 更新速度估计
+    void updateVelocity(const BlobQuanRecord& lastRecord);
+    //! 根据内存上限决定是否为新记录保存截图
+    bool allowImage(long long int bytes);
 };
 
 //! 保存抓拍图片和相关信息的结构体
 struct BlobSnapshotRecord
 {
     //! 构造函数
-    BlobSnapshotRecord(void) : bound(-1), crossIn(-1), direction(-1), time(0), count(0) {};
+    BlobSnapshotRecord(void) : bound(-1), crossIn(-1), direction(-1), time(0), count(0), saveMode(0) {};
     //! 根据输入信息创建记录结构体
     /*!
         \param[in] scene 全景图代理
@@ -190,10 +434,12 @@ struct BlobSnapshotRecord
     void makeRecord(OrigSceneProxy& scene, OrigForeProxy& fore, 
         const SizeInfo& sizeInfo, const cv::Rect& baseRect, const cv::Rect& blobRect, 
         int loopBound, int crossMode, long long int currTime, int currCount, int saveMode);
-    //! 深拷贝复制 record 得到新的实例
+    //! 复制记录, 和 record 共享快照帧
     void copyTo(BlobSnapshotRecord& record) const;
-    //! 将时间和在原始尺寸上的图输出到对应的结构体中
+    //! 将时间和在原始尺寸上的图输出到对应的结构体中, 截图, 前景图和全景图在这里才生成
     void outputImages(ObjectSnapshotRecord& snapshotRecord) const;
+    //! 获取原始尺寸的运动目标截图, 浅拷贝, 用于显示
+    cv::Mat getSlice(void) const;
 
     int bound;                   ///< 跨越的是线圈的哪个边界 1 跨越线圈左边界 2 跨越线圈右边界 3 跨越线圈下边界 -1 跨越检测线
     int crossIn;                 ///< 抓拍时是否为进入线圈 1 是 0 不是 -1 未知
@@ -202,9 +448,8 @@ struct BlobSnapshotRecord
     cv::Rect origRect;           ///< 原始帧上的矩形
     long long int time;          ///< 时间戳
     int count;                   ///< 帧编号
-    cv::Mat blobImage;           ///< 原始尺寸的运动目标图片, 大小等于 origRect 的大小, 浅拷贝
-    cv::Mat foreImage;           ///< 原始尺寸的前景图, 浅拷贝
-    cv::Mat fullFrame;           ///< 原始尺寸的全景图, 浅拷贝
+    int saveMode;                ///< 存图模式
+    SnapshotFrameHandle frame;   ///< 抓拍时的快照帧
 };
 
 //! 抓拍图片基类
@@ -223,6 +468,9 @@ struct BlobSnapshotHistory
     virtual void updateHistory(OrigSceneProxy& scene, OrigForeProxy& fore, const cv::Rect& currRect) = 0;
     //! 输出图片历史到 objectInfo 中
     virtual bool outputHistory(ObjectInfo& objectInfo) const = 0;
+    //! 跳过这一帧的 updateHistory 是否会丢失抓拍, 例如目标正在跨越线圈或者还没有任何记录,
+    //! 单帧处理超出预算时这样的目标仍然更新, 默认总是返回 true
+    virtual bool mustUpdate(const cv::Rect& currRect) const {return true;};
 };
 
 //! 记录跨越三条线的抓拍图片的结构体
@@ -252,6 +500,8 @@ struct BlobTriBoundSnapshotHistory : public BlobSnapshotHistory
     virtual void updateHistory(OrigSceneProxy& scene, OrigForeProxy& fore, const cv::Rect& currRect);
     //! 输出图片记录
     virtual bool outputHistory(ObjectInfo& objectInfo) const;
+    //! 尚未记录或者矩形边正在跨越尚未抓拍的线圈边界时返回 true
+    virtual bool mustUpdate(const cv::Rect& currRect) const;
 
     int ID;                                ///< 运动目标编号
     bool hasLeftCrossLoopLeft;             ///< 矩形左边是否已经跨越线圈左边
@@ -306,6 +556,8 @@ struct BlobBottomBoundSnapshotHistory : public BlobSnapshotHistory
     virtual void updateHistory(OrigSceneProxy& scene, OrigForeProxy& fore, const cv::Rect& currRect);
     // 输出图片记录
     virtual bool outputHistory(ObjectInfo& objectInfo) const;
+    // 尚未记录或者矩形底边正在跨越线圈底边时返回 true
+    virtual bool mustUpdate(const cv::Rect& currRect) const;
 
     int ID;                                ///< 运动目标编号
     bool hasBottomCrossLoopBottom;         ///< 矩形底边是否已经跨越线圈底边
@@ -356,6 +608,8 @@ struct BlobCrossLineSnapshotHistory : public BlobSnapshotHistory
     virtual void updateHistory(OrigSceneProxy& scene, OrigForeProxy& fore, const cv::Rect& currRect);
     //! 输出图片记录
     virtual bool outputHistory(ObjectInfo& objectInfo) const;
+    //! 矩形中心第一次靠近线段时返回 true, 之后用更近的截图替换的更新可以跳过
+    virtual bool mustUpdate(const cv::Rect& currRect) const;
 
     int ID;                                ///< 运动目标编号
     bool hasCrossLine;                     ///< 矩形底边是否已经跨越线段
@@ -409,6 +663,8 @@ struct BlobMultiRecordSnapshotHistory : public BlobSnapshotHistory
     virtual void updateHistory(OrigSceneProxy& scene, OrigForeProxy& fore, const cv::Rect& currRect);
     //! 输出图片记录
     virtual bool outputHistory(ObjectInfo& objectInfo) const;
+    //! 还没有任何记录时返回 true
+    virtual bool mustUpdate(const cv::Rect& currRect) const;
 
     int ID;                                ///< 运动目标编号
     std::vector<BlobSnapshotRecord> history; ///< 保存的记录
@@ -519,6 +775,8 @@ public:
      */
     void updateState(OrigSceneProxy& scene, OrigForeProxy& fore, 
         const cv::Mat& gradDiffImage, const cv::Mat& lastGradDiffImage);    
+    //! 跳过这一帧的快照更新是否会丢失抓拍, 例如目标正在跨越线圈
+    bool mustUpdateSnapshot(void) const;
     //! 输出运动目标的图片和属性
     /*!
         \param[out] output 运动目标信息写入的结构体
@@ -529,6 +787,8 @@ public:
     void drawBlob(cv::Mat& normalImage, const cv::Scalar& color) const;
     //! 画历史
     void drawHistory(cv::Mat& normalImage, const cv::Scalar& color) const;
+    //! 修改输出历史轨迹的参数, 由本实例创建的实例共享这些参数, 参数含义见 BlobTracker::setOutputParams
+    void setOutputParams(const bool* interpolateHistory = 0, const int* maxInterpolateFrameGap = 0);
     //! 获取 Blob 的 ID
     int getID(void) const;
     //! 获取 Blob 的当前矩形位置
@@ -539,6 +799,17 @@ public:
     int getHistoryLength(void) const;
     //! 获取 Blob 矩形历史记录的中心点的历史记录
     void getCenterHistory(std::vector<cv::Point>& centerHistory) const;
+    //! 对 Blob 矩形历史记录的中心点拟合直线
+    /*!
+        \param[out] pointInLine 拟合直线上的一点
+        \param[out] dirVector 拟合直线的单位方向向量
+        \param[out] avgError 矩形中心到拟合直线的距离的均方根
+     */
+    void fitCenterLine(cv::Point& pointInLine, cv::Point2d& dirVector, double& avgError) const;
+    //! 获取按匀速运动模型预测的 Blob 在当前帧中的矩形位置
+    cv::Rect getPredictedRect(void) const;
+    //! 获取当前帧和 Blob 最近一次记录之间的时间间隔, 单位为毫秒
+    long long int getElapsedTime(void) const;
     //! 设置 Blob 当前矩形位置
     void setCurrRect(const cv::Rect& rect);
     //! 设置 Blob 将要被删除
@@ -547,6 +818,12 @@ public:
     bool doesTurnAround(void) const;
     //! 打印 Blob 的历史
     void printHistory(void) const;
+    //! 设置历史记录共享的容量配置和内存占用统计, 之后由本实例创建的实例也共享这些变量
+    void setHistoryMemory(const cv::Ptr<HistoryCapacity>& capacity, const cv::Ptr<HistoryMemoryInfo>& memory);
+    //! 获取 Blob 历史截图占用的字节数
+    long long int getHistoryImageBytes(void) const;
+    //! 从最早的记录开始释放 Blob 的历史截图, 返回实际释放的字节数
+    long long int releaseHistoryImages(long long int bytesToRelease);
 
 private:
     //! 未实现的拷贝构造函数
@@ -568,6 +845,8 @@ private:
         int minHistorySizeForOutput;            ///< 历史轨迹长度超过这个值, 才会在跟踪结束时输出历史和图片
         bool runOutputHistory;                  ///< 是否输出历史轨迹
         bool runOutputVisualAndState;           ///< 是否输出图片
+        bool runInterpolateHistory;             ///< 输出历史轨迹时是否对跳过的帧插值
+        int maxInterpolateFrameGap;             ///< 相邻两条记录的帧编号之差不超过这个值才进行插值, 小于等于 0 表示不限制
     };
     cv::Ptr<ConfigOutputInfo> configOutputInfo; ///< outputInfo 函数配置参数
 };
@@ -646,6 +925,22 @@ public:
      */
     void setConfigParams(const bool* checkTurnAround = 0, const double* maxDistRectAndBlob = 0,
         const double* minRatioIntersectToSelf = 0, const double* minRatioIntersectToBlob = 0);
+    //! 修改运动目标历史记录的容量和内存上限, 参数含义见 BlobTracker::setHistoryMemoryParams
+    void setHistoryMemoryParams(const int* maxHistorySize = 0, const int* numOfRecentRecords = 0,
+        const long long int* maxImageBytes = 0, const int* evictPolicy = 0);
+    //! 修改跟踪结束时输出历史轨迹的参数, 参数含义见 BlobTracker::setOutputParams
+    void setOutputParams(const bool* interpolateHistory = 0, const int* maxInterpolateFrameGap = 0);
+    //! 修改运动预测和匹配门限缩放参数, 参数含义见 BlobTracker::setMotionPredictParams
+    void setMotionPredictParams(const bool* runPredictMotion = 0, const int* refProcInterval = 0, 
+        const double* maxGateScale = 0);
+    //! 获取运动目标历史记录的内存占用统计
+    void getHistoryMemoryInfo(HistoryMemoryInfo& info) const;
+    //! 获取最近一次处理后的跟踪状态的活跃程度
+    void getActivityInfo(TrackingActivityInfo& info) const;
+    //! 设置单帧处理的时间预算
+    void setFrameDeadline(const cv::Ptr<FrameDeadline>& deadline);
+    //! 设置分步骤耗时统计器
+    void setStageProfiler(const cv::Ptr<StageProfiler>& profiler);
     //! 处理函数
     /*!
         \param[in] time 时间戳
@@ -733,6 +1028,10 @@ private:
     void match(const std::vector<cv::Rect>& rects);
     //! 输出运动目标的图片和属性
     bool outputInfo(std::vector<ObjectInfo>& objects, bool isFinal = false) const;
+    //! 历史截图占用内存超过上限时, 释放截图占用内存最多的目标的较早的截图
+    void evictHistoryImages(void);
+
+    SnapshotFrameRing frameRing;       ///< 快照帧环形缓冲区
 
     std::list<cv::Ptr<Blob> > blobList;///< 检测出的运动目标都放在这个结构体中
     cv::Ptr<Blob> blobInstance;        ///< 一个 Blob 实例，用于拷贝构造新的 Blob 实例
@@ -747,6 +1046,10 @@ private:
     cv::Ptr<int> currCount;            ///< 当前帧编号
     cv::Ptr<SizeInfo> sizeInfo;        ///< 原始尺寸和归一化尺寸
     cv::Ptr<cv::Rect> baseRect;        ///< 抓拍图片时使用的基准矩形, 图片只取落在基准矩形内的部分
+    cv::Ptr<HistoryCapacity> historyCapacity;  ///< 历史记录的容量和内存上限
+    cv::Ptr<HistoryMemoryInfo> historyMemory;  ///< 历史记录的内存占用统计
+    cv::Ptr<FrameDeadline> frameDeadline;      ///< 单帧处理的时间预算, 为空时不限制
+    cv::Ptr<StageProfiler> stageProfiler;      ///< 分步骤耗时统计, 为空时不计时
 
     //! match 函数的配置参数
     struct ConfigMatch
@@ -756,9 +1059,14 @@ private:
         double minRatioIntersectToSelf;   ///< 如果当前帧某个矩形和某个被跟踪对象在上一帧的矩形的交集的面积和当前帧这个矩形的面积的比值大于这个值, 则满足匹配条件之一
         double minRatioIntersectToBlob;   ///< 如果当前帧某个矩形和某个被跟踪对象在上一帧的矩形的交集的面积和这个被跟踪对象矩形的面积的比值大于这个值, 则满足匹配条件之一
         int maxHistorySizeForDistMatch;   ///< 如果被跟踪对象的历史长度小于这个值, 不用直线拟合的方式进行匹配
-        double maxAvgErrorForDistMatch;   ///< 矩形中心历史进行拟合后, 所有中心点到直线的距离的平均值小于这个值, 采根据拟合直线得到的结果进行匹配
+        //! 矩形中心历史进行拟合后, 所有中心点到直线的距离的均方根小于这个值, 采根据拟合直线得到的结果进行匹配,
+        //! 距离近似正态分布时均方根约为平均值的 1.25 倍, 原来按平均值设定为 15 的配置对应 19
+        double maxAvgErrorForDistMatch;
         bool runDisplayCalcResults;       ///< 显示匹配过程中计算的数据
         bool runShowFitLine;              ///< 显示拟合得到的直线
+        bool runPredictMotion;            ///< 是否按匀速运动模型预测运动目标在当前帧中的矩形, 并和预测的矩形进行匹配
+        int refProcInterval;              ///< maxDistRectAndBlob 对应的参考处理间隔, 单位为毫秒, 默认为 0, 小于等于 0 表示不缩放匹配门限
+        double maxGateScale;              ///< 处理间隔大于 refProcInterval 时, maxDistRectAndBlob 的最大放大倍数
     };
     ConfigMatch configMatch;              ///< match 函数配置参数实例
 };
@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+// 以下调试开关都为 0 时 MovingObjectDetector 和 ViBe 的各个实例不共享可变状态, 可以在多个线程中同时运行,
+// 显示图片使用的 highgui 窗口是进程全局的, 打开 CMPL_SHOW_IMAGE 后只能在一个线程中运行一个实例
+
 // 显示图片
 #define CMPL_SHOW_IMAGE                   0
 // 控制台输出程序运行过程中的打印信息
@@ -9,6 +12,4 @@
 // 阴影消除算法模式
 #define CMPL_USE_NEW_REFINE               0 
 // 静态目标跟踪
-#define CMPL_RUN_STATIC_OBJECT_TRACKER    0
-// 计时并且显示
-#define CMPL_CALC_PROC_TIME               0
\ No newline at end of file
+#define CMPL_RUN_STATIC_OBJECT_TRACKER    0
\ No newline at end of file
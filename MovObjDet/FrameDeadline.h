@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <opencv2/core/core.hpp>
+
+namespace zsfo
+{
+
+//! 单帧处理时间超出预算时可以跳过的处理步骤, 按跳过的先后顺序排列, 取值可以按位或
+struct OptionalStage
+{
+    enum
+    {
+        GradientRefine = 1,    ///< 根据梯度差值图消除阴影, 优化前景矩形
+        MergeBigSmall = 2,     ///< 合并有重叠的大小差异较大的前景矩形
+        CorrCheck = 4,         ///< 前景区域和背景区域的相关系数检测
+        SnapshotUpdate = 8     ///< 更新快照图片和历史截图, 跳过时仍然记录矩形, 正在跨越线圈的目标仍然更新
+    };
+};
+
+//! 单帧处理的时间预算
+/*!
+    每帧处理开始时调用 begin, 可选步骤执行前调用 allows 查询是否执行.
+    步骤属于按前几帧的处理时间强制跳过的步骤时, allows 返回 false, 步骤记入 skippedStages.
+    当前帧已经超出预算时, 只多跳过强制跳过的步骤之后的下一个步骤, 
+    跳过的步骤总是按 OptionalStage 的顺序, 与步骤在流水线中的执行顺序无关.
+    end 根据当前帧的处理时间调整强制跳过的步骤: 超出预算时按 OptionalStage 的顺序多跳过一个步骤,
+    连续 numOfFramesToRecover 帧的处理时间不到预算的一半时少跳过一个步骤.
+    预算小于等于 0 时所有步骤都执行.
+ */
+struct FrameDeadline
+{
+    //! 构造函数
+    FrameDeadline(void)
+        : budgetTicks(0), begTick(0), level(0), numOfFramesUnderHalf(0), forcedSkipStages(0), skippedStages(0)
+    {};
+    //! 设置预算, 以毫秒计算
+    void setBudget(double budgetInMilliSecond)
+    {
+        budgetTicks = budgetInMilliSecond > 0 ? (long long int)(budgetInMilliSecond * 0.001 * cv::getTickFrequency()) : 0;
+        level = 0;
+        numOfFramesUnderHalf = 0;
+        forcedSkipStages = 0;
+    };
+    //! 开始处理一帧
+    void begin(void)
+    {
+        begTick = cv::getTickCount();
+        skippedStages = 0;
+    };
+    //! 是否执行可选步骤 stage
+    bool allows(int stage)
+    {
+        if (budgetTicks <= 0)
+            return true;
+        // 超出预算时可以跳过的步骤是前 level + 1 个步骤, 流水线中先执行的步骤不会先于顺序靠前的步骤被跳过
+        int overrunSkipStages = (2 << level) - 1;
+        if ((forcedSkipStages & stage) ||
+            ((overrunSkipStages & stage) && cv::getTickCount() - begTick > budgetTicks))
+        {
+            skippedStages |= stage;
+            return false;
+        }
+        return true;
+    };
+    //! 当前帧处理结束
+    void end(void)
+    {
+        if (budgetTicks <= 0)
+            return;
+        long long int elapsed = cv::getTickCount() - begTick;
+        if (elapsed > budgetTicks)
+        {
+            if (level < numOfOptionalStages)
+                level++;
+            numOfFramesUnderHalf = 0;
+        }
+        else if (elapsed * 2 < budgetTicks && level > 0)
+        {
+            if (++numOfFramesUnderHalf >= numOfFramesToRecover)
+            {
+                level--;
+                numOfFramesUnderHalf = 0;
+            }
+        }
+        else
+            numOfFramesUnderHalf = 0;
+        forcedSkipStages = (1 << level) - 1;
+    };
+
+    enum {numOfOptionalStages = 4, numOfFramesToRecover = 10};
+    long long int budgetTicks;   ///< 预算, 以 cv::getTickCount 的计数计算, 小于等于 0 表示不限制
+    long long int begTick;       ///< 当前帧开始处理的时刻
+    int level;                   ///< 强制跳过前 level 个可选步骤
+    int numOfFramesUnderHalf;    ///< 处理时间连续不到预算一半的帧数
+    int forcedSkipStages;        ///< 强制跳过的步骤, OptionalStage 中的值按位或
+    int skippedStages;           ///< 当前帧跳过的步骤, OptionalStage 中的值按位或
+};
+
+}
@@ -35,6 +35,14 @@ public:
         const bool* charRegionCheck, const std::vector<cv::Rect>& charRegionRects,
         const bool* checkTurnAround, const double* maxDistRectAndBlob,
         const double* minRatioIntersectToSelf, const double* minRatioIntersectToBlob);
+    void setOutputParams(const bool* interpolateHistory, const int* maxInterpolateFrameGap);
+    void setUpdateBackInterval(int updateBackInterval);
+    void getActivityInfo(TrackingActivityInfo& info) const;
+    void setFrameBudget(double budgetInMilliSecond);
+    void setForegroundBurstParams(const double* maxForegroundRatio, const int* numOfRelearnFrames);
+    void setProfiling(bool enable);
+    void getStats(ProcStats& stats) const;
+    void clearStats(void);
     void build(const StampedImage& input);
     void proc(const StampedImage& input, ObjectDetails& output);
     void final(ObjectDetails& output);
@@ -53,11 +61,12 @@ private:
     StaticBlobTracker staticBlobTracker;
     int updateFullVisualInfoInterval;
     int procCount;
+    double maxForegroundRatio;
+    int numOfRelearnFrames;
+    cv::Ptr<FrameDeadline> frameDeadline;
+    cv::Ptr<StageProfiler> stageProfiler;
     std::vector<cv::Rect> rects, rectsNoUpdate; 
     cv::Mat initImage, normImage, foreImage, backImage, gradDiffImage;
-#if CMPL_CALC_PROC_TIME
-    ztool::RepeatTimer visualTimer, extractTimer, trackTimer;
-#endif
 };
 
 }
@@ -66,6 +75,10 @@ using namespace std;
 using namespace cv;
 using namespace ztool;
 
+// 前景突增检测的默认参数, 默认不检测
+static const double defaultMaxForegroundRatio = 1.0;
+static const int defaultNumOfRelearnFrames = 10;
+
 namespace zsfo
 {
 
@@ -95,6 +108,46 @@ void MovingObjectDetector::init(const StampedImage& input, const Size& normSize,
         checkTurnAround, maxDistRectAndBlob, minRatioIntersectToSelf, minRatioIntersectToBlob);
 }
 
+void MovingObjectDetector::setOutputParams(const bool* interpolateHistory, const int* maxInterpolateFrameGap)
+{
+    ptrImpl->setOutputParams(interpolateHistory, maxInterpolateFrameGap);
+}
+
+void MovingObjectDetector::setUpdateBackInterval(int updateBackInterval)
+{
+    ptrImpl->setUpdateBackInterval(updateBackInterval);
+}
+
+void MovingObjectDetector::getActivityInfo(TrackingActivityInfo& info) const
+{
+    ptrImpl->getActivityInfo(info);
+}
+
+void MovingObjectDetector::setFrameBudget(double budgetInMilliSecond)
+{
+    ptrImpl->setFrameBudget(budgetInMilliSecond);
+}
+
+void MovingObjectDetector::setForegroundBurstParams(const double* maxForegroundRatio, const int* numOfRelearnFrames)
+{
+    ptrImpl->setForegroundBurstParams(maxForegroundRatio, numOfRelearnFrames);
+}
+
+void MovingObjectDetector::setProfiling(bool enable)
+{
+    ptrImpl->setProfiling(enable);
+}
+
+void MovingObjectDetector::getStats(ProcStats& stats) const
+{
+    ptrImpl->getStats(stats);
+}
+
+void MovingObjectDetector::clearStats(void)
+{
+    ptrImpl->clearStats();
+}
+
 void MovingObjectDetector::build(const StampedImage& input)
 {
     ptrImpl->build(input);
@@ -247,6 +300,8 @@ void MovingObjectDetector::Impl::init(const StampedImage& input, const string& p
 #endif
 
     procCount = 0;
+    maxForegroundRatio = defaultMaxForegroundRatio;
+    numOfRelearnFrames = defaultNumOfRelearnFrames;
 
 #if CMPL_SHOW_IMAGE
     Mat temp = Mat::zeros(300, 300, CV_8UC1);
@@ -437,6 +492,8 @@ void MovingObjectDetector::Impl::init(const StampedImage& input, const Size& nor
 #endif
 
     procCount = 0;
+    maxForegroundRatio = defaultMaxForegroundRatio;
+    numOfRelearnFrames = defaultNumOfRelearnFrames;
 
     setConfigParam(normScale, minObjectArea, minObjectWidth, minObjectHeight, charRegionCheck, charRegionRects,
         checkTurnAround, maxDistRectAndBlob, minRatioIntersectToSelf, minRatioIntersectToBlob);
@@ -507,6 +564,73 @@ void MovingObjectDetector::Impl::setConfigParam(bool normScale, const double* mi
     }
 }
 
+void MovingObjectDetector::Impl::setOutputParams(const bool* interpolateHistory, const int* maxInterpolateFrameGap)
+{
+    blobTracker.setOutputParams(interpolateHistory, maxInterpolateFrameGap);
+}
+
+void MovingObjectDetector::Impl::setUpdateBackInterval(int updateBackInterval)
+{
+    updateFullVisualInfoInterval = updateBackInterval < 1 ? 1 : updateBackInterval;
+}
+
+void MovingObjectDetector::Impl::getActivityInfo(TrackingActivityInfo& info) const
+{
+    blobTracker.getActivityInfo(info);
+}
+
+void MovingObjectDetector::Impl::setFrameBudget(double budgetInMilliSecond)
+{
+    // 前景提取和跟踪共享同一个计时器
+    if (frameDeadline.empty())
+    {
+        frameDeadline = new FrameDeadline;
+        blobExtractor.setFrameDeadline(frameDeadline);
+        blobTracker.setFrameDeadline(frameDeadline);
+    }
+    frameDeadline->setBudget(budgetInMilliSecond);
+}
+
+void MovingObjectDetector::Impl::setForegroundBurstParams(const double* ptrMaxForegroundRatio, const int* ptrNumOfRelearnFrames)
+{
+    if (ptrMaxForegroundRatio)
+        maxForegroundRatio = *ptrMaxForegroundRatio;
+    if (ptrNumOfRelearnFrames)
+        numOfRelearnFrames = *ptrNumOfRelearnFrames < 1 ? 1 : *ptrNumOfRelearnFrames;
+}
+
+void MovingObjectDetector::Impl::setProfiling(bool enable)
+{
+    // 视觉信息, 前景提取和跟踪共享同一个统计器
+    if (stageProfiler.empty())
+    {
+        if (!enable)
+            return;
+        stageProfiler = new StageProfiler;
+        visualInfo.setStageProfiler(stageProfiler);
+        blobExtractor.setStageProfiler(stageProfiler);
+        blobTracker.setStageProfiler(stageProfiler);
+    }
+    stageProfiler->setEnabled(enable);
+}
+
+void MovingObjectDetector::Impl::getStats(ProcStats& stats) const
+{
+    if (stageProfiler.empty())
+    {
+        stats.frame = StageStats();
+        stats.stages.assign(ProcStage::Count, StageStats());
+        return;
+    }
+    stageProfiler->getStats(stats);
+}
+
+void MovingObjectDetector::Impl::clearStats(void)
+{
+    if (!stageProfiler.empty())
+        stageProfiler->clear();
+}
+
 void MovingObjectDetector::Impl::build(const StampedImage& input)
 {
 #if CMPL_WRITE_CONSOLE
@@ -522,14 +646,8 @@ void MovingObjectDetector::Impl::build(const StampedImage& input)
     medianBlur(initImage, normImage, 3);
     GaussianBlur(normImage, normImage, Size(3, 3), 0.0);
     //GaussianBlur(initImage, normImage, Size(3, 3), 0.0);
-#if CMPL_CALC_PROC_TIME
-    visualTimer.start();    
-#endif
     // 更新视觉信息
     visualInfo.update(normImage, true);
-#if CMPL_CALC_PROC_TIME
-    visualTimer.end();
-#endif
 }
 
 void MovingObjectDetector::Impl::proc(const StampedImage& input, ObjectDetails& output)
@@ -539,36 +657,49 @@ void MovingObjectDetector::Impl::proc(const StampedImage& input, ObjectDetails&
     printf("Current time: %lld", input.time);
     printf("\n");
 #endif
+    StageTimer frameTimer(stageProfiler, ProcStage::Count);
+    if (!frameDeadline.empty())
+        frameDeadline->begin();
 
     // 获取当前原始帧
     Mat origFrame = Mat(input.image);
     // 计算归一化图片
-    resize(origFrame, initImage, Size(sizeInfo.normWidth, sizeInfo.normHeight));
-    medianBlur(initImage, normImage, 3);
-    GaussianBlur(normImage, normImage, Size(3, 3), 0.0);
-    //GaussianBlur(initImage, normImage, Size(3, 3), 0.0);
-#if CMPL_CALC_PROC_TIME
-    visualTimer.start();    
-#endif
+    {
+        StageTimer timer(stageProfiler, ProcStage::Resize);
+        resize(origFrame, initImage, Size(sizeInfo.normWidth, sizeInfo.normHeight));
+    }
+    {
+        StageTimer timer(stageProfiler, ProcStage::Denoise);
+        medianBlur(initImage, normImage, 3);
+        GaussianBlur(normImage, normImage, Size(3, 3), 0.0);
+        //GaussianBlur(initImage, normImage, Size(3, 3), 0.0);
+    }
     // 更新视觉信息
     visualInfo.update(normImage, foreImage, backImage, gradDiffImage,
         (updateFullVisualInfoInterval == 1) || (procCount++ % updateFullVisualInfoInterval == 0)/*, rectsNoUpdate*/);
-#if CMPL_CALC_PROC_TIME
-    visualTimer.end();
-#endif
 
-#if CMPL_CALC_PROC_TIME
-    extractTimer.start();    
-#endif
-    // 找前景矩形
-    blobExtractor.proc(foreImage, normImage, backImage, rects, rectsNoUpdate);
-#if CMPL_CALC_PROC_TIME
-    extractTimer.end();
-#endif
+    // 前景突增时本帧的前景不可信, 跳过前景提取, 背景模型快速重新学习,
+    // 跟踪器仍然按没有前景矩形处理, 目标照常计入丢失, 结束的目标照常输出
+    // 没有开启前景突增检测时不统计前景比例
+    output.foregroundRatio = 0;
+    output.isForegroundBurst = false;
+    if (maxForegroundRatio < 1)
+    {
+        output.foregroundRatio = double(countNonZero(foreImage)) / (foreImage.rows * foreImage.cols);
+        output.isForegroundBurst = output.foregroundRatio > maxForegroundRatio;
+    }
+    if (output.isForegroundBurst)
+    {
+        visualInfo.relearn(numOfRelearnFrames);
+        rects.clear();
+        rectsNoUpdate.clear();
+    }
+    else
+    {
+        // 找前景矩形
+        blobExtractor.proc(foreImage, normImage, backImage, rects, rectsNoUpdate);
+    }
 
-#if CMPL_CALC_PROC_TIME
-    trackTimer.start();    
-#endif
     // 常规目标跟踪和处理
     blobTracker.proc(origFrame, foreImage, input.time, input.number, rects, output.objects);
 
@@ -576,9 +707,12 @@ void MovingObjectDetector::Impl::proc(const StampedImage& input, ObjectDetails&
 #if CMPL_RUN_STATIC_OBJECT_TRACKER 
     staticBlobTracker.proc(input.time, input.number, rectsNoUpdate, output.staticObjects);
 #endif
-#if CMPL_CALC_PROC_TIME
-    trackTimer.end();
-#endif
+    output.skippedStages = 0;
+    if (!frameDeadline.empty())
+    {
+        output.skippedStages = frameDeadline->skippedStages;
+        frameDeadline->end();
+    }
 
 #if CMPL_SHOW_IMAGE
     Mat imageForDrawing;
@@ -603,12 +737,6 @@ void MovingObjectDetector::Impl::proc(const StampedImage& input, ObjectDetails&
 void MovingObjectDetector::Impl::final(ObjectDetails& output)
 {
     blobTracker.final(output.objects);
-#if CMPL_CALC_PROC_TIME
-    printf("avg visual proc time = %f sec\n", visualTimer.getAvgTime());
-    printf("avg extract proc time = %f sec\n", extractTimer.getAvgTime());
-    printf("avg track proc time = %f sec\n", trackTimer.getAvgTime());
-    printf("\n");
-#endif
 }
 
 void procVideo(const string& videoName, const string& savePath, 
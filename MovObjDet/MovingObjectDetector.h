@@ -5,6 +5,13 @@
 #include <opencv2/core/core.hpp>
 #include "ExportControl.h"
 #include "BlobTracker.h"
+#include "FrameDeadline.h"
+#include "StageProfiler.h"
+
+namespace ztool
+{
+struct ImageWriteStatus;
+}
 
 namespace zsfo
 {
@@ -23,11 +30,21 @@ struct StampedImage
 //! 描述检测到的目标的具体信息的结构体
 struct ObjectDetails
 {
+    //! 构造函数
+    ObjectDetails(void) : skippedStages(0), foregroundRatio(0), isForegroundBurst(false) {};
+
     std::vector<ObjectInfo> objects;                ///< 输出的运动目标
     std::vector<StaticObjectInfo> staticObjects;    ///< 输出的静态目标
+    int skippedStages;                              ///< 因超出单帧处理时间预算跳过的步骤, OptionalStage 中的值按位或
+    double foregroundRatio;                         ///< 前景像素占整个归一化图片的比例, 没有开启前景突增检测时为 0
+    bool isForegroundBurst;                         ///< 前景比例超过阈值, 本帧没有进行前景提取, 跟踪时按没有前景矩形处理
 };
 
 //! 跟踪和快照类
+/*!
+    各个实例之间不共享可变状态, CompileControl.h 中的调试开关都为 0 时,
+    多个实例可以分别在不同的线程中同时运行, 同一个实例不能被多个线程同时调用
+ */
 class Z_LIB_EXPORT MovingObjectDetector
 {
 public:
@@ -109,6 +126,57 @@ public:
         const bool* charRegionCheck = 0, const std::vector<cv::Rect>& charRegionRects = std::vector<cv::Rect>(),
         const bool* checkTurnAround = 0, const double* maxDistRectAndBlob = 0,
         const double* minRatioIntersectToSelf = 0, const double* minRatioIntersectToBlob = 0);
+    //! 修改跟踪结束时输出历史轨迹的参数
+    /*!
+        在 init 之后调用, 参数含义见 BlobTracker::setOutputParams
+        \param[in] interpolateHistory 是否对跳过的帧插值
+        \param[in] maxInterpolateFrameGap 相邻两条记录的帧编号之差不超过这个值才进行插值, 小于等于 0 表示不限制
+     */
+    void setOutputParams(const bool* interpolateHistory = 0, const int* maxInterpolateFrameGap = 0);
+    //! 修改完整更新背景模型的间隔
+    /*!
+        在 init 之后调用, 调用者调整处理帧率时可以同时修改, 使单位时间内完整更新背景模型的次数保持不变
+        \param[in] updateBackInterval 每处理多少帧完整更新一次背景模型, 小于 1 时按 1 处理
+     */
+    void setUpdateBackInterval(int updateBackInterval);
+    //! 获取最近一次 proc 之后跟踪状态的活跃程度
+    void getActivityInfo(TrackingActivityInfo& info) const;
+    //! 设置单帧处理的时间预算
+    /*!
+        在 init 之后调用. 每次 proc 从开始计时, 超出预算后按 OptionalStage 的顺序跳过
+        梯度优化, 大小矩形合并, 相关系数检测和快照更新, 只保留前景提取, 矩形匹配和轨迹记录.
+        连续超出预算时从下一帧开始提前跳过更多的步骤, 处理时间恢复后逐步恢复.
+        每帧跳过的步骤记录在 ObjectDetails::skippedStages 中
+        \param[in] budgetInMilliSecond 预算, 以毫秒计算, 小于等于 0 时不限制
+     */
+    void setFrameBudget(double budgetInMilliSecond);
+    //! 修改前景突增的处理参数
+    /*!
+        在 init 之后调用. 光照突变, 镜头移动或者自动曝光调整时, 混合高斯模型会把大部分画面检测为前景,
+        此时前景提取和跟踪只会产生错误的目标并且耗时很长.
+        前景比例超过阈值的帧跳过前景提取, 跟踪器按没有前景矩形处理, 已经结束的目标照常输出,
+        同时背景模型快速重新学习, 几帧之后恢复正常检测.
+        指针不为空指针时才修改对应的参数
+        \param[in] maxForegroundRatio 前景像素占整个画面的比例超过这个值时认为前景突增, 
+            默认 1, 即不检测, 需要时设置为 0.7 左右
+        \param[in] numOfRelearnFrames 背景模型快速重新学习的帧数, 默认 10, 见 VisualInfo::relearn
+     */
+    void setForegroundBurstParams(const double* maxForegroundRatio = 0, const int* numOfRelearnFrames = 0);
+    //! 启用或者停止分步骤耗时统计
+    /*!
+        在 init 之后调用, 默认不启用. 启用后 proc 中缩放, 滤波, 混合高斯模型, 梯度差值, 形态学操作, 轮廓筛选,
+        矩形合并, 矩形优化, 矩形匹配和快照更新分别计时, 见 ProcStage, 每次计时只读两次时钟.
+        停止后已有的统计保留
+     */
+    void setProfiling(bool enable);
+    //! 获取分步骤耗时统计
+    /*!
+        build 中的背景模型更新也计入 ProcStage::Mog 和 ProcStage::Gradient,
+        从未启用过统计时各项都为 0
+     */
+    void getStats(ProcStats& stats) const;
+    //! 清空分步骤耗时统计
+    void clearStats(void);
     //! 建立背景模型函数
     /*!
         只学习和更新背景模型, 不进行前景检测和跟踪
@@ -162,6 +230,28 @@ public:
     void show(const StampedImage& input, const ObjectDetails& output);
     //! 保存结束跟踪的目标的信息
     void save(const ObjectDetails& output);
+    //! 设置二进制历史轨迹文件
+    /*!
+        设置后 save 函数会将目标的历史轨迹同时写入二进制轨迹文件, 格式见 TrajectoryFileWriter
+        \param[in] binaryHistoryFileName 二进制历史轨迹文件名, 保存在 savePath 下, 若为空, 则不保存
+     */
+    void setBinaryHistoryFile(const std::string& binaryHistoryFileName);
+    //! 设置历史轨迹简化
+    /*!
+        设置后 save 函数写入文本和二进制历史轨迹文件前先用 simplifyHistory 简化轨迹
+        \param[in] tolerance 简化允许的误差, 以归一化帧中的像素计算, 小于等于 0 时不简化
+     */
+    void setHistorySimplify(double tolerance);
+    //! 设置后台写图片
+    /*!
+        默认在 save 函数中同步写图片, 设置后由后台线程编码并写图片, final 函数会等待所有图片写完
+        \param[in] numOfThreads 后台线程数量, 小于等于 0 时同步写图片
+        \param[in] queueCapacity 等待写入的图片数量的上限
+        \param[in] dropWhenFull 等待写入的图片数量达到上限时是否丢弃新的图片, 否则等待
+     */
+    void setAsyncSave(int numOfThreads, int queueCapacity = 16, bool dropWhenFull = false);
+    //! 获取写图片的统计信息, 包括队列长度, 写入失败和被丢弃的图片数量
+    void getSaveStatus(ztool::ImageWriteStatus& status);
     //! 视频或者图片序列结束后调用, 给文本文件加上结束符
     /*!
         \param[in] label 结束符
@@ -6,6 +6,9 @@
 #include "MovingObjectDetector.h"
 #include "CompileControl.h"
 #include "CreateDirectory.h"
+#include "AsyncImageWriter.h"
+#include "BufferedTextWriter.h"
+#include "TrajectoryFile.h"
 
 namespace zsfo
 {
@@ -19,6 +22,10 @@ public:
         bool isPicSmall = true, int waitKeyTime = 0);
     void show(const StampedImage& input, const ObjectDetails& output);
     void save(const ObjectDetails& output);
+    void setBinaryHistoryFile(const std::string& binaryHistoryFileName);
+    void setHistorySimplify(double tolerance);
+    void setAsyncSave(int numOfThreads, int queueCapacity, bool dropWhenFull);
+    void getSaveStatus(ztool::ImageWriteStatus& status);
     void final(const std::string& label);
 
 private:
@@ -35,8 +42,13 @@ private:
     std::string historyName; 
     int infoCount;
     int historyCount;
-    std::fstream objectInfoFile;
-    std::fstream objectHistoryFile;
+    ztool::BufferedTextWriter objectInfoFile;
+    ztool::BufferedTextWriter objectHistoryFile;
+    ztool::AsyncImageWriter imageWriter;
+    bool saveBinaryHistory;
+    TrajectoryFileWriter binaryHistoryFile;
+    double simplifyTolerance;
+    std::vector<ObjectRecord> simplifiedHistory;
 };
 
 }
@@ -69,6 +81,26 @@ void OutputInfoParser::save(const ObjectDetails& output)
     ptrImpl->save(output);
 }
 
+void OutputInfoParser::setBinaryHistoryFile(const std::string& binaryHistoryFileName)
+{
+    ptrImpl->setBinaryHistoryFile(binaryHistoryFileName);
+}
+
+void OutputInfoParser::setHistorySimplify(double tolerance)
+{
+    ptrImpl->setHistorySimplify(tolerance);
+}
+
+void OutputInfoParser::setAsyncSave(int numOfThreads, int queueCapacity, bool dropWhenFull)
+{
+    ptrImpl->setAsyncSave(numOfThreads, queueCapacity, dropWhenFull);
+}
+
+void OutputInfoParser::getSaveStatus(ztool::ImageWriteStatus& status)
+{
+    ptrImpl->getSaveStatus(status);
+}
+
 void OutputInfoParser::final(const std::string& label)
 {
     ptrImpl->final(label);
@@ -100,19 +132,21 @@ void OutputInfoParser::Impl::init(const string& savePath,
     infoCount = 0;
     historyCount = 0;
 
+    imageWriter.init(0, 1);
+    saveBinaryHistory = false;
+    simplifyTolerance = 0;
+
     if (saveObjectInfo)
     {
         infoName = resultPath + "/" + objectInfoFileName;       
-        objectInfoFile.open(infoName.c_str(), ios::out);
-        objectInfoFile << "      ID        Time       Count       X       Y       W       H" << "\n";
-        objectInfoFile.close();
+        objectInfoFile.open(infoName);
+        objectInfoFile.write("      ID        Time       Count       X       Y       W       H\n");
     }
 
     if (saveObjectHistory)
     {
         historyName = resultPath + "/" + objectHistoryFileName;
-        objectHistoryFile.open(historyName.c_str(), ios::out);
-        objectHistoryFile.close();  
+        objectHistoryFile.open(historyName);
     }
 }
 
@@ -256,13 +290,6 @@ void OutputInfoParser::Impl::save(const ObjectDetails& output)
                     output.rects[i].width, output.rects[i].height);
         }
     }*/
-    if (saveObjectInfo)
-    {
-        objectInfoFile.open(infoName.c_str(), ios::ate | ios::out | ios::in);
-        objectInfoFile << fixed;
-    }
-    if (saveObjectHistory)
-        objectHistoryFile.open(historyName.c_str(), ios::ate | ios::out | ios::in);
     for (int i = 0; i < output.objects.size(); i++)
     {
         if (!output.objects[i].isFinal)
@@ -281,74 +308,114 @@ void OutputInfoParser::Impl::save(const ObjectDetails& output)
                 if (saveScene && refImage.scene.data)
                 {
                     sceneNameStr << resultPath << "/" << sceneName << refObject.ID << "-" << j << ".jpg";
-                    imwrite(sceneNameStr.str(), refImage.scene);
+                    Mat image = refImage.scene;
+                    imageWriter.submit(sceneNameStr.str(), image);
                 }
                 if (saveSlice && refImage.slice.data)
                 {
                     sliceNameStr << resultPath << "/" << sliceName << refObject.ID << "-" << j << ".jpg";
-                    imwrite(sliceNameStr.str(), refImage.slice);
+                    Mat image = refImage.slice;
+                    imageWriter.submit(sliceNameStr.str(), image);
                 }
                 if (saveMask && refImage.mask.data)
                 {
                     maskNameStr << resultPath << "/" << maskName << refObject.ID << "-" << j << ".jpg";
-                    imwrite(maskNameStr.str(), refImage.mask);  
+                    Mat image = refImage.mask;
+                    imageWriter.submit(maskNameStr.str(), image);
                 }
                 if (saveObjectInfo)
                 {
-                    objectInfoFile << setw(8) << refObject.ID
-                        << setw(12) << refImage.time
-                        << setw(12) << refImage.number
-                        << setw(8) << refImage.rect.x << setw(8) << refImage.rect.y
-                        << setw(8) << refImage.rect.width << setw(8) << refImage.rect.height;
-                    objectInfoFile << "\n";
+                    objectInfoFile.write(refObject.ID, 8)
+                        .write(refImage.time, 12)
+                        .write(refImage.number, 12)
+                        .write(refImage.rect.x, 8).write(refImage.rect.y, 8)
+                        .write(refImage.rect.width, 8).write(refImage.rect.height, 8);
+                    objectInfoFile.write("\n");
                 }
             }
         }
 
+        if ((saveObjectHistory || saveBinaryHistory) && output.objects[i].hasHistory && simplifyTolerance > 0)
+            simplifyHistory(refObject, simplifyTolerance, simplifiedHistory);
+        const vector<ObjectRecord>& refHistory = simplifyTolerance > 0 ? simplifiedHistory : refObject.history;
+
         if (saveObjectHistory)
         {
             if (output.objects[i].hasHistory)
             {
                 historyCount++; 
-                const vector<ObjectRecord>& refHistory = refObject.history;
-                objectHistoryFile << "Vehicle Count: " << historyCount << "\n";
-                objectHistoryFile << "ID:            " << refObject.ID << "\n";
-                objectHistoryFile << "Size:          " << refHistory.size() << "\n";
-                objectHistoryFile << "Frame Count Time Stamp       x       y       w       h" << "\n";
-                for (int j = 0; j < output.objects[i].history.size(); j++)
+                objectHistoryFile.write("Vehicle Count: ").write(historyCount).write("\n");
+                objectHistoryFile.write("ID:            ").write(refObject.ID).write("\n");
+                objectHistoryFile.write("Size:          ").write(refHistory.size()).write("\n");
+                objectHistoryFile.write("Frame Count Time Stamp       x       y       w       h\n");
+                for (int j = 0; j < refHistory.size(); j++)
                 {
-                    objectHistoryFile << setw(11) << refHistory[j].number
-                        << setw(11) << refHistory[j].time
-                        << setw(8) << refHistory[j].normRect.x
-                        << setw(8) << refHistory[j].normRect.y
-                        << setw(8) << refHistory[j].normRect.width
-                        << setw(8) << refHistory[j].normRect.height << "\n";
+                    objectHistoryFile.write(refHistory[j].number, 11)
+                        .write(refHistory[j].time, 11)
+                        .write(refHistory[j].normRect.x, 8)
+                        .write(refHistory[j].normRect.y, 8)
+                        .write(refHistory[j].normRect.width, 8)
+                        .write(refHistory[j].normRect.height, 8).write("\n");
                 }
-                objectHistoryFile << "\n";
+                objectHistoryFile.write("\n");
             }   
         }
+
+        if (saveBinaryHistory && output.objects[i].hasHistory)
+            binaryHistoryFile.write(refObject.ID, refHistory);
     }
     if (saveObjectInfo)
-        objectInfoFile.close();
+        objectInfoFile.endRecord();
     if (saveObjectHistory)
-        objectHistoryFile.close();
+        objectHistoryFile.endRecord();
 } 
 
+void OutputInfoParser::Impl::setBinaryHistoryFile(const string& binaryHistoryFileName)
+{
+    binaryHistoryFile.close();
+    saveBinaryHistory = !binaryHistoryFileName.empty() && 
+        binaryHistoryFile.open(resultPath + "/" + binaryHistoryFileName);
+}
+
+void OutputInfoParser::Impl::setHistorySimplify(double tolerance)
+{
+    simplifyTolerance = tolerance;
+}
+
+void OutputInfoParser::Impl::setAsyncSave(int numOfThreads, int queueCapacity, bool dropWhenFull)
+{
+    imageWriter.init(numOfThreads, queueCapacity, dropWhenFull);
+}
+
+void OutputInfoParser::Impl::getSaveStatus(ztool::ImageWriteStatus& status)
+{
+    imageWriter.getStatus(status);
+}
+
 void OutputInfoParser::Impl::final(const string& label)
 {
+    imageWriter.flush();
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    ztool::ImageWriteStatus status;
+    imageWriter.getStatus(status);
+    printf("Images written: %d, failed: %d, dropped: %d, max queue depth: %d\n",
+        status.numOfWritten, status.numOfFailed, status.numOfDropped, status.maxQueueDepth);
+#endif
+
     if (saveObjectInfo)
     {
-        objectInfoFile.open(infoName.c_str(), ios::ate | ios::out | ios::in);
-        objectInfoFile << label << "\n";
+        objectInfoFile.write(label).write("\n");
         objectInfoFile.close();
     }
 
     if (saveObjectHistory)
     {
-        objectHistoryFile.open(historyName.c_str(), ios::ate | ios::out | ios::in);
-        objectHistoryFile << label << "\n";
+        objectHistoryFile.write(label).write("\n");
         objectHistoryFile.close();
     }
+
+    if (saveBinaryHistory)
+        binaryHistoryFile.close();
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+﻿#include <cmath>
+#include <cstring>
+#include "StageProfiler.h"
+
+namespace zsfo
+{
+
+static const char* stageNames[ProcStage::Count] = 
+{
+    "resize", "denoise", "mog", "gradient", "morphology", 
+    "labeling", "merge", "refine", "match", "snapshot"
+};
+
+const char* getProcStageName(int stage)
+{
+    return stage >= 0 && stage < ProcStage::Count ? stageNames[stage] : "frame";
+}
+
+StageProfiler::StageProfiler(void)
+    : enabled(false)
+{
+    microSecondsPerTick = 1000000.0 / cv::getTickFrequency();
+    clear();
+}
+
+void StageProfiler::clear(void)
+{
+    memset(hists, 0, sizeof(hists));
+}
+
+void StageProfiler::record(int stage, long long int ticks)
+{
+    if (stage < 0 || stage > ProcStage::Count)
+        return;
+
+    Histogram& hist = hists[stage];
+    double microSeconds = ticks * microSecondsPerTick;
+    // 耗时在 [2^e, 2^(e + 1)) 微秒之间时落在第 e 个二倍区间, 区间内再均分成 numOfSubBuckets 个桶
+    int index = 0;
+    if (microSeconds >= 1)
+    {
+        int exponent;
+        double fraction = frexp(microSeconds, &exponent);
+        index = 1 + (exponent - 1) * numOfSubBuckets + int((fraction * 2 - 1) * numOfSubBuckets);
+        if (index >= numOfBuckets)
+            index = numOfBuckets - 1;
+    }
+    hist.buckets[index]++;
+    hist.count++;
+    hist.sumOfMicroSeconds += microSeconds;
+    if (microSeconds > hist.maxMicroSeconds)
+        hist.maxMicroSeconds = microSeconds;
+}
+
+void StageProfiler::calcStats(const Histogram& hist, StageStats& stats)
+{
+    stats = StageStats();
+    if (hist.count == 0)
+        return;
+
+    stats.count = hist.count;
+    stats.meanLatency = hist.sumOfMicroSeconds / hist.count * 0.001;
+    stats.maxLatency = hist.maxMicroSeconds * 0.001;
+    const double quantiles[2] = {0.5, 0.99};
+    double* ptrLatency[2] = {&stats.p50Latency, &stats.p99Latency};
+    for (int k = 0; k < 2; k++)
+    {
+        int rank = int(ceil(quantiles[k] * hist.count));
+        int accCount = 0;
+        for (int i = 0; i < numOfBuckets; i++)
+        {
+            accCount += hist.buckets[i];
+            if (accCount < rank)
+                continue;
+            // 第 i 个桶的上界, 不超过最大耗时
+            double upper = 1;
+            if (i > 0)
+            {
+                int exponent = (i - 1) / numOfSubBuckets;
+                int sub = (i - 1) % numOfSubBuckets;
+                upper = ldexp(1 + double(sub + 1) / numOfSubBuckets, exponent);
+            }
+            *ptrLatency[k] = (upper < hist.maxMicroSeconds ? upper : hist.maxMicroSeconds) * 0.001;
+            break;
+        }
+    }
+}
+
+void StageProfiler::getStats(ProcStats& stats) const
+{
+    calcStats(hists[ProcStage::Count], stats.frame);
+    stats.stages.resize(ProcStage::Count);
+    for (int i = 0; i < ProcStage::Count; i++)
+        calcStats(hists[i], stats.stages[i]);
+}
+
+}
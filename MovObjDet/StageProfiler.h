@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace zsfo
+{
+
+//! 逐帧处理中分别计时的步骤
+struct ProcStage
+{
+    enum
+    {
+        Resize = 0,        ///< 缩放到归一化尺寸
+        Denoise = 1,       ///< 中值滤波和高斯滤波
+        Mog = 2,           ///< 混合高斯模型检测前景和更新背景
+        Gradient = 3,      ///< 计算梯度差值图并加到前景图中
+        Morphology = 4,    ///< 前景图的膨胀和腐蚀
+        Labeling = 5,      ///< 查找前景轮廓并筛选
+        Merge = 6,         ///< 合并前景矩形
+        Refine = 7,        ///< 根据梯度差值图优化前景矩形
+        Match = 8,         ///< 前景矩形和运动目标匹配
+        Snapshot = 9,      ///< 更新快照图片和历史截图
+        Count = 10         ///< 步骤的数量
+    };
+};
+
+//! 步骤的名称, stage 为 ProcStage 中的值, 用于打印统计信息
+const char* getProcStageName(int stage);
+
+//! 单个步骤的耗时统计, 以毫秒计算
+struct StageStats
+{
+    //! 构造函数
+    StageStats(void) : count(0), meanLatency(0), p50Latency(0), p99Latency(0), maxLatency(0) {};
+
+    int count;             ///< 计时次数
+    double meanLatency;    ///< 平均耗时
+    double p50Latency;     ///< 中位数
+    double p99Latency;     ///< 99% 分位数
+    double maxLatency;     ///< 最大耗时
+};
+
+//! 逐帧处理的耗时统计
+struct ProcStats
+{
+    StageStats frame;                 ///< 整帧处理的耗时
+    std::vector<StageStats> stages;   ///< 各个步骤的耗时, 下标为 ProcStage 中的值
+};
+
+//! 分步骤的耗时统计
+/*!
+    每个步骤保存一个按耗时对数分桶的直方图, 每个二倍区间分成 8 个桶, 
+    分位数取所在桶的上界, 相对误差不超过 12.5%, 超过 16 秒的耗时都计入最后一个桶.
+    记录一次耗时只需要一次除法和数组加一, 不分配内存.
+    和检测器一样只能在一个线程中使用
+ */
+class StageProfiler
+{
+public:
+    //! 构造函数, 默认不启用
+    StageProfiler(void);
+    //! 启用或者停止统计, 停止后已有的统计保留
+    void setEnabled(bool enable) { enabled = enable; };
+    //! 是否启用
+    bool isEnabled(void) const { return enabled; };
+    //! 清空统计
+    void clear(void);
+    //! 记录一次耗时
+    /*!
+        \param[in] stage ProcStage 中的值, 等于 ProcStage::Count 时记为整帧处理的耗时
+        \param[in] ticks 耗时, 以 cv::getTickCount 的计数计算
+     */
+    void record(int stage, long long int ticks);
+    //! 获取统计结果
+    void getStats(ProcStats& stats) const;
+
+private:
+    enum {numOfSubBuckets = 8, numOfOctaves = 24, numOfBuckets = 1 + numOfSubBuckets * numOfOctaves};
+    //! 单个步骤的耗时直方图, 第 0 个桶记录不到 1 微秒的耗时
+    struct Histogram
+    {
+        int buckets[numOfBuckets];
+        int count;
+        double sumOfMicroSeconds;
+        double maxMicroSeconds;
+    };
+    static void calcStats(const Histogram& hist, StageStats& stats);
+
+    bool enabled;
+    double microSecondsPerTick;
+    Histogram hists[ProcStage::Count + 1];
+};
+
+//! 作用域计时器, 构造时开始计时, 析构时把耗时记入 profiler
+/*!
+    profiler 为空指针或者未启用时不读取时钟
+ */
+class StageTimer
+{
+public:
+    StageTimer(StageProfiler* profiler, int stage)
+        : ptrProfiler(profiler && profiler->isEnabled() ? profiler : 0), procStage(stage), 
+          begTick(ptrProfiler ? cv::getTickCount() : 0)
+    {};
+    ~StageTimer(void)
+    {
+        if (ptrProfiler)
+            ptrProfiler->record(procStage, cv::getTickCount() - begTick);
+    };
+
+private:
+    StageTimer(const StageTimer&);
+    StageTimer& operator=(const StageTimer&);
+
+    StageProfiler* ptrProfiler;
+    int procStage;
+    long long int begTick;
+};
+
+}
@@ -1,4 +1,5 @@
 ﻿#include <fstream>
+#include <algorithm>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -11,6 +12,25 @@ using namespace std;
 using namespace cv;
 using namespace ztool;
 
+namespace
+{
+
+// 静态目标网格索引的单元格边长, 归一化图像坐标
+static const int GridCellSize = 16;
+// 每个静态目标最多保留的 Interval 数量, 超出的部分合并到统计量中
+static const int MaxNumOfIntervals = 16;
+
+// 判断两个矩形是否完美匹配
+bool isPerfectMatch(const cv::Rect& blobRect, const cv::Rect& rect)
+{
+    cv::Rect intersectRect = blobRect & rect;
+    cv::Rect unionRect = blobRect | rect;
+    return unionRect.width > 20 && unionRect.height > 20 ? 
+        intersectRect.area() > 0.95 * unionRect.area() : intersectRect.area() > 0.75 * unionRect.area();
+}
+
+}
+
 namespace zsfo
 {
 
@@ -65,7 +85,13 @@ void StaticBlob::init(int currID, const Rect& currRect, long long int time)
     rect = currRect;
     isStatic = false;
     hasOutputStatic = false;
+    isMatchInCurrFrame = false;
+    intervals.clear();
     intervals.push_back(Interval(time, true));
+    begTime = time;
+    numOfCompactedIntervals = 0;
+    compactedMatchTime = 0;
+    compactedMissTime = 0;
 }
 
 void StaticBlob::setConfigParam(const double* minStaticTimeInMinute)
@@ -74,13 +100,37 @@ void StaticBlob::setConfigParam(const double* minStaticTimeInMinute)
         configCheckStatic->minStaticTimeInMinute = *minStaticTimeInMinute;
 }
 
+void StaticBlob::compactIntervals(const long long int time)
+{
+    // 最后一个 Interval 始终保留, 其余的 Interval 如果结束时间早于 minStaticTimeInMinute 之前
+    // 或者总数超过上限, 就合并到统计量中
+    long long int compactTime = time - configCheckStatic->minStaticTimeInMinute * 60 * 1000;
+    int numOfIntervals = intervals.size();
+    int numToCompact = 0;
+    while (numToCompact < numOfIntervals - 1 &&
+           (intervals[numToCompact].end < compactTime || numOfIntervals - numToCompact > MaxNumOfIntervals))
+    {
+        const Interval& interval = intervals[numToCompact];
+        if (interval.isMatch)
+            compactedMatchTime += interval.end - interval.beg;
+        else
+            compactedMissTime += interval.end - interval.beg;
+        ++numToCompact;
+    }
+    if (numToCompact > 0)
+    {
+        numOfCompactedIntervals += numToCompact;
+        intervals.erase(intervals.begin(), intervals.begin() + numToCompact);
+    }
+}
+
 void StaticBlob::checkStatic(const long long int time, const int count)
 {
     if (isStatic) return;
 
     if (!intervals.back().isMatch) return;
 
-    if (intervals.back().end - intervals.front().beg > configCheckStatic->minStaticTimeInMinute * 60 * 1000)
+    if (intervals.back().end - begTime > configCheckStatic->minStaticTimeInMinute * 60 * 1000)
     {
         isStatic = true;
 #if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
@@ -111,6 +161,11 @@ void StaticBlob::drawBlob(Mat& image, const Scalar& staticColor, const Scalar& n
 void StaticBlob::displayHistory(void) const
 {
     printf("Begin display history.............\n");
+    if (numOfCompactedIntervals > 0)
+    {
+        printf("Compacted %d intervals, begtime %lld, match time %lld, miss time %lld\n",
+            numOfCompactedIntervals, begTime % 100000, compactedMatchTime, compactedMissTime);
+    }
     printf("Number   match   begtime   endtime\n");
     for (int k = 0; k < intervals.size(); k++)
     {
@@ -120,6 +175,84 @@ void StaticBlob::displayHistory(void) const
     printf("End display history...............\n");
 }
 
+void StaticBlobGrid::init(int width, int height, int size)
+{
+    cellSize = size > 0 ? size : GridCellSize;
+    numOfCols = (width + cellSize - 1) / cellSize;
+    numOfRows = (height + cellSize - 1) / cellSize;
+    if (numOfCols < 1) numOfCols = 1;
+    if (numOfRows < 1) numOfRows = 1;
+    cells.clear();
+    cells.resize(numOfCols * numOfRows);
+}
+
+void StaticBlobGrid::clear(void)
+{
+    for (int i = 0; i < cells.size(); i++)
+        cells[i].clear();
+}
+
+bool StaticBlobGrid::getCellRange(const Rect& rect, int& colBeg, int& colEnd, int& rowBeg, int& rowEnd) const
+{
+    if (rect.width <= 0 || rect.height <= 0)
+        return false;
+    colBeg = std::max(rect.x / cellSize, 0);
+    colEnd = std::min((rect.x + rect.width - 1) / cellSize, numOfCols - 1);
+    rowBeg = std::max(rect.y / cellSize, 0);
+    rowEnd = std::min((rect.y + rect.height - 1) / cellSize, numOfRows - 1);
+    return colBeg <= colEnd && rowBeg <= rowEnd;
+}
+
+void StaticBlobGrid::insert(StaticBlob* blob)
+{
+    int colBeg, colEnd, rowBeg, rowEnd;
+    if (!getCellRange(blob->rect, colBeg, colEnd, rowBeg, rowEnd))
+        return;
+    for (int row = rowBeg; row <= rowEnd; row++)
+    {
+        for (int col = colBeg; col <= colEnd; col++)
+            cells[row * numOfCols + col].push_back(blob);
+    }
+}
+
+void StaticBlobGrid::remove(StaticBlob* blob)
+{
+    int colBeg, colEnd, rowBeg, rowEnd;
+    if (!getCellRange(blob->rect, colBeg, colEnd, rowBeg, rowEnd))
+        return;
+    for (int row = rowBeg; row <= rowEnd; row++)
+    {
+        for (int col = colBeg; col <= colEnd; col++)
+        {
+            vector<StaticBlob*>& cell = cells[row * numOfCols + col];
+            vector<StaticBlob*>::iterator itr = std::find(cell.begin(), cell.end(), blob);
+            if (itr != cell.end())
+            {
+                *itr = cell.back();
+                cell.pop_back();
+            }
+        }
+    }
+}
+
+void StaticBlobGrid::query(const Rect& rect, vector<StaticBlob*>& blobs) const
+{
+    blobs.clear();
+    int colBeg, colEnd, rowBeg, rowEnd;
+    if (!getCellRange(rect, colBeg, colEnd, rowBeg, rowEnd))
+        return;
+    for (int row = rowBeg; row <= rowEnd; row++)
+    {
+        for (int col = colBeg; col <= colEnd; col++)
+        {
+            const vector<StaticBlob*>& cell = cells[row * numOfCols + col];
+            blobs.insert(blobs.end(), cell.begin(), cell.end());
+        }
+    }
+    std::sort(blobs.begin(), blobs.end());
+    blobs.erase(std::unique(blobs.begin(), blobs.end()), blobs.end());
+}
+
 void StaticBlobTracker::init(const SizeInfo& sizesOrigAndNorm, const RegionOfInterest& observedRegion, const string& path)
 {
     ptrImpl = new Impl;
@@ -142,11 +275,20 @@ void StaticBlobTracker::drawBlobs(Mat& image, const Scalar& staticColor, const S
     ptrImpl->drawBlobs(image, staticColor, nonStaticColor);
 }
 
+StaticBlobTracker::Impl::~Impl(void)
+{
+    for (int i = 0; i < blobPool.size(); i++)
+        delete blobPool[i];
+}
+
 void StaticBlobTracker::Impl::init(const SizeInfo& sizesOrigAndNorm, const RegionOfInterest& observedRegion, const string& path)
 {
     roi = observedRegion;
     sizeInfo = sizesOrigAndNorm;
     blobCount = 0;
+    freeBlobs.insert(freeBlobs.end(), blobList.begin(), blobList.end());
+    blobList.clear();
+    blobGrid.init(sizeInfo.normWidth, sizeInfo.normHeight, GridCellSize);
 
     blobInstance.init(path);
 
@@ -208,135 +350,117 @@ void StaticBlobTracker::Impl::proc(const long long int time, const int count,
     outputInfo(staticObjects);
 }
 
+StaticBlob* StaticBlobTracker::Impl::allocBlob(void)
+{
+    if (!freeBlobs.empty())
+    {
+        StaticBlob* staticBlob = freeBlobs.back();
+        freeBlobs.pop_back();
+        return staticBlob;
+    }
+    StaticBlob* staticBlob = new StaticBlob(blobInstance);
+    blobPool.push_back(staticBlob);
+    return staticBlob;
+}
+
+void StaticBlobTracker::Impl::releaseBlob(StaticBlob* blob)
+{
+    blobGrid.remove(blob);
+    freeBlobs.push_back(blob);
+}
+
 void StaticBlobTracker::Impl::updateBlobList(const long long int time, const int count, const vector<Rect>& rects)
 {
     if (rects.empty())
         return;
 
     int numOfValidRects = 0;
-    vector<Rect> validRects;
+    vector<RectInfo> rectInfos;
 
     int numOfRects = rects.size();
-    validRects.reserve(numOfRects);
+    rectInfos.reserve(numOfRects);
     for (int i = 0; i < numOfRects; i++)
     {
         if (roi.intersects(rects[i]))
         {
-            validRects.push_back(rects[i]);
+            rectInfos.push_back(RectInfo(rects[i]));
             numOfValidRects++;
         }
     }
 
-    //printf("  k  rect.x  rect.y  rect.w  rect.h\n");
-    //for (int k = 0; k < numOfValidRects; k++)
-    //{
-    //  printf("%3d%8d%8d%8d%8d\n", k, validRects[k].x, validRects[k].y, validRects[k].width, validRects[k].height);
-    //}
-    //printf("SID  rect.x  rect.y  rect.w  rect.h\n");
-    //for (list<StaticBlob*>::iterator itr = blobList.begin(); itr != blobList.end(); ++itr)
-    //{
-    //  printf("%3d%8d%8d%8d%8d\n", (*itr)->ID, 
-    //      (*itr)->rect.x, (*itr)->rect.y, (*itr)->rect.width, (*itr)->rect.height);
-    //}
-    
-    // 如果 blobList 为空，则将当前帧的 validRects 都 push 到 blobList 中，结束
-    if (blobList.empty())
+    // 通过网格索引找出所有和 rectInfos 中的矩形完美匹配的 blobList 中的对象
+    matchPairs.clear();
+    for (int i = 0; i < numOfValidRects; i++)
     {
-        for (int i = 0; i < numOfValidRects; i++)
+        blobGrid.query(rectInfos[i].rect, candidateBlobs);
+        for (int j = 0; j < candidateBlobs.size(); j++)
         {
-            ++blobCount;
-#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
-            printf("Static Blob ID: %d Begin tracking. Time stamp: %lld, Frame count: %d\n", 
-                blobCount, time, count);
-#endif
-            StaticBlob* staticBlob = new StaticBlob(blobInstance);
-            staticBlob->init(blobCount, validRects[i], time);
-            blobList.push_back(staticBlob);
+            if (isPerfectMatch(candidateBlobs[j]->rect, rectInfos[i].rect))
+                matchPairs.push_back(MatchPair(candidateBlobs[j], i));
         }
-        return;
     }
 
-    vector<RectInfo> rectInfos(numOfValidRects);
-    for (int i = 0; i < numOfValidRects; i++)
+    // 按照 ID 从小到大的顺序, 每个对象匹配下标最小的尚未匹配的矩形
+    for (int i = 0; i < blobList.size(); i++)
+        blobList[i]->isMatchInCurrFrame = false;
+    std::sort(matchPairs.begin(), matchPairs.end());
+    for (int i = 0; i < matchPairs.size(); i++)
     {
-        rectInfos[i] = validRects[i];
-    }
-
-    // 如果 blobList 中的跟踪对象能够和 validRects 中的矩形完美匹配，则更新 blobList 中的那个对象
-    for (list<StaticBlob*>::iterator itr = blobList.begin(); itr != blobList.end();)
-    {
-        bool match = false;
-        for (int i = 0; i < numOfValidRects; i++)
+        StaticBlob* staticBlob = matchPairs[i].blob;
+        RectInfo& rectInfo = rectInfos[matchPairs[i].rectIndex];
+        if (staticBlob->isMatchInCurrFrame || rectInfo.isMatch)
+            continue;
+
+        rectInfo.isMatch = true;
+        staticBlob->isMatchInCurrFrame = true;
+        if (staticBlob->rect != rectInfo.rect)
         {
-            if (rectInfos[i].isMatch)
-                continue;
-
-            Rect intersectRect = (*itr)->rect & rectInfos[i].rect;
-            Rect unionRect = (*itr)->rect | rectInfos[i].rect;
-
-            // 完美匹配的情况
-            if (unionRect.width > 20 && unionRect.height > 20 ? 
-                intersectRect.area() > 0.95 * unionRect.area() : intersectRect.area() > 0.75 * unionRect.area())
-            {
-                rectInfos[i].isMatch = true;
-                match = true;
-                (*itr)->rect = rectInfos[i].rect;
-                if ((*itr)->intervals.back().isMatch)
-                    (*itr)->intervals.back().end = time;
-                else
-                {
-                    //printf("SID: %d appear again\n", (*itr)->ID);
-                    //waitKey(0);
-                    (*itr)->intervals.push_back(StaticBlob::Interval(time, true));
-                }
-                break;
-            }
+            blobGrid.remove(staticBlob);
+            staticBlob->rect = rectInfo.rect;
+            blobGrid.insert(staticBlob);
         }
+        if (staticBlob->intervals.back().isMatch)
+            staticBlob->intervals.back().end = time;
+        else
+            staticBlob->intervals.push_back(StaticBlob::Interval(time, true));
+    }
 
-        if (!match)
+    // 更新没有匹配上的对象, 删除丢失时间过长的对象
+    int numOfBlobs = blobList.size();
+    int numOfKeptBlobs = 0;
+    for (int i = 0; i < numOfBlobs; i++)
+    {
+        StaticBlob* staticBlob = blobList[i];
+        if (!staticBlob->isMatchInCurrFrame)
         {
             // 上一帧还处于被跟踪的状态 则新创建一个 Interval 表明当前没检测到
-            if ((*itr)->intervals.back().isMatch)
+            if (staticBlob->intervals.back().isMatch)
             {
-                //printf("SID: %d miss\n", (*itr)->ID);
-                //waitKey(0);
-                (*itr)->intervals.push_back(StaticBlob::Interval(time, false));
-                ++itr;
+                staticBlob->intervals.push_back(StaticBlob::Interval(time, false));
             }
             // 上一帧处于丢失状态
             else
             {
                 // 丢失时间太长，删除
-                if (time - (*itr)->intervals.back().beg > 
+                if (time - staticBlob->intervals.back().beg > 
                     configUpdateBlobList.minMissTimeInMinuteToDelete * 60 * 1000)
                 {
-                    //printf("SID: %d delete\n", (*itr)->ID);
-                    //for (int k = 0; k < (*itr)->intervals.size(); k++)
-                    //{
-                    //  printf(" k = %d, match = %s, beg = %lld, end = %lld\n",
-                    //      k, (*itr)->intervals[k].isMatch ? "true" : "false", (*itr)->intervals[k].beg, (*itr)->intervals[k].end);
-                    //}
-                    //printf("time: %lld, beg: %lld\n", time, (*itr)->intervals.back().beg);
-                    //waitKey(0);
 #if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
                     printf("Static Blob ID: %d Miss too long, deleted. Time stamp: %lld, Frame count: %d\n",
-                        (*itr)->ID, time, count);
-                    (*itr)->displayHistory();
-                    //waitKey(0);
+                        staticBlob->ID, time, count);
+                    staticBlob->displayHistory();
 #endif
-                    delete (*itr);
-                    itr = blobList.erase(itr);                  
+                    releaseBlob(staticBlob);
+                    continue;
                 }
                 else
-                {
-                    (*itr)->intervals.back().end = time;
-                    ++itr;
-                }
+                    staticBlob->intervals.back().end = time;
             }
         }
-        else
-            ++itr;
+        staticBlob->compactIntervals(time);
+        blobList[numOfKeptBlobs++] = staticBlob;
     }
+    blobList.resize(numOfKeptBlobs);
 
     // 处理没有被匹配上的矩形
     for (int i = 0; i < numOfValidRects; i++)
@@ -348,9 +472,10 @@ void StaticBlobTracker::Impl::updateBlobList(const long long int time, const int
             printf("Static Blob ID: %d Begin tracking. Time stamp: %lld, Frame count: %d\n", 
                 blobCount, time, count);
 #endif
-            StaticBlob* staticBlob = new StaticBlob(blobInstance);
-            staticBlob->init(blobCount, validRects[i], time);
+            StaticBlob* staticBlob = allocBlob();
+            staticBlob->init(blobCount, rectInfos[i].rect, time);
             blobList.push_back(staticBlob);
+            blobGrid.insert(staticBlob);
         }
     }
 }
@@ -358,27 +483,28 @@ void StaticBlobTracker::Impl::updateBlobList(const long long int time, const int
 void StaticBlobTracker::Impl::checkStatic(const long long int time, const int count)
 {
     // 判断是否停留时间过长
-    for (list<StaticBlob*>::iterator itr = blobList.begin(); itr != blobList.end(); ++itr)
+    for (int i = 0; i < blobList.size(); i++)
     {
-        (*itr)->checkStatic(time, count);
+        blobList[i]->checkStatic(time, count);
     }
 }
 
 void StaticBlobTracker::Impl::outputInfo(vector<StaticObjectInfo>& staticObjects) const
 {
     staticObjects.clear();
-    for (list<StaticBlob*>::const_iterator itr = blobList.begin(); itr != blobList.end(); ++itr)
+    for (int i = 0; i < blobList.size(); i++)
     {
+        StaticBlob* staticBlob = blobList[i];
         // 只有 isStatic 为真并且当前处于 match 状态的目标 并且尚未输出过静止状态 才会输出
-        if ((*itr)->isStatic && (*itr)->hasOutputStatic == false &&(*itr)->intervals.back().isMatch)
+        if (staticBlob->isStatic && staticBlob->hasOutputStatic == false && staticBlob->intervals.back().isMatch)
         {
-            (*itr)->hasOutputStatic = true;
+            staticBlob->hasOutputStatic = true;
             StaticObjectInfo objectInfo;
-            objectInfo.ID = (*itr)->ID;
-            objectInfo.rect = Rect((*itr)->rect.x * sizeInfo.horiScale,
-                                   (*itr)->rect.y * sizeInfo.vertScale,
-                                   (*itr)->rect.width * sizeInfo.horiScale,
-                                   (*itr)->rect.height * sizeInfo.vertScale);
+            objectInfo.ID = staticBlob->ID;
+            objectInfo.rect = Rect(staticBlob->rect.x * sizeInfo.horiScale,
+                                   staticBlob->rect.y * sizeInfo.vertScale,
+                                   staticBlob->rect.width * sizeInfo.horiScale,
+                                   staticBlob->rect.height * sizeInfo.vertScale);
             staticObjects.push_back(objectInfo);
         }
     }
@@ -386,9 +512,9 @@ void StaticBlobTracker::Impl::outputInfo(vector<StaticObjectInfo>& staticObjects
 
 void StaticBlobTracker::Impl::drawBlobs(Mat& image, const Scalar& staticColor, const Scalar& nonStaticColor) const
 {
-    for (list<StaticBlob*>::const_iterator itr = blobList.begin(); itr != blobList.end(); ++itr)
+    for (int i = 0; i < blobList.size(); i++)
     {
-        (*itr)->drawBlob(image, staticColor, nonStaticColor);
+        blobList[i]->drawBlob(image, staticColor, nonStaticColor);
     }
 }
 
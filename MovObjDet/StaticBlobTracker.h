@@ -22,6 +22,7 @@ struct StaticBlob
     void init(const std::string& path);
     void init(int currID, const cv::Rect& currRect, long long int time);
     void setConfigParam(const double* minStaticTimeInMinute = 0);
+    void compactIntervals(const long long int time);
     void checkStatic(const long long int time, const int count);
     void outputInfo(StaticObjectInfo& objectInfo) const;
     void drawBlob(cv::Mat& image, const cv::Scalar& staticColor, const cv::Scalar& nonStaticColor) const;
@@ -31,6 +32,7 @@ struct StaticBlob
     cv::Rect rect;
     bool isStatic;
     bool hasOutputStatic;
+    bool isMatchInCurrFrame;
     struct Interval
     {
         Interval() {};
@@ -38,7 +40,12 @@ struct StaticBlob
         long long int beg, end;
         bool isMatch;
     };
+    // 只保留最近的 Interval, 更早的 Interval 合并到下面的统计量中, 保证每个目标占用的内存有上限
     std::vector<Interval> intervals;
+    long long int begTime;             ///< 开始跟踪的时间戳
+    int numOfCompactedIntervals;       ///< 已经合并的 Interval 数量
+    long long int compactedMatchTime;  ///< 已经合并的 Interval 中匹配上的总时长
+    long long int compactedMissTime;   ///< 已经合并的 Interval 中丢失的总时长
     struct ConfigCheckStatic
     {
         double minStaticTimeInMinute;
@@ -46,11 +53,29 @@ struct StaticBlob
     cv::Ptr<ConfigCheckStatic> configCheckStatic;
 };
 
+//! 按照网格索引 StaticBlob, 只和空间上邻近的目标比较
+class StaticBlobGrid
+{
+public:
+    void init(int width, int height, int cellSize);
+    void clear(void);
+    void insert(StaticBlob* blob);
+    void remove(StaticBlob* blob);
+    void query(const cv::Rect& rect, std::vector<StaticBlob*>& blobs) const;
+
+private:
+    bool getCellRange(const cv::Rect& rect, int& colBeg, int& colEnd, int& rowBeg, int& rowEnd) const;
+
+    int cellSize;
+    int numOfCols, numOfRows;
+    std::vector<std::vector<StaticBlob*> > cells;
+};
+
 class StaticBlobTracker::Impl
 {
 public:
     Impl(void) {};
-    ~Impl(void) {};
+    ~Impl(void);
 
     void init(const SizeInfo& sizesOrigAndNorm, const RegionOfInterest& observedRegion, const std::string& path);
     void setConfigParam(const double* allowedMissTimeInMinute = 0, const double* minStaticTimeInMinute = 0);
@@ -62,9 +87,14 @@ private:
     void updateBlobList(const long long int time, const int count, const std::vector<cv::Rect>& rects);
     void checkStatic(const long long int time, const int count);
     void outputInfo(std::vector<StaticObjectInfo>& staticObjects) const;
+    StaticBlob* allocBlob(void);
+    void releaseBlob(StaticBlob* blob);
 
     int blobCount;
-    std::list<StaticBlob*> blobList;
+    std::vector<StaticBlob*> blobList;  ///< 正在跟踪的目标, 按照 ID 递增排列
+    std::vector<StaticBlob*> blobPool;  ///< 所有分配过的目标, 析构时统一释放
+    std::vector<StaticBlob*> freeBlobs; ///< 可以复用的目标
+    StaticBlobGrid blobGrid;
     RegionOfInterest roi;
     SizeInfo sizeInfo;
     StaticBlob blobInstance;
@@ -81,6 +111,19 @@ private:
         cv::Rect rect;
         bool isMatch;
     };
+    struct MatchPair
+    {
+        MatchPair(void) {};
+        MatchPair(StaticBlob* blobPtr, int index) : blob(blobPtr), rectIndex(index) {};
+        bool operator<(const MatchPair& other) const
+        {
+            return blob->ID < other.blob->ID || (blob->ID == other.blob->ID && rectIndex < other.rectIndex);
+        }
+        StaticBlob* blob;
+        int rectIndex;
+    };
+    std::vector<StaticBlob*> candidateBlobs;
+    std::vector<MatchPair> matchPairs;
 };
 
 } // namespace zsfo
\ No newline at end of file
@@ -0,0 +1,577 @@
+﻿#if WIN32 || _WIN32
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "TrajectoryFile.h"
+#include "FileStreamScopeGuard.h"
+#include "Exception.h"
+
+using namespace std;
+using namespace cv;
+
+namespace
+{
+
+static const char fileMagic[4] = {'Z', 'T', 'R', 'K'};
+static const char footerMagic[4] = {'Z', 'T', 'R', 'E'};
+static const unsigned int fileVersion = 1;
+static const int headerSize = 16;
+static const int footerSize = 16;
+static const int indexEntrySize = 36;
+static const int numOfColumns = 6;
+
+void putUInt32(vector<unsigned char>& buf, unsigned int val)
+{
+    for (int i = 0; i < 4; i++)
+        buf.push_back((unsigned char)(val >> (8 * i)));
+}
+
+void putUInt64(vector<unsigned char>& buf, unsigned long long int val)
+{
+    for (int i = 0; i < 8; i++)
+        buf.push_back((unsigned char)(val >> (8 * i)));
+}
+
+unsigned int getUInt32(const unsigned char* ptr)
+{
+    return (unsigned int)ptr[0] | ((unsigned int)ptr[1] << 8) |
+        ((unsigned int)ptr[2] << 16) | ((unsigned int)ptr[3] << 24);
+}
+
+unsigned long long int getUInt64(const unsigned char* ptr)
+{
+    return (unsigned long long int)getUInt32(ptr) | ((unsigned long long int)getUInt32(ptr + 4) << 32);
+}
+
+// 差值先做 zigzag 变换, 使绝对值小的负数也编码成较短的变长整数
+void putVarint(vector<unsigned char>& buf, long long int val)
+{
+    unsigned long long int zigzag = ((unsigned long long int)val << 1) ^ (unsigned long long int)(val >> 63);
+    while (zigzag >= 0x80)
+    {
+        buf.push_back((unsigned char)(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    buf.push_back((unsigned char)zigzag);
+}
+
+// 解码时不越过 end, 数据被截断或者变长整数超过 10 字节时返回 false
+bool getVarint(const unsigned char*& ptr, const unsigned char* end, long long int& val)
+{
+    unsigned long long int zigzag = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (ptr >= end)
+            return false;
+        unsigned char byte = *ptr++;
+        zigzag |= (unsigned long long int)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            val = (long long int)(zigzag >> 1) ^ -(long long int)(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+long long int getColumnValue(const zsfo::TrajectoryRecord& record, int column)
+{
+    switch (column)
+    {
+    case 0: return record.number;
+    case 1: return record.time;
+    case 2: return record.rect.x;
+    case 3: return record.rect.y;
+    case 4: return record.rect.width;
+    default: return record.rect.height;
+    }
+}
+
+struct IndexEntry
+{
+    int ID;
+    unsigned int numOfRecords;
+    unsigned long long int offset;
+    unsigned int size;
+    long long int timeBeg;
+    long long int timeEnd;
+};
+
+}
+
+namespace zsfo
+{
+
+class TrajectoryFileWriter::Impl
+{
+public:
+    Impl(void) : file(0), offset(0) {};
+    ~Impl(void) {close();};
+    bool open(const string& path);
+    bool isOpen(void) const {return file != 0;};
+    void write(int ID, const vector<TrajectoryRecord>& records);
+    void close(void);
+
+private:
+    FILE* file;
+    unsigned long long int offset;
+    vector<IndexEntry> index;
+    vector<unsigned char> columns[numOfColumns];
+    vector<unsigned char> buffer;
+};
+
+bool TrajectoryFileWriter::Impl::open(const string& path)
+{
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    buffer.clear();
+    buffer.insert(buffer.end(), fileMagic, fileMagic + 4);
+    putUInt32(buffer, fileVersion);
+    putUInt32(buffer, 0);
+    putUInt32(buffer, 0);
+    fwrite(&buffer[0], 1, buffer.size(), file);
+    offset = buffer.size();
+    index.clear();
+    return true;
+}
+
+void TrajectoryFileWriter::Impl::write(int ID, const vector<TrajectoryRecord>& records)
+{
+    if (!file || records.empty())
+        return;
+
+    int numOfRecords = records.size();
+    for (int k = 0; k < numOfColumns; k++)
+    {
+        columns[k].clear();
+        long long int prevVal = 0;
+        for (int i = 0; i < numOfRecords; i++)
+        {
+            long long int currVal = getColumnValue(records[i], k);
+            putVarint(columns[k], currVal - prevVal);
+            prevVal = currVal;
+        }
+    }
+
+    // 数据块先写每一列的字节数, 再依次写各列
+    buffer.clear();
+    for (int k = 0; k < numOfColumns; k++)
+        putUInt32(buffer, columns[k].size());
+    for (int k = 0; k < numOfColumns; k++)
+        buffer.insert(buffer.end(), columns[k].begin(), columns[k].end());
+    fwrite(&buffer[0], 1, buffer.size(), file);
+
+    IndexEntry entry;
+    entry.ID = ID;
+    entry.numOfRecords = numOfRecords;
+    entry.offset = offset;
+    entry.size = buffer.size();
+    entry.timeBeg = records.front().time;
+    entry.timeEnd = records.back().time;
+    index.push_back(entry);
+    offset += buffer.size();
+}
+
+void TrajectoryFileWriter::Impl::close(void)
+{
+    if (!file)
+        return;
+
+    buffer.clear();
+    int numOfObjects = index.size();
+    for (int i = 0; i < numOfObjects; i++)
+    {
+        putUInt32(buffer, (unsigned int)index[i].ID);
+        putUInt32(buffer, index[i].numOfRecords);
+        putUInt64(buffer, index[i].offset);
+        putUInt32(buffer, index[i].size);
+        putUInt64(buffer, (unsigned long long int)index[i].timeBeg);
+        putUInt64(buffer, (unsigned long long int)index[i].timeEnd);
+    }
+    putUInt64(buffer, offset);
+    putUInt32(buffer, numOfObjects);
+    buffer.insert(buffer.end(), footerMagic, footerMagic + 4);
+    fwrite(&buffer[0], 1, buffer.size(), file);
+    fclose(file);
+    file = 0;
+    index.clear();
+}
+
+TrajectoryFileWriter::TrajectoryFileWriter(void)
+{
+    ptrImpl = new Impl;
+}
+
+TrajectoryFileWriter::~TrajectoryFileWriter(void)
+{
+    ptrImpl->close();
+}
+
+bool TrajectoryFileWriter::open(const string& path)
+{
+    return ptrImpl->open(path);
+}
+
+void TrajectoryFileWriter::write(int ID, const vector<ObjectRecord>& history)
+{
+    if (!ptrImpl->isOpen())
+        return;
+
+    int size = history.size();
+    vector<TrajectoryRecord> records(size);
+    for (int i = 0; i < size; i++)
+    {
+        records[i].time = history[i].time;
+        records[i].number = history[i].number;
+        records[i].rect = history[i].normRect;
+    }
+    ptrImpl->write(ID, records);
+}
+
+void TrajectoryFileWriter::write(int ID, const vector<TrajectoryRecord>& records)
+{
+    ptrImpl->write(ID, records);
+}
+
+void TrajectoryFileWriter::close(void)
+{
+    ptrImpl->close();
+}
+
+class TrajectoryFileReader::Impl
+{
+public:
+    Impl(void);
+    ~Impl(void) {close();};
+    bool open(const string& path);
+    void close(void);
+    //! 第 entryIndex 个目标的索引项, entryIndex 越界时抛出异常
+    const unsigned char* getEntry(int entryIndex) const;
+
+    const unsigned char* data;
+    unsigned long long int dataSize;
+    int numOfObjects;
+    const unsigned char* index;
+
+private:
+#if WIN32 || _WIN32
+    HANDLE fileHandle;
+    HANDLE mapHandle;
+#else
+    int fileHandle;
+#endif
+};
+
+TrajectoryFileReader::Impl::Impl(void)
+    : data(0), dataSize(0), numOfObjects(0), index(0)
+{
+#if WIN32 || _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mapHandle = 0;
+#else
+    fileHandle = -1;
+#endif
+}
+
+bool TrajectoryFileReader::Impl::open(const string& path)
+{
+    close();
+
+#if WIN32 || _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < headerSize + footerSize)
+    {
+        close();
+        return false;
+    }
+    dataSize = fileSize.QuadPart;
+    mapHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+    if (!mapHandle)
+    {
+        close();
+        return false;
+    }
+    data = (const unsigned char*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+    fileHandle = ::open(path.c_str(), O_RDONLY);
+    if (fileHandle < 0)
+        return false;
+    struct stat fileStat;
+    if (fstat(fileHandle, &fileStat) != 0 || fileStat.st_size < headerSize + footerSize)
+    {
+        close();
+        return false;
+    }
+    dataSize = fileStat.st_size;
+    void* ptr = mmap(0, dataSize, PROT_READ, MAP_SHARED, fileHandle, 0);
+    data = (ptr == MAP_FAILED) ? 0 : (const unsigned char*)ptr;
+#endif
+    if (!data)
+    {
+        close();
+        return false;
+    }
+
+    // 检查文件头和文件尾, 定位索引
+    const unsigned char* footer = data + dataSize - footerSize;
+    if (memcmp(data, fileMagic, 4) != 0 || getUInt32(data + 4) != fileVersion ||
+        memcmp(footer + 12, footerMagic, 4) != 0)
+    {
+        close();
+        return false;
+    }
+    unsigned long long int indexOffset = getUInt64(footer);
+    unsigned long long int count = getUInt32(footer + 8);
+    if (indexOffset < headerSize || indexOffset > dataSize - footerSize ||
+        count != (dataSize - footerSize - indexOffset) / indexEntrySize ||
+        indexOffset + count * indexEntrySize + footerSize != dataSize)
+    {
+        close();
+        return false;
+    }
+    numOfObjects = (int)count;
+    index = data + indexOffset;
+
+    // 检查每个目标的数据块都在索引之前, 各列长度之和等于数据块长度,
+    // 每条记录在每一列中至少占一个字节, 记录数量不会超过列的字节数
+    for (int i = 0; i < numOfObjects; i++)
+    {
+        const unsigned char* entry = index + i * indexEntrySize;
+        unsigned long long int numOfRecords = getUInt32(entry + 4);
+        unsigned long long int blockOffset = getUInt64(entry + 8);
+        unsigned long long int blockSize = getUInt32(entry + 16);
+        bool isValid = blockOffset >= headerSize && blockOffset <= indexOffset &&
+            blockSize >= 4 * numOfColumns && blockSize <= indexOffset - blockOffset;
+        unsigned long long int sumOfColumnSizes = 4 * numOfColumns;
+        for (int k = 0; isValid && k < numOfColumns; k++)
+        {
+            unsigned long long int columnSize = getUInt32(data + blockOffset + 4 * k);
+            sumOfColumnSizes += columnSize;
+            isValid = numOfRecords <= columnSize;
+        }
+        if (!isValid || sumOfColumnSizes != blockSize)
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void TrajectoryFileReader::Impl::close(void)
+{
+#if WIN32 || _WIN32
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapHandle)
+        CloseHandle(mapHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+    mapHandle = 0;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (data)
+        munmap((void*)data, dataSize);
+    if (fileHandle >= 0)
+        ::close(fileHandle);
+    fileHandle = -1;
+#endif
+    data = 0;
+    dataSize = 0;
+    numOfObjects = 0;
+    index = 0;
+}
+
+TrajectoryFileReader::RecordIterator::RecordIterator(void)
+    : numOfRemain(0)
+{
+    for (int k = 0; k < NumOfColumns; k++)
+    {
+        cursors[k] = 0;
+        ends[k] = 0;
+        prevVals[k] = 0;
+    }
+}
+
+bool TrajectoryFileReader::RecordIterator::next(TrajectoryRecord& record)
+{
+    if (numOfRemain <= 0)
+        return false;
+
+    for (int k = 0; k < NumOfColumns; k++)
+    {
+        long long int diff;
+        if (!getVarint(cursors[k], ends[k], diff))
+        {
+            numOfRemain = 0;
+            return false;
+        }
+        prevVals[k] += diff;
+    }
+    record.number = prevVals[0];
+    record.time = prevVals[1];
+    record.rect = Rect(prevVals[2], prevVals[3], prevVals[4], prevVals[5]);
+    --numOfRemain;
+    return true;
+}
+
+TrajectoryFileReader::TrajectoryFileReader(void)
+{
+    ptrImpl = new Impl;
+}
+
+TrajectoryFileReader::~TrajectoryFileReader(void)
+{
+    ptrImpl->close();
+}
+
+bool TrajectoryFileReader::open(const string& path)
+{
+    return ptrImpl->open(path);
+}
+
+void TrajectoryFileReader::close(void)
+{
+    ptrImpl->close();
+}
+
+int TrajectoryFileReader::getNumOfObjects(void) const
+{
+    return ptrImpl->numOfObjects;
+}
+
+const unsigned char* TrajectoryFileReader::Impl::getEntry(int entryIndex) const
+{
+    if (entryIndex < 0 || entryIndex >= numOfObjects)
+        THROW_EXCEPT("object index out of range");
+    return index + entryIndex * indexEntrySize;
+}
+
+int TrajectoryFileReader::getObjectID(int index) const
+{
+    return (int)getUInt32(ptrImpl->getEntry(index));
+}
+
+int TrajectoryFileReader::getNumOfRecords(int index) const
+{
+    return (int)getUInt32(ptrImpl->getEntry(index) + 4);
+}
+
+pair<long long int, long long int> TrajectoryFileReader::getTimeBegAndEnd(int index) const
+{
+    const unsigned char* entry = ptrImpl->getEntry(index);
+    return make_pair((long long int)getUInt64(entry + 20), (long long int)getUInt64(entry + 28));
+}
+
+void TrajectoryFileReader::getRecordIterator(int index, RecordIterator& itr) const
+{
+    // 数据块的位置和各列长度已经在 open 中检查过
+    const unsigned char* entry = ptrImpl->getEntry(index);
+    const unsigned char* block = ptrImpl->data + getUInt64(entry + 8);
+    const unsigned char* column = block + 4 * numOfColumns;
+    for (int k = 0; k < numOfColumns; k++)
+    {
+        itr.cursors[k] = column;
+        column += getUInt32(block + 4 * k);
+        itr.ends[k] = column;
+        itr.prevVals[k] = 0;
+    }
+    itr.numOfRemain = getUInt32(entry + 4);
+}
+
+void TrajectoryFileReader::getRecords(int index, vector<TrajectoryRecord>& records) const
+{
+    RecordIterator itr;
+    getRecordIterator(index, itr);
+    int size = itr.remain();
+    records.resize(size);
+    int count = 0;
+    while (count < size && itr.next(records[count]))
+        count++;
+    // 数据损坏时只保留成功解码的记录
+    records.resize(count);
+}
+
+}
+
+namespace
+{
+
+bool convertTrajectories(fstream& textFile, zsfo::TrajectoryFileWriter& writer)
+{
+    // 每个目标: "xxx Count: n", "ID: n", "Size: n", 列标题, 然后是 Size 行记录
+    string line;
+    vector<zsfo::TrajectoryRecord> records;
+    while (getline(textFile, line))
+    {
+        if (line.find("Count:") == string::npos)
+            continue;
+
+        int ID = 0, size = 0;
+        string label;
+        if (!getline(textFile, line))
+            return false;
+        istringstream IDStrm(line);
+        IDStrm >> label >> ID;
+        if (!getline(textFile, line))
+            return false;
+        istringstream sizeStrm(line);
+        sizeStrm >> label >> size;
+        if (!getline(textFile, line) || size < 0)
+            return false;
+
+        records.resize(size);
+        for (int i = 0; i < size; i++)
+        {
+            if (!getline(textFile, line))
+                return false;
+            istringstream strm(line);
+            zsfo::TrajectoryRecord& record = records[i];
+            if (!(strm >> record.number >> record.time >> record.rect.x >> record.rect.y 
+                       >> record.rect.width >> record.rect.height))
+                return false;
+        }
+        writer.write(ID, records);
+    }
+    return true;
+}
+
+}
+
+namespace zsfo
+{
+
+bool convertTrajectoryTextToBinary(const string& textPath, const string& binaryPath)
+{
+    fstream textFile;
+    ztool::FileStreamScopeGuard<fstream> guard(textFile);
+    textFile.open(textPath.c_str(), ios::in);
+    if (!textFile.is_open())
+        return false;
+
+    TrajectoryFileWriter writer;
+    if (!writer.open(binaryPath))
+        return false;
+    bool success = convertTrajectories(textFile, writer);
+    writer.close();
+    // 文本格式错误时删除已经写了一部分的二进制文件, 不留下看起来完整的文件
+    if (!success)
+        remove(binaryPath.c_str());
+    return success;
+}
+
+}
@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <opencv2/core/core.hpp>
+#include "ExportControl.h"
+#include "BlobTracker.h"
+
+namespace zsfo
+{
+
+//! 二进制轨迹文件中的一条记录
+struct TrajectoryRecord
+{
+    //! 构造函数
+    TrajectoryRecord(void) : time(0), number(0) {};
+
+    long long int time;        ///< 时间戳
+    int number;                ///< 帧编号
+    cv::Rect rect;             ///< 归一化帧中的矩形
+};
+
+//! 二进制轨迹文件写入类
+/*!
+    文件结构: 文件头, 各个目标的数据块, 目标索引, 文件尾.
+    每个目标的数据块按列存储帧编号, 时间戳, x, y, w, h 六列,
+    每列存储与前一条记录的差值, 差值经过 zigzag 变换后用变长整数编码.
+    目标索引记录每个目标的编号, 记录数量, 起止时间戳和数据块的位置,
+    文件尾记录索引的位置, 读取时不需要扫描整个文件.
+ */
+class Z_LIB_EXPORT TrajectoryFileWriter
+{
+public:
+    //! 构造函数
+    TrajectoryFileWriter(void);
+    //! 析构函数, 如果文件没有关闭, 会写入索引并关闭
+    ~TrajectoryFileWriter(void);
+    //! 新建文件
+    /*!
+        \param[in] path 文件全路径
+        \return 成功返回 true
+     */
+    bool open(const std::string& path);
+    //! 写入一个目标的历史轨迹
+    void write(int ID, const std::vector<ObjectRecord>& history);
+    //! 写入一个目标的历史轨迹
+    void write(int ID, const std::vector<TrajectoryRecord>& records);
+    //! 写入索引和文件尾, 关闭文件
+    void close(void);
+
+private:
+    TrajectoryFileWriter(const TrajectoryFileWriter&);
+    TrajectoryFileWriter& operator=(const TrajectoryFileWriter&);
+
+    class Impl;
+    cv::Ptr<Impl> ptrImpl;
+};
+
+//! 二进制轨迹文件读取类
+/*!
+    用内存映射方式打开文件, 通过索引直接定位目标, 按记录顺序解码, 不需要解析文本
+ */
+class Z_LIB_EXPORT TrajectoryFileReader
+{
+public:
+    //! 单个目标的记录迭代器
+    class Z_LIB_EXPORT RecordIterator
+    {
+    public:
+        //! 构造函数
+        RecordIterator(void);
+        //! 取出下一条记录
+        /*!
+            \param[out] record 下一条记录
+            \return 还有记录返回 true, 所有记录都已取出或者数据损坏无法解码返回 false
+         */
+        bool next(TrajectoryRecord& record);
+        //! 剩余的记录数量
+        int remain(void) const {return numOfRemain;};
+
+    private:
+        friend class TrajectoryFileReader;
+        enum {NumOfColumns = 6};
+        const unsigned char* cursors[NumOfColumns];
+        const unsigned char* ends[NumOfColumns];
+        long long int prevVals[NumOfColumns];
+        int numOfRemain;
+    };
+
+    //! 构造函数
+    TrajectoryFileReader(void);
+    //! 析构函数
+    ~TrajectoryFileReader(void);
+    //! 打开文件
+    /*!
+        会检查索引和每个目标数据块的位置, 长度都在文件范围之内
+        \param[in] path 文件全路径
+        \return 成功打开并且文件格式正确返回 true
+     */
+    bool open(const std::string& path);
+    //! 关闭文件
+    void close(void);
+    //! 文件中的目标数量
+    int getNumOfObjects(void) const;
+    //! 第 index 个目标的编号, 以下按 index 访问的函数在 index 越界时都会抛出异常
+    int getObjectID(int index) const;
+    //! 第 index 个目标的记录数量
+    int getNumOfRecords(int index) const;
+    //! 第 index 个目标的起始和结束时间戳
+    std::pair<long long int, long long int> getTimeBegAndEnd(int index) const;
+    //! 获取第 index 个目标的记录迭代器
+    void getRecordIterator(int index, RecordIterator& itr) const;
+    //! 解码第 index 个目标的所有记录, 数据损坏时只输出成功解码的记录
+    void getRecords(int index, std::vector<TrajectoryRecord>& records) const;
+
+private:
+    TrajectoryFileReader(const TrajectoryFileReader&);
+    TrajectoryFileReader& operator=(const TrajectoryFileReader&);
+
+    class Impl;
+    cv::Ptr<Impl> ptrImpl;
+};
+
+//! 将文本格式的历史轨迹文件转换成二进制轨迹文件
+/*!
+    文本格式为 ObjectInfoParser 和 OutputInfoParser 输出的格式,
+    每个目标以 "xxx Count:", "ID:", "Size:" 和列标题开始, 后面是 Size 行记录
+    \param[in] textPath 文本格式的历史轨迹文件
+    \param[in] binaryPath 输出的二进制轨迹文件
+    \return 转换成功返回 true, 文件无法打开或者格式错误返回 false, 格式错误时不保留输出文件
+ */
+Z_LIB_EXPORT bool convertTrajectoryTextToBinary(const std::string& textPath, const std::string& binaryPath);
+
+}
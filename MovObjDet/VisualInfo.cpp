@@ -8,6 +8,7 @@
 
 #include "VisualInfo.h"
 #include "ExtendedMog.h"
+#include "StageProfiler.h"
 #include "CompileControl.h"
 #include "OperateData.h"
 #include "ShowData.h"
@@ -112,6 +113,7 @@ void VisualInfo::init(const Mat& image)
     // 初始化背景模型
     backModel = new Mog;
     backModel->init(image);
+    relearnCount = 0;
 }
 
 void VisualInfo::update(const Mat& image, 
@@ -138,15 +140,25 @@ void VisualInfo::update(const Mat& image, Mat& foreImage, Mat& backImage,
 void VisualInfo::update(const Mat& image, Mat& foreImage, Mat& backImage, Mat& gradDiffImage, 
     bool fullUpdate, const vector<Rect>& rectsNoUpdate)
 {
+    // 重新学习期间背景变化大, 每帧都完全更新背景模型
+    if (relearnCount > 0)
+    {
+        fullUpdate = true;
+        relearnCount--;
+    }
     // 更新背景模型
-    if (fullUpdate)
-        backModel->update(image, foreImage, backImage, rectsNoUpdate);
-    else
     {
-        vector<Rect> rects(1);
-        rects[0] = Rect(0, 0, width, height);
-        backModel->update(image, foreImage, backImage, rects);
+        StageTimer timer(stageProfiler, ProcStage::Mog);
+        if (fullUpdate)
+            backModel->update(image, foreImage, backImage, rectsNoUpdate);
+        else
+        {
+            vector<Rect> rects(1);
+            rects[0] = Rect(0, 0, width, height);
+            backModel->update(image, foreImage, backImage, rects);
+        }
     }
+    StageTimer timer(stageProfiler, ProcStage::Gradient);
 #if CMPL_SHOW_IMAGE
     imshow("background image", backImage);
     imshow("foreground image", foreImage);
@@ -194,5 +206,16 @@ void VisualInfo::update(const Mat& image, Mat& foreImage, Mat& backImage, Mat& g
 #endif
 }
 
+void VisualInfo::relearn(int numOfFrames)
+{
+    backModel->relearn(numOfFrames);
+    relearnCount = numOfFrames;
+}
+
+void VisualInfo::setStageProfiler(const Ptr<StageProfiler>& profiler)
+{
+    stageProfiler = profiler;
+}
+
 }
 
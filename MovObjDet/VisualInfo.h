@@ -8,6 +8,7 @@ namespace zsfo
 {
 
 class Mog;
+class StageProfiler;
 //! 图像信息
 class Z_LIB_EXPORT VisualInfo
 {
@@ -37,9 +38,19 @@ public:
         const std::vector<cv::Rect>& rectsNoUpdate = std::vector<cv::Rect>());
     void update(const cv::Mat& image, cv::Mat& foreImage, cv::Mat& backImage, cv::Mat& gradDiffImage, 
         bool fullUpdate = true, const std::vector<cv::Rect>& rectsNoUpdate = std::vector<cv::Rect>());
+    //! 快速重新学习背景模型
+    /*!
+        之后的 numOfFrames 次 update 忽略 fullUpdate 参数, 始终完全更新背景模型,
+        这期间背景模型的学习率临时增大, 结束后恢复原来的学习率
+        \param[in] numOfFrames 重新学习的帧数, 见 Mog::relearn
+     */
+    void relearn(int numOfFrames);
+    //! 设置分步骤耗时统计器, 混合高斯模型和梯度差值分别计时, 为空时不计时
+    void setStageProfiler(const cv::Ptr<StageProfiler>& profiler);
 
 private:
     cv::Ptr<Mog> backModel;        ///< 混合高斯模型进行背景建模
+    cv::Ptr<StageProfiler> stageProfiler;  ///< 分步骤耗时统计, 为空时不计时
     cv::Mat normGrayImage;         ///< 输入图片 image 对应的灰度图
     cv::Mat backGrayImage;         ///< backImage 对应的灰度图
     cv::Mat normGradImage;         ///< normGrayImage 的梯度图
@@ -47,6 +58,7 @@ private:
 
     int width;                     ///< 处理图片的宽度
     int height;                    ///< 处理图片的高度
+    int relearnCount;              ///< 剩余的需要完全更新背景模型的帧数
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,253 @@
+﻿#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "ProcVideo.h"
+#include "ActivityTimeline.h"
+#include "VideoFrameIndex.h"
+#include "VideoSplitter.h"
+#include "Exception.h"
+#include "Thread.h"
+
+using namespace std;
+using namespace cv;
+
+static const char* timelineFileExt = ".zat";
+static const char timelineFileTag[4] = {'Z', 'A', 'T', 'L'};
+static const int timelineFileVersion = 1;
+// 时间下采样间隔, 与 ActivityProfiler 的默认值一致
+static const int timelineFrameInterval = 3;
+// 量化后的活跃度不超过该值时认为场景空闲, 160x120 的图像共 300 个块, 对应不超过 2 个活跃块
+static const int maxIdleActivity = 2;
+
+static string getIntString(int val)
+{
+    stringstream strm;
+    strm << val;
+    return strm.str();
+}
+
+namespace
+{
+//! 分析一段视频的工作线程, 每个线程使用独立的 VideoCapture 和 ActivityProfiler
+struct TimelineWorker
+{
+    static void entry(void* ptrWorker);
+    void run(void);
+
+    const string* ptrVideoPath;
+    const zpv::VideoFrameIndex* ptrFrameIndex;
+    int begInc;                  ///< 起始帧(包含), 是 frameInterval 的整数倍
+    int endExc;                  ///< 结束帧(不包含)
+    int frameInterval;
+    unsigned char* ptrActivity;  ///< 第 begInc 帧对应的活跃度存储位置
+    string errorMessage;
+    ztool::Thread thread;
+};
+
+void TimelineWorker::entry(void* ptrWorker)
+{
+    ((TimelineWorker*)ptrWorker)->run();
+}
+
+void TimelineWorker::run(void)
+{
+    try
+    {
+        VideoCapture videoCap;
+        if (!videoCap.open(*ptrVideoPath))
+            THROW_EXCEPT("cannot open file " + *ptrVideoPath);
+        Mat frame;
+        if (!zpv::locateFrame(videoCap, *ptrVideoPath, begInc, ptrFrameIndex) || !videoCap.read(frame))
+            THROW_EXCEPT("cannot seek designated frame, frame count " + getIntString(begInc));
+
+        zvs::ActivityProfiler profiler;
+        profiler.init(frame, frameInterval);
+        for (int i = begInc + 1; i < endExc; i++)
+        {
+            // 不需要分析的帧只 grab
+            if (!profiler.needFrame())
+            {
+                if (!videoCap.grab())
+                    THROW_EXCEPT("cannot read designated frame, frame count " + getIntString(i));
+                profiler.skip();
+                continue;
+            }
+            if (!videoCap.read(frame))
+                THROW_EXCEPT("cannot read designated frame, frame count " + getIntString(i));
+            profiler.proc(frame);
+        }
+
+        const vector<double>& activity = profiler.getActivity();
+        int numOfSamples = activity.size();
+        for (int i = 0; i < numOfSamples; i++)
+            ptrActivity[i] = saturate_cast<unsigned char>(activity[i] * 255);
+    }
+    catch (const exception& e)
+    {
+        errorMessage = e.what();
+    }
+}
+}
+
+namespace zpv
+{
+
+string getActivityTimelinePath(const string& videoPath)
+{
+    return videoPath + timelineFileExt;
+}
+
+bool loadActivityTimeline(const string& videoPath, ActivityTimeline& timeline)
+{
+    long long int fileSize = getFileSize(videoPath);
+    if (fileSize < 0)
+        return false;
+
+    fstream file;
+    file.open(getActivityTimelinePath(videoPath).c_str(), ios::in | ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char tag[4];
+    int version = 0;
+    ActivityTimeline temp;
+    int numOfSamples = 0;
+    file.read(tag, sizeof(tag));
+    file.read((char*)&version, sizeof(version));
+    if (!file || memcmp(tag, timelineFileTag, sizeof(tag)) != 0 || version != timelineFileVersion)
+        return false;
+    file.read((char*)&temp.fileSize, sizeof(temp.fileSize));
+    file.read((char*)&temp.frameInterval, sizeof(temp.frameInterval));
+    file.read((char*)&numOfSamples, sizeof(numOfSamples));
+    if (!file || temp.fileSize != fileSize || temp.frameInterval < 1 || numOfSamples < 1)
+        return false;
+    temp.activity.resize(numOfSamples);
+    file.read((char*)&temp.activity[0], numOfSamples);
+    if (!file)
+        return false;
+
+    timeline.fileSize = temp.fileSize;
+    timeline.frameInterval = temp.frameInterval;
+    timeline.activity.swap(temp.activity);
+    return true;
+}
+
+bool saveActivityTimeline(const string& videoPath, const ActivityTimeline& timeline)
+{
+    if (timeline.activity.empty())
+        return false;
+
+    string path = getActivityTimelinePath(videoPath);
+    string tempPath = getTempFilePath(path);
+    fstream file;
+    file.open(tempPath.c_str(), ios::out | ios::binary);
+    if (!file.is_open())
+        return false;
+
+    int numOfSamples = timeline.activity.size();
+    file.write(timelineFileTag, sizeof(timelineFileTag));
+    file.write((const char*)&timelineFileVersion, sizeof(timelineFileVersion));
+    file.write((const char*)&timeline.fileSize, sizeof(timeline.fileSize));
+    file.write((const char*)&timeline.frameInterval, sizeof(timeline.frameInterval));
+    file.write((const char*)&numOfSamples, sizeof(numOfSamples));
+    file.write((const char*)&timeline.activity[0], numOfSamples);
+    bool success = !file.fail();
+    file.close();
+    if (!success)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return replaceWithTempFile(tempPath, path);
+}
+
+void buildActivityTimeline(const string& videoPath, ActivityTimeline& timeline, int numOfThreads)
+{
+    VideoFrameIndex frameIndex;
+    probeFrameIndex(videoPath, frameIndex);
+    int frameCount = frameIndex.frameCount;
+    int interval = timelineFrameInterval;
+
+    // 每段的起点是采样间隔的整数倍, 各段的活跃度可以直接拼接
+    if (numOfThreads <= 0)
+        numOfThreads = getNumberOfCPUs();
+    int numOfSamples = (frameCount + interval - 1) / interval;
+    int numOfSamplesPerChunk = (numOfSamples + numOfThreads - 1) / numOfThreads;
+    if (numOfSamplesPerChunk < 1)
+        numOfSamplesPerChunk = 1;
+    int numOfChunks = (numOfSamples + numOfSamplesPerChunk - 1) / numOfSamplesPerChunk;
+
+    ActivityTimeline temp;
+    temp.fileSize = frameIndex.fileSize;
+    temp.frameInterval = interval;
+    temp.activity.resize(numOfSamples);
+    vector<Ptr<TimelineWorker> > workers(numOfChunks);
+    for (int i = 0; i < numOfChunks; i++)
+    {
+        workers[i] = new TimelineWorker;
+        workers[i]->ptrVideoPath = &videoPath;
+        workers[i]->ptrFrameIndex = &frameIndex;
+        workers[i]->begInc = i * numOfSamplesPerChunk * interval;
+        workers[i]->endExc = min((i + 1) * numOfSamplesPerChunk * interval, frameCount);
+        workers[i]->frameInterval = interval;
+        workers[i]->ptrActivity = &temp.activity[i * numOfSamplesPerChunk];
+    }
+    // 线程启动失败时由调用者线程分析该段
+    for (int i = 1; i < numOfChunks; i++)
+    {
+        if (!workers[i]->thread.start(TimelineWorker::entry, (TimelineWorker*)workers[i]))
+            workers[i]->run();
+    }
+    workers[0]->run();
+    for (int i = 1; i < numOfChunks; i++)
+        workers[i]->thread.join();
+    for (int i = 0; i < numOfChunks; i++)
+    {
+        if (!workers[i]->errorMessage.empty())
+            THROW_EXCEPT(workers[i]->errorMessage);
+    }
+
+    timeline.fileSize = temp.fileSize;
+    timeline.frameInterval = temp.frameInterval;
+    timeline.activity.swap(temp.activity);
+}
+
+void findIdleSpans(const ActivityTimeline& timeline, int minSpanFrameCount, int marginFrameCount,
+    vector<pair<int, int> >& idleSpans)
+{
+    idleSpans.clear();
+    int numOfSamples = timeline.activity.size();
+    int interval = timeline.frameInterval;
+    if (minSpanFrameCount < 1)
+        minSpanFrameCount = 1;
+    if (marginFrameCount < 0)
+        marginFrameCount = 0;
+
+    int begIndex = -1;
+    for (int i = 0; i <= numOfSamples; i++)
+    {
+        bool isIdle = i < numOfSamples && timeline.activity[i] <= maxIdleActivity;
+        if (isIdle && begIndex < 0)
+            begIndex = i;
+        else if (!isIdle && begIndex >= 0)
+        {
+            // 第 begIndex 到第 i - 1 个采样空闲, 覆盖的帧从 begIndex * interval 到 i * interval - 1
+            int begInc = begIndex * interval + marginFrameCount;
+            int endInc = i * interval - 1 - marginFrameCount;
+            if (endInc - begInc + 1 >= minSpanFrameCount)
+                idleSpans.push_back(make_pair(begInc, endInc));
+            begIndex = -1;
+        }
+    }
+}
+
+bool createActivityTimeline(const string& videoPath, int numOfThreads)
+{
+    ActivityTimeline timeline;
+    buildActivityTimeline(videoPath, timeline, numOfThreads);
+    return saveActivityTimeline(videoPath, timeline);
+}
+
+}
@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace zpv
+{
+
+//! 视频的场景活跃度时间线
+/*!
+    由 zvs::ActivityProfiler 对整个视频分析得到, 每 frameInterval 帧记录一个活跃度,
+    活跃度是活跃块占全部块的比例, 量化到 0 到 255 保存.
+    时间线保存在视频文件旁边的同名 .zat 文件中, 视频文件大小变化后需要重新建立.
+ */
+struct ActivityTimeline
+{
+    //! 构造函数
+    ActivityTimeline(void) : fileSize(0), frameInterval(1) {};
+
+    long long int fileSize;               ///< 建立时间线时视频文件的字节数
+    int frameInterval;                    ///< 相邻两个活跃度记录之间的帧数
+    std::vector<unsigned char> activity;  ///< 第 i 项是第 i * frameInterval 帧的活跃度
+};
+
+//! 活跃度时间线文件的全路径
+std::string getActivityTimelinePath(const std::string& videoPath);
+
+//! 读取活跃度时间线文件, 文件存在, 格式正确并且与视频文件大小一致时返回 true
+bool loadActivityTimeline(const std::string& videoPath, ActivityTimeline& timeline);
+
+//! 保存活跃度时间线文件
+bool saveActivityTimeline(const std::string& videoPath, const ActivityTimeline& timeline);
+
+//! 分析整个视频建立活跃度时间线
+/*!
+    视频按帧数分成若干段, 每个线程使用独立的 VideoCapture 和 ActivityProfiler 分析一段.
+    可能会抛出 std::exception 类型的异常
+    \param[in] videoPath 视频文件全路径
+    \param[out] timeline 活跃度时间线
+    \param[in] numOfThreads 线程数量, 小于等于 0 时等于 CPU 核数
+ */
+void buildActivityTimeline(const std::string& videoPath, ActivityTimeline& timeline, int numOfThreads = 0);
+
+//! 在时间线中寻找空闲区间
+/*!
+    活跃度连续低于阈值的区间两端各收缩 marginFrameCount 帧, 长度不小于 minSpanFrameCount 帧的区间为空闲区间.
+    \param[in] timeline 活跃度时间线
+    \param[in] minSpanFrameCount 空闲区间的最小帧数
+    \param[in] marginFrameCount 区间两端收缩的帧数, 保证目标进入和离开场景的帧仍然正常检测
+    \param[out] idleSpans 空闲区间的起始帧(包含)和结束帧(包含), 按帧编号升序排列
+ */
+void findIdleSpans(const ActivityTimeline& timeline, int minSpanFrameCount, int marginFrameCount,
+    std::vector<std::pair<int, int> >& idleSpans);
+
+//! 按帧编号递增的顺序查询帧是否处于空闲区间
+class IdleSpanCursor
+{
+public:
+    IdleSpanCursor(void) : ptrSpans(0), index(0) {};
+    //! 设置空闲区间, 区间的生命周期由调用者保证
+    void init(const std::vector<std::pair<int, int> >* ptrIdleSpans)
+    {
+        ptrSpans = ptrIdleSpans;
+        index = 0;
+    };
+    //! 帧编号为 number 的帧是否处于空闲区间, 连续调用时 number 不能减小
+    bool isIdle(int number)
+    {
+        if (!ptrSpans)
+            return false;
+        int size = ptrSpans->size();
+        while (index < size && (*ptrSpans)[index].second < number)
+            index++;
+        return index < size && (*ptrSpans)[index].first <= number;
+    };
+
+private:
+    const std::vector<std::pair<int, int> >* ptrSpans;
+    int index;
+};
+
+}
@@ -0,0 +1,563 @@
+﻿#if WIN32 || _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#   include <io.h>
+#   include <process.h>
+#else
+#   include <dirent.h>
+#   include <unistd.h>
+#   include <signal.h>
+#   include <errno.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <deque>
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+#include "ProcVideo.h"
+#include "ConfigFileReader.h"
+#include "CreateDirectory.h"
+#include "Exception.h"
+#include "Thread.h"
+
+using namespace std;
+
+static const char* jobFileExt = ".job";
+static const char* errorFileExt = ".error";
+static const char* runningFileExt = ".running";
+static const char* runningDirName = "running";
+static const char* doneDirName = "done";
+static const char* failedDirName = "failed";
+
+static string joinPath(const string& dir, const string& name)
+{
+    if (dir.empty() || dir[dir.size() - 1] == '/' || dir[dir.size() - 1] == '\\')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+//! 列出目录下扩展名为 ext 的文件名, 按文件名排序, 先提交的任务通常先处理
+static void listFiles(const string& dir, const string& ext, vector<string>& names)
+{
+    names.clear();
+#if WIN32 || _WIN32
+    _finddata_t data;
+    intptr_t handle = _findfirst(joinPath(dir, "*" + ext).c_str(), &data);
+    if (handle == -1)
+        return;
+    do
+    {
+        if (!(data.attrib & _A_SUBDIR))
+            names.push_back(data.name);
+    }
+    while (_findnext(handle, &data) == 0);
+    _findclose(handle);
+#else
+    DIR* ptrDir = opendir(dir.c_str());
+    if (!ptrDir)
+        return;
+    while (dirent* ptrEntry = readdir(ptrDir))
+    {
+        string name = ptrEntry->d_name;
+        if (name.size() > ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0)
+            names.push_back(name);
+    }
+    closedir(ptrDir);
+#endif
+    sort(names.begin(), names.end());
+}
+
+//! 移动文件, 目标文件存在时覆盖
+static bool moveFile(const string& src, const string& dst)
+{
+    if (rename(src.c_str(), dst.c_str()) == 0)
+        return true;
+    // Windows 下目标文件存在时改名失败
+    remove(dst.c_str());
+    return rename(src.c_str(), dst.c_str()) == 0;
+}
+
+static int getProcessID(void)
+{
+#if WIN32 || _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+static string getHostName(void)
+{
+#if WIN32 || _WIN32
+    char buf[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD size = sizeof(buf);
+    if (!GetComputerNameA(buf, &size))
+        return "localhost";
+    return string(buf, size);
+#else
+    char buf[256] = {0};
+    if (gethostname(buf, sizeof(buf) - 1) != 0 || buf[0] == 0)
+        return "localhost";
+    return buf;
+#endif
+}
+
+//! 判断本机上的进程是否仍在运行, 无法确定时按仍在运行处理
+static bool isProcessAlive(int processID)
+{
+#if WIN32 || _WIN32
+    HANDLE handle = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, processID);
+    if (!handle)
+        return GetLastError() != ERROR_INVALID_PARAMETER;
+    DWORD exitCode = 0;
+    bool alive = !GetExitCodeProcess(handle, &exitCode) || exitCode == STILL_ACTIVE;
+    CloseHandle(handle);
+    return alive;
+#else
+    return kill(processID, 0) == 0 || errno != ESRCH;
+#endif
+}
+
+//! running 子目录中的文件名, 由任务文件名和领取任务的主机名与进程号组成, 如 0001.job@host@1234.running
+static string makeRunningName(const string& name, const string& hostName, int processID)
+{
+    stringstream strm;
+    strm << name << "@" << hostName << "@" << processID << runningFileExt;
+    return strm.str();
+}
+
+//! 从 running 子目录中的文件名解析出任务文件名和领取任务的主机名与进程号, 任务文件名可以包含 @
+static bool parseRunningName(const string& runningName, string& name, string& hostName, int& processID)
+{
+    string ext = runningFileExt;
+    if (runningName.size() <= ext.size() ||
+        runningName.compare(runningName.size() - ext.size(), ext.size(), ext) != 0)
+        return false;
+    string str = runningName.substr(0, runningName.size() - ext.size());
+    size_t pidPos = str.rfind('@');
+    if (pidPos == string::npos || pidPos == 0)
+        return false;
+    size_t hostPos = str.rfind('@', pidPos - 1);
+    if (hostPos == string::npos || hostPos == 0)
+        return false;
+    string pidStr = str.substr(pidPos + 1);
+    if (pidStr.empty() || pidStr.find_first_not_of("0123456789") != string::npos)
+        return false;
+    name = str.substr(0, hostPos);
+    hostName = str.substr(hostPos + 1, pidPos - hostPos - 1);
+    processID = atoi(pidStr.c_str());
+    return true;
+}
+
+namespace
+{
+
+struct JobType
+{
+    enum
+    {
+        Zheng,
+        Taicang
+    };
+};
+
+//! 从任务描述文件读取的任务
+struct BatchJob
+{
+    int type;
+    zpv::TaskInfo task;
+    zpv::TaicangTaskInfo taicangTask;
+};
+
+void parseJob(const string& path, BatchJob& job)
+{
+    ztool::ConfigFileReader reader(path);
+    if (!reader.canBeOpened())
+        THROW_EXCEPT("cannot open file " + path);
+    if (!reader.read("[Task]"))
+        THROW_EXCEPT("cannot find label [Task] in file " + path);
+    reader.seek("");
+
+    string type;
+    reader.getSingleKeySingleVal("#type", type);
+    if (type.empty() || type == "Zheng")
+        job.type = JobType::Zheng;
+    else if (type == "Taicang")
+        job.type = JobType::Taicang;
+    else
+        THROW_EXCEPT("unknown task type " + type + " in file " + path);
+
+    string taskID, videoPath, videoSegmentID, saveImagePath, saveHistoryPath, historyFileName;
+    vector<int> frameCountBegAndEnd;
+    reader.getSingleKeySingleVal("#taskID", taskID);
+    reader.getSingleKeySingleVal("#videoPath", videoPath);
+    reader.getSingleKeySingleVal("#videoSegmentID", videoSegmentID);
+    reader.getSingleKeyMultiVal("#frameCountBegAndEnd", frameCountBegAndEnd);
+    reader.getSingleKeySingleVal("#saveImagePath", saveImagePath);
+    reader.getSingleKeySingleVal("#saveHistoryPath", saveHistoryPath);
+    reader.getSingleKeySingleVal("#historyFileName", historyFileName);
+    if (videoPath.empty())
+        THROW_EXCEPT("no video path in file " + path);
+    // 没有指定起止帧时处理整个视频
+    pair<int, int> begAndEnd(0, -1);
+    if (frameCountBegAndEnd.size() == 2)
+        begAndEnd = make_pair(frameCountBegAndEnd[0], frameCountBegAndEnd[1]);
+
+    if (job.type == JobType::Zheng)
+    {
+        zpv::TaskInfo& task = job.task;
+        task.taskID = taskID;
+        task.videoPath = videoPath;
+        task.videoSegmentID = videoSegmentID;
+        task.frameCountBegAndEnd = begAndEnd;
+        task.saveImagePath = saveImagePath;
+        task.saveHistoryPath = saveHistoryPath;
+        task.historyFileName = historyFileName;
+    }
+    else
+    {
+        zpv::TaicangTaskInfo& task = job.taicangTask;
+        task.taskID = taskID;
+        task.videoPath = videoPath;
+        task.videoSegmentID = videoSegmentID;
+        task.frameCountBegAndEnd = begAndEnd;
+        task.saveImagePath = saveImagePath;
+        task.saveHistoryPath = saveHistoryPath;
+        task.historyFileName = historyFileName;
+        reader.getSingleKeySingleVal("#caseName", task.caseName);
+        reader.getSingleKeySingleVal("#caseSetName", task.caseSetName);
+    }
+}
+
+//! 工作线程正在处理的任务
+struct RunningJob
+{
+    RunningJob(void) : begTick(0), progress(0), isExpired(false) {};
+    string name;               ///< 任务文件名, 为空表示没有正在处理的任务
+    string runningName;        ///< running 子目录中的文件名
+    long long int begTick;     ///< 领取任务的时刻
+    float progress;            ///< 任务的进度, 0 到 1
+    bool isExpired;            ///< 任务是否已经超时并记为失败
+};
+
+//! 所有工作线程共享的批处理状态
+struct BatchExecutor
+{
+    bool claimJob(int workerIndex, string& runningName);
+    void finishJob(int workerIndex, const string& errorMessage);
+    float updateProgress(int workerIndex, float jobProgressPercentage);
+    bool checkExpired(int workerIndex);
+    void expireTimedOutJobs(void);
+    void expireJob(RunningJob& job);
+    void moveToFailed(const string& runningName, const string& name, const string& errorMessage);
+
+    static void watchEntry(void* ptrExecutor);
+
+    const zpv::BatchConfigInfo* ptrConfig;
+    procVideoCallBack ptrCallBackFunc;
+    taicangProcVideoCallBack ptrTaicangCallBackFunc;
+    void* ptrUserData;
+    string runningDir, doneDir, failedDir;
+    string hostName;
+    int processID;
+
+    cv::Mutex callBackMtx;     ///< 保证同一时刻只有一个线程回调, 回调期间不持有 mtx
+    ztool::Semaphore stopWatch;  ///< 通知超时检查线程结束
+
+    cv::Mutex mtx;             ///< 保护以下成员
+    deque<string> pendingNames;
+    vector<RunningJob> runningJobs;  ///< 各个工作线程当前处理的任务
+    zpv::BatchStatus status;
+};
+
+//! 工作线程, 每次领取一个任务处理
+struct BatchWorker
+{
+    static void entry(void* ptrWorker);
+    void run(void);
+    void runJob(const string& runningName);
+    void checkTimeLimit(float progressPercentage);
+
+    static void callBack(float progressPercentage, const vector<zpv::ObjectInfo>& infos, void* ptrWorker);
+    static void taicangCallBack(float progressPercentage, const vector<zpv::TaicangObjectInfo>& infos, void* ptrWorker);
+
+    BatchExecutor* ptrExecutor;
+    int index;
+    ztool::Thread thread;
+};
+
+bool BatchExecutor::claimJob(int workerIndex, string& runningName)
+{
+    cv::AutoLock lock(mtx);
+    bool hasListed = false;
+    while (true)
+    {
+        // 本地列表取完后重新列出队列目录, 处理过程中新加入的任务也能领到,
+        // 重新列出后仍然领取不到任务时结束, 无法移动的文件不会导致死循环
+        if (pendingNames.empty())
+        {
+            if (hasListed)
+                return false;
+            hasListed = true;
+            vector<string> names;
+            listFiles(ptrConfig->queueDir, jobFileExt, names);
+            if (names.empty())
+                return false;
+            pendingNames.assign(names.begin(), names.end());
+        }
+        string name = pendingNames.front();
+        pendingNames.pop_front();
+        // 改名是原子操作, 失败说明任务已经被其他进程领取,
+        // 新文件名记录了领取任务的主机和进程, 重新启动时据此判断任务是否还有进程在处理
+        runningName = makeRunningName(name, hostName, processID);
+        if (rename(joinPath(ptrConfig->queueDir, name).c_str(), joinPath(runningDir, runningName).c_str()) == 0)
+        {
+            RunningJob& job = runningJobs[workerIndex];
+            job.name = name;
+            job.runningName = runningName;
+            job.begTick = cv::getTickCount();
+            job.progress = 0;
+            job.isExpired = false;
+            status.numOfJobs++;
+            return true;
+        }
+    }
+}
+
+void BatchExecutor::moveToFailed(const string& runningName, const string& name, const string& errorMessage)
+{
+    moveFile(joinPath(runningDir, runningName), joinPath(failedDir, name));
+    fstream file;
+    file.open(joinPath(failedDir, name + errorFileExt).c_str(), ios::out);
+    if (file.is_open())
+        file << errorMessage << "\n";
+}
+
+void BatchExecutor::finishJob(int workerIndex, const string& errorMessage)
+{
+    cv::AutoLock lock(mtx);
+    RunningJob& job = runningJobs[workerIndex];
+    // 超时的任务已经移动到 failed 子目录并计入失败数量
+    if (!job.isExpired)
+    {
+        if (errorMessage.empty())
+            moveFile(joinPath(runningDir, job.runningName), joinPath(doneDir, job.name));
+        else
+            moveToFailed(job.runningName, job.name, errorMessage);
+        errorMessage.empty() ? status.numOfSucceeded++ : status.numOfFailed++;
+    }
+    job = RunningJob();
+}
+
+float BatchExecutor::updateProgress(int workerIndex, float jobProgressPercentage)
+{
+    // 调用者已经加锁, 总任务数是已经领取的任务数加上本地列表中尚未领取的任务数
+    runningJobs[workerIndex].progress = min(max(jobProgressPercentage / 100, 0.0F), 1.0F);
+    float done = float(status.numOfSucceeded + status.numOfFailed);
+    for (int i = 0; i < runningJobs.size(); i++)
+    {
+        if (!runningJobs[i].isExpired)
+            done += runningJobs[i].progress;
+    }
+    int total = status.numOfJobs + pendingNames.size();
+    return total > 0 ? done / total * 100 : 100;
+}
+
+void BatchExecutor::expireJob(RunningJob& job)
+{
+    // 调用者已经加锁, 超过时限的任务立即记为失败, 不必等到处理线程返回
+    double maxJobTimeInSecond = ptrConfig->maxJobTimeInSecond;
+    if (maxJobTimeInSecond <= 0 || job.name.empty() || job.isExpired ||
+        double(cv::getTickCount() - job.begTick) / cv::getTickFrequency() <= maxJobTimeInSecond)
+        return;
+    job.isExpired = true;
+    moveToFailed(job.runningName, job.name, "job exceeds time limit");
+    status.numOfFailed++;
+}
+
+bool BatchExecutor::checkExpired(int workerIndex)
+{
+    cv::AutoLock lock(mtx);
+    expireJob(runningJobs[workerIndex]);
+    return runningJobs[workerIndex].isExpired;
+}
+
+void BatchExecutor::expireTimedOutJobs(void)
+{
+    cv::AutoLock lock(mtx);
+    for (int i = 0; i < runningJobs.size(); i++)
+        expireJob(runningJobs[i]);
+}
+
+void BatchExecutor::watchEntry(void* ptrExecutor)
+{
+    // 定期检查所有工作线程的任务, 长时间没有进度回调的任务也能按时记为失败
+    BatchExecutor* ptr = (BatchExecutor*)ptrExecutor;
+    int intervalInMilliSecond = int(min(max(ptr->ptrConfig->maxJobTimeInSecond * 100, 10.0), 1000.0));
+    while (!ptr->stopWatch.wait(intervalInMilliSecond))
+        ptr->expireTimedOutJobs();
+}
+
+void BatchWorker::entry(void* ptrWorker)
+{
+    ((BatchWorker*)ptrWorker)->run();
+}
+
+void BatchWorker::run(void)
+{
+    string runningName;
+    while (ptrExecutor->claimJob(index, runningName))
+        runJob(runningName);
+}
+
+void BatchWorker::runJob(const string& runningName)
+{
+    const zpv::BatchConfigInfo& config = *ptrExecutor->ptrConfig;
+    string errorMessage;
+    try
+    {
+        BatchJob job;
+        parseJob(joinPath(ptrExecutor->runningDir, runningName), job);
+        if (job.type == JobType::Zheng)
+        {
+            if (config.numOfThreadsPerJob > 1)
+                zpv::procVideoParallel(job.task, config.config, config.numOfThreadsPerJob, callBack, this);
+            else
+                zpv::procVideo(job.task, config.config, callBack, this);
+        }
+        else
+            zpv::procVideo(job.taicangTask, config.param, taicangCallBack, this);
+    }
+    catch (const exception& e)
+    {
+        errorMessage = e.what();
+        if (errorMessage.empty())
+            errorMessage = "unknown error";
+    }
+
+    // 超时后才返回的任务即使处理完毕也记为失败
+    ptrExecutor->checkExpired(index);
+    ptrExecutor->finishJob(index, errorMessage);
+}
+
+void BatchWorker::checkTimeLimit(float progressPercentage)
+{
+    // 超时的任务通过回调中抛出的异常中止, procVideo 会正常释放资源, 已经处理完毕的任务不再中止
+    if (progressPercentage < 100 && ptrExecutor->checkExpired(index))
+        THROW_EXCEPT("job exceeds time limit");
+}
+
+void BatchWorker::callBack(float progressPercentage, const vector<zpv::ObjectInfo>& infos, void* ptrWorker)
+{
+    BatchWorker* ptr = (BatchWorker*)ptrWorker;
+    ptr->checkTimeLimit(progressPercentage);
+    BatchExecutor& executor = *ptr->ptrExecutor;
+    // 先加回调锁再计算进度, 回调的进度按调用顺序递增, 用户回调期间其他线程仍然可以领取和完成任务
+    cv::AutoLock callBackLock(executor.callBackMtx);
+    float batchProgress;
+    {
+        cv::AutoLock lock(executor.mtx);
+        batchProgress = executor.updateProgress(ptr->index, progressPercentage);
+    }
+    if (executor.ptrCallBackFunc)
+        executor.ptrCallBackFunc(batchProgress, infos, executor.ptrUserData);
+}
+
+void BatchWorker::taicangCallBack(float progressPercentage, const vector<zpv::TaicangObjectInfo>& infos, void* ptrWorker)
+{
+    BatchWorker* ptr = (BatchWorker*)ptrWorker;
+    ptr->checkTimeLimit(progressPercentage);
+    BatchExecutor& executor = *ptr->ptrExecutor;
+    cv::AutoLock callBackLock(executor.callBackMtx);
+    float batchProgress;
+    {
+        cv::AutoLock lock(executor.mtx);
+        batchProgress = executor.updateProgress(ptr->index, progressPercentage);
+    }
+    if (executor.ptrTaicangCallBackFunc)
+        executor.ptrTaicangCallBackFunc(batchProgress, infos, executor.ptrUserData);
+}
+
+}
+
+namespace zpv
+{
+
+void procVideoBatch(const BatchConfigInfo& batchConfig, procVideoCallBack ptrCallBackFunc,
+    taicangProcVideoCallBack ptrTaicangCallBackFunc, void* ptrUserData, BatchStatus* ptrStatus)
+{
+    BatchExecutor executor;
+    executor.ptrConfig = &batchConfig;
+    executor.ptrCallBackFunc = ptrCallBackFunc;
+    executor.ptrTaicangCallBackFunc = ptrTaicangCallBackFunc;
+    executor.ptrUserData = ptrUserData;
+    executor.runningDir = joinPath(batchConfig.queueDir, runningDirName);
+    executor.doneDir = joinPath(batchConfig.queueDir, doneDirName);
+    executor.failedDir = joinPath(batchConfig.queueDir, failedDirName);
+    executor.hostName = getHostName();
+    executor.processID = getProcessID();
+    executor.status.numOfJobs = 0;
+    executor.status.numOfSucceeded = 0;
+    executor.status.numOfFailed = 0;
+    executor.status.numOfResumed = 0;
+
+    // 队列目录已经存在, 直接创建子目录, createDirectory 逐级创建时不能处理以 / 开头的绝对路径
+    ztool::createDirectoryBase(executor.runningDir);
+    ztool::createDirectoryBase(executor.doneDir);
+    ztool::createDirectoryBase(executor.failedDir);
+    if (ACCESS(executor.runningDir.c_str(), 0) != 0 || ACCESS(executor.doneDir.c_str(), 0) != 0 ||
+        ACCESS(executor.failedDir.c_str(), 0) != 0)
+        THROW_EXCEPT("cannot create sub directories in " + batchConfig.queueDir);
+
+    // 上次运行中断时正在处理的任务移回队列目录重新处理,
+    // 只回收本机上已经退出的进程领取的任务, 其他进程正在处理的任务和其他主机领取的任务保持不动.
+    // 本进程尚未领取任务, 进程号与本进程相同的文件只能来自已经退出的进程
+    vector<string> names;
+    listFiles(executor.runningDir, runningFileExt, names);
+    for (int i = 0; i < names.size(); i++)
+    {
+        string name, hostName;
+        int processID;
+        if (!parseRunningName(names[i], name, hostName, processID) || hostName != executor.hostName ||
+            (processID != executor.processID && isProcessAlive(processID)))
+            continue;
+        if (moveFile(joinPath(executor.runningDir, names[i]), joinPath(batchConfig.queueDir, name)))
+            executor.status.numOfResumed++;
+    }
+
+    int numOfThreadsPerJob = max(batchConfig.numOfThreadsPerJob, 1);
+    int numOfWorkers = batchConfig.numOfWorkers > 0 ?
+        batchConfig.numOfWorkers : max(cv::getNumberOfCPUs() / numOfThreadsPerJob, 1);
+    executor.runningJobs.assign(numOfWorkers, RunningJob());
+    vector<cv::Ptr<BatchWorker> > workers(numOfWorkers);
+    for (int i = 0; i < numOfWorkers; i++)
+    {
+        workers[i] = new BatchWorker;
+        workers[i]->ptrExecutor = &executor;
+        workers[i]->index = i;
+    }
+    // 超时检查线程启动失败时仍然在进度回调和任务返回时检查时限
+    ztool::Thread watchThread;
+    if (batchConfig.maxJobTimeInSecond > 0)
+        watchThread.start(BatchExecutor::watchEntry, &executor);
+    // 调用者线程作为第一个工作线程, 其他线程启动失败时由其余线程处理全部任务
+    for (int i = 1; i < numOfWorkers; i++)
+        workers[i]->thread.start(BatchWorker::entry, (BatchWorker*)workers[i]);
+    workers[0]->run();
+    for (int i = 1; i < numOfWorkers; i++)
+        workers[i]->thread.join();
+    if (watchThread.joinable())
+    {
+        executor.stopWatch.post();
+        watchThread.join();
+    }
+
+    if (ptrStatus)
+        *ptrStatus = executor.status;
+}
+
+}
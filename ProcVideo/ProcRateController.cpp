@@ -0,0 +1,79 @@
+﻿#include <cmath>
+#include <algorithm>
+#include "ProcRateController.h"
+#include "BlobTracker.h"
+
+using namespace std;
+
+// 每处理这么多帧更新一次平均处理时间
+static const int numOfFramesPerBudgetWindow = 25;
+// 场景空闲超过这个时长之后才降低处理帧率, 以秒计算
+static const double idleHoldTimeInSecond = 1;
+
+namespace zpv
+{
+
+ProcRateController::ProcRateController(void)
+{
+    init(1, 1, 25, 0, 1);
+}
+
+void ProcRateController::init(int minProcEveryNFrame, int maxProcEveryNFrame, double fps, double cpuBudget, 
+    int updateBackInterval)
+{
+    minStep = max(1, minProcEveryNFrame);
+    maxStep = max(minStep, maxProcEveryNFrame - maxProcEveryNFrame % minStep);
+    currStep = minStep;
+    nextProcCount = minStep;
+    frameRate = fps > 0 ? fps : 25;
+    budget = cpuBudget;
+    idleFrameCount = 0;
+    idleHoldFrameCount = int(idleHoldTimeInSecond * frameRate + 0.5);
+    baseUpdateBackInterval = max(1, updateBackInterval);
+    avgProcTime = 0;
+    procTimer.clear();
+}
+
+void ProcRateController::endProc(int count, const zsfo::TrackingActivityInfo& info)
+{
+    procTimer.end();
+    if (procTimer.getCount() >= numOfFramesPerBudgetWindow)
+    {
+        avgProcTime = procTimer.getAvgTime();
+        procTimer.clear();
+    }
+
+    if (info.numOfBlobsNearRecord > 0)
+    {
+        currStep = minStep;
+        idleFrameCount = 0;
+    }
+    else if (info.numOfBlobs > 0)
+    {
+        currStep = min(currStep, min(minStep * 2, maxStep));
+        idleFrameCount = 0;
+    }
+    else
+    {
+        idleFrameCount += currStep;
+        if (idleFrameCount > idleHoldFrameCount)
+            currStep = min(currStep + minStep, maxStep);
+    }
+
+    // 处理时间 avgProcTime * frameRate / step 不能超过预算
+    if (budget > 0 && avgProcTime > 0)
+    {
+        int budgetStep = int(ceil(avgProcTime * frameRate / budget));
+        budgetStep = (budgetStep + minStep - 1) / minStep * minStep;
+        currStep = max(currStep, min(budgetStep, maxStep));
+    }
+
+    nextProcCount = count + currStep;
+}
+
+int ProcRateController::getUpdateBackInterval(void) const
+{
+    return max(1, int(double(baseUpdateBackInterval) * minStep / currStep + 0.5));
+}
+
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include "Timer.h"
+
+namespace zsfo
+{
+struct TrackingActivityInfo;
+}
+
+namespace zpv
+{
+
+//! 根据场景活跃程度和 CPU 预算调整处理帧率
+/*!
+    处理间隔总是 minProcEveryNFrame 的整数倍, 处理的帧都是按固定帧率处理时也会处理的帧.
+    有运动目标靠近抓拍线圈或线段时立即恢复最高处理帧率, 有运动目标但远离线圈时间隔不超过最小间隔的 2 倍,
+    场景空闲超过 1 秒后每处理一帧间隔增加一个最小间隔, 直到 maxProcEveryNFrame.
+    检测器的处理时间由 ztool::RepeatTimer 统计, 每处理 numOfFramesPerBudgetWindow 帧更新一次平均处理时间,
+    平均处理时间乘以处理帧率超过 CPU 预算时加大处理间隔, 预算优先于场景活跃程度.
+ */
+class ProcRateController
+{
+public:
+    ProcRateController(void);
+    //! 初始化
+    /*!
+        \param[in] minProcEveryNFrame 最小处理间隔, 即按固定帧率处理时的间隔
+        \param[in] maxProcEveryNFrame 最大处理间隔, 向下取整为 minProcEveryNFrame 的整数倍
+        \param[in] fps 视频帧率
+        \param[in] cpuBudget 处理时间占视频时长的比例上限, 小于等于 0 时不限制
+        \param[in] updateBackInterval 按最小处理间隔处理时完整更新背景模型的间隔
+     */
+    void init(int minProcEveryNFrame, int maxProcEveryNFrame, double fps, double cpuBudget, int updateBackInterval);
+    //! 第 count 帧是否需要处理, 连续调用时 count 不能减小
+    bool needProc(int count) const
+    {
+        return count >= nextProcCount && count % minStep == 0;
+    };
+    //! 开始处理一帧前调用
+    void beginProc(void)
+    {
+        procTimer.start();
+    };
+    //! 处理完第 count 帧后调用, 根据跟踪状态和处理时间计算下一个处理帧
+    void endProc(int count, const zsfo::TrackingActivityInfo& info);
+    //! 当前的处理间隔
+    int getProcEveryNFrame(void) const
+    {
+        return currStep;
+    };
+    //! 当前处理间隔下完整更新背景模型的间隔, 单位时间内完整更新的次数与按最小处理间隔处理时相同
+    int getUpdateBackInterval(void) const;
+
+private:
+    int minStep, maxStep, currStep;
+    int nextProcCount;
+    int idleFrameCount;            ///< 场景连续空闲的帧数
+    int idleHoldFrameCount;        ///< 场景连续空闲超过这个帧数后才开始降低处理帧率
+    int baseUpdateBackInterval;
+    double frameRate;
+    double budget;
+    double avgProcTime;            ///< 最近一个统计窗口内每帧的平均处理时间, 以秒计算
+    ztool::RepeatTimer procTimer;
+};
+
+}
@@ -1,10 +1,14 @@
 ﻿#include <climits>
+#include <cmath>
 #include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <string>
+#include <deque>
+#include <map>
+#include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -15,6 +19,14 @@
 #include "Exception.h"
 #include "CompileControl.h"
 #include "Date.h"
+#include "Thread.h"
+#include "SPSCQueue.h"
+#include "AsyncImageWriter.h"
+#include "BufferedTextWriter.h"
+#include "TrajectoryFile.h"
+#include "VideoFrameIndex.h"
+#include "ActivityTimeline.h"
+#include "ProcRateController.h"
 
 using namespace std;
 using namespace cv;
@@ -36,24 +48,74 @@ struct ObjectInfoParser
 {
     void init(const string& saveImageDir, const string& listFileName,
         const string& scenePrefix, const string& slicePrefix,
-        const string& saveHistoryDir, const string& historyFileName);
+        const string& saveHistoryDir, const string& historyFileName,
+        int numOfEncoderThreads = 0, int encoderQueueCapacity = 16, int historyFlushIntervalInMilliSecond = 5000,
+        int historyFileFormat = zpv::HistoryFileFormat::Text, double historySimplifyTolerance = 0);
     void parse(const vector<zsfo::ObjectInfo>& src, vector<zpv::ObjectInfo>& dst);
     void parse(const vector<zsfo::ObjectInfo>& src, vector<zpv::TaicangObjectInfo>& dst);
+    void flush(vector<zpv::ObjectInfo>& dst);
+    void flush(vector<zpv::TaicangObjectInfo>& dst);
     void final(void);
+    void writeTracklet(const zsfo::ObjectInfo& refObj);
+    void writeTracklets(const vector<zsfo::ObjectInfo>& tracklets);
 
+    //! 图片尚未写完的目标, 图片写完后才通过回调输出
+    template<typename ObjectInfoType>
+    struct PendingObject
+    {
+        ObjectInfoType info;
+        long long int sceneTicket;
+        long long int sliceTicket;
+    };
+    template<typename ObjectInfoType>
+    void collect(deque<PendingObject<ObjectInfoType> >& pending, vector<ObjectInfoType>& dst, bool wait);
+    template<typename ObjectInfoType>
+    void submitImages(const zsfo::ObjectSnapshotRecord& refImage, const ObjectInfoType& info,
+        deque<PendingObject<ObjectInfoType> >& pending);
+    long long int submitScene(const string& sceneName, Mat& scene);
+    bool hasSceneWritten(const string& sceneName, long long int ticket);
+
+    //! 已经提交的全景图, 同一帧中的多个目标共用一张全景图
+    struct SceneImage
+    {
+        long long int ticket;
+        int written;    ///< 是否写入成功, -1 表示尚未查询
+    };
+
+    ztool::AsyncImageWriter imageWriter;
+    ztool::BufferedTextWriter trackletsFile;
+    zsfo::TrajectoryFileWriter binaryTrackletsFile;
+    double simplifyTolerance;
+    vector<zsfo::ObjectRecord> simplifiedHistory;
+    //! 非空时 writeTracklet 不写文件, 只把目标的历史轨迹保存在这里, 并行处理时汇总后按时间顺序写出
+    vector<zsfo::ObjectInfo>* ptrKeptTracklets;
+    deque<PendingObject<zpv::ObjectInfo> > pendingObjects;
+    deque<PendingObject<zpv::TaicangObjectInfo> > pendingTaicangObjects;
     int objectCount;
     std::string imageDir;
     //std::string listName;
     std::string sceneNamePrefix;
     std::string sliceNamePrefix;
+    //! 全景图文件名的后缀, 默认为空, 并行处理时各个片段和接续结果使用不同的后缀, 避免不同的线程写同一个文件
+    std::string sceneNameSuffix;
     std::string historyName;
+    std::map<std::string, SceneImage> sceneImages;
 };
 
 void ObjectInfoParser::init(const string& saveImageDir, const string& listFileName,
     const string& scenePrefix, const string& slicePrefix,
-    const string& saveHistoryDir, const string& historyFileName)
+    const string& saveHistoryDir, const string& historyFileName,
+    int numOfEncoderThreads, int encoderQueueCapacity, int historyFlushIntervalInMilliSecond,
+    int historyFileFormat, double historySimplifyTolerance)
 {
+    simplifyTolerance = historySimplifyTolerance;
+    ptrKeptTracklets = 0;
     objectCount = 0;
+    imageWriter.init(numOfEncoderThreads, encoderQueueCapacity);
+    pendingObjects.clear();
+    pendingTaicangObjects.clear();
+    sceneImages.clear();
+    sceneNameSuffix.clear();
     imageDir = saveImageDir + "/";
     //listName = saveImageDir + "/" + listFileName;
     sceneNamePrefix = saveImageDir + "/" + scenePrefix;
@@ -63,46 +125,159 @@ void ObjectInfoParser::init(const string& saveImageDir, const string& listFileNa
     ztool::createDirectory(saveImageDir);
     ztool::createDirectory(saveHistoryDir);
 
-    fstream file;
     //file.open(listName.c_str(), ios::out);
     //file << "      ID        Time       Count       X       Y       W       H\n";
     //file.close();
-    file.open(historyName.c_str(), ios::out);
-    file.close();
+    // 轨迹文件在整个处理过程中保持打开, 按时间间隔和在 final 中写盘
+    if ((historyFileFormat & zpv::HistoryFileFormat::Text) &&
+        !trackletsFile.open(historyName, false, 1 << 20, historyFlushIntervalInMilliSecond))
+        THROW_EXCEPT("cannot open file " + historyName);
+    if ((historyFileFormat & zpv::HistoryFileFormat::Binary) &&
+        !binaryTrackletsFile.open(historyName + ".trk"))
+        THROW_EXCEPT("cannot open file " + historyName + ".trk");
+}
+
+void ObjectInfoParser::writeTracklet(const zsfo::ObjectInfo& refObj)
+{
+    if (ptrKeptTracklets)
+    {
+        // 截图已经交给 imageWriter, 这里只保留快照记录用于简化轨迹
+        ptrKeptTracklets->push_back(zsfo::ObjectInfo());
+        zsfo::ObjectInfo& refKept = ptrKeptTracklets->back();
+        refKept.ID = refObj.ID;
+        refKept.isFinal = 1;
+        refKept.hasHistory = 1;
+        refKept.history = refObj.history;
+        refKept.snapshotHistory = refObj.snapshotHistory;
+        for (int i = 0; i < refKept.snapshotHistory.size(); i++)
+        {
+            refKept.snapshotHistory[i].scene.release();
+            refKept.snapshotHistory[i].mask.release();
+            refKept.snapshotHistory[i].slice.release();
+        }
+        return;
+    }
+
+    if (simplifyTolerance > 0)
+        zsfo::simplifyHistory(refObj, simplifyTolerance, simplifiedHistory);
+    const vector<zsfo::ObjectRecord>& refHistory = simplifyTolerance > 0 ? simplifiedHistory : refObj.history;
+    trackletsFile.write("Object Count:  ").write(objectCount).write("\n");
+    trackletsFile.write("ID:            ").write(refObj.ID).write("\n");
+    trackletsFile.write("Size:          ").write(refHistory.size()).write("\n");
+    trackletsFile.write("Frame Count Time Stamp       x       y       w       h\n");
+    for (int j = 0; j < refHistory.size(); j++)
+    {
+        trackletsFile.write(refHistory[j].number, 11)
+            .write(refHistory[j].time, 11)
+            .write(refHistory[j].normRect.x, 8)
+            .write(refHistory[j].normRect.y, 8)
+            .write(refHistory[j].normRect.width, 8)
+            .write(refHistory[j].normRect.height, 8).write("\n");
+    }
+    trackletsFile.write("\n");
+    binaryTrackletsFile.write(refObj.ID, refHistory);
+}
+
+struct LessBeginTime
+{
+    bool operator()(const zsfo::ObjectInfo* lhs, const zsfo::ObjectInfo* rhs) const
+    {
+        return lhs->history.front().time < rhs->history.front().time;
+    }
+};
+
+void ObjectInfoParser::writeTracklets(const vector<zsfo::ObjectInfo>& tracklets)
+{
+    ptrKeptTracklets = 0;
+    vector<const zsfo::ObjectInfo*> ptrTracklets;
+    ptrTracklets.reserve(tracklets.size());
+    for (int i = 0; i < tracklets.size(); i++)
+    {
+        if (!tracklets[i].history.empty())
+            ptrTracklets.push_back(&tracklets[i]);
+    }
+    stable_sort(ptrTracklets.begin(), ptrTracklets.end(), LessBeginTime());
+    objectCount = 0;
+    for (int i = 0; i < ptrTracklets.size(); i++)
+    {
+        ++objectCount;
+        writeTracklet(*ptrTracklets[i]);
+        trackletsFile.endRecord();
+    }
 }
 
+template<typename ObjectInfoType>
+void ObjectInfoParser::submitImages(const zsfo::ObjectSnapshotRecord& refImage, const ObjectInfoType& info,
+    deque<PendingObject<ObjectInfoType> >& pending)
+{
+    // 只复制 Mat 头, 像素数据的所有权交给 imageWriter
+    Mat scene = refImage.scene, slice = refImage.slice;
+    pending.push_back(PendingObject<ObjectInfoType>());
+    pending.back().info = info;
+    pending.back().sceneTicket = submitScene(info.sceneName, scene);
+    pending.back().sliceTicket = imageWriter.submit(info.sliceName, slice);
 }
 
-static void getNormHistoryProperties(const vector<zsfo::ObjectRecord>& history, 
-    double& avgWidth, double& avgHeight, double& stdDevX, double& stdDevY)
+// 同一帧的全景图只写一次, 缓存的记录超过上限时清除已经查询过结果的记录,
+// 被清除的帧如果之后还有目标输出, 在上一次写完之后再写一次相同的内容
+static const int maxNumOfSceneImages = 64;
+
+long long int ObjectInfoParser::submitScene(const string& sceneName, Mat& scene)
 {
-    avgWidth = 0;
-    avgHeight = 0;
-    stdDevX = 0;
-    stdDevY = 0;
-    if (history.empty()) return;
+    map<string, SceneImage>::iterator itr = sceneImages.find(sceneName);
+    if (itr != sceneImages.end())
+        return itr->second.ticket;
+
+    if (int(sceneImages.size()) >= maxNumOfSceneImages)
+    {
+        for (itr = sceneImages.begin(); itr != sceneImages.end();)
+        {
+            if (itr->second.written >= 0)
+                sceneImages.erase(itr++);
+            else
+                ++itr;
+        }
+    }
+    SceneImage image;
+    image.ticket = imageWriter.submit(sceneName, scene);
+    image.written = -1;
+    // 被丢弃的图片不记录, 之后同一帧的目标重新提交
+    if (image.ticket >= 0)
+        sceneImages[sceneName] = image;
+    return image.ticket;
+}
+
+bool ObjectInfoParser::hasSceneWritten(const string& sceneName, long long int ticket)
+{
+    map<string, SceneImage>::iterator itr = sceneImages.find(sceneName);
+    if (itr == sceneImages.end() || itr->second.ticket != ticket)
+        return imageWriter.hasWritten(ticket);
+    if (itr->second.written < 0)
+        itr->second.written = imageWriter.hasWritten(ticket) ? 1 : 0;
+    return itr->second.written > 0;
+}
 
-    int length = history.size();
-    Mat xMat(1, length, CV_64FC1), yMat(1, length, CV_64FC1);
-    Mat widthMat(1, length, CV_64FC1), heightMat(1, length, CV_64FC1);    
-    double* ptrX = (double*)xMat.data;
-    double* ptrY = (double*)yMat.data;
-    double* ptrWidth = (double*)widthMat.data;
-    double* ptrHeight = (double*)heightMat.data;
-    for (int i = 0; i < length; i++)
+template<typename ObjectInfoType>
+void ObjectInfoParser::collect(deque<PendingObject<ObjectInfoType> >& pending, vector<ObjectInfoType>& dst, bool wait)
+{
+    if (wait)
+        imageWriter.flush();
+    // 按提交的顺序输出, 前面的目标图片没写完时后面的目标也不输出
+    while (!pending.empty() && 
+           imageWriter.hasFinished(pending.front().sceneTicket) && 
+           imageWriter.hasFinished(pending.front().sliceTicket))
     {
-        ptrX[i] = history[i].normRect.x;
-        ptrY[i] = history[i].normRect.y;
-        ptrWidth[i] = history[i].normRect.width;
-        ptrHeight[i] = history[i].normRect.height;
+        // 写入失败或者被丢弃的图片不存在, 不输出它的路径
+        PendingObject<ObjectInfoType>& front = pending.front();
+        if (!hasSceneWritten(front.info.sceneName, front.sceneTicket))
+            front.info.sceneName.clear();
+        if (!imageWriter.hasWritten(front.sliceTicket))
+            front.info.sliceName.clear();
+        dst.push_back(front.info);
+        pending.pop_front();
     }
-    avgWidth = mean(widthMat)[0];
-    avgHeight = mean(heightMat)[0];
-    Scalar xMu, yMu, xSigma, ySigma;
-    meanStdDev(xMat, xMu, xSigma);
-    meanStdDev(yMat, yMu, ySigma);
-    stdDevX = xSigma[0];
-    stdDevY = ySigma[0];
+}
+
 }
 
 static const double minSideLen = 20;
@@ -118,32 +293,32 @@ namespace oip
 
 void ObjectInfoParser::parse(const vector<zsfo::ObjectInfo>& src, vector<zpv::ObjectInfo>& dst)
 {
-    if (src.empty()) return;
+    if (src.empty())
+    {
+        collect(pendingObjects, dst, false);
+        return;
+    }
 
     int size = src.size();
     dst.reserve(size);
     //fstream objectListFile;
-    fstream trackletsFile;
     //objectListFile.open(listName.c_str(), ios::ate | ios::out | ios::in);
-    trackletsFile.open(historyName.c_str(), ios::ate | ios::out | ios::in);
     for (int i = 0; i < size; i++)
     {
         const zsfo::ObjectInfo& refObj = src[i];
         if (!refObj.isFinal || !refObj.hasHistory || !refObj.hasSnapshotHistory) continue;
 
-        double muWidth, muHeight, sigmaX, sigmaY;
-        getNormHistoryProperties(refObj.history, muWidth, muHeight, sigmaX, sigmaY);
-        double sideLen = max(muWidth, muHeight);
-        double movStdDev = max(sigmaX, sigmaY);
-        double aspectRatio = muWidth / muHeight;
-        int historyLen = refObj.history.size();
+        const zsfo::ObjectHistoryStatistics& refStat = refObj.historyStatistics;
+        double sideLen = max(refStat.meanNormWidth, refStat.meanNormHeight);
+        double movStdDev = max(refStat.stdDevNormX, refStat.stdDevNormY);
+        double aspectRatio = refStat.meanNormWidth / refStat.meanNormHeight;
+        int historyLen = refStat.numOfRecords;
         if (sideLen < minSideLen && movStdDev < minMovStdDev ||
             (aspectRatio < minAspectRatio || aspectRatio > maxAspectRatio) && historyLen < minHistoryLen ||
             sideLen > maxHistoryLen && historyLen > maxHistoryLen)
             continue;
 
-        dst.push_back(zpv::ObjectInfo());
-        zpv::ObjectInfo& procVideoObj = dst.back();
+        zpv::ObjectInfo procVideoObj;
         procVideoObj.objectID = refObj.ID;
         procVideoObj.timeBegAndEnd.first = refObj.history.front().time;
         procVideoObj.timeBegAndEnd.second = refObj.history.back().time;
@@ -156,65 +331,51 @@ void ObjectInfoParser::parse(const vector<zsfo::ObjectInfo>& src, vector<zpv::Ob
         procVideoObj.sliceLocation.height = refImage.rect.height;
         string IDStr = getString(refObj.ID);
         string frameCountStr = getString(refImage.number);
-        procVideoObj.sceneName = sceneNamePrefix + "ProcVideo_frame" + frameCountStr + ".jpg";
+        procVideoObj.sceneName = sceneNamePrefix + "ProcVideo_frame" + frameCountStr + sceneNameSuffix + ".jpg";
         procVideoObj.sliceName = sliceNamePrefix + "ProcVideo_frame" + frameCountStr + "_slice_" + IDStr + ".jpg";
 
-        imwrite(procVideoObj.sceneName, refImage.scene);
-        imwrite(procVideoObj.sliceName, refImage.slice);
+        submitImages(refImage, procVideoObj, pendingObjects);
         //objectListFile << setw(8) << refObj.ID
         //    << setw(12) << refImage.time << setw(12) << refImage.number
         //    << setw(8) << refImage.rect.x << setw(8) << refImage.rect.y
         //    << setw(8) << refImage.rect.width << setw(8) << refImage.rect.height;
         //objectListFile << "\n";
-        const vector<zsfo::ObjectRecord>& refHistory = refObj.history;
-        trackletsFile << "Object Count:  " << objectCount << "\n";
-        trackletsFile << "ID:            " << refObj.ID << "\n";
-        trackletsFile << "Size:          " << refHistory.size() << "\n";
-        trackletsFile << "Frame Count Time Stamp       x       y       w       h" << "\n";
-        for (int j = 0; j < refHistory.size(); j++)
-        {
-            trackletsFile << setw(11) << refHistory[j].number
-                << setw(11) << refHistory[j].time
-                << setw(8) << refHistory[j].normRect.x
-                << setw(8) << refHistory[j].normRect.y
-                << setw(8) << refHistory[j].normRect.width
-                << setw(8) << refHistory[j].normRect.height << "\n";
-        }
-        trackletsFile << "\n";
+        writeTracklet(refObj);
     }
     //objectListFile.close();
-    trackletsFile.close();
+    trackletsFile.endRecord();
+    collect(pendingObjects, dst, false);
 }
 
 void ObjectInfoParser::parse(const vector<zsfo::ObjectInfo>& src, vector<zpv::TaicangObjectInfo>& dst)
 {
-    if (src.empty()) return;
+    if (src.empty())
+    {
+        collect(pendingTaicangObjects, dst, false);
+        return;
+    }
 
     int size = src.size();
     dst.reserve(size);
     //fstream objectListFile;
-    fstream trackletsFile;
     //objectListFile.open(listName.c_str(), ios::ate | ios::out | ios::in);
-    trackletsFile.open(historyName.c_str(), ios::ate | ios::out | ios::in);
     for (int i = 0; i < size; i++)
     {
         const zsfo::ObjectInfo& refObj = src[i];
         if (!refObj.isFinal || !refObj.hasHistory || !refObj.hasSnapshotHistory) continue;
         if (refObj.history.size() < 4) continue;
 
-        /*double muWidth, muHeight, sigmaX, sigmaY;
-        getNormHistoryProperties(refObj.history, muWidth, muHeight, sigmaX, sigmaY);
-        double sideLen = max(muWidth, muHeight);
-        double movStdDev = max(sigmaX, sigmaY);
-        double aspectRatio = muWidth / muHeight;
-        int historyLen = refObj.history.size();
+        /*const zsfo::ObjectHistoryStatistics& refStat = refObj.historyStatistics;
+        double sideLen = max(refStat.meanNormWidth, refStat.meanNormHeight);
+        double movStdDev = max(refStat.stdDevNormX, refStat.stdDevNormY);
+        double aspectRatio = refStat.meanNormWidth / refStat.meanNormHeight;
+        int historyLen = refStat.numOfRecords;
         if (sideLen < minSideLen && movStdDev < minMovStdDev ||
             (aspectRatio < minAspectRatio || aspectRatio > maxAspectRatio) && historyLen < minHistoryLen ||
             sideLen > maxHistoryLen && historyLen > maxHistoryLen)
             continue;*/
 
-        dst.push_back(zpv::TaicangObjectInfo());
-        zpv::TaicangObjectInfo& procVideoObj = dst.back();
+        zpv::TaicangObjectInfo procVideoObj;
         procVideoObj.objectID = refObj.ID;
         procVideoObj.timeBegAndEnd.first = refObj.history.front().time;
         procVideoObj.timeBegAndEnd.second = refObj.history.back().time;
@@ -227,45 +388,47 @@ void ObjectInfoParser::parse(const vector<zsfo::ObjectInfo>& src, vector<zpv::Ta
         procVideoObj.sliceLocation.height = refImage.rect.height;
         string IDStr = getString(refObj.ID);
         string frameCountStr = getString(refImage.number);
-        procVideoObj.sceneName = sceneNamePrefix + "ProcVideo_frame_" + frameCountStr + ".jpg";
+        procVideoObj.sceneName = sceneNamePrefix + "ProcVideo_frame_" + frameCountStr + sceneNameSuffix + ".jpg";
         procVideoObj.sliceName = sliceNamePrefix + "ProcVideo_frame_" + frameCountStr + "_slice_" + IDStr + ".jpg";
 
-        imwrite(procVideoObj.sceneName, refImage.scene);
-        imwrite(procVideoObj.sliceName, refImage.slice);
+        submitImages(refImage, procVideoObj, pendingTaicangObjects);
         //objectListFile << setw(8) << refObj.ID
         //    << setw(12) << refImage.time << setw(12) << refImage.number
         //    << setw(8) << refImage.rect.x << setw(8) << refImage.rect.y
         //    << setw(8) << refImage.rect.width << setw(8) << refImage.rect.height;
         //objectListFile << "\n";
-        const vector<zsfo::ObjectRecord>& refHistory = refObj.history;
-        trackletsFile << "Object Count:  " << objectCount << "\n";
-        trackletsFile << "ID:            " << refObj.ID << "\n";
-        trackletsFile << "Size:          " << refHistory.size() << "\n";
-        trackletsFile << "Frame Count Time Stamp       x       y       w       h" << "\n";
-        for (int j = 0; j < refHistory.size(); j++)
-        {
-            trackletsFile << setw(11) << refHistory[j].number
-                << setw(11) << refHistory[j].time
-                << setw(8) << refHistory[j].normRect.x
-                << setw(8) << refHistory[j].normRect.y
-                << setw(8) << refHistory[j].normRect.width
-                << setw(8) << refHistory[j].normRect.height << "\n";
-        }
-        trackletsFile << "\n";
+        writeTracklet(refObj);
     }
     //objectListFile.close();
-    trackletsFile.close();
+    trackletsFile.endRecord();
+    collect(pendingTaicangObjects, dst, false);
+}
+
+void ObjectInfoParser::flush(vector<zpv::ObjectInfo>& dst)
+{
+    collect(pendingObjects, dst, true);
+}
+
+void ObjectInfoParser::flush(vector<zpv::TaicangObjectInfo>& dst)
+{
+    collect(pendingTaicangObjects, dst, true);
 }
 
 void ObjectInfoParser::final(void)
 {
-    fstream file;
+    imageWriter.flush();
+    trackletsFile.write("End\n");
+    trackletsFile.close();
+    binaryTrackletsFile.close();
+#if CMPL_WRITE_CONSOLE || CMPL_WRITE_NECESSARY_CONSOLE
+    ztool::ImageWriteStatus status;
+    imageWriter.getStatus(status);
+    printf("Images written: %d, failed: %d, dropped: %d, max queue depth: %d\n",
+        status.numOfWritten, status.numOfFailed, status.numOfDropped, status.maxQueueDepth);
+#endif
     //file.open(listName.c_str(), ios::ate | ios::out | ios::in);
     //file << "End\n";
     //file.close();
-    file.open(historyName.c_str(), ios::ate | ios::out | ios::in);
-    file << "End\n";
-    file.close();
 }
 
 }
@@ -305,6 +468,639 @@ static void mul(vector<vector<Point> >& points, const ztool::Size2d& scale)
     }
 }
 
+//! 根据视频帧率和期望的处理帧率计算每隔多少帧处理一帧
+static int calcProcEveryNFrame(double fps, const zpv::ConfigInfo& config)
+{
+    int procEveryNFrame = (fps < 16 || fps > 30) ? 1 : int(fps / 10 + 0.5);
+    if (config.procFrameRate > 0 && fps > 0)
+        procEveryNFrame = max(1, int(fps / config.procFrameRate + 0.5));
+    return procEveryNFrame;
+}
+
+// 按固定帧率处理时每处理多少帧完整更新一次背景模型
+static const int defaultUpdateBackInterval = 2;
+// 历史轨迹插值时允许目标连续漏检的处理帧数, 漏检一次时相邻两条记录相差 2 * procEveryNFrame 帧
+static const int maxInterpolateMissedProcFrames = 2;
+
+//! 按照任务配置初始化运动目标检测器
+static void initDetector(zsfo::MovingObjectDetector& movObjDet, const zsfo::StampedImage& input,
+    const zpv::ConfigInfo& config, int procEveryNFrame)
+{
+    Size origSize(input.image.size()), normSize(320, 240);
+    int updateBackInterval = defaultUpdateBackInterval;
+    bool historyWithImages = false; 
+    int recordSnapshotMode = zsfo::RecordSnapshotMode::Multi;
+    int saveSnapshotMode = zsfo::SaveSnapshotMode::SaveScene | zsfo::SaveSnapshotMode::SaveSlice;
+    int saveSnapshotInterval = 2;
+    int numOfSnapshotSaved = 1;
+    
+    vector<vector<Point> > incPoints, excPoints;
+    pairToPoint(config.includeRegion, incPoints);
+    pairToPoint(config.excludeRegion, excPoints);
+    ztool::Size2d scaleNormToOrig = ztool::div(normSize, origSize); 
+    mul(incPoints, scaleNormToOrig);
+    mul(excPoints, scaleNormToOrig);
+
+    bool normScale = true;
+    double minObjectArea = 50;
+    double minObjectWidth = 10;
+    double minObjectHeight = 10;
+    bool charRegionCheck = false;
+    vector<Rect> charRegions;
+    bool checkTurnAround = true;
+    double maxDistRectAndBlob = 20;
+    double minRatioIntersectToSelf = 0.5;
+    double minRatioIntersectToBlob = 0.5;
+
+    movObjDet.init(input, normSize, updateBackInterval, historyWithImages,
+        recordSnapshotMode, saveSnapshotMode, saveSnapshotInterval, numOfSnapshotSaved, 
+        normScale, incPoints, excPoints, vector<Point>(),
+        &minObjectArea, &minObjectWidth, &minObjectHeight, &charRegionCheck, charRegions,
+        &checkTurnAround, &maxDistRectAndBlob, &minRatioIntersectToSelf, &minRatioIntersectToBlob);
+    if (config.interpolateHistory)
+    {
+        bool interpolateHistory = true;
+        int maxInterpolateFrameGap = (maxInterpolateMissedProcFrames + 1) * procEveryNFrame;
+        movObjDet.setOutputParams(&interpolateHistory, &maxInterpolateFrameGap);
+    }
+    if (config.frameBudgetInMilliSecond > 0)
+        movObjDet.setFrameBudget(config.frameBudgetInMilliSecond);
+}
+
+// 空闲区间两端正常检测的时长和区间内更新背景的时间间隔, 以秒计算
+static const double idleSpanMarginInSecond = 2;
+static const double idleBuildIntervalInSecond = 2;
+
+//! 读取活跃度时间线并找出需要跳过的空闲区间, 不跳过或者时间线不可用时区间为空
+static void loadIdleSpans(const string& videoPath, double fps, const zpv::ConfigInfo& config,
+    vector<pair<int, int> >& idleSpans)
+{
+    idleSpans.clear();
+    zpv::ActivityTimeline timeline;
+    if (config.minIdleSpanInSecond <= 0 || !zpv::loadActivityTimeline(videoPath, timeline))
+        return;
+    double frameRate = fps > 0 ? fps : 25;
+    zpv::findIdleSpans(timeline, int(config.minIdleSpanInSecond * frameRate + 0.5),
+        int(idleSpanMarginInSecond * frameRate + 0.5), idleSpans);
+}
+
+//! 空闲区间内每隔多少帧读一帧更新背景, 是 procEveryNFrame 的整数倍, 读取的帧是正常处理时也会处理的帧
+static int calcIdleBuildEveryNFrame(double fps, int procEveryNFrame)
+{
+    int idleBuildEveryNFrame = int(idleBuildIntervalInSecond * (fps > 0 ? fps : 25) + 0.5);
+    idleBuildEveryNFrame -= idleBuildEveryNFrame % procEveryNFrame;
+    return max(idleBuildEveryNFrame, procEveryNFrame);
+}
+
+namespace
+{
+
+//! 流水线中由解码线程传递给检测线程的帧
+struct PipelineFrame
+{
+    int count;                 ///< 主循环计数
+    bool needProc;             ///< 是否需要做检测, 否则只用于回调报告进度
+    bool isIdle;               ///< 是否处于空闲区间, 是则只用于更新背景
+    bool isEnd;                ///< 是否是结束标志
+    std::string errorMessage;  ///< 解码线程抛出的异常信息
+    zsfo::StampedImage input;
+};
+
+//! 流水线中由检测线程传递给输出阶段的结果
+struct PipelineResult
+{
+    int count;                 ///< 主循环计数
+    bool isEnd;                ///< 是否是结束标志
+    std::string errorMessage;  ///< 解码线程或者检测线程抛出的异常信息
+    zsfo::ObjectDetails output;
+};
+
+//! 流水线中传递缓冲区下标的队列
+/*!
+    信号量的计数等于队列中下标的数量, 队列为空时消费者阻塞在信号量上, 不轮询.
+    队列容量等于缓冲区数量, 所以 push 一定成功.
+ */
+struct IndexQueue
+{
+    void init(int capacity) {queue.init(capacity);};
+    void push(int index) {queue.tryPush(index); numOfItems.post();};
+    //! 等待取出一个下标, 停止标志置位时返回 false
+    bool pop(int& index, ztool::AtomicFlag* stopFlag)
+    {
+        numOfItems.wait();
+        if (stopFlag && stopFlag->isSet())
+            return false;
+        return queue.tryPop(index);
+    };
+    //! 唤醒阻塞在 pop 中的消费者, 使其检查停止标志
+    void wake(void) {numOfItems.post();};
+
+    ztool::SPSCQueue<int> queue;
+    ztool::Semaphore numOfItems;
+};
+
+//! 解码, 检测, 输出三级流水线
+/*!
+    解码和检测各占一个线程, 输出(写图片, 写轨迹文件, 回调)在调用者线程中进行, 
+    保证回调的线程和顺序与单线程处理时相同.
+    相邻两级之间使用单生产者单消费者无锁队列传递缓冲区下标, 缓冲区循环使用,
+    下游处理不过来时上游等待空闲缓冲区, 实现反压.
+ */
+struct VideoPipeline
+{
+    VideoPipeline(VideoCapture& capture, zsfo::MovingObjectDetector& detector)
+        : cap(capture), movObjDet(detector) {};
+
+    void init(int queueDepth);
+    void start(void);
+    void stop(void);
+    bool popResult(int& index);
+    void releaseResult(int index);
+
+    static void decodeEntry(void* ptrPipeline);
+    static void detectEntry(void* ptrPipeline);
+    void decode(void);
+    void detect(void);
+
+    VideoCapture& cap;
+    zsfo::MovingObjectDetector& movObjDet;
+    int procEveryNFrame;
+    int idleBuildEveryNFrame;
+    int buildFrameCount;
+    int totalFrameCount;
+    int procTotalCount;
+    int progressInterval;
+
+    zpv::IdleSpanCursor idleSpans;
+    std::vector<PipelineFrame> frames;
+    std::vector<PipelineResult> results;
+    IndexQueue freeFrames, decodedFrames;
+    IndexQueue freeResults, detectedResults;
+    ztool::AtomicFlag stopDecode, stopDetect;
+    ztool::Thread decodeThread, detectThread;
+
+private:
+    VideoPipeline(const VideoPipeline&);
+    VideoPipeline& operator=(const VideoPipeline&);
+};
+
+void VideoPipeline::init(int queueDepth)
+{
+    // 除了队列中的缓冲区, 上下游各自还可能占用一个缓冲区
+    int poolSize = max(queueDepth, 1) + 2;
+    frames.clear();
+    frames.resize(poolSize);
+    results.clear();
+    results.resize(poolSize);
+    freeFrames.init(poolSize);
+    decodedFrames.init(poolSize);
+    freeResults.init(poolSize);
+    detectedResults.init(poolSize);
+    for (int i = 0; i < poolSize; i++)
+    {
+        freeFrames.push(i);
+        freeResults.push(i);
+    }
+    stopDecode.reset();
+    stopDetect.reset();
+}
+
+void VideoPipeline::start(void)
+{
+    if (!decodeThread.start(decodeEntry, this))
+        THROW_EXCEPT("cannot start decode thread");
+    if (!detectThread.start(detectEntry, this))
+    {
+        stop();
+        THROW_EXCEPT("cannot start detect thread");
+    }
+}
+
+void VideoPipeline::stop(void)
+{
+    stopDecode.set();
+    stopDetect.set();
+    // 解码线程只会阻塞在等待空闲帧缓冲区上, 检测线程阻塞在等待解码帧或者空闲结果缓冲区上
+    freeFrames.wake();
+    decodedFrames.wake();
+    freeResults.wake();
+    decodeThread.join();
+    detectThread.join();
+}
+
+bool VideoPipeline::popResult(int& index)
+{
+    return detectedResults.pop(index, 0);
+}
+
+void VideoPipeline::releaseResult(int index)
+{
+    freeResults.push(index);
+}
+
+void VideoPipeline::decodeEntry(void* ptrPipeline)
+{
+    ((VideoPipeline*)ptrPipeline)->decode();
+}
+
+void VideoPipeline::detectEntry(void* ptrPipeline)
+{
+    ((VideoPipeline*)ptrPipeline)->detect();
+}
+
+void VideoPipeline::decode(void)
+{
+    int index;
+    std::string errorMessage;
+    try
+    {
+        for (int count = 1; count < procTotalCount; count++)
+        {
+            long long int time = (long long int)cap.get(CV_CAP_PROP_POS_MSEC);
+            int number = (int)cap.get(CV_CAP_PROP_POS_FRAMES);
+            if (number >= totalFrameCount)
+                break;
+            bool isIdle = idleSpans.isIdle(number);
+            bool needProc = (count % (isIdle ? idleBuildEveryNFrame : procEveryNFrame) == 0);
+            bool needReport = (count % progressInterval == 0);
+            // 不需要检测也不需要报告进度的帧, 只 grab 不 retrieve, 也不占用缓冲区
+            if (!needProc && !needReport)
+            {
+                cap.grab();
+                continue;
+            }
+            if (!freeFrames.pop(index, &stopDecode))
+                return;
+            PipelineFrame& frame = frames[index];
+            bool readSuccess = needProc ? cap.read(frame.input.image) : cap.grab();
+            if (!readSuccess)
+            {
+                freeFrames.push(index);
+                continue;
+            }
+            frame.count = count;
+            frame.needProc = needProc;
+            frame.isIdle = isIdle;
+            frame.isEnd = false;
+            frame.input.time = time;
+            frame.input.number = number;
+            decodedFrames.push(index);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        errorMessage = e.what();
+    }
+
+    if (!freeFrames.pop(index, &stopDecode))
+        return;
+    PipelineFrame& frame = frames[index];
+    frame.isEnd = true;
+    frame.errorMessage = errorMessage;
+    decodedFrames.push(index);
+}
+
+void VideoPipeline::detect(void)
+{
+    int frameIndex, resultIndex;
+    while (true)
+    {
+        if (!decodedFrames.pop(frameIndex, &stopDetect))
+            return;
+        PipelineFrame& frame = frames[frameIndex];
+        if (!freeResults.pop(resultIndex, &stopDetect))
+            return;
+        PipelineResult& result = results[resultIndex];
+        result.count = frame.count;
+        result.isEnd = frame.isEnd;
+        result.errorMessage = frame.errorMessage;
+        result.output.objects.clear();
+        result.output.staticObjects.clear();
+        if (!frame.isEnd && frame.needProc)
+        {
+            try
+            {
+                if (frame.count < buildFrameCount || frame.isIdle)
+                    movObjDet.build(frame.input);
+                else
+                    movObjDet.proc(frame.input, result.output);
+            }
+            catch (const std::exception& e)
+            {
+                // 检测出错后通知解码线程停止, 并把异常信息传给输出阶段
+                stopDecode.set();
+                result.isEnd = true;
+                result.errorMessage = e.what();
+            }
+        }
+        bool isEnd = result.isEnd;
+        freeFrames.push(frameIndex);
+        detectedResults.push(resultIndex);
+        if (isEnd)
+            return;
+    }
+}
+
+//! 流水线停止守卫, 离开作用域时停止并等待所有线程结束, 输出阶段抛出异常时也能正确退出
+struct VideoPipelineStopGuard
+{
+    VideoPipelineStopGuard(VideoPipeline& pipeline) : ptrPipeline(&pipeline) {};
+    ~VideoPipelineStopGuard(void) {ptrPipeline->stop();};
+    VideoPipeline* ptrPipeline;
+};
+
+}
+
+namespace
+{
+
+//! 并行处理时各个工作线程共享的输出
+struct ParallelOutput
+{
+    ParallelOutput(void) : numOfFramesDone(0), objectCount(0) {};
+
+    cv::Mutex mtx;
+    std::vector<zpv::ObjectInfo> objects;  ///< 等待在调用者线程中回调输出的目标, 由 mtx 保护
+    int numOfFramesDone;                   ///< 各个线程已经读取的帧数之和, 用 CV_XADD 累加
+    int objectCount;                       ///< 全局目标编号计数, 用 CV_XADD 分配, 保证编号不重复
+    ztool::AtomicFlag stop;                ///< 出错时通知所有线程停止
+};
+
+//! 并行处理中负责一个视频片段的工作线程
+/*!
+    每个线程使用独立的 VideoCapture 和 MovingObjectDetector.
+    除第一个片段外, 线程从片段起点之前 overlap 帧开始检测, 再往前多读 build 帧建立背景.
+    除最后一个片段外, 线程处理到片段终点之后 overlap 帧.
+    起始帧落在本片段中的目标由本线程输出, 起始帧在本片段之前的目标留作接续上一片段的目标,
+    起始帧在本片段之后的目标由下一片段输出.
+ */
+struct SegmentWorker
+{
+    static void entry(void* ptrWorker);
+    void run(void);
+    void handle(const vector<zsfo::ObjectInfo>& objects, bool isFinalCall);
+
+    const zpv::TaskInfo* ptrTask;
+    const zpv::ConfigInfo* ptrConfig;
+    const zpv::VideoFrameIndex* ptrFrameIndex;
+    const vector<pair<int, int> >* ptrIdleSpans;
+    ParallelOutput* ptrOutput;
+    int procEveryNFrame;
+    int idleBuildEveryNFrame;
+    int readBegCount;    ///< 读取的第一帧, 用于初始化检测器
+    int buildFrameCount; ///< 从 readBegCount 开始用于建立背景的帧数
+    int coreBegCount;    ///< 本片段的起始帧(包含)
+    int coreEndCount;    ///< 本片段的结束帧(包含)
+    int readEndCount;    ///< 读取的最后一帧(包含)
+    bool isFirst;
+    bool isLast;
+
+    oip::ObjectInfoParser infoParser;
+    vector<zsfo::ObjectInfo> tracklets;      ///< 本线程输出的目标的历史轨迹
+    vector<zsfo::ObjectInfo> openObjects;    ///< 起始帧在本片段中, 处理结束时仍在跟踪的目标, 等待接续
+    vector<zsfo::ObjectInfo> headObjects;    ///< 起始帧在本片段之前的目标, 不含截图
+    vector<unsigned char> headObjectIsOpen;  ///< 对应的 headObjects 在处理结束时是否仍在跟踪
+    string errorMessage;
+    ztool::AtomicFlag finished;
+    ztool::Thread thread;
+};
+
+void SegmentWorker::entry(void* ptrWorker)
+{
+    ((SegmentWorker*)ptrWorker)->run();
+}
+
+void SegmentWorker::handle(const vector<zsfo::ObjectInfo>& objects, bool isFinalCall)
+{
+    vector<zsfo::ObjectInfo> ownedObjects;
+    for (int i = 0; i < objects.size(); i++)
+    {
+        const zsfo::ObjectInfo& refObj = objects[i];
+        if (!refObj.isFinal || !refObj.hasHistory || refObj.history.empty())
+            continue;
+        // 处理结束时仍在跟踪的目标, 最后一个片段除外, 都在片段终点之后被截断
+        bool isOpen = isFinalCall && !isLast;
+        int begCount = refObj.history.front().number;
+        if (!isFirst && begCount < coreBegCount)
+        {
+            headObjects.push_back(refObj);
+            headObjects.back().snapshotHistory.clear();
+            headObjectIsOpen.push_back(isOpen);
+        }
+        else if (begCount > coreEndCount)
+            continue;
+        else if (isOpen)
+            openObjects.push_back(refObj);
+        else
+        {
+            ownedObjects.push_back(refObj);
+            ownedObjects.back().ID = CV_XADD(&ptrOutput->objectCount, 1) + 1;
+        }
+    }
+
+    vector<zpv::ObjectInfo> infos;
+    infoParser.parse(ownedObjects, infos);
+    if (isFinalCall)
+        infoParser.flush(infos);
+    if (!infos.empty())
+    {
+        cv::AutoLock lock(ptrOutput->mtx);
+        ptrOutput->objects.insert(ptrOutput->objects.end(), infos.begin(), infos.end());
+    }
+}
+
+void SegmentWorker::run(void)
+{
+    try
+    {
+        VideoCapture cap;
+        if (!cap.open(ptrTask->videoPath))
+            THROW_EXCEPT("cannot open " + ptrTask->videoPath);
+        if (!zpv::locateFrame(cap, ptrTask->videoPath, readBegCount, ptrFrameIndex))
+            THROW_EXCEPT("cannot locate frame count " + getString(readBegCount));
+
+        zsfo::StampedImage input;
+        input.time = (long long int)cap.get(CV_CAP_PROP_POS_MSEC);
+        input.number = readBegCount;
+        if (!cap.read(input.image))
+            THROW_EXCEPT("cannot read frame, frame count " + getString(readBegCount));
+
+        zsfo::MovingObjectDetector movObjDet;
+        initDetector(movObjDet, input, *ptrConfig, procEveryNFrame);
+        infoParser.ptrKeptTracklets = &tracklets;
+        zpv::IdleSpanCursor idleSpans;
+        idleSpans.init(ptrIdleSpans);
+
+        int reportInterval = 25;
+        int procTotalCount = readEndCount - readBegCount + 1;
+        for (int count = 1; count < procTotalCount; count++)
+        {
+            if (ptrOutput->stop.isSet())
+                break;
+            if (count % reportInterval == 0)
+                CV_XADD(&ptrOutput->numOfFramesDone, reportInterval);
+            input.time = (long long int)cap.get(CV_CAP_PROP_POS_MSEC);
+            input.number = readBegCount + count;
+            // 空闲区间内只隔较长时间读一帧更新背景
+            bool isIdle = idleSpans.isIdle(input.number);
+            bool needProc = (count % (isIdle ? idleBuildEveryNFrame : procEveryNFrame) == 0);
+            if (!(needProc ? cap.read(input.image) : cap.grab())) 
+                continue;
+            if (!needProc)
+                continue;
+            if (count < buildFrameCount || isIdle)
+                movObjDet.build(input);
+            else
+            {
+                zsfo::ObjectDetails output;
+                movObjDet.proc(input, output);
+                handle(output.objects, false);
+            }
+        }
+        CV_XADD(&ptrOutput->numOfFramesDone, (procTotalCount - 1) % reportInterval + 1);
+
+        zsfo::ObjectDetails output;
+        movObjDet.final(output);
+        handle(output.objects, true);
+        infoParser.final();
+    }
+    catch (const std::exception& e)
+    {
+        errorMessage = e.what();
+        ptrOutput->stop.set();
+    }
+    finished.set();
+}
+
+//! 并行处理停止守卫, 离开作用域时通知并等待所有工作线程结束, 回调抛出异常时也能正确退出
+struct SegmentWorkersStopGuard
+{
+    SegmentWorkersStopGuard(vector<cv::Ptr<SegmentWorker> >& workers, ParallelOutput& output)
+        : ptrWorkers(&workers), ptrOutput(&output) {};
+    ~SegmentWorkersStopGuard(void)
+    {
+        ptrOutput->stop.set();
+        for (int i = 0; i < ptrWorkers->size(); i++)
+            (*ptrWorkers)[i]->thread.join();
+    };
+    vector<cv::Ptr<SegmentWorker> >* ptrWorkers;
+    ParallelOutput* ptrOutput;
+};
+
+struct LessRecordNumber
+{
+    bool operator()(const zsfo::ObjectRecord& lhs, int rhs) const
+    {
+        return lhs.number < rhs;
+    }
+};
+
+// 接续跨越片段边界的目标时, 重叠部分至少有这么多条记录的帧编号相同, 
+// 并且这些记录的矩形交并比的均值大于阈值
+static const int minNumOfCommonRecords = 3;
+static const double minMeanOverlapRatio = 0.5;
+
+//! 在 candidates 中寻找与 refObj 在重叠帧上轨迹一致的目标, 返回下标, 找不到返回 -1
+int findContinuation(const zsfo::ObjectInfo& refObj, const vector<zsfo::ObjectInfo>& candidates,
+    const vector<unsigned char>& isUsed)
+{
+    const vector<zsfo::ObjectRecord>& refHistory = refObj.history;
+    int begCount = refHistory.front().number, endCount = refHistory.back().number;
+    int bestIndex = -1;
+    double bestRatio = minMeanOverlapRatio;
+    for (int i = 0; i < candidates.size(); i++)
+    {
+        if (isUsed[i])
+            continue;
+        const vector<zsfo::ObjectRecord>& candHistory = candidates[i].history;
+        int numOfCommon = 0;
+        double sumRatio = 0;
+        for (int j = 0; j < candHistory.size(); j++)
+        {
+            int number = candHistory[j].number;
+            if (number < begCount || number > endCount)
+                continue;
+            vector<zsfo::ObjectRecord>::const_iterator itr = 
+                lower_bound(refHistory.begin(), refHistory.end(), number, LessRecordNumber());
+            if (itr == refHistory.end() || itr->number != number)
+                continue;
+            Rect intersectRect = itr->normRect & candHistory[j].normRect;
+            double unionArea = itr->normRect.area() + candHistory[j].normRect.area() - intersectRect.area();
+            if (unionArea > 0)
+                sumRatio += intersectRect.area() / unionArea;
+            numOfCommon++;
+        }
+        if (numOfCommon >= minNumOfCommonRecords && sumRatio / numOfCommon > bestRatio)
+        {
+            bestIndex = i;
+            bestRatio = sumRatio / numOfCommon;
+        }
+    }
+    return bestIndex;
+}
+
+//! 根据历史轨迹重新计算统计量, 接续后的目标使用
+void calcHistoryStatistics(const vector<zsfo::ObjectRecord>& history, zsfo::ObjectHistoryStatistics& stat)
+{
+    int size = history.size();
+    double sumW = 0, sumH = 0, sumX = 0, sumY = 0, sumXX = 0, sumYY = 0;
+    for (int i = 0; i < size; i++)
+    {
+        const Rect& refRect = history[i].normRect;
+        sumW += refRect.width;
+        sumH += refRect.height;
+        sumX += refRect.x;
+        sumY += refRect.y;
+        sumXX += double(refRect.x) * refRect.x;
+        sumYY += double(refRect.y) * refRect.y;
+    }
+    stat.numOfRecords = size;
+    if (size == 0)
+        return;
+    stat.meanNormWidth = sumW / size;
+    stat.meanNormHeight = sumH / size;
+    double meanX = sumX / size, meanY = sumY / size;
+    stat.stdDevNormX = sqrt(max(0.0, sumXX / size - meanX * meanX));
+    stat.stdDevNormY = sqrt(max(0.0, sumYY / size - meanY * meanY));
+}
+
+//! 用下一片段中起始帧在片段之前的目标接续 openObjects 中被截断的目标
+/*!
+    接续上的目标在重叠帧之后的记录追加到原目标的历史轨迹中, 保留原目标的编号和快照.
+    如果接续上的目标在下一片段处理结束时仍在跟踪, 合并后的目标留在 openObjects 中继续等待接续,
+    其余目标移到 closedObjects 中.
+ */
+void stitchObjects(vector<zsfo::ObjectInfo>& openObjects, const SegmentWorker& nextWorker,
+    vector<zsfo::ObjectInfo>& closedObjects)
+{
+    const vector<zsfo::ObjectInfo>& candidates = nextWorker.headObjects;
+    vector<unsigned char> isUsed(candidates.size(), 0);
+    vector<zsfo::ObjectInfo> stillOpenObjects;
+    for (int i = 0; i < openObjects.size(); i++)
+    {
+        zsfo::ObjectInfo& refObj = openObjects[i];
+        int index = findContinuation(refObj, candidates, isUsed);
+        if (index < 0)
+        {
+            closedObjects.push_back(refObj);
+            continue;
+        }
+        isUsed[index] = 1;
+        const vector<zsfo::ObjectRecord>& candHistory = candidates[index].history;
+        vector<zsfo::ObjectRecord>::const_iterator itr = 
+            lower_bound(candHistory.begin(), candHistory.end(), refObj.history.back().number + 1, LessRecordNumber());
+        refObj.history.insert(refObj.history.end(), itr, candHistory.end());
+        calcHistoryStatistics(refObj.history, refObj.historyStatistics);
+        if (nextWorker.headObjectIsOpen[index])
+            stillOpenObjects.push_back(refObj);
+        else
+            closedObjects.push_back(refObj);
+    }
+    openObjects.swap(stillOpenObjects);
+}
+
+}
+
 namespace zpv
 {
 
@@ -320,8 +1116,26 @@ void procVideo(const TaskInfo& task, const ConfigInfo& config,
     }
 
     double fps = cap.get(CV_CAP_PROP_FPS);
-    int procEveryNFrame = (fps < 16 || fps > 30) ? 1 : int(fps / 10 + 0.5);
+    int procEveryNFrame = calcProcEveryNFrame(fps, config);
     int totalFrameCount = cap.get(CV_CAP_PROP_FRAME_COUNT);
+    // 分割视频时保存了帧索引, 其中的总帧数比容器记录的帧数可靠
+    VideoFrameIndex frameIndex;
+    if (loadFrameIndex(task.videoPath, frameIndex))
+        totalFrameCount = frameIndex.frameCount;
+    // 活跃度时间线中的空闲区间只 grab, 隔一段时间读一帧更新背景
+    vector<pair<int, int> > idleSpans;
+    loadIdleSpans(task.videoPath, fps, config, idleSpans);
+    int idleBuildEveryNFrame = calcIdleBuildEveryNFrame(fps, procEveryNFrame);
+    IdleSpanCursor idleSpanCursor;
+    idleSpanCursor.init(&idleSpans);
+    // 显示中间结果时, imshow 和 waitKey 必须在同一个线程中调用, 所以不使用流水线
+    bool usePipeline = config.pipelineQueueDepth > 0 && !CMPL_SHOW_IMAGE;
+    // 自适应处理帧率只用于单线程顺序处理
+    bool adaptiveProcRate = config.adaptiveProcRate && !usePipeline;
+    int maxProcEveryNFrame = !adaptiveProcRate ? procEveryNFrame :
+        max(procEveryNFrame, int(config.maxProcIntervalInSecond * (fps > 0 ? fps : 25) + 0.5));
+    ProcRateController rateController;
+    rateController.init(procEveryNFrame, maxProcEveryNFrame, fps, config.procCpuBudget, defaultUpdateBackInterval);
 
     int buildFrameCount = 0;
     int begIncCount = 0;
@@ -338,7 +1152,8 @@ void procVideo(const TaskInfo& task, const ConfigInfo& config,
         endIncCount = task.frameCountBegAndEnd.second;
     }
         
-    if (!cap.set(CV_CAP_PROP_POS_FRAMES, begIncCount))
+    // 已经建立过关键帧时利用索引定位, 否则直接定位
+    if (!locateFrame(cap, task.videoPath, begIncCount, &frameIndex))
     {
         THROW_EXCEPT("cannot locate frame count " + getString(begIncCount));
     }
@@ -351,40 +1166,13 @@ void procVideo(const TaskInfo& task, const ConfigInfo& config,
     zsfo::MovingObjectDetector movObjDet;
     oip::ObjectInfoParser infoParser;
 
-    Size origSize(input.image.size()), normSize(320, 240);
-    int updateBackInterval = 2;
-    bool historyWithImages = false; 
-    int recordSnapshotMode = zsfo::RecordSnapshotMode::Multi;
-    int saveSnapshotMode = zsfo::SaveSnapshotMode::SaveScene | zsfo::SaveSnapshotMode::SaveSlice;
-    int saveSnapshotInterval = 2;
-    int numOfSnapshotSaved = 1;
-    
-    vector<vector<Point> > incPoints, excPoints;
-    pairToPoint(config.includeRegion, incPoints);
-    pairToPoint(config.excludeRegion, excPoints);
-    ztool::Size2d scaleNormToOrig = ztool::div(normSize, origSize); 
-    mul(incPoints, scaleNormToOrig);
-    mul(excPoints, scaleNormToOrig);
-
-    bool normScale = true;
-    double minObjectArea = 50;
-    double minObjectWidth = 10;
-    double minObjectHeight = 10;
-    bool charRegionCheck = false;
-    vector<Rect> charRegions;
-    bool checkTurnAround = true;
-    double maxDistRectAndBlob = 20;
-    double minRatioIntersectToSelf = 0.5;
-    double minRatioIntersectToBlob = 0.5;
-    
     try
     {
-        movObjDet.init(input, normSize, updateBackInterval, historyWithImages,
-            recordSnapshotMode, saveSnapshotMode, saveSnapshotInterval, numOfSnapshotSaved, 
-            normScale, incPoints, excPoints, vector<Point>(),
-            &minObjectArea, &minObjectWidth, &minObjectHeight, &charRegionCheck, charRegions,
-            &checkTurnAround, &maxDistRectAndBlob, &minRatioIntersectToSelf, &minRatioIntersectToBlob);
-        infoParser.init(task.saveImagePath, "", "", "", task.saveHistoryPath, task.historyFileName);
+        // 处理间隔可变时, 相邻两条历史记录的帧编号之差最大为自适应调整的最大间隔
+        initDetector(movObjDet, input, config, maxProcEveryNFrame);
+        infoParser.init(task.saveImagePath, "", "", "", task.saveHistoryPath, task.historyFileName,
+            config.numOfEncoderThreads, config.encoderQueueCapacity, int(config.historyFlushIntervalInSecond * 1000),
+            config.historyFileFormat, config.historySimplifyTolerance);
     }
     catch (const exception& e)
     {
@@ -393,48 +1181,280 @@ void procVideo(const TaskInfo& task, const ConfigInfo& config,
 
     int progressInterval = 25;
     int procTotalCount = endIncCount - begIncCount + 1;
-    for (int count = 1; count < procTotalCount; count++)
+    if (usePipeline)
     {
-        input.time = (long long int)cap.get(CV_CAP_PROP_POS_MSEC);
-        input.number = (int)cap.get(CV_CAP_PROP_POS_FRAMES);
-        if (input.number >= totalFrameCount)
-            break;
-        if (!cap.read(input.image)) 
-            continue;
-        zsfo::ObjectDetails output;
-        vector<ObjectInfo> objects;
-        if (count % procEveryNFrame == 0)
+        VideoPipeline pipeline(cap, movObjDet);
+        pipeline.procEveryNFrame = procEveryNFrame;
+        pipeline.idleBuildEveryNFrame = idleBuildEveryNFrame;
+        pipeline.idleSpans.init(&idleSpans);
+        pipeline.buildFrameCount = buildFrameCount;
+        pipeline.totalFrameCount = totalFrameCount;
+        pipeline.procTotalCount = procTotalCount;
+        pipeline.progressInterval = progressInterval;
+        pipeline.init(config.pipelineQueueDepth);
+        pipeline.start();
+        VideoPipelineStopGuard guard(pipeline);
+        int index;
+        while (pipeline.popResult(index))
         {
+            PipelineResult& result = pipeline.results[index];
+            if (result.isEnd)
+            {
+                if (!result.errorMessage.empty())
+                    THROW_EXCEPT(result.errorMessage);
+                break;
+            }
+            vector<ObjectInfo> objects;
             try
             {
-                if (count < buildFrameCount)
-                    movObjDet.build(input);
-                else
-                {
-                    movObjDet.proc(input, output);
-                    infoParser.parse(output.objects, objects);
-                }
+                infoParser.parse(result.output.objects, objects);
             }
             catch (const exception& e)
             {
                 THROW_EXCEPT(e.what());
             }
+            int count = result.count;
+            pipeline.releaseResult(index);
+            if (ptrCallBackFunc && (count % progressInterval == 0 || !objects.empty()))
+                ptrCallBackFunc(float(count) / procTotalCount * 100, objects, ptrUserData);
         }
-        if (ptrCallBackFunc && (count % progressInterval == 0 || !objects.empty()))
-            ptrCallBackFunc(float(count) / procTotalCount * 100, objects, ptrUserData);
+    }
+    else
+    {
+        for (int count = 1; count < procTotalCount; count++)
+        {
+            input.time = (long long int)cap.get(CV_CAP_PROP_POS_MSEC);
+            input.number = (int)cap.get(CV_CAP_PROP_POS_FRAMES);
+            if (input.number >= totalFrameCount)
+                break;
+            // 不处理的帧只 grab, 省去 retrieve 中的颜色转换和拷贝
+            bool isIdle = idleSpanCursor.isIdle(input.number);
+            bool isAdaptive = adaptiveProcRate && !isIdle && count >= buildFrameCount;
+            bool needProc = isAdaptive ? rateController.needProc(count) :
+                (count % (isIdle ? idleBuildEveryNFrame : procEveryNFrame) == 0);
+            if (!(needProc ? cap.read(input.image) : cap.grab())) 
+                continue;
+            zsfo::ObjectDetails output;
+            vector<ObjectInfo> objects;
+            if (needProc)
+            {
+                try
+                {
+                    if (count < buildFrameCount || isIdle)
+                        movObjDet.build(input);
+                    else if (isAdaptive)
+                    {
+                        rateController.beginProc();
+                        movObjDet.proc(input, output);
+                        zsfo::TrackingActivityInfo activity;
+                        movObjDet.getActivityInfo(activity);
+                        rateController.endProc(count, activity);
+                        movObjDet.setUpdateBackInterval(rateController.getUpdateBackInterval());
+                        infoParser.parse(output.objects, objects);
+                    }
+                    else
+                    {
+                        movObjDet.proc(input, output);
+                        infoParser.parse(output.objects, objects);
+                    }
+                }
+                catch (const exception& e)
+                {
+                    THROW_EXCEPT(e.what());
+                }
+            }
+            if (ptrCallBackFunc && (count % progressInterval == 0 || !objects.empty()))
+                ptrCallBackFunc(float(count) / procTotalCount * 100, objects, ptrUserData);
 #if CMPL_SHOW_IMAGE        
-        waitKey(output.objects.empty() ? 5 : 5);
+            waitKey(output.objects.empty() ? 5 : 5);
 #endif
+        }
     }
 
     zsfo::ObjectDetails output;
     vector<ObjectInfo> objects;
     movObjDet.final(output);
     infoParser.parse(output.objects, objects);
+    infoParser.flush(objects);
     infoParser.final();
     ptrCallBackFunc(100, objects, ptrUserData);
 }
 
+
+void procVideoParallel(const TaskInfo& task, const ConfigInfo& config, int numOfThreads,
+    procVideoCallBack ptrCallBackFunc, void* ptrUserData)
+{
+    VideoCapture cap; 
+    cap.open(task.videoPath);
+
+    if (!cap.isOpened())
+    {
+        THROW_EXCEPT("cannot open " + task.videoPath);
+    }
+
+    double fps = cap.get(CV_CAP_PROP_FPS);
+    int procEveryNFrame = calcProcEveryNFrame(fps, config);
+    cap.release();
+
+    // 总帧数来自帧索引, 各个线程利用其中的关键帧定位
+    VideoFrameIndex frameIndex;
+    try
+    {
+        probeFrameIndex(task.videoPath, frameIndex);
+    }
+    catch (const exception& e)
+    {
+        THROW_EXCEPT(e.what());
+    }
+    int totalFrameCount = frameIndex.frameCount;
+    vector<pair<int, int> > idleSpans;
+    loadIdleSpans(task.videoPath, fps, config, idleSpans);
+
+    int begIncCount = 0;
+    int endIncCount = totalFrameCount - 1;
+    if (task.frameCountBegAndEnd.first > begIncCount &&
+        task.frameCountBegAndEnd.second < endIncCount &&
+        task.frameCountBegAndEnd.first < task.frameCountBegAndEnd.second)
+    {
+        begIncCount = task.frameCountBegAndEnd.first;
+        endIncCount = task.frameCountBegAndEnd.second;
+    }
+
+    int buildFrameCount = 50 * procEveryNFrame;
+    int overlapFrameCount = int(max(config.segmentOverlapInSecond, 1.0) * (fps > 0 ? fps : 25) + 0.5);
+    // 每个片段至少要比建立背景和重叠部分长, 否则多线程没有收益
+    int minSegmentFrameCount = 2 * (buildFrameCount + overlapFrameCount);
+    int numOfSegments = min(max(numOfThreads, 1), max((endIncCount - begIncCount + 1) / minSegmentFrameCount, 1));
+
+    ParallelOutput parallelOutput;
+    vector<Ptr<SegmentWorker> > workers(numOfSegments);
+    int readBegCountOfFirst = max(begIncCount - buildFrameCount, 0);
+    int totalReadCount = 0;
+    try
+    {
+        for (int i = 0; i < numOfSegments; i++)
+        {
+            workers[i] = new SegmentWorker;
+            SegmentWorker& refWorker = *workers[i];
+            refWorker.ptrTask = &task;
+            refWorker.ptrConfig = &config;
+            refWorker.ptrFrameIndex = &frameIndex;
+            refWorker.ptrIdleSpans = &idleSpans;
+            refWorker.ptrOutput = &parallelOutput;
+            refWorker.procEveryNFrame = procEveryNFrame;
+            refWorker.idleBuildEveryNFrame = calcIdleBuildEveryNFrame(fps, procEveryNFrame);
+            refWorker.isFirst = (i == 0);
+            refWorker.isLast = (i == numOfSegments - 1);
+            refWorker.coreBegCount = begIncCount + 
+                int((long long int)(endIncCount - begIncCount + 1) * i / numOfSegments);
+            refWorker.coreEndCount = begIncCount + 
+                int((long long int)(endIncCount - begIncCount + 1) * (i + 1) / numOfSegments) - 1;
+            int detectBegCount = refWorker.isFirst ? 
+                refWorker.coreBegCount : max(refWorker.coreBegCount - overlapFrameCount, readBegCountOfFirst);
+            refWorker.readBegCount = max(detectBegCount - buildFrameCount, readBegCountOfFirst);
+            // 各个片段处理的帧与单线程处理时相同, 重叠部分的记录帧编号一致, 便于接续
+            refWorker.readBegCount -= (refWorker.readBegCount - readBegCountOfFirst) % procEveryNFrame;
+            refWorker.buildFrameCount = detectBegCount - refWorker.readBegCount;
+            refWorker.readEndCount = refWorker.isLast ? 
+                endIncCount : min(refWorker.coreEndCount + overlapFrameCount, endIncCount);
+            totalReadCount += refWorker.readEndCount - refWorker.readBegCount + 1;
+            // 各个线程只写图片, 历史轨迹汇总后统一写入
+            refWorker.infoParser.init(task.saveImagePath, "", "", "", task.saveHistoryPath, task.historyFileName,
+                config.numOfEncoderThreads, config.encoderQueueCapacity, 0, 0);
+            // 重叠部分的同一帧可能由相邻的两个片段同时输出, 全景图文件名带上片段序号
+            refWorker.infoParser.sceneNameSuffix = "_part" + getString(i);
+        }
+    }
+    catch (const exception& e)
+    {
+        THROW_EXCEPT(e.what());
+    }
+
+    oip::ObjectInfoParser infoParser;
+    vector<zsfo::ObjectInfo> stitchedTracklets;
+    try
+    {
+        infoParser.init(task.saveImagePath, "", "", "", task.saveHistoryPath, task.historyFileName,
+            config.numOfEncoderThreads, config.encoderQueueCapacity, int(config.historyFlushIntervalInSecond * 1000),
+            config.historyFileFormat, config.historySimplifyTolerance);
+        infoParser.ptrKeptTracklets = &stitchedTracklets;
+        infoParser.sceneNameSuffix = "_stitch";
+    }
+    catch (const exception& e)
+    {
+        THROW_EXCEPT(e.what());
+    }
+
+    {
+        SegmentWorkersStopGuard guard(workers, parallelOutput);
+        for (int i = 0; i < numOfSegments; i++)
+        {
+            if (!workers[i]->thread.start(SegmentWorker::entry, (SegmentWorker*)workers[i]))
+                THROW_EXCEPT("cannot start segment worker thread");
+        }
+
+        // 回调在调用者线程中进行
+        float lastPercentage = 0;
+        while (true)
+        {
+            bool allFinished = true;
+            for (int i = 0; i < numOfSegments; i++)
+                allFinished = allFinished && workers[i]->finished.isSet();
+            vector<ObjectInfo> objects;
+            {
+                AutoLock lock(parallelOutput.mtx);
+                objects.swap(parallelOutput.objects);
+            }
+            float percentage = float(CV_XADD(&parallelOutput.numOfFramesDone, 0)) / totalReadCount * 100;
+            percentage = min(percentage, 99.0F);
+            if (ptrCallBackFunc && (percentage >= lastPercentage + 1 || !objects.empty()))
+            {
+                ptrCallBackFunc(percentage, objects, ptrUserData);
+                lastPercentage = percentage;
+            }
+            if (allFinished)
+                break;
+            ztool::sleepInMilliSecond(20);
+        }
+    }
+
+    for (int i = 0; i < numOfSegments; i++)
+    {
+        if (!workers[i]->errorMessage.empty())
+            THROW_EXCEPT(workers[i]->errorMessage);
+    }
+
+    // 按片段顺序接续跨越片段边界的目标
+    vector<zsfo::ObjectInfo> openObjects, closedObjects;
+    for (int i = 0; i < numOfSegments; i++)
+    {
+        if (i > 0)
+            stitchObjects(openObjects, *workers[i], closedObjects);
+        openObjects.insert(openObjects.end(), workers[i]->openObjects.begin(), workers[i]->openObjects.end());
+    }
+    closedObjects.insert(closedObjects.end(), openObjects.begin(), openObjects.end());
+    for (int i = 0; i < closedObjects.size(); i++)
+        closedObjects[i].ID = CV_XADD(&parallelOutput.objectCount, 1) + 1;
+
+    vector<ObjectInfo> objects;
+    vector<zsfo::ObjectInfo> tracklets;
+    try
+    {
+        infoParser.parse(closedObjects, objects);
+        infoParser.flush(objects);
+        for (int i = 0; i < numOfSegments; i++)
+            tracklets.insert(tracklets.end(), workers[i]->tracklets.begin(), workers[i]->tracklets.end());
+        tracklets.insert(tracklets.end(), stitchedTracklets.begin(), stitchedTracklets.end());
+        infoParser.writeTracklets(tracklets);
+        infoParser.final();
+    }
+    catch (const exception& e)
+    {
+        THROW_EXCEPT(e.what());
+    }
+    if (ptrCallBackFunc)
+        ptrCallBackFunc(100, objects, ptrUserData);
+}
 }
 
 static void transformRects(const vector<zpv::TaicangParamInfo::Rect>& src, vector<Rect>& dst)
@@ -488,6 +1508,9 @@ void procVideo(const TaicangTaskInfo& task, const TaicangParamInfo& param,
     double fps = cap.get(CV_CAP_PROP_FPS);
     int procEveryNFrame = (fps < 16 || fps > 30) ? 1 : int(fps / 10 + 0.5);
     int totalFrameCount = cap.get(CV_CAP_PROP_FRAME_COUNT);
+    VideoFrameIndex frameIndex;
+    if (loadFrameIndex(task.videoPath, frameIndex))
+        totalFrameCount = frameIndex.frameCount;
 
     int buildFrameCount = 0;
     int begIncCount = 0;
@@ -504,14 +1527,13 @@ void procVideo(const TaicangTaskInfo& task, const TaicangParamInfo& param,
         endIncCount = task.frameCountBegAndEnd.second;
     }
         
-    int readCount = 0;
-    Mat frame;
-    while (readCount < begIncCount)
-    {
-        if (!cap.read(frame))
-            THROW_EXCEPT("cannot read frame, frame count " + getString(readCount));
-        readCount++;
-    }
+    // 这类视频直接设置 CV_CAP_PROP_POS_FRAMES 不可靠, 首次处理非起始片段时建立帧索引,
+    // 之后从不超过 begIncCount 的最近关键帧开始向后 grab
+    if (begIncCount > 0 && frameIndex.keyFrames.empty())
+        getFrameIndex(task.videoPath, frameIndex);
+    if (!locateFrame(cap, task.videoPath, begIncCount, &frameIndex))
+        THROW_EXCEPT("cannot locate frame count " + getString(begIncCount));
+    int readCount = begIncCount;
 
     zsfo::StampedImage input;
     input.time = (long long int)cap.get(CV_CAP_PROP_POS_MSEC);
@@ -576,12 +1598,13 @@ void procVideo(const TaicangTaskInfo& task, const TaicangParamInfo& param,
         input.number = readCount;
         if (input.number >= totalFrameCount)
             break;
-        if (!cap.read(input.image)) 
+        bool needProc = (count % procEveryNFrame == 0);
+        if (!(needProc ? cap.read(input.image) : cap.grab())) 
             break;
         readCount++;
         zsfo::ObjectDetails output;
         vector<TaicangObjectInfo> objects;
-        if (count % procEveryNFrame == 0)
+        if (needProc)
         {
             try
             {
@@ -617,6 +1640,7 @@ void procVideo(const TaicangTaskInfo& task, const TaicangParamInfo& param,
     vector<TaicangObjectInfo> objects;
     movObjDet.final(output);
     infoParser.parse(output.objects, objects);
+    infoParser.flush(objects);
     addInfo(task.taskID, task.caseName, task.caseSetName, objects);
     infoParser.final();
     ptrCallBackFunc(100, objects, ptrUserData);
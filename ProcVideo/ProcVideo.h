@@ -54,9 +54,29 @@ struct EnvironmentType
     };
 };
 
+//! 历史轨迹文件格式
+struct HistoryFileFormat
+{
+    enum
+    {
+        Text = 1,    ///< 文本格式
+        Binary = 2   ///< 按列存储的二进制格式, 文件名是文本格式的文件名加上 .trk 后缀, 用 zsfo::TrajectoryFileReader 读取
+    };
+};
+
 //! 任务配置信息
 struct ConfigInfo
 {
+    //! 构造函数
+    ConfigInfo(void) 
+        : tiltType(TiltType::MIDDLE_ANGLE), zoomType(ZoomType::MIDDLE_SCENE), 
+          environmentType(EnvironmentType::SUNNY), procFrameRate(0), interpolateHistory(false), 
+          pipelineQueueDepth(0), numOfEncoderThreads(0), encoderQueueCapacity(16), 
+          historyFlushIntervalInSecond(5), historyFileFormat(HistoryFileFormat::Text), 
+          historySimplifyTolerance(0), segmentOverlapInSecond(10), minIdleSpanInSecond(0), 
+          adaptiveProcRate(false), maxProcIntervalInSecond(1), procCpuBudget(0), frameBudgetInMilliSecond(0) 
+    {};
+
     std::string configPath;  ///< 配置文件路径
     //! 感兴趣区域
     std::vector<std::vector<std::pair<int, int> > > includeRegion;
@@ -65,6 +85,59 @@ struct ConfigInfo
     int tiltType;                ///< 视角类型
     int zoomType;                ///< 视距类型
     int environmentType;         ///< 光照天气背景类型
+    double procFrameRate;        ///< 期望的处理帧率, 小于等于 0 时按每秒约 10 帧处理, 高速公路场景可以降到每秒 3 到 5 帧
+    bool interpolateHistory;     ///< 历史轨迹文件中是否对跳过的帧插值, 使轨迹保持原始帧率, 目标连续漏检不超过 2 个处理帧时也插值
+    //! 流水线模式下解码, 检测, 输出各级之间队列的长度
+    /*!
+        大于 0 时解码和检测分别在独立线程中进行, 写图片, 写轨迹文件和回调仍然在调用者线程中按原来的顺序进行,
+        小于等于 0 时单线程顺序处理
+     */
+    int pipelineQueueDepth;
+    //! 后台编码并写图片的线程数量
+    /*!
+        大于 0 时 jpg 图片由后台线程编码写入, 目标在图片写完后才通过回调输出, 处理结束时会等待所有图片写完,
+        小于等于 0 时在分析过程中同步写图片
+     */
+    int numOfEncoderThreads;
+    int encoderQueueCapacity;    ///< 后台写图片时等待写入的图片数量上限, 达到上限时分析等待
+    //! 历史轨迹文件写盘的最长时间间隔, 以秒计算, 小于等于 0 时只在缓冲区满和处理结束时写盘
+    double historyFlushIntervalInSecond;
+    int historyFileFormat;       ///< 历史轨迹文件格式, HistoryFileFormat 中的值按位或
+    //! 历史轨迹简化允许的误差, 以归一化帧中的像素计算, 小于等于 0 时不简化, 一般取 1 到 2
+    /*!
+        目标匀速直线运动时只保留首尾记录, 按帧编号线性插值可以在误差范围内恢复被删除的记录,
+        快照图片所在帧的记录总是保留
+     */
+    double historySimplifyTolerance;
+    //! procVideoParallel 中相邻片段重叠的时长, 以秒计算, 跨越片段边界的目标在重叠部分接续, 不小于 1
+    double segmentOverlapInSecond;
+    //! 跳过空闲区间的最短时长, 以秒计算, 小于等于 0 时不跳过
+    /*!
+        大于 0 时读取视频旁边的活跃度时间线文件, 场景空闲持续时间不短于该值的区间只 grab 不检测,
+        每隔约 2 秒读一帧用于更新背景模型, 区间两端各留 2 秒正常检测. 时间线文件由 createActivityTimeline 建立,
+        文件不存在或者与视频不一致时正常处理所有帧
+     */
+    double minIdleSpanInSecond;
+    //! 是否根据场景活跃程度自适应调整处理帧率
+    /*!
+        为 true 时, 有运动目标靠近抓拍线圈或线段时按 procFrameRate 对应的帧率处理, 
+        有运动目标但远离线圈时处理帧率减半, 场景空闲超过 1 秒后逐步降低处理帧率, 直到每 maxProcIntervalInSecond 秒处理一帧,
+        处理帧率降低时同步减小完整更新背景模型的间隔. 只在 procVideo 的单线程顺序处理模式下有效, 
+        流水线模式和 procVideoParallel 按固定帧率处理
+     */
+    bool adaptiveProcRate;
+    double maxProcIntervalInSecond;  ///< 自适应调整时相邻两个处理帧的最长时间间隔, 以秒计算
+    //! 自适应调整时每路视频的 CPU 预算, 检测器处理时间占视频时长的比例上限, 小于等于 0 时不限制
+    /*!
+        例如 0.5 表示处理 1 秒视频最多使用 0.5 秒 CPU 时间, 超出预算时即使场景繁忙也降低处理帧率
+     */
+    double procCpuBudget;
+    //! 检测器处理单帧的时间预算, 以毫秒计算, 小于等于 0 时不限制
+    /*!
+        超出预算时依次跳过梯度优化, 大小矩形合并, 相关系数检测和快照更新, 见 zsfo::MovingObjectDetector::setFrameBudget,
+        实时视频流可以设为帧间隔, 使拥挤或噪声大的画面中处理时间有上限
+     */
+    double frameBudgetInMilliSecond;
 };
 
 //! 跟踪对象信息
@@ -73,8 +146,8 @@ struct ObjectInfo
     int objectID;            ///< 目标编号
     //! 起始和结束的时间戳
     std::pair<long long int, long long int> timeBegAndEnd;   
-    std::string sliceName;   ///< 全景图全路径
-    std::string sceneName;   ///< 目标截图全路径
+    std::string sliceName;   ///< 全景图全路径, 图片没有写成功时为空
+    std::string sceneName;   ///< 目标截图全路径, 图片没有写成功时为空
     int frameCount;          ///< 截图的帧编号
     struct Rect
     {
@@ -121,6 +194,28 @@ Z_LIB_EXPORT bool findSplitPositions(const std::string& videoPath, const int exp
     double& videoLengthInSecond, std::vector<double>& segmentLengthInSecond,
     std::vector<std::pair<int, int> >& splitBegAndEnd);
 
+//! 建立视频帧索引
+/*!
+    顺序 grab 整个视频, 记录总帧数和可以准确定位的关键帧, 保存到视频文件旁边的同名 .zfi 文件中.
+    findSplitPositions 会探测总帧数并保存到索引文件中, procVideo 读取其中的总帧数,
+    处理非起始片段时如果索引中没有关键帧会自动建立, 也可以在分割视频之前调用本函数预先建立.
+    可能会抛出 std::exception 类型的异常
+    \param[in] videoPath 视频文件全路径
+    \return 索引文件保存成功返回 true
+ */
+Z_LIB_EXPORT bool createFrameIndex(const std::string& videoPath);
+
+//! 建立视频的场景活跃度时间线
+/*!
+    多线程低分辨率分析整个视频, 每 3 帧记录一个场景活跃度, 保存到视频文件旁边的同名 .zat 文件中.
+    ConfigInfo::minIdleSpanInSecond 大于 0 时 procVideo 和 procVideoParallel 根据时间线跳过空闲区间.
+    可能会抛出 std::exception 类型的异常
+    \param[in] videoPath 视频文件全路径
+    \param[in] numOfThreads 线程数量, 小于等于 0 时等于 CPU 核数
+    \return 时间线文件保存成功返回 true
+ */
+Z_LIB_EXPORT bool createActivityTimeline(const std::string& videoPath, int numOfThreads = 0);
+
 //! 处理视频片段函数
 /*!
     可能会抛出 std::exception 类型的异常
@@ -131,6 +226,22 @@ Z_LIB_EXPORT bool findSplitPositions(const std::string& videoPath, const int exp
  */
 Z_LIB_EXPORT void procVideo(const TaskInfo& task, const ConfigInfo& config, 
     procVideoCallBack ptrCallBackFunc, void* ptrUserData);
+
+//! 多线程处理视频函数
+/*!
+    视频按帧数均分为若干片段, 每个线程使用独立的 MovingObjectDetector 处理一个片段,
+    相邻片段重叠 config.segmentOverlapInSecond 秒, 跨越片段边界的目标在重叠部分接续成一个目标.
+    目标编号在整个视频中唯一, 历史轨迹在处理结束时按目标起始时间顺序写入一个文件.
+    回调在调用者线程中进行, 不同片段的目标按完成的先后输出, 不保证时间顺序.
+    可能会抛出 std::exception 类型的异常
+    \param[in] task 分析任务信息, frameCountBegAndEnd 无效时处理整个视频
+    \param[in] config 配置信息, pipelineQueueDepth 不起作用
+    \param[in] numOfThreads 线程数量, 视频较短时实际使用的线程会减少
+    \param[in] ptrCallBackFunc 回调函数指针
+    \param[in,out] ptrUserData 用户数据
+ */
+Z_LIB_EXPORT void procVideoParallel(const TaskInfo& task, const ConfigInfo& config, int numOfThreads,
+    procVideoCallBack ptrCallBackFunc, void* ptrUserData);
 }
 
 namespace zpv
@@ -185,8 +296,8 @@ struct TaicangObjectInfo
     int objectID;            ///< 目标编号
     //! 起始和结束的时间戳
     std::pair<long long int, long long int> timeBegAndEnd;   
-    std::string sliceName;   ///< 全景图全路径
-    std::string sceneName;   ///< 目标截图全路径
+    std::string sliceName;   ///< 全景图全路径, 图片没有写成功时为空
+    std::string sceneName;   ///< 目标截图全路径, 图片没有写成功时为空
     int frameCount;          ///< 截图的帧编号
     struct Rect
     {
@@ -215,3 +326,77 @@ namespace zpv
 Z_LIB_EXPORT void procVideo(const TaicangTaskInfo& task, const TaicangParamInfo& param,
     taicangProcVideoCallBack ptrCallBackFunc, void* ptrUserData);
 }
+
+namespace zpv
+{
+
+//! 批量处理的配置信息
+struct BatchConfigInfo
+{
+    //! 构造函数
+    BatchConfigInfo(void)
+        : numOfWorkers(0), numOfThreadsPerJob(1), maxJobTimeInSecond(0)
+    {};
+
+    //! 任务队列目录
+    /*!
+        目录下每个 .job 文件描述一个等待处理的任务, 文件格式与参数配置文件相同, 例如
+        -----------------------------------
+        [Task]
+        #type                  Zheng
+        #taskID                T0001
+        #videoPath             /data/video/0001.mp4
+        #videoSegmentID        0
+        #frameCountBegAndEnd   0 -1
+        #saveImagePath         /data/result/T0001/
+        #saveHistoryPath       /data/result/T0001/
+        #historyFileName       history.txt
+        -----------------------------------
+        #type 为 Taicang 时按 TaicangTaskInfo 处理, 还可以有 #caseName 和 #caseSetName.
+        #frameCountBegAndEnd 可以省略, 省略或者无效时处理整个视频.
+        任务开始处理时文件移动到 running 子目录, 文件名加上领取任务的主机名和进程号, 如 0001.job@host@1234.running,
+        成功后移动到 done 子目录, 失败后移动到 failed 子目录, 同时写入同名的 .error 文件记录异常信息.
+        启动时本机上已经退出的进程领取的任务移回队列目录重新处理, 其他进程正在处理的任务保持不动,
+        其他主机领取的任务无法判断进程是否存在, 需要手动移回队列目录.
+     */
+    std::string queueDir;
+    int numOfWorkers;            ///< 同时处理的任务数量, 小于等于 0 时等于 CPU 核数除以 numOfThreadsPerJob
+    //! 每个任务使用的线程数量, 大于 1 时 TaskInfo 任务用 procVideoParallel 处理, TaicangTaskInfo 任务总是单线程处理
+    int numOfThreadsPerJob;
+    //! 每个任务的最长处理时间, 以秒计算, 小于等于 0 时不限制.
+    //! 超时的任务立即记为失败并移动到 failed 子目录, 处理线程在下一次进度回调时中止,
+    //! 没有进度回调的任务无法中止, 处理线程返回后才能领取下一个任务
+    double maxJobTimeInSecond;
+    ConfigInfo config;           ///< TaskInfo 任务的配置信息
+    TaicangParamInfo param;      ///< TaicangTaskInfo 任务的参数信息
+};
+
+//! 批量处理的统计信息
+struct BatchStatus
+{
+    int numOfJobs;       ///< 处理的任务数量
+    int numOfSucceeded;  ///< 成功的任务数量
+    int numOfFailed;     ///< 失败的任务数量
+    int numOfResumed;    ///< 上次运行中断后重新处理的任务数量
+};
+
+//! 批量处理任务队列目录中的任务
+/*!
+    多个工作线程从队列目录中领取任务, 领取通过文件改名完成, 多个进程处理同一个队列目录也不会重复处理.
+    队列目录中的任务处理完毕后返回, 处理过程中新加入队列目录的任务也会被处理.
+    回调函数在工作线程中调用, 同一时刻只有一个线程在回调, 回调的进度是整个批次的进度,
+    回调期间其他工作线程仍然可以领取和完成任务.
+    单个任务的异常不会中断批处理, 只记为失败.
+    任务在调用者进程内的工作线程中处理, 进度才能通过回调函数返回, 所以每个任务只限制占用的 CPU 核数 numOfThreadsPerJob
+    和处理时间 maxJobTimeInSecond, 不单独限制内存和 CPU 时间, setrlimit 等系统资源限制只能作用于整个进程,
+    需要时由调用者在调用本函数之前对整个批处理进程设置.
+    可能会抛出 std::exception 类型的异常
+    \param[in] batchConfig 批量处理的配置信息
+    \param[in] ptrCallBackFunc TaskInfo 任务的回调函数指针, 可以为空
+    \param[in] ptrTaicangCallBackFunc TaicangTaskInfo 任务的回调函数指针, 可以为空
+    \param[in,out] ptrUserData 用户数据
+    \param[out] ptrStatus 统计信息, 可以为空
+ */
+Z_LIB_EXPORT void procVideoBatch(const BatchConfigInfo& batchConfig, procVideoCallBack ptrCallBackFunc,
+    taicangProcVideoCallBack ptrTaicangCallBackFunc, void* ptrUserData, BatchStatus* ptrStatus = 0);
+}
@@ -0,0 +1,301 @@
+﻿#if WIN32 || _WIN32
+#   include <process.h>
+#else
+#   include <unistd.h>
+#endif
+#include <cstdio>
+#include <cmath>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include "ProcVideo.h"
+#include "VideoFrameIndex.h"
+#include "Exception.h"
+
+using namespace std;
+using namespace cv;
+
+static const char* indexFileExt = ".zfi";
+static const char* indexFileTag = "ZFI";
+static const int indexFileVersion = 1;
+
+namespace
+{
+struct LessFrameCount
+{
+    bool operator()(const pair<int, long long int>& lhs, int rhs) const
+    {
+        return lhs.first < rhs;
+    }
+};
+
+// 时间戳与期望值相差不到半帧时认为定位准确
+double getMaxTimeDiff(double frameRate)
+{
+    return frameRate > 0 ? 500.0 / frameRate : 20.0;
+}
+
+// grab 一帧并核对时间戳
+bool grabAndCheckTime(VideoCapture& cap, double expectTime, double frameRate)
+{
+    return cap.grab() && fabs(cap.get(CV_CAP_PROP_POS_MSEC) - expectTime) < getMaxTimeDiff(frameRate);
+}
+
+// 重新打开视频, 从第 0 帧开始逐帧 grab, 使下一次 grab 得到第 frameCount 帧
+bool seekFromBegin(VideoCapture& cap, const string& videoPath, int frameCount)
+{
+    if (!cap.open(videoPath))
+        return false;
+    for (int i = 0; i < frameCount; i++)
+    {
+        if (!cap.grab())
+            return false;
+    }
+    return true;
+}
+}
+
+namespace zpv
+{
+
+long long int getFileSize(const string& path)
+{
+    fstream file;
+    file.open(path.c_str(), ios::in | ios::binary);
+    if (!file.is_open())
+        return -1;
+    file.seekg(0, ios::end);
+    return (long long int)file.tellg();
+}
+
+string getFrameIndexPath(const string& videoPath)
+{
+    return videoPath + indexFileExt;
+}
+
+bool loadFrameIndex(const string& videoPath, VideoFrameIndex& index)
+{
+    long long int fileSize = getFileSize(videoPath);
+    if (fileSize < 0)
+        return false;
+
+    fstream file;
+    file.open(getFrameIndexPath(videoPath).c_str(), ios::in);
+    if (!file.is_open())
+        return false;
+
+    string tag;
+    int version = 0;
+    VideoFrameIndex temp;
+    int numOfKeyFrames = 0;
+    file >> tag >> version;
+    if (!file || tag != indexFileTag || version != indexFileVersion)
+        return false;
+    file >> temp.fileSize >> temp.frameCount >> temp.frameRate >> numOfKeyFrames;
+    if (!file || temp.fileSize != fileSize || temp.frameCount < 1 || numOfKeyFrames < 0)
+        return false;
+    temp.keyFrames.resize(numOfKeyFrames);
+    for (int i = 0; i < numOfKeyFrames; i++)
+        file >> temp.keyFrames[i].first >> temp.keyFrames[i].second;
+    if (!file || (numOfKeyFrames > 0 && temp.keyFrames[0].first != 0))
+        return false;
+
+    index = temp;
+    return true;
+}
+
+string getTempFilePath(const string& path)
+{
+    static int tempFileCount = 0;
+#if WIN32 || _WIN32
+    int processID = _getpid();
+#else
+    int processID = getpid();
+#endif
+    stringstream strm;
+    strm << path << "." << processID << "." << CV_XADD(&tempFileCount, 1) << ".tmp";
+    return strm.str();
+}
+
+bool replaceWithTempFile(const string& tempPath, const string& path)
+{
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        // Windows 下目标文件存在时改名失败
+        remove(path.c_str());
+        if (rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool saveFrameIndex(const string& videoPath, const VideoFrameIndex& index)
+{
+    string path = getFrameIndexPath(videoPath);
+    string tempPath = getTempFilePath(path);
+    fstream file;
+    file.open(tempPath.c_str(), ios::out);
+    if (!file.is_open())
+        return false;
+
+    file << indexFileTag << " " << indexFileVersion << "\n";
+    file << index.fileSize << " " << index.frameCount << " "
+         << setprecision(10) << index.frameRate << "\n";
+    int numOfKeyFrames = index.keyFrames.size();
+    file << numOfKeyFrames << "\n";
+    for (int i = 0; i < numOfKeyFrames; i++)
+        file << index.keyFrames[i].first << " " << index.keyFrames[i].second << "\n";
+    bool success = !file.fail();
+    file.close();
+    if (!success)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return replaceWithTempFile(tempPath, path);
+}
+
+void buildFrameIndex(const string& videoPath, VideoFrameIndex& index, double keyFrameIntervalInSecond)
+{
+    VideoCapture cap;
+    if (!cap.open(videoPath))
+        THROW_EXCEPT("cannot open file " + videoPath);
+
+    VideoFrameIndex temp;
+    temp.fileSize = getFileSize(videoPath);
+    temp.frameRate = cap.get(CV_CAP_PROP_FPS);
+    int keyFrameInterval = temp.frameRate > 0 ? int(keyFrameIntervalInSecond * temp.frameRate + 0.5) : 250;
+    if (keyFrameInterval < 1)
+        keyFrameInterval = 1;
+
+    // 顺序 grab 计数, 同时记录候选关键帧的时间戳
+    vector<pair<int, long long int> > candidates;
+    int count = 0;
+    while (cap.grab())
+    {
+        if (count % keyFrameInterval == 0)
+            candidates.push_back(make_pair(count, (long long int)cap.get(CV_CAP_PROP_POS_MSEC)));
+        count++;
+    }
+    cap.release();
+    if (count < 1)
+        THROW_EXCEPT("cannot read any frame from " + videoPath);
+    temp.frameCount = count;
+
+    // 第 0 帧总是可以通过重新打开视频到达
+    temp.keyFrames.push_back(candidates[0]);
+    int numOfCandidates = candidates.size();
+    if (numOfCandidates > 1 && cap.open(videoPath))
+    {
+        // 定位后 grab 得到的时间戳与顺序解码相差不到半帧, 认为定位准确
+        for (int i = 1; i < numOfCandidates; i++)
+        {
+            if (cap.set(CV_CAP_PROP_POS_FRAMES, candidates[i].first) && 
+                grabAndCheckTime(cap, double(candidates[i].second), temp.frameRate))
+                temp.keyFrames.push_back(candidates[i]);
+        }
+    }
+
+    index = temp;
+}
+
+void getFrameIndex(const string& videoPath, VideoFrameIndex& index)
+{
+    if (loadFrameIndex(videoPath, index) && !index.keyFrames.empty())
+        return;
+    buildFrameIndex(videoPath, index);
+    saveFrameIndex(videoPath, index);
+}
+
+void probeFrameIndex(const string& videoPath, VideoFrameIndex& index)
+{
+    if (loadFrameIndex(videoPath, index))
+        return;
+
+    VideoCapture cap;
+    if (!cap.open(videoPath))
+        THROW_EXCEPT("cannot open file " + videoPath);
+
+    VideoFrameIndex temp;
+    temp.fileSize = getFileSize(videoPath);
+    temp.frameRate = cap.get(CV_CAP_PROP_FPS);
+    int frameCount = (int)cap.get(CV_CAP_PROP_FRAME_COUNT);
+    // 按第 0 帧的时间戳和帧率推算最后一帧的时间戳, 定位到最后一帧 grab 并核对时间戳, 
+    // 定位不准确, 容器帧数偏大或者帧率不恒定时时间戳不符, 帧数偏小时再次 grab 成功, 都需要顺序计数
+    bool isFrameCountValid = frameCount > 0 && temp.frameRate > 0 && cap.grab();
+    if (isFrameCountValid && frameCount > 1)
+    {
+        double expectTime = cap.get(CV_CAP_PROP_POS_MSEC) + (frameCount - 1) * 1000.0 / temp.frameRate;
+        isFrameCountValid = cap.set(CV_CAP_PROP_POS_FRAMES, frameCount - 1) && 
+            grabAndCheckTime(cap, expectTime, temp.frameRate);
+    }
+    if (isFrameCountValid && !cap.grab())
+    {
+        temp.frameCount = frameCount;
+        index = temp;
+        saveFrameIndex(videoPath, index);
+        return;
+    }
+    cap.release();
+
+    buildFrameIndex(videoPath, index);
+    saveFrameIndex(videoPath, index);
+}
+
+bool seekByFrameIndex(VideoCapture& cap, const string& videoPath, const VideoFrameIndex& index, int frameCount)
+{
+    if (frameCount <= 0)
+        return true;
+    if (index.keyFrames.empty())
+        return false;
+
+    // 取帧编号小于 frameCount 的最近关键帧, 定位后 grab 该帧核对时间戳, 再向后 grab,
+    // 关键帧是第 0 帧或者时间戳不符时从头 grab
+    vector<pair<int, long long int> >::const_iterator itr =
+        lower_bound(index.keyFrames.begin(), index.keyFrames.end(), frameCount, LessFrameCount());
+    --itr;
+    int keyFrameCount = itr->first;
+    if (keyFrameCount == 0 || !cap.set(CV_CAP_PROP_POS_FRAMES, keyFrameCount) ||
+        !grabAndCheckTime(cap, double(itr->second), index.frameRate))
+        return seekFromBegin(cap, videoPath, frameCount);
+    for (int i = keyFrameCount + 1; i < frameCount; i++)
+    {
+        if (!cap.grab())
+            return false;
+    }
+    return true;
+}
+
+bool locateFrame(VideoCapture& cap, const string& videoPath, int frameCount, const VideoFrameIndex* ptrIndex)
+{
+    if (frameCount <= 0)
+        return true;
+    if (ptrIndex && !ptrIndex->keyFrames.empty())
+        return seekByFrameIndex(cap, videoPath, *ptrIndex, frameCount);
+
+    // 没有关键帧时按恒定帧率推算第 frameCount - 1 帧的时间戳, 
+    // 直接定位到该帧并 grab, 时间戳相差不到半帧时认为定位准确, 下一次 grab 得到第 frameCount 帧
+    double frameRate = cap.get(CV_CAP_PROP_FPS);
+    if (frameRate > 0 && cap.open(videoPath) && cap.grab())
+    {
+        double firstFrameTime = cap.get(CV_CAP_PROP_POS_MSEC);
+        double expectTime = firstFrameTime + (frameCount - 1) * 1000.0 / frameRate;
+        if (frameCount == 1 || 
+            (cap.set(CV_CAP_PROP_POS_FRAMES, frameCount - 1) && grabAndCheckTime(cap, expectTime, frameRate)))
+            return true;
+    }
+    return seekFromBegin(cap, videoPath, frameCount);
+}
+
+bool createFrameIndex(const string& videoPath)
+{
+    VideoFrameIndex index;
+    buildFrameIndex(videoPath, index);
+    return saveFrameIndex(videoPath, index);
+}
+
+}
@@ -0,0 +1,110 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <opencv2/highgui/highgui.hpp>
+
+namespace zpv
+{
+
+//! 视频帧索引
+/*!
+    VideoCapture 不提供关键帧信息, 这里的关键帧指的是按 CV_CAP_PROP_POS_FRAMES 定位后
+    得到的帧时间戳与顺序解码结果一致的位置, 从这些位置向后逐帧 grab 可以准确到达任意帧.
+    索引保存在视频文件旁边的同名 .zfi 文件中, 视频文件大小变化后需要重新建立.
+ */
+struct VideoFrameIndex
+{
+    //! 构造函数
+    VideoFrameIndex(void) : fileSize(0), frameCount(0), frameRate(0) {};
+
+    long long int fileSize;   ///< 建立索引时视频文件的字节数
+    int frameCount;           ///< 总帧数, 顺序 grab 计数或者经过校验的容器帧数
+    double frameRate;         ///< 帧率
+    //! 可以准确定位的帧编号和该帧的时间戳, 按帧编号升序排列, 第一项总是第 0 帧,
+    //! 为空表示只探测了总帧数, 还没有建立关键帧
+    std::vector<std::pair<int, long long int> > keyFrames;
+};
+
+//! 文件的字节数, 文件无法打开时返回 -1
+long long int getFileSize(const std::string& path);
+
+//! 帧索引文件的全路径
+std::string getFrameIndexPath(const std::string& videoPath);
+
+//! 读取帧索引文件
+/*!
+    \param[in] videoPath 视频文件全路径
+    \param[out] index 帧索引
+    \return 索引文件存在, 格式正确并且与视频文件大小一致时返回 true
+ */
+bool loadFrameIndex(const std::string& videoPath, VideoFrameIndex& index);
+
+//! 保存帧索引文件, 先写临时文件再改名, 同一视频的多个任务同时保存不会得到残缺的文件
+bool saveFrameIndex(const std::string& videoPath, const VideoFrameIndex& index);
+
+//! 保存 path 时使用的临时文件全路径
+/*!
+    文件名包含进程号和进程内递增的序号, 多个进程或者线程同时保存同一个文件时各自写不同的临时文件
+ */
+std::string getTempFilePath(const std::string& path);
+
+//! 把写好的临时文件改名为 path, 替换已有的文件, 失败时删除临时文件
+bool replaceWithTempFile(const std::string& tempPath, const std::string& path);
+
+//! 顺序 grab 整个视频建立帧索引
+/*!
+    可能会抛出 std::exception 类型的异常
+    \param[in] videoPath 视频文件全路径
+    \param[out] index 帧索引
+    \param[in] keyFrameIntervalInSecond 候选关键帧的间隔, 以秒计算,
+        定位到任意帧最多需要向后 grab 这么长时间的视频
+ */
+void buildFrameIndex(const std::string& videoPath, VideoFrameIndex& index, double keyFrameIntervalInSecond = 10);
+
+//! 读取帧索引, 索引文件不可用或者没有关键帧时建立索引并保存
+/*!
+    可能会抛出 std::exception 类型的异常, 索引文件保存失败不会抛出异常
+ */
+void getFrameIndex(const std::string& videoPath, VideoFrameIndex& index);
+
+//! 探测视频的总帧数和帧率, 结果保存在帧索引文件中
+/*!
+    索引文件可用时直接读取.
+    否则先采用容器记录的帧数, 定位到最后一帧 grab, 该帧的时间戳与按第 0 帧时间戳和帧率推算的值
+    相差不到半帧, 并且再次 grab 失败时认为该帧数可信, 得到的索引没有关键帧, 
+    之后 locateFrame 同样按时间戳核对定位结果. 容器帧数不可信时顺序 grab 整个视频建立完整的索引.
+    可能会抛出 std::exception 类型的异常, 索引文件保存失败不会抛出异常
+ */
+void probeFrameIndex(const std::string& videoPath, VideoFrameIndex& index);
+
+//! 利用帧索引定位, 使下一次 grab 或 read 得到第 frameCount 帧
+/*!
+    定位到小于 frameCount 的最近关键帧, grab 该帧并核对时间戳, 然后向后逐帧 grab, 不做颜色转换和拷贝.
+    最近关键帧是第 0 帧或者时间戳与索引不符时重新打开视频, 从头逐帧 grab.
+    \param[in,out] cap 已经打开的视频
+    \param[in] videoPath 视频文件全路径
+    \param[in] index 帧索引
+    \param[in] frameCount 目标帧编号
+    \return 成功返回 true
+ */
+bool seekByFrameIndex(cv::VideoCapture& cap, const std::string& videoPath,
+    const VideoFrameIndex& index, int frameCount);
+
+//! 将视频定位到第 frameCount 帧, 下一次 grab 或 read 得到的就是该帧
+/*!
+    有帧索引时定位到最近的关键帧再向后 grab.
+    没有帧索引时直接定位到第 frameCount - 1 帧并 grab, 按第 0 帧的时间戳和帧率核对该帧的时间戳.
+    如果设置失败或者时间戳相差超过半帧, 重新打开视频, 从头逐帧 grab, 只解码不做颜色转换和拷贝.
+    frameCount 大于 0 时函数会重新打开或者定位 cap, 不依赖 cap 原来的读取位置.
+    \param[in,out] cap 已经打开的视频
+    \param[in] videoPath 视频文件全路径
+    \param[in] frameCount 目标帧编号
+    \param[in] ptrIndex 帧索引, 为空或者没有关键帧时不使用
+    \return 成功返回 true
+ */
+bool locateFrame(cv::VideoCapture& cap, const std::string& videoPath, int frameCount, 
+    const VideoFrameIndex* ptrIndex = 0);
+
+}
@@ -5,11 +5,13 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include "ProcVideo.h"
 #include "VideoSplitter.h"
+#include "VideoFrameIndex.h"
 #include "OperateData.h"
 #include "ShowData.h"
 #include "Segment.h"
 #include "CreateDirectory.h"
 #include "Exception.h"
+#include "Thread.h"
 
 using namespace std;
 using namespace cv;
@@ -19,6 +21,72 @@ using namespace ztool;
 #define VIDEO_SPLIT_CMPL_LOG 0
 #define VIDEO_SPLIT_CMPL_SHOW 0
 #define VIDEO_SPLIT_CMPL_SIMPLE_METHOD 1
+// 寻找分割点时使用低开销的 ActivityProfiler 代替 VideoAnalyzer
+#define VIDEO_SPLIT_CMPL_FAST_PROFILER 1
+// 同时运行 ActivityProfiler 和 VideoAnalyzer, 打开 VIDEO_SPLIT_CMPL_LOG 时把两者找到的分割点写入日志文件用于比较
+#define VIDEO_SPLIT_CMPL_VALIDATE_PROFILER 0
+
+//! 在活跃度序列中寻找靠近 expectCount 的最宽的稀疏段, 返回其中心
+static int findSparseCenter(const vector<double>& ratioForeToFull, double maxRatioForSparse, int expectCount)
+{
+    int numOfFrames = ratioForeToFull.size();
+    vector<unsigned char> isSparse(numOfFrames, 0);
+    for (int i = 0; i < numOfFrames; i++)
+    {
+        if (ratioForeToFull[i] < maxRatioForSparse)
+            isSparse[i] = 1;
+    }
+
+#if VIDEO_SPLIT_CMPL_SHOW
+        showArrayByVertBar("Ratio Fore To Full", ratioForeToFull, false, true, true, 0, 1, true, 200);
+        showArrayByVertBar("Is Sparse", isSparse, false, true, true, 0, 1, true, 100);
+        //waitKey(0);
+#endif
+
+    vector<Segment<unsigned char> > isSparseSeg;
+    findSegments(isSparse, isSparseSeg);
+    int numOfSeg = isSparseSeg.size();
+    bool wideSegExists = false;
+    for (int i = 0; i < numOfSeg; i++)
+    {
+        if (isSparseSeg[i].length > numOfFrames * 0.1)
+        {
+            wideSegExists = true;
+            break;
+        }
+    }
+    if (!wideSegExists)
+        return expectCount;
+
+    vector<double> testRatio;
+    vector<int> index;  
+    testRatio.reserve(numOfSeg);
+    index.reserve(numOfSeg);
+    for (int i = 0; i < numOfSeg; i++)
+    {
+        if (isSparseSeg[i].data)
+        {
+            testRatio.push_back(double(isSparseSeg[i].end - isSparseSeg[i].begin) /
+                                double(abs((isSparseSeg[i].end + isSparseSeg[i].begin) / 2 - expectCount)));
+            index.push_back(i);
+        }
+    }
+    if (testRatio.size() < 1)
+        return expectCount;
+
+    int maxIndex = -1;
+    double maxRatio = -1;
+    for (int i = 0; i < testRatio.size(); i++)
+    {
+        if (testRatio[i] > maxRatio)
+        {
+            maxIndex = i;
+            maxRatio = testRatio[i];
+        }
+    }
+
+    return (isSparseSeg[index[maxIndex]].begin + isSparseSeg[index[maxIndex]].end) / 2;
+}
 
 namespace zvs
 {
@@ -193,67 +261,140 @@ int VideoAnalyzer::findSplitPosition(int expectCount)
     if (expectCount >= frameCount)
         return frameCount - 1;
 
-    vector<unsigned char> isSparse(frameCount, 0);
-    for (int i = 0; i < frameCount; i++)
-    {
-        if (ratioForeToFull[i] < maxRatioForSparse)
-            isSparse[i] = 1;
-    }
+    return findSparseCenter(ratioForeToFull, maxRatioForSparse, expectCount);
+}
 
-#if VIDEO_SPLIT_CMPL_SHOW
-        showArrayByVertBar("Ratio Fore To Full", ratioForeToFull, false, true, true, 0, 1, true, 200);
-        showArrayByVertBar("Is Sparse", isSparse, false, true, true, 0, 1, true, 100);
-        //waitKey(0);
-#endif
+void VideoAnalyzer::release(void)
+{
 
-    vector<Segment<unsigned char> > isSparseSeg;
-    findSegments(isSparse, isSparseSeg);
-    int numOfSeg = isSparseSeg.size();
-    bool wideSegExists = false;
-    for (int i = 0; i < numOfSeg; i++)
+}
+
+ActivityProfiler::ActivityProfiler()
+    : interval(1), frameCount(0), blockSize(8), maxRatioForSparse(0.05)
+{
+
+}
+
+ActivityProfiler::~ActivityProfiler()
+{
+
+}
+
+// 一次遍历完成灰度化和 Scharr 梯度计算, 只保留三行灰度值, 梯度按 L1 范数计算并截断到 255
+static void calcGrayGradient(const Mat& image, Mat& gradImage, vector<int>& rowBuf)
+{
+    if (image.type() != CV_8UC3)
+        THROW_EXCEPT("unsupported element type");
+
+    int rows = image.rows, cols = image.cols;
+    gradImage.create(rows, cols, CV_8UC1);
+    gradImage.row(0).setTo(0);
+    gradImage.row(rows - 1).setTo(0);
+    rowBuf.resize(3 * cols);
+    int* ptrGrayRows[3] = {&rowBuf[0], &rowBuf[cols], &rowBuf[2 * cols]};
+    for (int i = 0; i < rows; i++)
     {
-        if (isSparseSeg[i].length > frameCount * 0.1)
+        const unsigned char* ptrImageData = image.ptr<unsigned char>(i);
+        int* ptrGray = ptrGrayRows[i % 3];
+        for (int j = 0; j < cols; j++, ptrImageData += 3)
+            ptrGray[j] = (29 * ptrImageData[0] + 150 * ptrImageData[1] + 77 * ptrImageData[2]) >> 8;
+        if (i < 2)
+            continue;
+
+        const int* ptrUp = ptrGrayRows[(i - 2) % 3];
+        const int* ptrMid = ptrGrayRows[(i - 1) % 3];
+        const int* ptrDown = ptrGray;
+        unsigned char* ptrGradData = gradImage.ptr<unsigned char>(i - 1);
+        ptrGradData[0] = 0;
+        ptrGradData[cols - 1] = 0;
+        for (int j = 1; j < cols - 1; j++)
         {
-            wideSegExists = true;
-            break;
+            int horiGrad = 3 * (ptrUp[j - 1] - ptrUp[j + 1] + ptrDown[j - 1] - ptrDown[j + 1]) + 
+                10 * (ptrMid[j - 1] - ptrMid[j + 1]);
+            int vertGrad = 3 * (ptrUp[j - 1] + ptrUp[j + 1] - ptrDown[j - 1] - ptrDown[j + 1]) + 
+                10 * (ptrUp[j] - ptrDown[j]);
+            int grad = abs(horiGrad) + abs(vertGrad);
+            ptrGradData[j] = grad > 255 ? 255 : grad;
         }
     }
-    if (!wideSegExists)
-        return expectCount;
+}
 
-    vector<double> testRatio;
-    vector<int> index;  
-    testRatio.reserve(numOfSeg);
-    index.reserve(numOfSeg);
-    for (int i = 0; i < numOfSeg; i++)
+void ActivityProfiler::init(const Mat& image, int frameInterval)
+{
+    interval = frameInterval > 1 ? frameInterval : 1;
+    resize(image, smallImage, Size(160, 120), 0, 0, INTER_AREA);
+    calcGrayGradient(smallImage, gradImage, rowBuf);
+    backModel.init(gradImage, ViBe::Config::getGradientConfig());
+
+    ratioForeToFull.clear();
+    ratioForeToFull.push_back(0);
+    frameCount = 1;
+}
+
+bool ActivityProfiler::needFrame(void) const
+{
+    return frameCount % interval == 0;
+}
+
+void ActivityProfiler::proc(const Mat& image)
+{
+    resize(image, smallImage, Size(160, 120), 0, 0, INTER_AREA);
+    calcGrayGradient(smallImage, gradImage, rowBuf);
+    backModel.update(gradImage, gradForeImage);
+    calcActivity(gradForeImage);
+    frameCount++;
+}
+
+void ActivityProfiler::skip(void)
+{
+    frameCount++;
+}
+
+void ActivityProfiler::calcActivity(const Mat& foreImage)
+{
+    int numOfBlockRows = foreImage.rows / blockSize;
+    int numOfBlockCols = foreImage.cols / blockSize;
+    int minForeCount = blockSize * blockSize / 4;
+    vector<int> foreCount(numOfBlockCols);
+    int numOfActiveBlocks = 0;
+    for (int bi = 0; bi < numOfBlockRows; bi++)
     {
-        if (isSparseSeg[i].data)
+        fill(foreCount.begin(), foreCount.end(), 0);
+        for (int i = bi * blockSize; i < (bi + 1) * blockSize; i++)
         {
-            testRatio.push_back(double(isSparseSeg[i].end - isSparseSeg[i].begin) /
-                                double(abs((isSparseSeg[i].end + isSparseSeg[i].begin) / 2 - expectCount)));
-            index.push_back(i);
+            const unsigned char* ptrForeData = foreImage.ptr<unsigned char>(i);
+            for (int j = 0; j < numOfBlockCols * blockSize; j++)
+            {
+                if (ptrForeData[j])
+                    foreCount[j / blockSize]++;
+            }
         }
-    }
-    if (testRatio.size() < 1)
-        return expectCount;
-
-    int maxIndex = -1;
-    double maxRatio = -1;
-    for (int i = 0; i < testRatio.size(); i++)
-    {
-        if (testRatio[i] > maxRatio)
+        for (int bj = 0; bj < numOfBlockCols; bj++)
         {
-            maxIndex = i;
-            maxRatio = testRatio[i];
+            if (foreCount[bj] > minForeCount)
+                numOfActiveBlocks++;
         }
     }
-
-    return (isSparseSeg[index[maxIndex]].begin + isSparseSeg[index[maxIndex]].end) / 2;
+    ratioForeToFull.push_back(double(numOfActiveBlocks) / (numOfBlockRows * numOfBlockCols));
 }
 
-void VideoAnalyzer::release(void)
+int ActivityProfiler::findSplitPosition(int expectCount)
 {
+    if (expectCount <= 0)
+        return 0;
+    if (expectCount >= frameCount)
+        return frameCount - 1;
 
+    // ratioForeToFull 中第 i 项对应第 i * interval 帧
+    int numOfSamples = ratioForeToFull.size();
+    int expectIndex = expectCount / interval;
+    if (expectIndex >= numOfSamples)
+        expectIndex = numOfSamples - 1;
+    int centerIndex = findSparseCenter(ratioForeToFull, maxRatioForSparse, expectIndex);
+    // 没有合适的稀疏段时返回期望位置本身
+    if (centerIndex == expectIndex)
+        return expectCount;
+    return min(centerIndex * interval, frameCount - 1);
 }
 
 }
@@ -272,6 +413,144 @@ static string getDoubleString(double val)
     return strm.str();
 }
 
+namespace
+{
+//! 分割点附近的一段视频, 在其中寻找运动目标最少的位置作为分割点
+struct SplitWindow
+{
+    int begInc;               ///< 起始帧(包含)
+    int endExc;               ///< 结束帧(不包含)
+    int cutPosition;          ///< 分割点相对 begInc 的位置
+    int refCutPosition;       ///< 核对 ActivityProfiler 时 VideoAnalyzer 找到的分割点相对 begInc 的位置
+    std::string errorMessage; ///< 分析过程中抛出的异常信息
+};
+
+//! 分析分割点附近视频的工作线程, 每个线程使用独立的 VideoCapture 和 VideoAnalyzer
+/*!
+    各个线程通过共享的计数器领取窗口, 直接定位到窗口起点, 只解码窗口内的帧
+ */
+struct SplitWindowWorker
+{
+    static void entry(void* ptrWorker);
+    void run(void);
+    void analyze(VideoCapture& videoCap, SplitWindow& window);
+
+    const string* ptrVideoPath;
+    const zpv::VideoFrameIndex* ptrFrameIndex;
+    vector<SplitWindow>* ptrWindows;
+    int* ptrNextWindow;
+    int width, height;
+    ztool::Thread thread;
+};
+
+void SplitWindowWorker::entry(void* ptrWorker)
+{
+    ((SplitWindowWorker*)ptrWorker)->run();
+}
+
+void SplitWindowWorker::run(void)
+{
+    VideoCapture videoCap;
+    bool isOpened = videoCap.open(*ptrVideoPath);
+    int numOfWindows = ptrWindows->size();
+    while (true)
+    {
+        int index = CV_XADD(ptrNextWindow, 1);
+        if (index >= numOfWindows)
+            break;
+        SplitWindow& window = (*ptrWindows)[index];
+        try
+        {
+            if (!isOpened)
+                THROW_EXCEPT("cannot open file " + *ptrVideoPath);
+            analyze(videoCap, window);
+        }
+        catch (const exception& e)
+        {
+            window.errorMessage = e.what();
+        }
+    }
+}
+
+void SplitWindowWorker::analyze(VideoCapture& videoCap, SplitWindow& window)
+{
+    Mat frame, image;
+    if (!zpv::locateFrame(videoCap, *ptrVideoPath, window.begInc, ptrFrameIndex) || !videoCap.read(frame))
+        THROW_EXCEPT("cannot seek designated frame, frame count " + getIntString(window.begInc));
+#if VIDEO_SPLIT_CMPL_FAST_PROFILER
+    zvs::ActivityProfiler profiler;
+    profiler.init(frame);
+#endif
+#if !VIDEO_SPLIT_CMPL_FAST_PROFILER || VIDEO_SPLIT_CMPL_VALIDATE_PROFILER
+    resize(frame, image, Size(width, height), INTER_LINEAR);
+    zvs::VideoAnalyzer analyzer;
+    analyzer.init(image);
+#endif
+
+    for (int i = 1; i < window.endExc - window.begInc; i++)
+    {
+#if VIDEO_SPLIT_CMPL_FAST_PROFILER && !VIDEO_SPLIT_CMPL_VALIDATE_PROFILER
+        // 不需要分析的帧只 grab
+        if (!profiler.needFrame())
+        {
+            if (!videoCap.grab())
+                THROW_EXCEPT("cannot read designated frame, frame count " + getIntString(window.begInc + i));
+            profiler.skip();
+            continue;
+        }
+#endif
+        if (!videoCap.read(frame))
+            THROW_EXCEPT("cannot read designated frame, frame count " + getIntString(window.begInc + i));
+#if VIDEO_SPLIT_CMPL_FAST_PROFILER
+        if (profiler.needFrame())
+            profiler.proc(frame);
+        else
+            profiler.skip();
+#endif
+#if !VIDEO_SPLIT_CMPL_FAST_PROFILER || VIDEO_SPLIT_CMPL_VALIDATE_PROFILER
+        resize(frame, image, Size(width, height), INTER_LINEAR);
+        analyzer.proc(image);
+#endif
+    }
+
+    int expectCount = (window.endExc - window.begInc) / 2;
+#if VIDEO_SPLIT_CMPL_FAST_PROFILER
+    window.cutPosition = profiler.findSplitPosition(expectCount);
+#else
+    window.cutPosition = analyzer.findSplitPosition(expectCount);
+#endif
+#if VIDEO_SPLIT_CMPL_FAST_PROFILER && VIDEO_SPLIT_CMPL_VALIDATE_PROFILER
+    window.refCutPosition = analyzer.findSplitPosition(expectCount);
+#endif
+}
+
+//! 多线程分析所有窗口, 线程数量不超过窗口数量和 CPU 核数
+void analyzeSplitWindows(const string& videoPath, const zpv::VideoFrameIndex& frameIndex,
+    int width, int height, vector<SplitWindow>& windows)
+{
+    int numOfWindows = windows.size();
+    int numOfThreads = max(1, min(numOfWindows, getNumberOfCPUs()));
+    int nextWindow = 0;
+    vector<Ptr<SplitWindowWorker> > workers(numOfThreads);
+    for (int i = 0; i < numOfThreads; i++)
+    {
+        workers[i] = new SplitWindowWorker;
+        workers[i]->ptrVideoPath = &videoPath;
+        workers[i]->ptrFrameIndex = &frameIndex;
+        workers[i]->ptrWindows = &windows;
+        workers[i]->ptrNextWindow = &nextWindow;
+        workers[i]->width = width;
+        workers[i]->height = height;
+    }
+    // 线程启动失败时由调用者线程分析剩下的窗口
+    for (int i = 1; i < numOfThreads; i++)
+        workers[i]->thread.start(SplitWindowWorker::entry, (SplitWindowWorker*)workers[i]);
+    workers[0]->run();
+    for (int i = 1; i < numOfThreads; i++)
+        workers[i]->thread.join();
+}
+}
+
 namespace
 {
 bool findSplitPositions(const string& videoPath, const double segmentUnit, 
@@ -283,7 +562,6 @@ bool findSplitPositions(const string& videoPath, const double segmentUnit,
     splitBegAndEnd.clear();
 
     VideoCapture videoCap;
-    Mat frame, image;
 
 #if VIDEO_SPLIT_CMPL_LOG
     string videoName = videoPath;
@@ -308,10 +586,11 @@ bool findSplitPositions(const string& videoPath, const double segmentUnit,
 #endif
         THROW_EXCEPT("cannot open file " + videoPath);
     }
-    int count = 0;
-    while (videoCap.read(frame))
-        count++;
-    double videoFrameCount = count/*videoCap.get(CV_CAP_PROP_FRAME_COUNT)*/;
+    // 总帧数来自帧索引, 索引不存在时优先采用经过校验的容器帧数, 不可信时才顺序 grab 计数,
+    // 结果保存在帧索引文件中, 处理各个片段时不需要重新计数
+    zpv::VideoFrameIndex frameIndex;
+    zpv::probeFrameIndex(videoPath, frameIndex);
+    double videoFrameCount = frameIndex.frameCount/*videoCap.get(CV_CAP_PROP_FRAME_COUNT)*/;
     double videoFrameRate = videoCap.get(CV_CAP_PROP_FPS);
     if (videoFrameCount < 1.0)
     {
@@ -398,89 +677,70 @@ bool findSplitPositions(const string& videoPath, const double segmentUnit,
 #endif
 
     videoCap.release();
-    videoCap.open(videoPath);
-    count = 0;
     segmentLengthInSecond.clear();
     splitBegAndEnd.clear();
     vector<int> splitFramePos;
     splitFramePos.push_back(0);
-    for (int j = 1; j < numOfSeg; j++)
-    {
 #if VIDEO_SPLIT_CMPL_SIMPLE_METHOD
+    for (int j = 1; j < numOfSeg; j++)
         splitFramePos.push_back(splitUnitInSecond * j * videoFrameRate);
 #else
-        int center, begInc, endExc;
-        center = splitUnitInSecond * j * videoFrameRate;
-        begInc = (splitUnitInSecond * j - marginInSecond) * videoFrameRate;
-        endExc = (splitUnitInSecond * j + marginInSecond) * videoFrameRate;
-        
-        while (count <= begInc)
-        {
-            if (!videoCap.read(frame))
-                THROW_EXCEPT("cannot seek designated frame, frame count " + getIntString(begInc));
-            count++;
-        }
-        resize(frame, image, Size(width, height), INTER_LINEAR);
+    // 每个分割点只分析前后 marginInSecond 秒, 各个窗口直接定位后并行分析
+    vector<SplitWindow> windows(numOfSeg - 1);
+    for (int j = 1; j < numOfSeg; j++)
+    {
+        windows[j - 1].begInc = (splitUnitInSecond * j - marginInSecond) * videoFrameRate;
+        windows[j - 1].endExc = (splitUnitInSecond * j + marginInSecond) * videoFrameRate;
+        windows[j - 1].cutPosition = 0;
+        windows[j - 1].refCutPosition = 0;
+    }
+    analyzeSplitWindows(videoPath, frameIndex, width, height, windows);
 
-        try
+    for (int j = 1; j < numOfSeg; j++)
+    {
+        const SplitWindow& window = windows[j - 1];
+        if (!window.errorMessage.empty())
         {
-            zvs::VideoAnalyzer analyzer;
-            analyzer.init(image);       
-
-            printf("before proc count = %d\n", count);
-            for (int i = 1; i < endExc - begInc; i++)
-            {
-                if (!videoCap.read(frame))
-                {
 #if VIDEO_SPLIT_CMPL_LOG
-                    string message = "ERROR in function findSplitPositions(), "
-                                     "cannot read designated frame";
-                    logFile << message << "\n";
-                    logFile.close();
-                    cerr << message << "\n";
+            logFile << window.errorMessage << "\n";
+            logFile.close();
+            cerr << window.errorMessage << "\n";
 #endif
-                    THROW_EXCEPT("cannot read designated frame, frame count " + getIntString(begInc + i));
-                }
-                count++;
-                resize(frame, image, Size(width, height), INTER_LINEAR);
-                analyzer.proc(image);
-            }
-            printf("after proc count = %d\n", count);
-            int cutPosition = analyzer.findSplitPosition((endExc - begInc) / 2);
+            THROW_EXCEPT(window.errorMessage);
+        }
+        int begInc = window.begInc, endExc = window.endExc, cutPosition = window.cutPosition;
 #if VIDEO_SPLIT_CMPL_LOG
-            cout << "split segment " << j - 1 << " and segment " << j << ": ";
-            cout << "expected center frame count = " << center << ", "
-                 << "allowed begInc frame count = " << begInc << ", "
-                 << "allowed endExc frame count = " << endExc << ", "
-                 << "real cut position = " << begInc + cutPosition << "\n";
+        int center = splitUnitInSecond * j * videoFrameRate;
+        cout << "split segment " << j - 1 << " and segment " << j << ": ";
+        cout << "expected center frame count = " << center << ", "
+             << "allowed begInc frame count = " << begInc << ", "
+             << "allowed endExc frame count = " << endExc << ", "
+             << "real cut position = " << begInc + cutPosition << "\n";
+#if VIDEO_SPLIT_CMPL_FAST_PROFILER && VIDEO_SPLIT_CMPL_VALIDATE_PROFILER
+        logFile << fixed;
+        logFile << "split segment " << j - 1 << " and segment " << j << ": "
+                << "profiler cut position = " << begInc + cutPosition << ", "
+                << "analyzer cut position = " << begInc + window.refCutPosition << ", "
+                << "difference in second = " << setprecision(2) 
+                << abs(cutPosition - window.refCutPosition) / videoFrameRate << "\n";
+#endif
 #endif
-            splitFramePos.push_back(begInc + cutPosition);
+        splitFramePos.push_back(begInc + cutPosition);
 
 #if VIDEO_SPLIT_CMPL_SHOW
-                VideoCapture frameExtractor;
-                Mat extractFrame;
-                frameExtractor.open(videoPath);
-                frameExtractor.set(CV_CAP_PROP_POS_FRAMES, begInc + cutPosition);
-                frameExtractor.read(extractFrame);  
-                stringstream imageName;
-                imageName << "split frame " << begInc + cutPosition;
-                imshow(imageName.str(), extractFrame);
-                waitKey(0);
-                frameExtractor.release();
+            VideoCapture frameExtractor;
+            Mat extractFrame;
+            frameExtractor.open(videoPath);
+            frameExtractor.set(CV_CAP_PROP_POS_FRAMES, begInc + cutPosition);
+            frameExtractor.read(extractFrame);  
+            stringstream imageName;
+            imageName << "split frame " << begInc + cutPosition;
+            imshow(imageName.str(), extractFrame);
+            waitKey(0);
+            frameExtractor.release();
 #endif  
-        }
-        catch (const exception& s)
-        {
-#if VIDEO_SPLIT_CMPL_LOG
-            logFile << s.what() << "\n";
-            logFile.close();
-            cerr << s.what() << "\n";
-#endif
-            THROW_EXCEPT(s.what());
-        }
-#endif
     }
-    videoCap.release();
+#endif
 
     for (int i = 1; i < splitFramePos.size(); i++)
     {
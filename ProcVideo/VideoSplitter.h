@@ -45,4 +45,47 @@ private:
     double maxRatioForSparse;
 };
 
+//! 低开销的场景活跃度分析类, 用于寻找分割点
+/*!
+    与 VideoAnalyzer 相比:
+    缩放到 160x120 处理, 每 frameInterval 帧只处理一帧;
+    灰度化和梯度计算在一次遍历中完成, 不做中值滤波和高斯滤波;
+    前景按 8x8 的块计数, 前景像素占块面积超过四分之一的块为活跃块, 不提取轮廓.
+    活跃度是活跃块占全部块的比例, 寻找分割点的规则与 VideoAnalyzer 相同.
+ */
+class ActivityProfiler
+{
+public:
+    ActivityProfiler();
+    ~ActivityProfiler();
+
+    //! 初始化, image 是第一帧, frameInterval 是时间下采样的间隔
+    void init(const cv::Mat& image, int frameInterval = 3);
+    //! 下一帧是否需要处理, 需要时调用 proc, 否则调用 skip, 调用者可以只 grab 不需要处理的帧
+    bool needFrame(void) const;
+    //! 处理一帧
+    void proc(const cv::Mat& image);
+    //! 跳过一帧
+    void skip(void);
+    //! 返回分割点相对第一帧的帧编号
+    int findSplitPosition(int expectCount);
+    //! 活跃度序列, 第 i 项对应第 i * frameInterval 帧, 第一帧的活跃度为 0
+    const std::vector<double>& getActivity(void) const { return ratioForeToFull; };
+
+private:    
+    ActivityProfiler(const ActivityProfiler& profiler);
+    ActivityProfiler& operator=(const ActivityProfiler& profiler);
+
+    void calcActivity(const cv::Mat& image);
+
+    int interval;
+    int frameCount;
+    int blockSize;
+    zsfo::ViBe backModel;
+    cv::Mat smallImage, gradImage, gradForeImage;
+    std::vector<int> rowBuf;
+    std::vector<double> ratioForeToFull;
+    double maxRatioForSparse;
+};
+
 }
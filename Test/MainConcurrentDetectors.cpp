@@ -0,0 +1,198 @@
+﻿#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <exception>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "MovingObjectDetector.h"
+#include "Thread.h"
+
+using namespace std;
+using namespace cv;
+using namespace zsfo;
+using namespace ztool;
+
+// 多个 MovingObjectDetector 实例在不同线程中同时处理同一段视频,
+// 每个实例的逐帧输出应与单线程运行的结果完全一致
+
+struct DetectorRunner
+{
+    static void entry(void* ptrRunner);
+    void run(void);
+
+    const vector<StampedImage>* ptrFrames;
+    int buildBackCount;
+    string trace;          ///< 逐帧输出的文本记录
+    string errorMessage;
+    Thread thread;
+};
+
+void DetectorRunner::entry(void* ptrRunner)
+{
+    ((DetectorRunner*)ptrRunner)->run();
+}
+
+static void appendObjects(const ObjectDetails& output, int number, stringstream& strm)
+{
+    const vector<ObjectInfo>& objects = output.objects;
+    int objSize = objects.size();
+    for (int i = 0; i < objSize; i++)
+    {
+        const ObjectInfo& refObj = objects[i];
+        strm << number << " " << refObj.ID << " " << refObj.currRect.x << " " << refObj.currRect.y << " "
+             << refObj.currRect.width << " " << refObj.currRect.height << " " << refObj.isFinal << "\n";
+        if (refObj.isFinal && refObj.hasHistory)
+        {
+            int hisSize = refObj.history.size();
+            for (int j = 0; j < hisSize; j++)
+            {
+                const ObjectRecord& refRec = refObj.history[j];
+                strm << "    " << refRec.number << " " << refRec.origRect.x << " " << refRec.origRect.y << " "
+                     << refRec.origRect.width << " " << refRec.origRect.height << "\n";
+            }
+        }
+    }
+}
+
+void DetectorRunner::run(void)
+{
+    try
+    {
+        const vector<StampedImage>& frames = *ptrFrames;
+        Size normSize(320, 240);
+        vector<vector<Point> > incPts(1);
+        vector<vector<Point> > excPts;
+        incPts[0].resize(4);
+        incPts[0][0] = Point(10, 10);
+        incPts[0][1] = Point(10, 230);
+        incPts[0][2] = Point(310, 230);
+        incPts[0][3] = Point(310, 10);
+        vector<Point> catchPts(4);
+        catchPts[0] = Point(10, 120);
+        catchPts[1] = Point(10, 220);
+        catchPts[2] = Point(310, 220);
+        catchPts[3] = Point(310, 120);
+        vector<Rect> charRegions;
+
+        MovingObjectDetector mod;
+        ObjectDetails output;
+        stringstream strm;
+        mod.init(frames[0], normSize, 4, false,
+            RecordSnapshotMode::CrossBottomBound, SaveSnapshotMode::SaveSlice, 2, 1,
+            true, incPts, excPts, catchPts, 0, 0, 0, 0, charRegions);
+        int numOfFrames = frames.size();
+        for (int i = 1; i < numOfFrames; i++)
+        {
+            if (frames[i].number < buildBackCount)
+                mod.build(frames[i]);
+            else
+            {
+                mod.proc(frames[i], output);
+                appendObjects(output, frames[i].number, strm);
+            }
+        }
+        mod.final(output);
+        appendObjects(output, -1, strm);
+        trace = strm.str();
+    }
+    catch (const exception& e)
+    {
+        errorMessage = e.what();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    string videoFileName = "D:\\Files\\RTXFiles\\zhengxuping\\bb.avi";
+    int numOfThreads = 8;
+    int maxNumOfFrames = 1000;
+    if (argc > 1)
+        videoFileName = argv[1];
+    if (argc > 2)
+        numOfThreads = atoi(argv[2]);
+    if (numOfThreads < 1)
+        numOfThreads = 1;
+
+    try
+    {
+        // 先把帧读入内存, 各个线程只读共享的帧, 每个线程使用自己的检测器
+        VideoCapture cap;
+        if (!cap.open(videoFileName))
+        {
+            printf("ERROR: cannot open file %s\n", videoFileName.c_str());
+            return 1;
+        }
+        vector<StampedImage> frames;
+        while (frames.size() < maxNumOfFrames)
+        {
+            StampedImage input;
+            input.time = cap.get(CV_CAP_PROP_POS_MSEC);
+            input.number = cap.get(CV_CAP_PROP_POS_FRAMES);
+            Mat image;
+            if (!cap.read(image))
+                break;
+            input.image = image.clone();
+            frames.push_back(input);
+        }
+        if (frames.size() < 2)
+        {
+            printf("ERROR: too few frames in %s\n", videoFileName.c_str());
+            return 1;
+        }
+        printf("read %d frames\n", (int)frames.size());
+
+        DetectorRunner reference;
+        reference.ptrFrames = &frames;
+        reference.buildBackCount = 20;
+        reference.run();
+        if (!reference.errorMessage.empty())
+        {
+            printf("ERROR: reference run failed, %s\n", reference.errorMessage.c_str());
+            return 1;
+        }
+
+        vector<Ptr<DetectorRunner> > runners(numOfThreads);
+        for (int i = 0; i < numOfThreads; i++)
+        {
+            runners[i] = new DetectorRunner;
+            runners[i]->ptrFrames = &frames;
+            runners[i]->buildBackCount = 20;
+        }
+        for (int i = 0; i < numOfThreads; i++)
+        {
+            if (!runners[i]->thread.start(DetectorRunner::entry, (DetectorRunner*)runners[i]))
+                runners[i]->run();
+        }
+        for (int i = 0; i < numOfThreads; i++)
+            runners[i]->thread.join();
+
+        int numOfMismatches = 0;
+        for (int i = 0; i < numOfThreads; i++)
+        {
+            if (!runners[i]->errorMessage.empty())
+            {
+                printf("thread %d: ERROR: %s\n", i, runners[i]->errorMessage.c_str());
+                numOfMismatches++;
+            }
+            else if (runners[i]->trace != reference.trace)
+            {
+                printf("thread %d: output differs from single-threaded run\n", i);
+                numOfMismatches++;
+            }
+            else
+                printf("thread %d: match\n", i);
+        }
+        printf("%d threads, %d mismatches\n", numOfThreads, numOfMismatches);
+        // 有任何线程失败或者结果不一致时返回非零值, 便于脚本判断
+        if (numOfMismatches > 0)
+            return 1;
+    }
+    catch (exception& e)
+    {
+        printf("ERROR: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -67,6 +67,7 @@ int main(int argc, char* argv[])
             isNormScale, incPts, excPts, catchPts, &minObjectArea, &minObjectWidth, &minObjectHeight,
             &charRegionCheck, charRegions, &checkTurnAround, &maxDistRectAndBlob,
             &minRatioIntersectToSelf, &minRatioIntersectToBlob);
+        mod.setProfiling(true);
         while (true)
         {
             input.time = cap.get(CV_CAP_PROP_POS_MSEC);
@@ -132,6 +133,16 @@ int main(int argc, char* argv[])
             waitKey(10);
         }
         mod.final(output);
+
+        ProcStats stats;
+        mod.getStats(stats);
+        printf("%-12s%8s%10s%10s%10s%10s\n", "stage", "count", "mean ms", "p50 ms", "p99 ms", "max ms");
+        for (int i = 0; i <= ProcStage::Count; i++)
+        {
+            const StageStats& refStats = i < ProcStage::Count ? stats.stages[i] : stats.frame;
+            printf("%-12s%8d%10.3f%10.3f%10.3f%10.3f\n", getProcStageName(i), refStats.count,
+                refStats.meanLatency, refStats.p50Latency, refStats.p99Latency, refStats.maxLatency);
+        }
     }
     catch (exception& e)
     {
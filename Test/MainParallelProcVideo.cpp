@@ -0,0 +1,155 @@
+﻿#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <exception>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "ProcVideo.h"
+
+using namespace std;
+using namespace cv;
+using namespace zpv;
+
+// 同一段视频分别用 procVideo 单线程处理和 procVideoParallel 多线程处理, 检查片段接续的结果:
+// 1. 多线程输出的图片文件名互不相同, 不同线程不会写同一个文件
+// 2. 单线程输出的每个目标在多线程输出中最多对应一个目标, 跨越片段边界的目标没有被拆成两段或者重复输出
+// 3. 多线程输出的目标数量与单线程相差不超过 5%, 片段起点前重新建立背景带来的少量差异可以接受
+
+static void collect(float progressPercentage, const vector<ObjectInfo>& infos, void* ptrUserData)
+{
+    vector<ObjectInfo>& objects = *(vector<ObjectInfo>*)ptrUserData;
+    objects.insert(objects.end(), infos.begin(), infos.end());
+}
+
+// 两个目标起止时间的交并比
+static double calcTimeOverlapRatio(const ObjectInfo& lhs, const ObjectInfo& rhs)
+{
+    long long int interBeg = max(lhs.timeBegAndEnd.first, rhs.timeBegAndEnd.first);
+    long long int interEnd = min(lhs.timeBegAndEnd.second, rhs.timeBegAndEnd.second);
+    long long int unionBeg = min(lhs.timeBegAndEnd.first, rhs.timeBegAndEnd.first);
+    long long int unionEnd = max(lhs.timeBegAndEnd.second, rhs.timeBegAndEnd.second);
+    if (interEnd < interBeg)
+        return 0;
+    if (unionEnd == unionBeg)
+        return 1;
+    return double(interEnd - interBeg) / double(unionEnd - unionBeg);
+}
+
+// 截图位置相交的目标才可能是同一个目标
+static bool isLocationOverlapped(const ObjectInfo& lhs, const ObjectInfo& rhs)
+{
+    Rect lhsRect(lhs.sliceLocation.x, lhs.sliceLocation.y, lhs.sliceLocation.width, lhs.sliceLocation.height);
+    Rect rhsRect(rhs.sliceLocation.x, rhs.sliceLocation.y, rhs.sliceLocation.width, rhs.sliceLocation.height);
+    return (lhsRect & rhsRect).area() > 0;
+}
+
+// 截图文件名不能重复, 全景图只能由同一帧的目标共用
+static bool checkUniqueFileNames(const vector<ObjectInfo>& objects)
+{
+    set<string> sliceNames;
+    map<string, int> sceneFrameCounts;
+    bool success = true;
+    for (int i = 0; i < objects.size(); i++)
+    {
+        const string& sliceName = objects[i].sliceName;
+        if (!sliceName.empty() && !sliceNames.insert(sliceName).second)
+        {
+            printf("file name %s used by more than one object\n", sliceName.c_str());
+            success = false;
+        }
+        const string& sceneName = objects[i].sceneName;
+        if (sceneName.empty())
+            continue;
+        map<string, int>::iterator itr = sceneFrameCounts.find(sceneName);
+        if (itr == sceneFrameCounts.end())
+            sceneFrameCounts[sceneName] = objects[i].frameCount;
+        else if (itr->second != objects[i].frameCount)
+        {
+            printf("file name %s used by objects in different frames\n", sceneName.c_str());
+            success = false;
+        }
+    }
+    return success;
+}
+
+static bool checkStitching(const vector<ObjectInfo>& sequential, const vector<ObjectInfo>& parallel)
+{
+    static const double minPartOverlapRatio = 0.1;
+    bool success = true;
+    for (int i = 0; i < sequential.size(); i++)
+    {
+        // 与单线程目标在时间上明显重叠并且位置相交的多线程目标超过一个, 说明跨越片段边界的目标没有接续上
+        int numOfParts = 0;
+        for (int j = 0; j < parallel.size(); j++)
+        {
+            if (isLocationOverlapped(sequential[i], parallel[j]) &&
+                calcTimeOverlapRatio(sequential[i], parallel[j]) > minPartOverlapRatio)
+                numOfParts++;
+        }
+        if (numOfParts > 1)
+        {
+            printf("object %d (%lld, %lld) split into %d objects\n", sequential[i].objectID,
+                sequential[i].timeBegAndEnd.first, sequential[i].timeBegAndEnd.second, numOfParts);
+            success = false;
+        }
+    }
+
+    int diff = abs(int(sequential.size()) - int(parallel.size()));
+    if (diff > max(1, int(sequential.size() * 0.05)))
+    {
+        printf("object count mismatch: sequential %d, parallel %d\n", int(sequential.size()), int(parallel.size()));
+        success = false;
+    }
+    return success;
+}
+
+int main(int argc, char* argv[])
+{
+    string videoPath = argc > 1 ? argv[1] : "D:/SHARED/TaicangVideo/1/70.flv";
+    int numOfThreads = argc > 2 ? atoi(argv[2]) : 4;
+
+    VideoCapture cap;
+    if (!cap.open(videoPath))
+    {
+        printf("cannot open %s\n", videoPath.c_str());
+        return 1;
+    }
+    int totalFrameCount = cap.get(CV_CAP_PROP_FRAME_COUNT);
+    cap.release();
+
+    TaskInfo task;
+    ConfigInfo config;
+    task.taskID = "0XFFFF";
+    task.videoSegmentID = "0XABCD";
+    task.videoPath = videoPath;
+    task.historyFileName = "history.txt";
+    task.frameCountBegAndEnd = make_pair(0, totalFrameCount - 1);
+    config.tiltType = TiltType::MIDDLE_ANGLE;
+    config.zoomType = ZoomType::MIDDLE_SCENE;
+    config.environmentType = EnvironmentType::SUNNY;
+    config.numOfEncoderThreads = 2;
+
+    vector<ObjectInfo> sequential, parallel;
+    try
+    {
+        task.saveImagePath = task.saveHistoryPath = "result/sequential";
+        procVideo(task, config, collect, &sequential);
+        task.saveImagePath = task.saveHistoryPath = "result/parallel";
+        procVideoParallel(task, config, numOfThreads, collect, &parallel);
+    }
+    catch (const exception& e)
+    {
+        printf("%s\n", e.what());
+        return 1;
+    }
+
+    bool success = checkUniqueFileNames(parallel);
+    success = checkStitching(sequential, parallel) && success;
+    printf("sequential %d objects, parallel %d objects, %s\n", 
+        int(sequential.size()), int(parallel.size()), success ? "PASS" : "FAIL");
+    return success ? 0 : 1;
+}
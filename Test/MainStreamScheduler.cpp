@@ -0,0 +1,230 @@
+﻿#include <cstdio>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "StreamScheduler.h"
+#include "Thread.h"
+
+using namespace std;
+using namespace cv;
+using namespace ztool;
+
+// 检查 StreamScheduler 的调度行为:
+// 1. 同一视频流的任务按提交顺序串行执行
+// 2. 只有一个工作线程时, 所有实时视频流的任务都在积压录像的任务之前执行
+// 3. 一个工作线程被长任务占用时, 排在它就绪队列中的视频流由空闲的工作线程执行
+// 4. flush 返回时所有任务都已执行完毕
+
+//! 记录任务执行顺序的视频流
+struct OrderedStream
+{
+    OrderedStream(void) : numOfInside(0), nextSeq(0), numOfErrors(0) {};
+    int numOfInside;   ///< 正在执行的任务数量, 用 CV_XADD 修改
+    int nextSeq;       ///< 下一个应该执行的任务序号
+    int numOfErrors;
+};
+
+struct OrderedTask
+{
+    OrderedStream* ptrStream;
+    int seq;
+};
+
+static void runOrderedTask(void* ptrTask)
+{
+    OrderedTask& task = *(OrderedTask*)ptrTask;
+    OrderedStream& stream = *task.ptrStream;
+    if (CV_XADD(&stream.numOfInside, 1) != 0)
+        stream.numOfErrors++;
+    if (task.seq != stream.nextSeq)
+        stream.numOfErrors++;
+    stream.nextSeq++;
+    volatile double sum = 0;
+    for (int i = 0; i < 2000 * (1 + task.seq % 3); i++)
+        sum += i * 0.5;
+    CV_XADD(&stream.numOfInside, -1);
+}
+
+static bool testSerialOrder(void)
+{
+    const int numOfStreams = 12, numOfTasks = 500;
+    StreamScheduler scheduler;
+    scheduler.init(4);
+    vector<OrderedStream> streams(numOfStreams);
+    vector<vector<OrderedTask> > tasks(numOfStreams, vector<OrderedTask>(numOfTasks));
+    vector<int> streamIDs(numOfStreams);
+    for (int i = 0; i < numOfStreams; i++)
+        streamIDs[i] = scheduler.addStream(i % 3 == 0 ? StreamPriority::Live : StreamPriority::Backlog);
+    for (int k = 0; k < numOfTasks; k++)
+    {
+        for (int i = 0; i < numOfStreams; i++)
+        {
+            tasks[i][k].ptrStream = &streams[i];
+            tasks[i][k].seq = k;
+            scheduler.submit(streamIDs[i], runOrderedTask, &tasks[i][k]);
+        }
+    }
+    scheduler.flush();
+
+    bool success = true;
+    for (int i = 0; i < numOfStreams; i++)
+    {
+        StreamStatus status;
+        scheduler.getStreamStatus(streamIDs[i], status);
+        if (streams[i].numOfErrors || streams[i].nextSeq != numOfTasks || status.numOfFinished != numOfTasks)
+        {
+            printf("stream %d: %d errors, %d of %d tasks run, %d finished\n",
+                i, streams[i].numOfErrors, streams[i].nextSeq, numOfTasks, status.numOfFinished);
+            success = false;
+        }
+    }
+    return success;
+}
+
+//! 阻塞工作线程直到被释放的任务
+struct BlockingTask
+{
+    Semaphore started;
+    Semaphore release;
+};
+
+static void runBlockingTask(void* ptrTask)
+{
+    BlockingTask& task = *(BlockingTask*)ptrTask;
+    task.started.post();
+    task.release.wait();
+}
+
+//! 记录执行顺序的任务
+struct LoggedTask
+{
+    int label;
+    cv::Mutex* ptrMtx;
+    vector<int>* ptrLog;
+    Semaphore* ptrDone;
+};
+
+static void runLoggedTask(void* ptrTask)
+{
+    LoggedTask& task = *(LoggedTask*)ptrTask;
+    {
+        cv::AutoLock lock(*task.ptrMtx);
+        task.ptrLog->push_back(task.label);
+    }
+    if (task.ptrDone)
+        task.ptrDone->post();
+}
+
+static bool testPriority(void)
+{
+    StreamScheduler scheduler;
+    scheduler.init(1);
+    int blockStream = scheduler.addStream(StreamPriority::Backlog);
+    int backlogStream = scheduler.addStream(StreamPriority::Backlog);
+    int liveStream = scheduler.addStream(StreamPriority::Live);
+
+    // 唯一的工作线程被占用时先提交积压录像的任务, 再提交实时视频流的任务
+    BlockingTask blocker;
+    scheduler.submit(blockStream, runBlockingTask, &blocker);
+    blocker.started.wait();
+    const int numOfTasks = 8;
+    cv::Mutex mtx;
+    vector<int> log;
+    vector<LoggedTask> tasks(2 * numOfTasks);
+    for (int i = 0; i < 2 * numOfTasks; i++)
+    {
+        tasks[i].label = i < numOfTasks ? StreamPriority::Backlog : StreamPriority::Live;
+        tasks[i].ptrMtx = &mtx;
+        tasks[i].ptrLog = &log;
+        tasks[i].ptrDone = 0;
+        scheduler.submit(i < numOfTasks ? backlogStream : liveStream, runLoggedTask, &tasks[i]);
+    }
+    blocker.release.post();
+    scheduler.flush();
+
+    bool success = log.size() == 2 * numOfTasks;
+    for (int i = 0; success && i < log.size(); i++)
+        success = log[i] == (i < numOfTasks ? StreamPriority::Live : StreamPriority::Backlog);
+    if (!success)
+        printf("live tasks did not run before backlog tasks\n");
+    return success;
+}
+
+static bool testIdleWorkerTakesOver(void)
+{
+    StreamScheduler scheduler;
+    scheduler.init(2);
+    // 视频流轮流分配给工作线程, 编号为 0, 2, 4 的视频流的就绪队列属于同一个工作线程
+    int streamIDs[6];
+    for (int i = 0; i < 6; i++)
+        streamIDs[i] = scheduler.addStream(StreamPriority::Live);
+
+    // 一个工作线程被长任务占用, 其他视频流的任务必须由另一个线程在长任务结束前执行完
+    BlockingTask blocker;
+    scheduler.submit(streamIDs[0], runBlockingTask, &blocker);
+    blocker.started.wait();
+    cv::Mutex mtx;
+    vector<int> log;
+    Semaphore done;
+    LoggedTask tasks[2];
+    for (int i = 0; i < 2; i++)
+    {
+        tasks[i].label = i;
+        tasks[i].ptrMtx = &mtx;
+        tasks[i].ptrLog = &log;
+        tasks[i].ptrDone = &done;
+        scheduler.submit(streamIDs[2 + 2 * i], runLoggedTask, &tasks[i]);
+    }
+    bool success = done.wait(5000) && done.wait(5000);
+    blocker.release.post();
+    scheduler.flush();
+    if (!success)
+        printf("streams queued behind a busy worker were not taken over by the idle worker\n");
+    return success;
+}
+
+static bool testFlush(void)
+{
+    StreamScheduler scheduler;
+    scheduler.init(2);
+    int streamID = scheduler.addStream(StreamPriority::Backlog);
+    BlockingTask blocker;
+    scheduler.submit(streamID, runBlockingTask, &blocker);
+    blocker.started.wait();
+
+    // flush 在另一个线程中等待, 任务结束前不应返回
+    struct Flusher
+    {
+        static void entry(void* ptrFlusher)
+        {
+            Flusher& flusher = *(Flusher*)ptrFlusher;
+            flusher.ptrScheduler->flush(flusher.streamID);
+            flusher.returned.set();
+        }
+        StreamScheduler* ptrScheduler;
+        int streamID;
+        AtomicFlag returned;
+    } flusher;
+    flusher.ptrScheduler = &scheduler;
+    flusher.streamID = streamID;
+    Thread thread;
+    thread.start(Flusher::entry, &flusher);
+    sleepInMilliSecond(100);
+    bool success = !flusher.returned.isSet();
+    blocker.release.post();
+    thread.join();
+    success = success && flusher.returned.isSet();
+    if (!success)
+        printf("flush returned before the stream finished\n");
+    return success;
+}
+
+int main(int argc, char* argv[])
+{
+    bool success = true;
+    success = testSerialOrder() && success;
+    success = testPriority() && success;
+    success = testIdleWorkerTakesOver() && success;
+    success = testFlush() && success;
+    printf("%s\n", success ? "PASS" : "FAIL");
+    return success ? 0 : 1;
+}
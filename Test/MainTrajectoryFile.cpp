@@ -0,0 +1,195 @@
+﻿#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <exception>
+#include "TrajectoryFile.h"
+
+using namespace std;
+using namespace cv;
+using namespace zsfo;
+
+// 文本轨迹文件转换成二进制文件后再读回, 读回的记录应与文本中的记录完全一致,
+// 格式错误的文本不应留下二进制文件, 数据块长度被改写的二进制文件应打开失败
+
+struct TextObject
+{
+    int ID;
+    vector<TrajectoryRecord> records;
+};
+
+static void makeObjects(vector<TextObject>& objects)
+{
+    objects.resize(3);
+    for (int i = 0; i < objects.size(); i++)
+    {
+        objects[i].ID = 100 + i * 7;
+        int size = 1 + i * 40;
+        objects[i].records.resize(size);
+        for (int j = 0; j < size; j++)
+        {
+            TrajectoryRecord& record = objects[i].records[j];
+            record.number = 25 * i + 2 * j;
+            record.time = 1400000000000LL + record.number * 40;
+            // 坐标有增有减, 覆盖负的差值
+            record.rect = Rect(160 + (j % 7) * 9 - 30, 120 - (j % 5) * 11, 20 + j % 3, 40 - j % 4);
+        }
+    }
+}
+
+static bool writeText(const string& path, const vector<TextObject>& objects, bool truncate)
+{
+    ofstream file(path.c_str());
+    if (!file.is_open())
+        return false;
+    for (int i = 0; i < objects.size(); i++)
+    {
+        const vector<TrajectoryRecord>& records = objects[i].records;
+        file << "Object Count:  " << i + 1 << "\n";
+        file << "ID:            " << objects[i].ID << "\n";
+        file << "Size:          " << records.size() << "\n";
+        file << "Frame Count Time Stamp       x       y       w       h\n";
+        // 最后一个目标少写一行记录, 用来检查格式错误的处理
+        int size = (truncate && i == objects.size() - 1) ? records.size() - 1 : records.size();
+        for (int j = 0; j < size; j++)
+        {
+            file << records[j].number << " " << records[j].time << " " << records[j].rect.x << " "
+                 << records[j].rect.y << " " << records[j].rect.width << " " << records[j].rect.height << "\n";
+        }
+        file << "\n";
+    }
+    if (!truncate)
+        file << "End\n";
+    return true;
+}
+
+static bool isSameRecord(const TrajectoryRecord& lhs, const TrajectoryRecord& rhs)
+{
+    return lhs.number == rhs.number && lhs.time == rhs.time && lhs.rect == rhs.rect;
+}
+
+static bool checkReadBack(const string& path, const vector<TextObject>& objects)
+{
+    TrajectoryFileReader reader;
+    if (!reader.open(path))
+    {
+        printf("cannot open %s\n", path.c_str());
+        return false;
+    }
+    if (reader.getNumOfObjects() != objects.size())
+    {
+        printf("object count mismatch: %d vs %d\n", reader.getNumOfObjects(), (int)objects.size());
+        return false;
+    }
+    for (int i = 0; i < objects.size(); i++)
+    {
+        const vector<TrajectoryRecord>& expected = objects[i].records;
+        vector<TrajectoryRecord> records;
+        reader.getRecords(i, records);
+        pair<long long int, long long int> timeBegAndEnd = reader.getTimeBegAndEnd(i);
+        if (reader.getObjectID(i) != objects[i].ID || reader.getNumOfRecords(i) != expected.size() ||
+            records.size() != expected.size() || timeBegAndEnd.first != expected.front().time ||
+            timeBegAndEnd.second != expected.back().time)
+        {
+            printf("object %d header mismatch\n", i);
+            return false;
+        }
+        for (int j = 0; j < expected.size(); j++)
+        {
+            if (!isSameRecord(records[j], expected[j]))
+            {
+                printf("object %d record %d mismatch\n", i, j);
+                return false;
+            }
+        }
+    }
+    try
+    {
+        reader.getObjectID(objects.size());
+        printf("out of range index not rejected\n");
+        return false;
+    }
+    catch (const exception&)
+    {
+    }
+    return true;
+}
+
+static bool checkCorruptBinary(const string& path, const string& corruptPath)
+{
+    ifstream src(path.c_str(), ios::binary);
+    vector<char> bytes((istreambuf_iterator<char>(src)), istreambuf_iterator<char>());
+    src.close();
+    // 改写第一个数据块的第一列长度, 文件头, 索引和文件尾都完好, 但是列长度超出数据块
+    for (int i = 16; i < 20; i++)
+        bytes[i] = (char)0xff;
+    ofstream dst(corruptPath.c_str(), ios::binary);
+    dst.write(&bytes[0], bytes.size());
+    dst.close();
+
+    TrajectoryFileReader reader;
+    if (reader.open(corruptPath))
+    {
+        printf("corrupt binary file opened\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    string dir = argc > 1 ? argv[1] : ".";
+    string textPath = dir + "/TrajectoryFileTest.txt";
+    string binaryPath = dir + "/TrajectoryFileTest.trk";
+    string badTextPath = dir + "/TrajectoryFileTestBad.txt";
+    string badBinaryPath = dir + "/TrajectoryFileTestBad.trk";
+    string corruptPath = dir + "/TrajectoryFileTestCorrupt.trk";
+
+    vector<TextObject> objects;
+    makeObjects(objects);
+    bool success = true;
+    try
+    {
+        if (!writeText(textPath, objects, false) || !writeText(badTextPath, objects, true))
+        {
+            printf("cannot write text files in %s\n", dir.c_str());
+            return 1;
+        }
+
+        if (!convertTrajectoryTextToBinary(textPath, binaryPath))
+        {
+            printf("convert %s failed\n", textPath.c_str());
+            success = false;
+        }
+        else
+        {
+            success = checkReadBack(binaryPath, objects) && success;
+            success = checkCorruptBinary(binaryPath, corruptPath) && success;
+        }
+
+        if (convertTrajectoryTextToBinary(badTextPath, badBinaryPath))
+        {
+            printf("convert malformed %s succeeded\n", badTextPath.c_str());
+            success = false;
+        }
+        if (ifstream(badBinaryPath.c_str()).is_open())
+        {
+            printf("partial binary file %s left behind\n", badBinaryPath.c_str());
+            success = false;
+        }
+    }
+    catch (const exception& e)
+    {
+        printf("exception: %s\n", e.what());
+        success = false;
+    }
+
+    remove(textPath.c_str());
+    remove(binaryPath.c_str());
+    remove(badTextPath.c_str());
+    remove(badBinaryPath.c_str());
+    remove(corruptPath.c_str());
+    printf("%s\n", success ? "PASS" : "FAIL");
+    return success ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+﻿#include <deque>
+#include <set>
+#include <opencv2/highgui/highgui.hpp>
+#include "AsyncImageWriter.h"
+#include "Thread.h"
+#include "Exception.h"
+
+namespace ztool
+{
+
+struct AsyncImageWriter::Impl
+{
+    Impl(void);
+    ~Impl(void);
+    void init(int numOfThreads, int queueCapacity, bool dropWhenFull);
+    long long int submit(const std::string& path, cv::Mat& image);
+    bool hasFinished(long long int ticket);
+    bool hasWritten(long long int ticket);
+    void flush(void);
+    void stop(void);
+    void getStatus(ImageWriteStatus& status);
+
+    static void workEntry(void* ptrImpl);
+    void work(void);
+    bool write(const std::string& path, const cv::Mat& image);
+    void addFailed(long long int ticket);
+
+    struct Task
+    {
+        long long int ticket;
+        std::string path;
+        cv::Mat image;
+    };
+
+    int capacity;
+    bool dropNewTask;
+    std::vector<cv::Ptr<Thread> > threads;
+    AtomicFlag stopFlag;
+    cv::Ptr<Semaphore> numOfTasks;         ///< 计数等于队列中的任务数量, 后台线程在上面等待任务
+    cv::Ptr<Semaphore> numOfFreeSlots;     ///< 计数等于队列中的空位数量, 提交者在上面等待空位
+    Semaphore allFinished;                 ///< 所有任务完成时唤醒 flush 中等待的线程
+    int numOfFlushWaiters;                 ///< 在 flush 中等待的线程数量, 由 mtx 保护
+    cv::Mutex mtx;
+    std::deque<Task> tasks;                ///< 等待写入的任务
+    std::set<long long int> unfinished;    ///< 等待写入和正在写入的任务编号
+    std::set<long long int> failed;        ///< 写入失败并且尚未被 hasWritten 查询的任务编号, 最多 maxNumOfFailed 个
+    long long int nextTicket;
+    ImageWriteStatus status;
+};
+
+// 写入失败的任务编号最多保留的数量, 超过时丢弃最早的记录, 从不查询结果的调用者也不会无限增长
+static const int maxNumOfFailed = 1024;
+
+AsyncImageWriter::Impl::Impl(void)
+    : capacity(0), dropNewTask(false), numOfFlushWaiters(0), nextTicket(0)
+{
+    status.queueDepth = 0;
+    status.maxQueueDepth = 0;
+    status.numOfSubmitted = 0;
+    status.numOfWritten = 0;
+    status.numOfFailed = 0;
+    status.numOfDropped = 0;
+}
+
+AsyncImageWriter::Impl::~Impl(void)
+{
+    stop();
+}
+
+void AsyncImageWriter::Impl::init(int numOfThreads, int queueCapacity, bool dropWhenFull)
+{
+    stop();
+
+    capacity = queueCapacity > 0 ? queueCapacity : 1;
+    dropNewTask = dropWhenFull;
+    stopFlag.reset();
+    if (numOfThreads <= 0)
+        return;
+
+    // 重新初始化时丢弃上一轮残留的信号量计数
+    numOfTasks = new Semaphore;
+    numOfFreeSlots = new Semaphore;
+    numOfFreeSlots->post(capacity);
+    threads.resize(numOfThreads);
+    for (int i = 0; i < numOfThreads; i++)
+    {
+        threads[i] = new Thread;
+        if (!threads[i]->start(workEntry, this))
+        {
+            stop();
+            THROW_EXCEPT("cannot start image writer thread");
+        }
+    }
+}
+
+long long int AsyncImageWriter::Impl::submit(const std::string& path, cv::Mat& image)
+{
+    Task task;
+    task.path = path;
+    task.image = image;
+    image.release();
+
+    if (threads.empty())
+    {
+        cv::AutoLock lock(mtx);
+        task.ticket = nextTicket++;
+        status.numOfSubmitted++;
+        bool success = write(task.path, task.image);
+        if (success)
+            status.numOfWritten++;
+        else
+        {
+            status.numOfFailed++;
+            addFailed(task.ticket);
+        }
+        return task.ticket;
+    }
+
+    // 队列满时丢弃或者阻塞等待后台线程取走任务
+    if (!numOfFreeSlots->wait(dropNewTask ? 0 : -1))
+    {
+        cv::AutoLock lock(mtx);
+        status.numOfSubmitted++;
+        status.numOfDropped++;
+        return -1;
+    }
+    {
+        cv::AutoLock lock(mtx);
+        task.ticket = nextTicket++;
+        status.numOfSubmitted++;
+        unfinished.insert(task.ticket);
+        tasks.push_back(task);
+        status.queueDepth = tasks.size();
+        if (status.queueDepth > status.maxQueueDepth)
+            status.maxQueueDepth = status.queueDepth;
+    }
+    numOfTasks->post();
+    return task.ticket;
+}
+
+bool AsyncImageWriter::Impl::hasFinished(long long int ticket)
+{
+    cv::AutoLock lock(mtx);
+    return unfinished.find(ticket) == unfinished.end();
+}
+
+bool AsyncImageWriter::Impl::hasWritten(long long int ticket)
+{
+    if (ticket < 0)
+        return false;
+    cv::AutoLock lock(mtx);
+    if (unfinished.find(ticket) != unfinished.end())
+        return false;
+    // 失败的结果报告一次后删除记录
+    return failed.erase(ticket) == 0;
+}
+
+void AsyncImageWriter::Impl::addFailed(long long int ticket)
+{
+    // 调用者已经加锁
+    failed.insert(ticket);
+    if (int(failed.size()) > maxNumOfFailed)
+        failed.erase(failed.begin());
+}
+
+void AsyncImageWriter::Impl::flush(void)
+{
+    while (true)
+    {
+        {
+            cv::AutoLock lock(mtx);
+            if (unfinished.empty())
+                return;
+            numOfFlushWaiters++;
+        }
+        allFinished.wait();
+    }
+}
+
+void AsyncImageWriter::Impl::stop(void)
+{
+    if (threads.empty())
+        return;
+
+    flush();
+    stopFlag.set();
+    numOfTasks->post(threads.size());
+    for (int i = 0; i < threads.size(); i++)
+        threads[i]->join();
+    threads.clear();
+}
+
+void AsyncImageWriter::Impl::getStatus(ImageWriteStatus& currStatus)
+{
+    cv::AutoLock lock(mtx);
+    currStatus = status;
+}
+
+void AsyncImageWriter::Impl::workEntry(void* ptrImpl)
+{
+    ((Impl*)ptrImpl)->work();
+}
+
+void AsyncImageWriter::Impl::work(void)
+{
+    while (true)
+    {
+        // 每个任务对应一个计数, stop 时再为每个线程加一个计数, 所以取到计数时队列为空说明需要退出
+        numOfTasks->wait();
+        Task task;
+        {
+            cv::AutoLock lock(mtx);
+            if (tasks.empty())
+            {
+                if (stopFlag.isSet())
+                    return;
+                continue;
+            }
+            task = tasks.front();
+            tasks.pop_front();
+            status.queueDepth = tasks.size();
+        }
+        numOfFreeSlots->post();
+
+        bool success = write(task.path, task.image);
+        task.image.release();
+        cv::AutoLock lock(mtx);
+        if (success)
+            status.numOfWritten++;
+        else
+        {
+            status.numOfFailed++;
+            addFailed(task.ticket);
+        }
+        unfinished.erase(task.ticket);
+        if (unfinished.empty() && numOfFlushWaiters > 0)
+        {
+            allFinished.post(numOfFlushWaiters);
+            numOfFlushWaiters = 0;
+        }
+    }
+}
+
+bool AsyncImageWriter::Impl::write(const std::string& path, const cv::Mat& image)
+{
+    if (!image.data)
+        return false;
+    try
+    {
+        return cv::imwrite(path, image);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+AsyncImageWriter::AsyncImageWriter(void)
+{
+    ptrImpl = new Impl;
+}
+
+AsyncImageWriter::~AsyncImageWriter(void)
+{
+    ptrImpl->stop();
+}
+
+void AsyncImageWriter::init(int numOfThreads, int queueCapacity, bool dropWhenFull)
+{
+    ptrImpl->init(numOfThreads, queueCapacity, dropWhenFull);
+}
+
+long long int AsyncImageWriter::submit(const std::string& path, cv::Mat& image)
+{
+    return ptrImpl->submit(path, image);
+}
+
+bool AsyncImageWriter::hasFinished(long long int ticket)
+{
+    return ptrImpl->hasFinished(ticket);
+}
+
+bool AsyncImageWriter::hasWritten(long long int ticket)
+{
+    return ptrImpl->hasWritten(ticket);
+}
+
+void AsyncImageWriter::flush(void)
+{
+    ptrImpl->flush();
+}
+
+void AsyncImageWriter::getStatus(ImageWriteStatus& status)
+{
+    ptrImpl->getStatus(status);
+}
+
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace ztool
+{
+
+//! 异步写图片的统计信息
+struct ImageWriteStatus
+{
+    int queueDepth;       ///< 当前队列中等待写入的图片数量
+    int maxQueueDepth;    ///< 队列中等待写入的图片数量的最大值
+    int numOfSubmitted;   ///< 提交的写图片任务数量
+    int numOfWritten;     ///< 成功写入的图片数量
+    int numOfFailed;      ///< 写入失败的图片数量
+    int numOfDropped;     ///< 队列满时被丢弃的图片数量
+};
+
+//! 后台编码并写图片的线程池
+/*!
+    调用者线程提交图片, 后台线程调用 imwrite 编码并写文件, 避免 jpg 编码阻塞分析.
+    提交时接管 cv::Mat 的数据, 不复制像素, 调用者手中的 cv::Mat 会被释放.
+    队列有上限, 队列满时可以选择等待或者丢弃.
+    线程数量小于等于 0 时在提交函数中直接写图片, 行为和同步写图片相同.
+ */
+class AsyncImageWriter
+{
+public:
+    AsyncImageWriter(void);
+    //! 析构前会等待所有已提交的图片写完
+    ~AsyncImageWriter(void);
+    //! 初始化
+    /*!
+        \param[in] numOfThreads 后台线程数量, 小于等于 0 时同步写图片
+        \param[in] queueCapacity 队列最多容纳的图片数量
+        \param[in] dropWhenFull 队列满时是否丢弃新提交的图片, 否则等待队列有空位
+     */
+    void init(int numOfThreads, int queueCapacity, bool dropWhenFull = false);
+    //! 提交写图片任务
+    /*!
+        \param[in] path 图片文件全路径
+        \param[in,out] image 需要写入的图片, 函数返回后 image 为空
+        \return 任务编号, 用于 hasFinished 查询, 图片被丢弃时返回 -1
+     */
+    long long int submit(const std::string& path, cv::Mat& image);
+    //! 编号为 ticket 的任务是否已经完成, 写入失败, 被丢弃也视为完成
+    bool hasFinished(long long int ticket);
+    //! 编号为 ticket 的任务是否已经成功写入, 等待写入, 写入失败和被丢弃的任务都返回 false
+    /*!
+        已经完成的任务的结果只能查询一次, 写入失败的记录在查询后删除, 再次查询返回 true.
+        只保留最近 1024 个写入失败的记录, 更早的失败任务查询时也返回 true
+     */
+    bool hasWritten(long long int ticket);
+    //! 等待所有已提交的图片写完
+    void flush(void);
+    //! 获取统计信息
+    void getStatus(ImageWriteStatus& status);
+
+private:
+    AsyncImageWriter(const AsyncImageWriter&);
+    AsyncImageWriter& operator=(const AsyncImageWriter&);
+
+    struct Impl;
+    cv::Ptr<Impl> ptrImpl;
+};
+
+}
@@ -0,0 +1,118 @@
+﻿#include <cstring>
+#include <opencv2/core/core.hpp>
+#include "BufferedTextWriter.h"
+
+namespace ztool
+{
+
+BufferedTextWriter::BufferedTextWriter(void)
+    : file(0), length(0), flushIntervalInTicks(0), lastFlushTick(0)
+{
+
+}
+
+BufferedTextWriter::~BufferedTextWriter(void)
+{
+    close();
+}
+
+bool BufferedTextWriter::open(const std::string& path, bool append, int bufferSize, int flushIntervalInMilliSecond)
+{
+    close();
+    file = fopen(path.c_str(), append ? "a" : "w");
+    if (!file)
+        return false;
+    buffer.resize(bufferSize > 256 ? bufferSize : 256);
+    length = 0;
+    flushIntervalInTicks = flushIntervalInMilliSecond > 0 ? 
+        (long long int)(flushIntervalInMilliSecond * 0.001 * cv::getTickFrequency()) : 0;
+    lastFlushTick = cv::getTickCount();
+    return true;
+}
+
+bool BufferedTextWriter::isOpen(void) const
+{
+    return file != 0;
+}
+
+BufferedTextWriter& BufferedTextWriter::write(const char* str)
+{
+    append(str, strlen(str));
+    return *this;
+}
+
+BufferedTextWriter& BufferedTextWriter::write(const std::string& str)
+{
+    append(str.data(), str.size());
+    return *this;
+}
+
+BufferedTextWriter& BufferedTextWriter::write(long long int val, int width)
+{
+    // 从低位向高位填充数字, 最多 20 位数字加上负号
+    char digits[24];
+    int pos = sizeof(digits);
+    bool negative = val < 0;
+    unsigned long long int absVal = negative ? 0ULL - (unsigned long long int)val : (unsigned long long int)val;
+    do
+    {
+        digits[--pos] = char('0' + absVal % 10);
+        absVal /= 10;
+    }
+    while (absVal);
+    if (negative)
+        digits[--pos] = '-';
+    int numOfChars = sizeof(digits) - pos;
+    static const char spaces[] = "                                ";
+    for (int numOfSpaces = width - numOfChars; numOfSpaces > 0; numOfSpaces -= sizeof(spaces) - 1)
+        append(spaces, numOfSpaces < int(sizeof(spaces) - 1) ? numOfSpaces : int(sizeof(spaces) - 1));
+    append(digits + pos, numOfChars);
+    return *this;
+}
+
+void BufferedTextWriter::endRecord(void)
+{
+    if (flushIntervalInTicks > 0 && cv::getTickCount() - lastFlushTick > flushIntervalInTicks)
+        flush();
+}
+
+void BufferedTextWriter::flush(void)
+{
+    if (!file)
+        return;
+    if (length > 0)
+        fwrite(&buffer[0], 1, length, file);
+    length = 0;
+    fflush(file);
+    lastFlushTick = cv::getTickCount();
+}
+
+void BufferedTextWriter::close(void)
+{
+    if (!file)
+        return;
+    flush();
+    fclose(file);
+    file = 0;
+}
+
+void BufferedTextWriter::append(const char* data, int dataLength)
+{
+    if (!file || dataLength <= 0)
+        return;
+    if (length + dataLength > int(buffer.size()))
+    {
+        fwrite(&buffer[0], 1, length, file);
+        length = 0;
+        // 超过缓冲区大小的内容直接写入
+        if (dataLength > int(buffer.size()))
+        {
+            fwrite(data, 1, dataLength, file);
+            return;
+        }
+    }
+    memcpy(&buffer[length], data, dataLength);
+    length += dataLength;
+}
+
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ztool
+{
+
+//! 长期打开文件的带缓冲文本写入类
+/*!
+    文件在 open 和 close 之间保持打开, 写入的内容先放在缓冲区中, 
+    缓冲区满, 距离上次写盘超过设定的时间间隔, 调用 flush 或 close 时才写入文件.
+    整数使用自带的格式化函数, 不经过 iostream.
+ */
+class BufferedTextWriter
+{
+public:
+    BufferedTextWriter(void);
+    //! 析构时写入缓冲区中的内容并关闭文件
+    ~BufferedTextWriter(void);
+    //! 打开文件
+    /*!
+        \param[in] path 文件全路径
+        \param[in] append 为 true 时在文件末尾追加, 否则清空文件
+        \param[in] bufferSize 缓冲区大小, 以字节计算
+        \param[in] flushIntervalInMilliSecond 两次写盘之间的最长时间间隔, 小于等于 0 时只在缓冲区满或者显式调用时写盘
+        \return 成功打开返回 true
+     */
+    bool open(const std::string& path, bool append = false, 
+        int bufferSize = 1 << 20, int flushIntervalInMilliSecond = 5000);
+    //! 文件是否打开
+    bool isOpen(void) const;
+    //! 写入字符串
+    BufferedTextWriter& write(const char* str);
+    //! 写入字符串
+    BufferedTextWriter& write(const std::string& str);
+    //! 写入整数, 宽度不足 width 时在左侧补空格, 和 std::setw 的效果相同
+    BufferedTextWriter& write(long long int val, int width = 0);
+    //! 一条完整的记录写完后调用, 检查是否需要写盘
+    void endRecord(void);
+    //! 把缓冲区中的内容写入文件
+    void flush(void);
+    //! 写入缓冲区中的内容并关闭文件
+    void close(void);
+
+private:
+    BufferedTextWriter(const BufferedTextWriter&);
+    BufferedTextWriter& operator=(const BufferedTextWriter&);
+
+    void append(const char* data, int length);
+
+    FILE* file;
+    std::vector<char> buffer;
+    int length;
+    long long int flushIntervalInTicks;
+    long long int lastFlushTick;
+};
+
+}
@@ -340,6 +340,8 @@ bool ConfigFileReader::readLabelContent(const std::string& currLabel, std::ifstr
             break;
         }
 
+        // 读取失败时有的标准库不修改 buf, 先清空, 保证文件末尾不会重复读入最后一个 value
+        buf[0] = 0;
         fileReader >> buf;
         // 如果最后一个 value 后面是换行符 上面一行操作最后一次会读入一个空字符串 
         // 需要用下面的操作过滤掉这个空字符串
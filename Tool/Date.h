@@ -117,10 +117,16 @@ inline bool allowRun(int numDaysAllowed)
     Date to;
     time_t timeVal;
     time(&timeVal);
-    tm* localTime = localtime(&timeVal);
-    to.year = localTime->tm_year + 1900;
-    to.month = localTime->tm_mon + 1;
-    to.day = localTime->tm_mday;
+    // localtime 返回静态存储区的指针, 多线程同时调用时结果可能被覆盖
+    tm localTime;
+#ifdef _WIN32
+    localtime_s(&localTime, &timeVal);
+#else
+    localtime_r(&timeVal, &localTime);
+#endif
+    to.year = localTime.tm_year + 1900;
+    to.month = localTime.tm_mon + 1;
+    to.day = localTime.tm_mday;
 
     Date from;
     from.year = atoi(cmplTimeStr.substr(7, 4).c_str());
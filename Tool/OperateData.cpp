@@ -374,10 +374,9 @@ void calcElemWiseL2Norm(const Mat& src1, const Mat& src2, Mat& dst)
 
 //static float horiArray[3][3] = {{1, 0, -1}, {sqrt(2.0F), 0, -sqrt(2.0F)}, {1, 0, -1}};
 //static float vertArray[3][3] = {{1, sqrt(2.0F), 1}, {0, 0, 0}, {-1, -sqrt(2.0F), -1}};
-static float horiArray[3][3] = {{3, 0, -3}, {10, 0, -10}, {3, 0, -3}};
-static float vertArray[3][3] = {{3, 10, 3}, {0, 0, 0}, {-3, -10, -3}};
-static Mat horiKernel = Mat(3, 3, CV_32F, horiArray);
-static Mat vertKernel = Mat(3, 3, CV_32F, vertArray);
+// 卷积核只读, 每次调用在栈上构造不拥有数据的 Mat 头, 多个线程同时调用时不共享 Mat 的引用计数
+static const float horiArray[3][3] = {{3, 0, -3}, {10, 0, -10}, {3, 0, -3}};
+static const float vertArray[3][3] = {{3, 10, 3}, {0, 0, 0}, {-3, -10, -3}};
 
 namespace ztool
 {
@@ -394,6 +393,8 @@ void calcThresholdedGradient(const Mat& src, Mat& dst, double thres)
     Mat vertGrad = Mat::zeros(src.rows, src.cols, CV_32FC1);
     Mat grad = Mat::zeros(src.rows, src.cols, CV_32FC1);
 
+    const Mat horiKernel(3, 3, CV_32F, (void*)horiArray);
+    const Mat vertKernel(3, 3, CV_32F, (void*)vertArray);
     filter2D(src, horiGrad, horiGrad.depth(), horiKernel);
     filter2D(src, vertGrad, vertGrad.depth(), vertKernel);
     calcElemWiseL1Norm(horiGrad, vertGrad, grad);
@@ -446,6 +447,8 @@ void calcGradient(const Mat& src, Mat& dst, double scale)
     Mat vertGrad = Mat::zeros(src.rows, src.cols, CV_32FC1);
     Mat grad = Mat::zeros(src.rows, src.cols, CV_32FC1);
 
+    const Mat horiKernel(3, 3, CV_32F, (void*)horiArray);
+    const Mat vertKernel(3, 3, CV_32F, (void*)vertArray);
     filter2D(src, horiGrad, horiGrad.depth(), horiKernel);
     filter2D(src, vertGrad, vertGrad.depth(), vertKernel);
     calcElemWiseL1Norm(horiGrad, vertGrad, grad);
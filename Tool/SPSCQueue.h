@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace ztool
+{
+
+//! 单生产者单消费者有界无锁队列
+/*!
+    只允许一个线程调用 tryPush, 另一个线程调用 tryPop.
+    读写位置只由各自的线程修改, 修改通过 CV_XADD 完成, 
+    保证元素写入之后才对另一个线程可见.
+    队列满或者空时直接返回 false, 由调用者决定等待还是放弃.
+ */
+template<typename Type>
+class SPSCQueue
+{
+public:
+    SPSCQueue(void) : head(0), tail(0) {};
+    //! 初始化, capacity 为队列最多能容纳的元素数量
+    void init(int capacity)
+    {
+        buffer.clear();
+        buffer.resize((capacity > 0 ? capacity : 1) + 1);
+        head = tail = 0;
+    }
+    //! 队列最多能容纳的元素数量
+    int capacity(void) const
+    {
+        return int(buffer.size()) - 1;
+    }
+    //! 在队尾插入元素, 只能由生产者线程调用, 队列满时返回 false
+    bool tryPush(const Type& item)
+    {
+        int currTail = load(tail);
+        int nextTail = currTail + 1 == int(buffer.size()) ? 0 : currTail + 1;
+        if (nextTail == load(head))
+            return false;
+        buffer[currTail] = item;
+        CV_XADD(&tail, nextTail - currTail);
+        return true;
+    }
+    //! 从队首取出元素, 只能由消费者线程调用, 队列空时返回 false
+    bool tryPop(Type& item)
+    {
+        int currHead = load(head);
+        if (currHead == load(tail))
+            return false;
+        item = buffer[currHead];
+        int nextHead = currHead + 1 == int(buffer.size()) ? 0 : currHead + 1;
+        CV_XADD(&head, nextHead - currHead);
+        return true;
+    }
+    //! 队列中元素的数量, 多线程下只是一个近似值
+    int size(void)
+    {
+        int diff = load(tail) - load(head);
+        return diff >= 0 ? diff : diff + int(buffer.size());
+    }
+
+private:
+    SPSCQueue(const SPSCQueue&);
+    SPSCQueue& operator=(const SPSCQueue&);
+
+    static int load(int& val)
+    {
+        return CV_XADD(&val, 0);
+    }
+
+    std::vector<Type> buffer;
+    int head;
+    int tail;
+};
+
+}
@@ -0,0 +1,412 @@
+﻿#include <deque>
+#include <vector>
+#include <exception>
+#include "StreamScheduler.h"
+#include "Exception.h"
+
+namespace ztool
+{
+
+struct StreamScheduler::Impl
+{
+    Impl(void);
+    ~Impl(void);
+    void init(int numOfThreads);
+    int addStream(int priority, int queueCapacity);
+    bool submit(int streamID, ThreadFunc func, void* ptrUserData);
+    void flush(int streamID);
+    void flush(void);
+    void stop(void);
+    bool getStreamStatus(int streamID, StreamStatus& status);
+    int getNumOfStreams(void);
+
+    struct Task
+    {
+        ThreadFunc func;
+        void* ptrUserData;
+        long long int submitTick;
+    };
+
+    //! 视频流, 任务队列非空时恰好在一个工作线程的就绪队列中或者正在被一个工作线程执行
+    struct Stream
+    {
+        int priority;
+        int capacity;
+        int homeWorker;          ///< 提交任务时放入这个工作线程的就绪队列
+        bool isScheduled;        ///< 是否在就绪队列中或者正在执行
+        std::deque<Task> tasks;
+        StreamStatus status;
+        double sumOfLatency;
+        int numOfFlushWaiters;   ///< 在 flush(streamID) 中等待的线程数量
+        Semaphore flushed;       ///< 视频流的任务全部执行完毕时唤醒 flush(streamID) 中等待的线程
+        cv::Mutex mtx;
+    };
+
+    //! 工作线程, 两个就绪队列分别存放实时视频流和积压录像的编号
+    struct Worker
+    {
+        Impl* ptrImpl;
+        int index;
+        std::deque<int> ready[2];
+        cv::Mutex mtx;
+        Thread thread;
+    };
+
+    static void workEntry(void* ptrWorker);
+    void work(int index);
+    Stream* getStream(int streamID);
+    void pushReady(int workerIndex, int streamID, int priority);
+    bool popReady(int workerIndex, int& streamID);
+    void runStream(int workerIndex, int streamID);
+
+    std::vector<cv::Ptr<Worker> > workers;
+    std::vector<cv::Ptr<Stream> > streams;
+    cv::Mutex streamsMtx;
+    AtomicFlag stopFlag;
+    //! 计数等于所有就绪队列中的视频流数量, 空闲的工作线程在上面休眠, stop 时为每个线程再加一个计数
+    cv::Ptr<Semaphore> numOfReady;
+    cv::Mutex finishMtx;
+    int numOfUnfinished;      ///< 已提交未执行完毕的任务数量, 由 finishMtx 保护
+    int numOfFlushWaiters;    ///< 在 flush() 中等待的线程数量, 由 finishMtx 保护
+    Semaphore allFinished;    ///< 所有任务执行完毕时唤醒 flush() 中等待的线程
+    double tickFreq;
+};
+
+StreamScheduler::Impl::Impl(void)
+    : numOfUnfinished(0), numOfFlushWaiters(0)
+{
+    tickFreq = cv::getTickFrequency();
+}
+
+StreamScheduler::Impl::~Impl(void)
+{
+    stop();
+}
+
+void StreamScheduler::Impl::init(int numOfThreads)
+{
+    stop();
+
+    {
+        cv::AutoLock lock(streamsMtx);
+        streams.clear();
+    }
+    stopFlag.reset();
+    // 重新初始化时丢弃上一轮残留的信号量计数
+    numOfReady = new Semaphore;
+    int numOfWorkers = numOfThreads > 0 ? numOfThreads : cv::getNumberOfCPUs();
+    workers.resize(numOfWorkers);
+    for (int i = 0; i < numOfWorkers; i++)
+    {
+        workers[i] = new Worker;
+        workers[i]->ptrImpl = this;
+        workers[i]->index = i;
+    }
+    // 先创建所有工作线程的数据, 再启动线程, 窃取时不会访问未创建的工作线程
+    for (int i = 0; i < numOfWorkers; i++)
+    {
+        if (!workers[i]->thread.start(workEntry, (Worker*)workers[i]))
+        {
+            stop();
+            THROW_EXCEPT("cannot start stream scheduler thread");
+        }
+    }
+}
+
+int StreamScheduler::Impl::addStream(int priority, int queueCapacity)
+{
+    cv::Ptr<Stream> ptrStream = new Stream;
+    ptrStream->priority = priority == StreamPriority::Live ? StreamPriority::Live : StreamPriority::Backlog;
+    ptrStream->capacity = queueCapacity;
+    ptrStream->isScheduled = false;
+    ptrStream->sumOfLatency = 0;
+    ptrStream->numOfFlushWaiters = 0;
+    StreamStatus& status = ptrStream->status;
+    status.priority = ptrStream->priority;
+    status.queueDepth = 0;
+    status.maxQueueDepth = 0;
+    status.numOfSubmitted = 0;
+    status.numOfFinished = 0;
+    status.numOfFailed = 0;
+    status.numOfDropped = 0;
+    status.lastLatency = 0;
+    status.meanLatency = 0;
+    status.maxLatency = 0;
+
+    cv::AutoLock lock(streamsMtx);
+    int streamID = streams.size();
+    // 视频流轮流分配给各个工作线程
+    ptrStream->homeWorker = workers.empty() ? 0 : streamID % (int)workers.size();
+    streams.push_back(ptrStream);
+    return streamID;
+}
+
+StreamScheduler::Impl::Stream* StreamScheduler::Impl::getStream(int streamID)
+{
+    // 视频流创建后不会删除, 返回的指针在 init 或析构之前一直有效
+    cv::AutoLock lock(streamsMtx);
+    if (streamID < 0 || streamID >= (int)streams.size())
+        return 0;
+    return streams[streamID];
+}
+
+bool StreamScheduler::Impl::submit(int streamID, ThreadFunc func, void* ptrUserData)
+{
+    Stream* ptrStream = getStream(streamID);
+    if (!ptrStream || !func || workers.empty())
+        return false;
+
+    Task task;
+    task.func = func;
+    task.ptrUserData = ptrUserData;
+    task.submitTick = cv::getTickCount();
+
+    cv::AutoLock lock(ptrStream->mtx);
+    StreamStatus& status = ptrStream->status;
+    status.numOfSubmitted++;
+    if (ptrStream->capacity > 0 && (int)ptrStream->tasks.size() >= ptrStream->capacity)
+    {
+        status.numOfDropped++;
+        return false;
+    }
+    ptrStream->tasks.push_back(task);
+    {
+        cv::AutoLock finishLock(finishMtx);
+        numOfUnfinished++;
+    }
+    status.queueDepth = ptrStream->tasks.size();
+    if (status.queueDepth > status.maxQueueDepth)
+        status.maxQueueDepth = status.queueDepth;
+    if (!ptrStream->isScheduled)
+    {
+        ptrStream->isScheduled = true;
+        pushReady(ptrStream->homeWorker, streamID, ptrStream->priority);
+    }
+    return true;
+}
+
+void StreamScheduler::Impl::flush(int streamID)
+{
+    Stream* ptrStream = getStream(streamID);
+    if (!ptrStream)
+        return;
+    while (true)
+    {
+        {
+            cv::AutoLock lock(ptrStream->mtx);
+            if (!ptrStream->isScheduled)
+                return;
+            ptrStream->numOfFlushWaiters++;
+        }
+        ptrStream->flushed.wait();
+    }
+}
+
+void StreamScheduler::Impl::flush(void)
+{
+    while (true)
+    {
+        {
+            cv::AutoLock lock(finishMtx);
+            if (numOfUnfinished <= 0)
+                return;
+            numOfFlushWaiters++;
+        }
+        allFinished.wait();
+    }
+}
+
+void StreamScheduler::Impl::stop(void)
+{
+    if (workers.empty())
+        return;
+
+    flush();
+    stopFlag.set();
+    int numOfWorkers = workers.size();
+    numOfReady->post(numOfWorkers);
+    for (int i = 0; i < numOfWorkers; i++)
+        workers[i]->thread.join();
+    workers.clear();
+}
+
+bool StreamScheduler::Impl::getStreamStatus(int streamID, StreamStatus& status)
+{
+    Stream* ptrStream = getStream(streamID);
+    if (!ptrStream)
+        return false;
+    cv::AutoLock lock(ptrStream->mtx);
+    status = ptrStream->status;
+    return true;
+}
+
+int StreamScheduler::Impl::getNumOfStreams(void)
+{
+    cv::AutoLock lock(streamsMtx);
+    return streams.size();
+}
+
+void StreamScheduler::Impl::pushReady(int workerIndex, int streamID, int priority)
+{
+    Worker& worker = *workers[workerIndex];
+    {
+        cv::AutoLock lock(worker.mtx);
+        worker.ready[priority].push_back(streamID);
+    }
+    numOfReady->post();
+}
+
+bool StreamScheduler::Impl::popReady(int workerIndex, int& streamID)
+{
+    int numOfWorkers = workers.size();
+    for (int priority = StreamPriority::Live; priority <= StreamPriority::Backlog; priority++)
+    {
+        // 先从自己的就绪队列头部取, 保证各个视频流轮流执行
+        {
+            Worker& self = *workers[workerIndex];
+            cv::AutoLock lock(self.mtx);
+            if (!self.ready[priority].empty())
+            {
+                streamID = self.ready[priority].front();
+                self.ready[priority].pop_front();
+                return true;
+            }
+        }
+        // 再从其他线程的就绪队列尾部窃取, 同一优先级的任务都取完之后才处理更低的优先级
+        for (int i = 1; i < numOfWorkers; i++)
+        {
+            Worker& victim = *workers[(workerIndex + i) % numOfWorkers];
+            cv::AutoLock lock(victim.mtx);
+            if (!victim.ready[priority].empty())
+            {
+                streamID = victim.ready[priority].back();
+                victim.ready[priority].pop_back();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void StreamScheduler::Impl::runStream(int workerIndex, int streamID)
+{
+    Stream* ptrStream = getStream(streamID);
+    Task task;
+    {
+        cv::AutoLock lock(ptrStream->mtx);
+        task = ptrStream->tasks.front();
+        ptrStream->tasks.pop_front();
+        ptrStream->status.queueDepth = ptrStream->tasks.size();
+    }
+
+    bool success = true;
+    try
+    {
+        task.func(task.ptrUserData);
+    }
+    catch (const std::exception&)
+    {
+        success = false;
+    }
+    double latency = double(cv::getTickCount() - task.submitTick) / tickFreq * 1000;
+
+    {
+        cv::AutoLock lock(ptrStream->mtx);
+        StreamStatus& status = ptrStream->status;
+        status.numOfFinished++;
+        if (!success)
+            status.numOfFailed++;
+        status.lastLatency = latency;
+        ptrStream->sumOfLatency += latency;
+        status.meanLatency = ptrStream->sumOfLatency / status.numOfFinished;
+        if (latency > status.maxLatency)
+            status.maxLatency = latency;
+        // 还有任务时放回当前线程的就绪队列尾部, 下一个任务仍然在前一个任务执行完之后才开始
+        if (!ptrStream->tasks.empty())
+            pushReady(workerIndex, streamID, ptrStream->priority);
+        else
+        {
+            ptrStream->isScheduled = false;
+            if (ptrStream->numOfFlushWaiters > 0)
+            {
+                ptrStream->flushed.post(ptrStream->numOfFlushWaiters);
+                ptrStream->numOfFlushWaiters = 0;
+            }
+        }
+    }
+
+    cv::AutoLock finishLock(finishMtx);
+    if (--numOfUnfinished == 0 && numOfFlushWaiters > 0)
+    {
+        allFinished.post(numOfFlushWaiters);
+        numOfFlushWaiters = 0;
+    }
+}
+
+void StreamScheduler::Impl::workEntry(void* ptrWorker)
+{
+    Worker* ptr = (Worker*)ptrWorker;
+    ptr->ptrImpl->work(ptr->index);
+}
+
+void StreamScheduler::Impl::work(int index)
+{
+    while (true)
+    {
+        // 每个就绪的视频流对应一个计数, 取到计数后一定能从某个就绪队列中取到视频流,
+        // 除非是 stop 增加的计数
+        numOfReady->wait();
+        int streamID;
+        if (popReady(index, streamID))
+            runStream(index, streamID);
+        else if (stopFlag.isSet())
+            return;
+    }
+}
+
+StreamScheduler::StreamScheduler(void)
+{
+    ptrImpl = new Impl;
+}
+
+StreamScheduler::~StreamScheduler(void)
+{
+    ptrImpl->stop();
+}
+
+void StreamScheduler::init(int numOfThreads)
+{
+    ptrImpl->init(numOfThreads);
+}
+
+int StreamScheduler::addStream(int priority, int queueCapacity)
+{
+    return ptrImpl->addStream(priority, queueCapacity);
+}
+
+bool StreamScheduler::submit(int streamID, ThreadFunc func, void* ptrUserData)
+{
+    return ptrImpl->submit(streamID, func, ptrUserData);
+}
+
+void StreamScheduler::flush(int streamID)
+{
+    ptrImpl->flush(streamID);
+}
+
+void StreamScheduler::flush(void)
+{
+    ptrImpl->flush();
+}
+
+bool StreamScheduler::getStreamStatus(int streamID, StreamStatus& status)
+{
+    return ptrImpl->getStreamStatus(streamID, status);
+}
+
+int StreamScheduler::getNumOfStreams(void)
+{
+    return ptrImpl->getNumOfStreams();
+}
+
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <opencv2/core/core.hpp>
+#include "Thread.h"
+
+namespace ztool
+{
+
+//! 视频流的优先级
+struct StreamPriority
+{
+    enum
+    {
+        Live = 0,     ///< 实时视频流, 优先处理
+        Backlog = 1   ///< 积压的录像, 没有实时视频流的任务时才处理
+    };
+};
+
+//! 单个视频流的统计信息, 延迟是从提交任务到任务执行完毕的时间, 以毫秒计算
+struct StreamStatus
+{
+    int priority;         ///< 优先级, StreamPriority 中的值
+    int queueDepth;       ///< 当前等待执行的任务数量
+    int maxQueueDepth;    ///< 等待执行的任务数量的最大值
+    int numOfSubmitted;   ///< 提交的任务数量
+    int numOfFinished;    ///< 执行完毕的任务数量, 包括抛出异常的任务
+    int numOfFailed;      ///< 抛出异常的任务数量
+    int numOfDropped;     ///< 队列满时被拒绝的任务数量
+    double lastLatency;   ///< 最近一个任务的延迟
+    double meanLatency;   ///< 平均延迟
+    double maxLatency;    ///< 最大延迟
+};
+
+//! 多路视频流的任务调度器
+/*!
+    固定数量的工作线程处理所有视频流的任务, 每个任务通常是某一路视频的一帧.
+    同一路视频流的任务严格按提交顺序串行执行, 不同视频流之间不共享可变状态,
+    每路视频的检测器等状态只会被一个线程访问, 不需要加锁.
+    每个工作线程有自己的就绪队列, 空闲时从其他线程的就绪队列中窃取视频流,
+    繁忙和空闲的摄像头混合时所有线程的负载仍然均衡, 没有任务时工作线程阻塞在信号量上, 不轮询.
+    实时视频流优先于积压的录像.
+ */
+class StreamScheduler
+{
+public:
+    StreamScheduler(void);
+    //! 析构前会等待所有已提交的任务执行完毕
+    ~StreamScheduler(void);
+    //! 初始化
+    /*!
+        已经初始化过时先等待所有已提交的任务执行完毕, 并清空所有视频流.
+        工作线程启动失败时停止已经启动的线程并抛出异常
+        \param[in] numOfThreads 工作线程数量, 小于等于 0 时等于 CPU 核数
+     */
+    void init(int numOfThreads = 0);
+    //! 添加视频流
+    /*!
+        \param[in] priority 优先级, StreamPriority 中的值
+        \param[in] queueCapacity 等待执行的任务数量上限, 小于等于 0 时不限制
+        \return 视频流编号
+     */
+    int addStream(int priority, int queueCapacity = 0);
+    //! 提交任务
+    /*!
+        任务在工作线程中调用 func(ptrUserData), ptrUserData 的生命周期由调用者保证.
+        任务抛出的 std::exception 被捕获并计入 numOfFailed, 不影响后续任务.
+        \param[in] streamID 视频流编号
+        \param[in] func 任务函数
+        \param[in] ptrUserData 传递给任务函数的参数
+        \return 成功提交返回 true, 视频流编号无效或者队列满时返回 false, 实时视频流可以据此丢帧
+     */
+    bool submit(int streamID, ThreadFunc func, void* ptrUserData);
+    //! 等待编号为 streamID 的视频流已提交的任务执行完毕
+    void flush(int streamID);
+    //! 等待所有已提交的任务执行完毕
+    void flush(void);
+    //! 获取视频流的统计信息, 视频流编号无效时返回 false
+    bool getStreamStatus(int streamID, StreamStatus& status);
+    //! 视频流的数量
+    int getNumOfStreams(void);
+
+private:
+    StreamScheduler(const StreamScheduler&);
+    StreamScheduler& operator=(const StreamScheduler&);
+
+    struct Impl;
+    cv::Ptr<Impl> ptrImpl;
+};
+
+}
@@ -0,0 +1,210 @@
+﻿#if WIN32 || _WIN32
+#   include <windows.h>
+#   include <process.h>
+#else
+#   include <pthread.h>
+#   include <sched.h>
+#   include <unistd.h>
+#   include <errno.h>
+#   include <sys/time.h>
+#endif
+
+#include "Thread.h"
+#include "Exception.h"
+
+namespace
+{
+
+struct ThreadStartInfo
+{
+    ztool::ThreadFunc func;
+    void* ptrUserData;
+};
+
+#if WIN32 || _WIN32
+unsigned __stdcall threadEntry(void* ptrStartInfo)
+{
+    ThreadStartInfo* info = (ThreadStartInfo*)ptrStartInfo;
+    info->func(info->ptrUserData);
+    return 0;
+}
+#else
+void* threadEntry(void* ptrStartInfo)
+{
+    ThreadStartInfo* info = (ThreadStartInfo*)ptrStartInfo;
+    info->func(info->ptrUserData);
+    return 0;
+}
+#endif
+
+}
+
+namespace ztool
+{
+
+struct Thread::Impl
+{
+    Impl(void) : isStarted(false) {};
+
+    ThreadStartInfo startInfo;
+    bool isStarted;
+#if WIN32 || _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+};
+
+Thread::Thread(void)
+{
+    ptrImpl = new Impl;
+}
+
+Thread::~Thread(void)
+{
+    join();
+}
+
+bool Thread::start(ThreadFunc func, void* ptrUserData)
+{
+    if (ptrImpl->isStarted || !func)
+        return false;
+
+    ptrImpl->startInfo.func = func;
+    ptrImpl->startInfo.ptrUserData = ptrUserData;
+#if WIN32 || _WIN32
+    ptrImpl->handle = (HANDLE)_beginthreadex(0, 0, threadEntry, &ptrImpl->startInfo, 0, 0);
+    ptrImpl->isStarted = (ptrImpl->handle != 0);
+#else
+    ptrImpl->isStarted = (pthread_create(&ptrImpl->handle, 0, threadEntry, &ptrImpl->startInfo) == 0);
+#endif
+    return ptrImpl->isStarted;
+}
+
+void Thread::join(void)
+{
+    if (!ptrImpl->isStarted)
+        return;
+
+#if WIN32 || _WIN32
+    WaitForSingleObject(ptrImpl->handle, INFINITE);
+    CloseHandle(ptrImpl->handle);
+#else
+    pthread_join(ptrImpl->handle, 0);
+#endif
+    ptrImpl->isStarted = false;
+}
+
+bool Thread::joinable(void) const
+{
+    return ptrImpl->isStarted;
+}
+
+struct Semaphore::Impl
+{
+#if WIN32 || _WIN32
+    HANDLE handle;
+#else
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    int count;
+#endif
+};
+
+Semaphore::Semaphore(void)
+{
+    ptrImpl = new Impl;
+#if WIN32 || _WIN32
+    ptrImpl->handle = CreateSemaphore(0, 0, 0x7fffffff, 0);
+    if (!ptrImpl->handle)
+        THROW_EXCEPT("cannot create semaphore");
+#else
+    ptrImpl->count = 0;
+    if (pthread_mutex_init(&ptrImpl->mtx, 0) != 0)
+        THROW_EXCEPT("cannot create semaphore");
+    if (pthread_cond_init(&ptrImpl->cond, 0) != 0)
+    {
+        pthread_mutex_destroy(&ptrImpl->mtx);
+        THROW_EXCEPT("cannot create semaphore");
+    }
+#endif
+}
+
+Semaphore::~Semaphore(void)
+{
+#if WIN32 || _WIN32
+    CloseHandle(ptrImpl->handle);
+#else
+    pthread_cond_destroy(&ptrImpl->cond);
+    pthread_mutex_destroy(&ptrImpl->mtx);
+#endif
+}
+
+void Semaphore::post(void)
+{
+    post(1);
+}
+
+void Semaphore::post(int count)
+{
+    if (count <= 0)
+        return;
+#if WIN32 || _WIN32
+    ReleaseSemaphore(ptrImpl->handle, count, 0);
+#else
+    pthread_mutex_lock(&ptrImpl->mtx);
+    ptrImpl->count += count;
+    if (count == 1)
+        pthread_cond_signal(&ptrImpl->cond);
+    else
+        pthread_cond_broadcast(&ptrImpl->cond);
+    pthread_mutex_unlock(&ptrImpl->mtx);
+#endif
+}
+
+bool Semaphore::wait(int milliSecond)
+{
+#if WIN32 || _WIN32
+    return WaitForSingleObject(ptrImpl->handle, milliSecond < 0 ? INFINITE : milliSecond) == WAIT_OBJECT_0;
+#else
+    timespec deadline;
+    if (milliSecond >= 0)
+    {
+        timeval now;
+        gettimeofday(&now, 0);
+        long long int nanoSecond = (long long int)now.tv_usec * 1000 + (long long int)(milliSecond % 1000) * 1000000;
+        deadline.tv_sec = now.tv_sec + milliSecond / 1000 + (time_t)(nanoSecond / 1000000000);
+        deadline.tv_nsec = (long)(nanoSecond % 1000000000);
+    }
+    pthread_mutex_lock(&ptrImpl->mtx);
+    bool success = true;
+    while (ptrImpl->count <= 0)
+    {
+        if (milliSecond < 0)
+            pthread_cond_wait(&ptrImpl->cond, &ptrImpl->mtx);
+        else if (pthread_cond_timedwait(&ptrImpl->cond, &ptrImpl->mtx, &deadline) == ETIMEDOUT)
+        {
+            success = ptrImpl->count > 0;
+            break;
+        }
+    }
+    if (success)
+        ptrImpl->count--;
+    pthread_mutex_unlock(&ptrImpl->mtx);
+    return success;
+#endif
+}
+
+void sleepInMilliSecond(int milliSecond)
+{
+#if WIN32 || _WIN32
+    Sleep(milliSecond > 0 ? milliSecond : 0);
+#else
+    if (milliSecond > 0)
+        usleep(milliSecond * 1000);
+    else
+        sched_yield();
+#endif
+}
+
+}
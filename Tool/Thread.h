@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <opencv2/core/core.hpp>
+
+namespace ztool
+{
+
+//! 线程函数类型
+typedef void (*ThreadFunc)(void* ptrUserData);
+
+//! 简单的线程封装, Windows 下使用 Win32 线程, 其他平台使用 pthread
+/*!
+    析构时如果线程仍在运行, 会等待线程结束
+ */
+class Thread
+{
+public:
+    Thread(void);
+    ~Thread(void);
+    //! 启动线程
+    /*!
+        \param[in] func 线程函数
+        \param[in,out] ptrUserData 传递给线程函数的参数
+        \return 成功启动返回 true, 如果线程已经启动或者创建失败返回 false
+     */
+    bool start(ThreadFunc func, void* ptrUserData);
+    //! 等待线程结束, 线程没有启动时直接返回
+    void join(void);
+    //! 线程是否已经启动并且尚未 join
+    bool joinable(void) const;
+
+private:
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+
+    struct Impl;
+    cv::Ptr<Impl> ptrImpl;
+};
+
+//! 当前线程休眠若干毫秒, milliSecond 小于等于 0 时让出时间片
+void sleepInMilliSecond(int milliSecond);
+
+//! 计数信号量, 用于线程之间的阻塞等待, 代替轮询加休眠
+/*!
+    Windows 下使用 Win32 信号量, 其他平台使用 pthread 互斥量和条件变量实现
+ */
+class Semaphore
+{
+public:
+    Semaphore(void);
+    ~Semaphore(void);
+    //! 计数加一, 唤醒一个等待的线程
+    void post(void);
+    //! 计数加 count, 最多唤醒 count 个等待的线程
+    void post(int count);
+    //! 等待计数大于零后把计数减一
+    /*!
+        \param[in] milliSecond 最长等待时间, 小于 0 表示一直等待
+        \return 计数成功减一返回 true, 超时返回 false
+     */
+    bool wait(int milliSecond = -1);
+
+private:
+    Semaphore(const Semaphore&);
+    Semaphore& operator=(const Semaphore&);
+
+    struct Impl;
+    cv::Ptr<Impl> ptrImpl;
+};
+
+//! 多线程之间共享的标志位, 读写都在互斥量保护下完成, 保证写入对其他线程可见
+/*!
+    多个线程同时 set 或者 reset 时, 标志位只会是置位或者未置位两种状态之一
+ */
+class AtomicFlag
+{
+public:
+    AtomicFlag(void) : val(false) {};
+    void set(void) {cv::AutoLock lock(mtx); val = true;};
+    void reset(void) {cv::AutoLock lock(mtx); val = false;};
+    bool isSet(void) {cv::AutoLock lock(mtx); return val;};
+private:
+    AtomicFlag(const AtomicFlag&);
+    AtomicFlag& operator=(const AtomicFlag&);
+
+    cv::Mutex mtx;
+    bool val;
+};
+
+}